@@ -69,8 +69,8 @@ set(FLOATS_LIST "half" "float" "double" "hip_bfloat16" "rccl_float8" "rccl_bfloa
 set(AllGather_Params     "RING" "*"      "Sum" "int8_t")
 set(AllReduce_Params     "*"    "*"      "*"   "*")
 set(AllToAllPivot_Params "RING" "SIMPLE" "Sum" "int8_t")
-set(Broadcast_Params     "RING" "*"      "Sum" "int8_t")
-set(Reduce_Params        "RING" "*"      "*"   "*")
+set(Broadcast_Params     "TREE/RING" "*" "Sum" "int8_t")
+set(Reduce_Params        "TREE/RING" "*" "*"   "*")
 set(ReduceScatter_Params "RING" "*"      "*"   "*")
 set(SendRecv_Params      "RING" "SIMPLE" "Sum" "int8_t")
 
@@ -15,6 +15,9 @@
 #include "signals.h" // [RCCL]
 #include "param.h"
 
+// Maximum number of connections the root accepts before reading them
+#define BOOTSTRAP_ACCEPT_BATCH 256
+
 struct bootstrapRootArgs {
   struct ncclSocket* listenSock;
   uint64_t magic;
@@ -105,6 +108,8 @@ static void *bootstrapRoot(void* rargs) {
   uint64_t magic = args->magic;
   ncclResult_t res = ncclSuccess;
   int nranks = 0, c = 0;
+  int listenFd, nSocks = 0;
+  struct ncclSocket socks[BOOTSTRAP_ACCEPT_BATCH];
   struct extInfo info;
   union ncclSocketAddress *rankAddresses = NULL;
   union ncclSocketAddress *rankAddressesRoot = NULL; // for initial rank <-> root information exchange
@@ -113,36 +118,50 @@ static void *bootstrapRoot(void* rargs) {
   setFilesLimit();
 
   TRACE(NCCL_INIT, "BEGIN");
+  NCCLCHECKGOTO(ncclSocketGetFd(listenSock, &listenFd), res, out);
   /* Receive addresses from all ranks */
   do {
-    struct ncclSocket sock;
-    NCCLCHECKGOTO(ncclSocketInit(&sock), res, out);
-    NCCLCHECKGOTO(ncclSocketAccept(&sock, listenSock), res, out);
-    NCCLCHECKGOTO(bootstrapNetRecv(&sock, &info, sizeof(info)), res, out);
-    NCCLCHECKGOTO(ncclSocketClose(&sock), res, out);
-
-    if (c == 0) {
-      nranks = info.nranks;
-      NCCLCHECKGOTO(ncclCalloc(&rankAddresses, nranks), res, out);
-      NCCLCHECKGOTO(ncclCalloc(&rankAddressesRoot, nranks), res, out);
-    }
+    // Accept every connection already queued before reading from them, so
+    // that the listen backlog drains as fast as ranks arrive and their SYNs
+    // are not dropped.
+    nSocks = 0;
+    do {
+      NCCLCHECKGOTO(ncclSocketInit(socks+nSocks), res, out);
+      NCCLCHECKGOTO(ncclSocketAccept(socks+nSocks, listenSock), res, out);
+      nSocks++;
+      struct pollfd pfd = { listenFd, POLLIN, 0 };
+      if (poll(&pfd, 1, 0) != 1) break;
+    } while (nSocks < BOOTSTRAP_ACCEPT_BATCH && (c == 0 || c+nSocks < nranks));
+    if (nSocks > 1) TRACE(NCCL_INIT, "Accepted %d pending connections", nSocks);
+
+    for (int s=0; s<nSocks; s++) {
+      NCCLCHECKGOTO(bootstrapNetRecv(socks+s, &info, sizeof(info)), res, out);
+      NCCLCHECKGOTO(ncclSocketClose(socks+s), res, out);
+
+      if (c == 0) {
+        nranks = info.nranks;
+        NCCLCHECKGOTO(ncclCalloc(&rankAddresses, nranks), res, out);
+        NCCLCHECKGOTO(ncclCalloc(&rankAddressesRoot, nranks), res, out);
+      }
 
-    if (nranks != info.nranks) {
-      WARN("Bootstrap Root : mismatch in rank count from procs %d : %d", nranks, info.nranks);
-      goto out;
-    }
+      if (nranks != info.nranks) {
+        WARN("Bootstrap Root : mismatch in rank count from procs %d : %d", nranks, info.nranks);
+        goto out;
+      }
 
-    if (memcmp(zero, &rankAddressesRoot[info.rank], sizeof(union ncclSocketAddress)) != 0) {
-      WARN("Bootstrap Root : rank %d of %d ranks has already checked in", info.rank, nranks);
-      goto out;
-    }
+      if (memcmp(zero, &rankAddressesRoot[info.rank], sizeof(union ncclSocketAddress)) != 0) {
+        WARN("Bootstrap Root : rank %d of %d ranks has already checked in", info.rank, nranks);
+        goto out;
+      }
 
-    // Save the connection handle for that rank
-    memcpy(rankAddressesRoot+info.rank, &info.extAddressListenRoot, sizeof(union ncclSocketAddress));
-    memcpy(rankAddresses+info.rank, &info.extAddressListen, sizeof(union ncclSocketAddress));
+      // Save the connection handle for that rank
+      memcpy(rankAddressesRoot+info.rank, &info.extAddressListenRoot, sizeof(union ncclSocketAddress));
+      memcpy(rankAddresses+info.rank, &info.extAddressListen, sizeof(union ncclSocketAddress));
 
-    ++c;
-    TRACE(NCCL_INIT, "Received connect from rank %d total %d/%d",  info.rank, c, nranks);
+      ++c;
+      TRACE(NCCL_INIT, "Received connect from rank %d total %d/%d",  info.rank, c, nranks);
+    }
+    nSocks = 0;
   } while (c < nranks);
   TRACE(NCCL_INIT, "COLLECTED ALL %d HANDLES", nranks);
 
@@ -158,6 +177,9 @@ static void *bootstrapRoot(void* rargs) {
   TRACE(NCCL_INIT, "SENT OUT ALL %d HANDLES", nranks);
 
 out:
+  for (int s=0; s<nSocks; s++) {
+    if (socks[s].fd != -1) ncclSocketClose(socks+s);
+  }
   if (listenSock != NULL) {
     ncclSocketClose(listenSock);
     free(listenSock);
@@ -317,6 +339,13 @@ ncclResult_t bootstrapInit(struct ncclBootstrapHandle* handle, struct ncclComm*
   NCCLCHECK(bootstrapAllGather(state, state->peerProxyAddressesUDS, sizeof(*state->peerProxyAddressesUDS)));
   NCCLCHECK(ncclProxyInit(comm, proxySocket, state->peerProxyAddresses, state->peerProxyAddressesUDS));
 
+  struct ncclSocketStats stats;
+  ncclSocketGetStats(&stats);
+  if (stats.refusedRetries || stats.timedOutRetries) {
+    INFO(NCCL_INIT, "Bootstrap : %lu connects, %lu refused and %lu timed out retries, %lu usec of backoff, slowest connect %lu usec",
+        stats.connects, stats.refusedRetries, stats.timedOutRetries, stats.backoffUs, stats.maxConnectUs);
+  }
+
   TRACE(NCCL_INIT, "rank %d nranks %d - DONE", rank, nranks);
 
   return ncclSuccess;
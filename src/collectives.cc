@@ -10,6 +10,9 @@
 #include "graph/topo.h"
 #include "nccl.h"
 #include "api_trace.h"
+#include "group.h"
+#include "gather_tree.h"
+#include "coll_v.h"
 
 #include "msccl/msccl_lifecycle.h"
 
@@ -37,6 +40,33 @@ ncclResult_t ncclAllGather_impl(const void* sendbuff, void* recvbuff, size_t sen
   return ncclEnqueueCheck(&info);
 }
 
+NCCL_API(ncclResult_t, ncclAllGatherv, const void* sendbuff, size_t sendcount, void* recvbuff,
+    const size_t recvcounts[], const size_t rdispls[], ncclDataType_t datatype, ncclComm_t comm, hipStream_t stream);
+
+ncclResult_t ncclAllGatherv_impl(const void* sendbuff, size_t sendcount, void* recvbuff,
+    const size_t recvcounts[], const size_t rdispls[], ncclDataType_t datatype, ncclComm_t comm, hipStream_t stream) {
+  NCCLCHECK(PtrCheck(comm, "AllGatherv", "comm"));
+  NCCLCHECK(PtrCheck((void*)recvcounts, "AllGatherv", "recvcounts"));
+  NCCLCHECK(PtrCheck((void*)rdispls, "AllGatherv", "rdispls"));
+  // Just pass the size of one message and not the total bytes sent/received.
+  constexpr nvtxPayloadSchemaEntry_t AllGathervSchema[] = {
+    {0, NVTX_PAYLOAD_ENTRY_TYPE_SIZE, "Message size [bytes]"}
+  };
+  size_t msgsize = sendcount * ncclTypeSize(datatype);
+  NVTX3_FUNC_WITH_PARAMS(AllGatherv, AllGathervSchema, msgsize)
+
+  if (sendcount != recvcounts[comm->rank]) {
+    WARN("AllGatherv : sendcount %ld does not match recvcounts[%d] %ld", sendcount, comm->rank, recvcounts[comm->rank]);
+    return ncclInvalidArgument;
+  }
+
+  // Planned as one AllGather of the largest count, see coll_v.h
+  struct ncclInfo info = { ncclFuncAllGather, "AllGatherv",
+    sendbuff, recvbuff, ncclCollVMaxCount(recvcounts, comm->nRanks), datatype, ncclSum, 0, comm, stream, /* Args */
+    ALLGATHER_CHUNKSTEPS, ALLGATHER_SLICESTEPS, recvcounts, rdispls };
+  return ncclEnqueueCheck(&info);
+}
+
 NCCL_API(ncclResult_t, ncclAllReduce, const void* sendbuff, void* recvbuff, size_t count,
     ncclDataType_t datatype, ncclRedOp_t op, ncclComm* comm, cudaStream_t stream);
 
@@ -194,6 +224,141 @@ ncclResult_t ncclBcast(void* buff, size_t count, ncclDataType_t datatype, int ro
   return ncclBroadcast(buff, buff, count, datatype, root, comm, stream);
 }
 
+// Gather/Scatter of up to this many bytes in total use a topology-aware k-nomial
+// tree rather than having the root talk to every rank. 0 disables the tree.
+RCCL_PARAM(GatherTreeMaxBytes, "GATHER_TREE_MAX_BYTES", 4 << 20);
+// Radix of the trees within a node and between node leaders, 0 is flat
+RCCL_PARAM(GatherTreeIntraRadix, "GATHER_TREE_INTRA_RADIX", 0);
+RCCL_PARAM(GatherTreeInterRadix, "GATHER_TREE_INTER_RADIX", 2);
+
+static bool gatherTreeEnabled(const char* opName, ncclComm_t comm, size_t bytes, int root) {
+  size_t maxBytes = rcclParamGatherTreeMaxBytes();
+  // An invalid root is left to the checks of the direct path.
+  if (maxBytes == 0 || comm->nNodes == 1 || bytes*comm->nRanks > maxBytes || root < 0 || root >= comm->nRanks) return false;
+  // Steps are ordered by separate groups, which a user group would merge. A nonblocking
+  // communicator would still be in progress when the next step is issued.
+  if (ncclGroupDepth > 0 || !comm->config.blocking) {
+    INFO(NCCL_COLL, "%s: comm %p root %d uses the flat path rather than the gather tree, called %s",
+        opName, comm, root, ncclGroupDepth > 0 ? "inside a group" : "on a nonblocking communicator");
+    return false;
+  }
+  return true;
+}
+
+// Schedule of this rank for root, built on first use and freed with the communicator
+static ncclResult_t gatherTreeSchedule(ncclComm_t comm, int root, struct ncclGatherTreeSchedule** schedule) {
+  ncclResult_t ret = ncclSuccess;
+  int nRanks = comm->nRanks, nNodes = comm->nNodes, pos = 0;
+  int* nodeStart = NULL;
+  struct ncclGatherTreeSchedule* s = NULL;
+  if (comm->gatherTreeSchedules == NULL) NCCLCHECK(ncclCalloc(&comm->gatherTreeSchedules, nRanks));
+  if (comm->gatherTreeSchedules[root]) {
+    *schedule = comm->gatherTreeSchedules[root];
+    return ncclSuccess;
+  }
+  NCCLCHECK(ncclCalloc(&s, 1));
+  NCCLCHECKGOTO(ncclCalloc(&s->order, nRanks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&s->plan.children, nRanks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&nodeStart, nNodes+1), ret, fail);
+  ncclGatherTreeOrder(nRanks, comm->rankToNode, nNodes, root, s->order, nodeStart);
+  while (s->order[pos] != comm->rank) pos++;
+  ncclGatherTreeBuild(nNodes, s->order, nodeStart, pos, rcclParamGatherTreeIntraRadix(), rcclParamGatherTreeInterRadix(), &s->plan);
+  comm->gatherTreeSchedules[root] = *schedule = s;
+exit:
+  free(nodeStart);
+  return ret;
+fail:
+  free(s->order);
+  free(s->plan.children);
+  free(s);
+  goto exit;
+}
+
+// Send or receive the blocks of positions [first, first+count), one operation per
+// run of consecutive ranks. Blocks are placed in buff by rank.
+static ncclResult_t gatherTreeXfer(bool send, char* buff, size_t count, ncclDataType_t datatype, const int* order,
+    struct ncclGatherTreeXfer* x, ncclComm_t comm, hipStream_t stream) {
+  size_t rankOffset = count * ncclTypeSize(datatype);
+  for (int p=x->first; p<x->first+x->count; ) {
+    int r = order[p], n = 1;
+    while (p+n < x->first+x->count && order[p+n] == r+n) n++;
+    if (send) {
+      NCCLCHECK(ncclSend(buff+r*rankOffset, n*count, datatype, x->peer, comm, stream));
+    } else {
+      NCCLCHECK(ncclRecv(buff+r*rankOffset, n*count, datatype, x->peer, comm, stream));
+    }
+    p += n;
+  }
+  return ncclSuccess;
+}
+
+// Gather (or Scatter) through the tree of gather_tree.h. A rank first receives from
+// all its children (or its parent) in one group, then sends to its parent (or its
+// children) in a second one. Intermediate ranks stage their subtree in gatherTreeBuff.
+static ncclResult_t gatherTree(bool gather, const void* sendbuff, void* recvbuff, size_t count,
+    ncclDataType_t datatype, int root, ncclComm_t comm, hipStream_t stream) {
+  ncclResult_t ret = ncclSuccess;
+  int nRanks = comm->nRanks, rank = comm->rank;
+  size_t rankOffset = count * ncclTypeSize(datatype);
+  struct ncclGatherTreeSchedule* schedule;
+  NCCLCHECK(gatherTreeSchedule(comm, root, &schedule));
+  const int* order = schedule->order;
+  struct ncclGatherTreePlan& plan = schedule->plan;
+  char* buff = NULL;
+
+  if (rank == root) {
+    buff = (char*)(gather ? recvbuff : sendbuff);
+  } else if (plan.nChildren > 0) {
+    if (comm->gatherTreeBuffSize < nRanks*rankOffset) {
+      // Older buffers may still be in use by queued operations, they are freed with the communicator
+      size_t size = std::max(comm->gatherTreeBuffSize*2, nRanks*rankOffset);
+      ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemOther);
+      NCCLCHECKGOTO(ncclCudaCalloc((char**)&comm->gatherTreeBuff, size, comm->sideStream), ret, exit);
+      ncclCommPushCudaFree(comm, comm->gatherTreeBuff);
+      comm->gatherTreeBuffSize = size;
+    }
+    buff = (char*)comm->gatherTreeBuff;
+  }
+
+  if (gather) {
+    if (plan.nChildren > 0 || rank == root) {
+      NCCLCHECKGOTO(ncclGroupStart(), ret, exit);
+      for (int c=0; c<plan.nChildren; c++) NCCLCHECKGOTO(gatherTreeXfer(false, buff, count, datatype, order, plan.children+c, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclSend(sendbuff, count, datatype, rank, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclRecv(buff+rank*rankOffset, count, datatype, rank, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclGroupEnd(), ret, exit);
+    }
+    if (rank != root) {
+      if (plan.nChildren == 0) {
+        NCCLCHECKGOTO(ncclSend(sendbuff, count, datatype, plan.up.peer, comm, stream), ret, exit);
+      } else {
+        NCCLCHECKGOTO(ncclGroupStart(), ret, exit);
+        NCCLCHECKGOTO(gatherTreeXfer(true, buff, count, datatype, order, &plan.up, comm, stream), ret, exit);
+        NCCLCHECKGOTO(ncclGroupEnd(), ret, exit);
+      }
+    }
+  } else {
+    if (rank != root) {
+      if (plan.nChildren == 0) {
+        NCCLCHECKGOTO(ncclRecv(recvbuff, count, datatype, plan.up.peer, comm, stream), ret, exit);
+      } else {
+        NCCLCHECKGOTO(ncclGroupStart(), ret, exit);
+        NCCLCHECKGOTO(gatherTreeXfer(false, buff, count, datatype, order, &plan.up, comm, stream), ret, exit);
+        NCCLCHECKGOTO(ncclGroupEnd(), ret, exit);
+      }
+    }
+    if (plan.nChildren > 0 || rank == root) {
+      NCCLCHECKGOTO(ncclGroupStart(), ret, exit);
+      for (int c=0; c<plan.nChildren; c++) NCCLCHECKGOTO(gatherTreeXfer(true, buff, count, datatype, order, plan.children+c, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclSend(buff+rank*rankOffset, count, datatype, rank, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclRecv(recvbuff, count, datatype, rank, comm, stream), ret, exit);
+      NCCLCHECKGOTO(ncclGroupEnd(), ret, exit);
+    }
+  }
+exit:
+  return ret;
+}
+
 NCCL_API(ncclResult_t, ncclGather, const void* sendbuff, void* recvbuff, size_t sendcount,
     ncclDataType_t datatype, int root, ncclComm_t comm, hipStream_t stream);
 
@@ -220,6 +385,7 @@ ncclResult_t ncclGather_impl(const void* sendbuff, void* recvbuff, size_t sendco
     NCCLCHECK(ncclCommCount(comm, &nRanks));
     size_t rankOffset = sendcount * ncclTypeSize(datatype);
     if (sendcount == 0) return ncclSuccess;
+    if (gatherTreeEnabled("Gather", comm, rankOffset, root)) return gatherTree(true, sendbuff, recvbuff, sendcount, datatype, root, comm, stream);
     int rank;
     NCCLCHECK(ncclCommUserRank(comm, &rank));
     NCCLCHECK(ncclGroupStart());
@@ -293,6 +459,38 @@ ncclResult_t ncclReduceScatter_impl(const void* sendbuff, void* recvbuff, size_t
   return ncclEnqueueCheck(&info);
 }
 
+NCCL_API(ncclResult_t, ncclReduceScatterv, const void* sendbuff, const size_t sendcounts[], const size_t sdispls[],
+    void* recvbuff, size_t recvcount, ncclDataType_t datatype, ncclRedOp_t op, ncclComm_t comm, hipStream_t stream);
+
+ncclResult_t ncclReduceScatterv_impl(const void* sendbuff, const size_t sendcounts[], const size_t sdispls[],
+    void* recvbuff, size_t recvcount, ncclDataType_t datatype, ncclRedOp_t op, ncclComm_t comm, hipStream_t stream) {
+  NCCLCHECK(PtrCheck(comm, "ReduceScatterv", "comm"));
+  NCCLCHECK(PtrCheck((void*)sendcounts, "ReduceScatterv", "sendcounts"));
+  NCCLCHECK(PtrCheck((void*)sdispls, "ReduceScatterv", "sdispls"));
+  struct NvtxParamsReduceScatterv {
+    size_t bytes;
+    ncclRedOp_t op;
+  };
+  constexpr nvtxPayloadSchemaEntry_t ReduceScattervSchema[] = {
+    {0, NVTX_PAYLOAD_ENTRY_TYPE_SIZE, "Message size [bytes]"},
+    {0, NVTX_PAYLOAD_ENTRY_NCCL_REDOP, "Reduction operation", nullptr, 0,
+      offsetof(NvtxParamsReduceScatterv, op)}
+  };
+  NvtxParamsReduceScatterv payload{recvcount * ncclTypeSize(datatype), op};
+  NVTX3_FUNC_WITH_PARAMS(ReduceScatterv, ReduceScattervSchema, payload)
+
+  if (recvcount != sendcounts[comm->rank]) {
+    WARN("ReduceScatterv : recvcount %ld does not match sendcounts[%d] %ld", recvcount, comm->rank, sendcounts[comm->rank]);
+    return ncclInvalidArgument;
+  }
+
+  // Planned as one ReduceScatter of the largest count, see coll_v.h
+  struct ncclInfo info = { ncclFuncReduceScatter, "ReduceScatterv",
+    sendbuff, recvbuff, ncclCollVMaxCount(sendcounts, comm->nRanks), datatype, op, 0, comm, stream, /* Args */
+    REDUCESCATTER_CHUNKSTEPS, REDUCESCATTER_SLICESTEPS, sendcounts, sdispls };
+  return ncclEnqueueCheck(&info);
+}
+
 NCCL_API(ncclResult_t, ncclScatter, const void* sendbuff, void* recvbuff, size_t recvcount, ncclDataType_t datatype, int root,
     ncclComm_t comm, hipStream_t stream);
 
@@ -320,6 +518,7 @@ ncclResult_t ncclScatter_impl(const void* sendbuff, void* recvbuff, size_t recvc
     NCCLCHECK(ncclCommCount(comm, &nRanks));
     size_t rankOffset = recvcount * ncclTypeSize(datatype);
     if (recvcount == 0) return ncclSuccess;
+    if (gatherTreeEnabled("Scatter", comm, rankOffset, root)) return gatherTree(false, sendbuff, recvbuff, recvcount, datatype, root, comm, stream);
     int rank;
     NCCLCHECK(ncclCommUserRank(comm, &rank));
     NCCLCHECK(ncclGroupStart());
@@ -23,10 +23,12 @@ namespace {
     const int nranks = ncclShmem.comm.nRanks;
     const size_t chunkCount = args->chunkCount;
     const size_t channelCount = args->workCount;
-    const size_t gridOffset = args->workOffset;
+    // AllGatherv channels walk through their part of every segment instead
+    const size_t gridOffset = args->vColl ? 0 : args->workOffset;
     const size_t count = args->count;
     size_t offset;
     size_t dataOffset;
+    size_t segOffset;
     int nelem;
     int rankDest;
 
@@ -74,6 +76,7 @@ namespace {
       // step 0: push data to next GPU
       rankDest = ringRanks[0];
       offset = dataOffset + rankDest * count;
+      if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &dataOffset);
 
 #if defined(ENABLE_NPKIT) && defined(ENABLE_NPKIT_EVENT_ALL_GATHER_RING_SEND_ENTRY)
       if (tid == 0) {
@@ -108,6 +111,7 @@ namespace {
       for (int j=1; j<nranks-1; ++j) {
         rankDest = ringRanks[nranks-j];
         offset = dataOffset + rankDest * count;
+        if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &segOffset);
 
         prims.directRecvCopySend(offset, nelem);
       }
@@ -122,6 +126,7 @@ namespace {
       // Make final copy from buffer to dest.
       rankDest = ringRanks[1];
       offset = dataOffset + rankDest * count;
+      if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &segOffset);
 
 #if defined(ENABLE_NPKIT) && defined(ENABLE_NPKIT_EVENT_ALL_GATHER_RING_DIRECT_RECV_ENTRY)
       if (tid == 0) {
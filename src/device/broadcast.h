@@ -86,6 +86,58 @@ namespace {
     }
 #endif
   }
+
+  template<typename T, typename RedOp, typename Proto>
+#if defined(USE_INDIRECT_FUNCTION_CALL) && !defined(__gfx940__) && !defined(__gfx941__) && !defined(__gfx942__)
+  __device__ void runTree(ncclWorkElem *args) {
+#else
+  __device__ __attribute__((noinline)) void runTree(ncclWorkElem *args) {
+#endif
+    const int tid = threadIdx.x;
+    const int nthreads = (int)args->nWarps * WARP_SIZE;
+    ncclTree *tree = &ncclShmem.channel.tree;
+    const int toRoot = args->treeToRoot;
+    const size_t chunkCount = args->chunkCount;
+    const size_t channelCount = args->workCount;
+    const size_t gridOffset = args->workOffset;
+    size_t offset;
+    int nelem;
+
+    // Receive from the neighbour leading to the root, send to all the others
+    int recvPeer = -1;
+    int sendPeers[NCCL_MAX_TREE_ARITY+1];
+    int nsend = 0;
+    for (int i=0; i<NCCL_MAX_TREE_ARITY; i++) {
+      if (tree->down[i] == -1) continue;
+      if (i == toRoot) recvPeer = tree->down[i];
+      else sendPeers[nsend++] = tree->down[i];
+    }
+    if (toRoot == NCCL_TREE_ROOT_UP) recvPeer = tree->up;
+    else if (tree->up != -1) sendPeers[nsend++] = tree->up;
+    for (int i=nsend; i<NCCL_MAX_TREE_ARITY+1; i++) sendPeers[i] = -1;
+
+    T *inputBuf = (T*)args->sendbuff;
+    T *outputBuf = (T*)args->recvbuff;
+    Primitives<T, RedOp, FanAsymmetric<1, NCCL_MAX_TREE_ARITY+1>, 0, Proto, 0>
+      prims(tid, nthreads, &recvPeer, sendPeers, inputBuf, outputBuf, args->redOpArg, 0, args->connIndex, args->connIndex);
+
+    for (size_t elemOffset = 0; elemOffset < channelCount; elemOffset += chunkCount) {
+      offset = gridOffset + elemOffset;
+      nelem = min(chunkCount, channelCount - elemOffset);
+
+      if (recvPeer == -1) {
+        if (inputBuf == outputBuf) {
+          prims.send(offset, nelem);
+        } else {
+          prims.copySend(offset, offset, nelem);
+        }
+      } else if (nsend == 0) {
+        prims.recv(offset, nelem);
+      } else {
+        prims.recvCopySend(offset, nelem);
+      }
+    }
+  }
 }
 
 template<typename T, typename RedOp>
@@ -108,4 +160,25 @@ struct RunWorkElement<ncclFuncBroadcast, T, RedOp, NCCL_ALGO_RING, NCCL_PROTO_LL
   __device__ __forceinline__ void run(ncclWorkElem *args) {
     runRing<T, RedOp, ProtoLL128>(args);
   }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncBroadcast, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_SIMPLE> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoSimple<1, 1>>(args);
+  }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncBroadcast, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_LL> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoLL>(args);
+  }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncBroadcast, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_LL128> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoLL128>(args);
+  }
 };
\ No newline at end of file
@@ -124,9 +124,11 @@ struct ncclShmemData {
   uint64_t redOpArgs[NCCL_MAX_NVLS_ARITY+1];
   int channelId;
   int aborted;
+  struct ncclWork* workHead;
   alignas(16) struct ncclDevComm comm;
   alignas(16) struct ncclDevChannel channel;
   alignas(16) struct ncclWork work;
+  alignas(16) struct ncclCollVSeg collVTable[NCCL_COLL_V_SHMEM_RANKS];
   alignas(16) union {
     unpackShmem unpack;
   } devicePlugin;
@@ -151,6 +153,24 @@ extern __shared__ ncclShmemData ncclShmem;
   extern __shared__ ulong2 ncclShmemPerWarp[ncclShmemScratchWarpSize()*(NCCL_MAX_NTHREADS/WARP_SIZE)/sizeof(ulong2)];
 #endif
 
+__device__ __forceinline__ bool reduceAccFp32() {
+  return ncclShmem.comm.reduceAccFp32;
+}
+
+// Chunk elemOffset of the part of this channel of the segment of rank, for
+// AllGatherv and ReduceScatterv. Returns its size and sets its offsets in the
+// large buffer and in the segment.
+template<typename T>
+__device__ __forceinline__ int collVChunk(struct ncclWorkElem* args, int rank, size_t elemOffset, size_t chunkCount, size_t* bufOffset, size_t* segOffset) {
+  struct ncclCollVSeg seg = ncclShmem.comm.nRanks <= NCCL_COLL_V_SHMEM_RANKS ? ncclShmem.collVTable[rank] :
+    ((const struct ncclCollVSeg*)(ncclShmem.workHead + args->vTable))[rank];
+  uint64_t offset;
+  int nelem = (int)ncclCollVChunk(seg.count, args->vPart, args->vNParts, ncclCollVAlign(sizeof(T)), elemOffset, chunkCount, &offset);
+  *bufOffset = seg.displ + offset;
+  *segOffset = offset;
+  return nelem;
+}
+
 __device__ inline void* ncclScratchForWarp(int warp) {
   return (char*)ncclShmemPerWarp + warp*ncclShmemScratchWarpSize();
 }
@@ -268,7 +288,10 @@ __forceinline__ __device__ void ncclKernelMain(struct ncclDevComm* comm, struct
     break;
   case 3:
     /* set abort flag to 0 */
-    if (tid == 3*WARP_SIZE) ncclShmem.aborted = 0;
+    if (tid == 3*WARP_SIZE) {
+      ncclShmem.aborted = 0;
+      ncclShmem.workHead = workHead;
+    }
     break;
   default:
     break;
@@ -326,13 +349,19 @@ __forceinline__ __device__ void ncclKernelMain(struct ncclDevComm* comm, struct
 
   while (true) {
     // Notify host that all fifo reads are complete.
-    if (tid == 0 && ncclShmem.work.header.isLast && ncclShmem.work.header.inFifo) {
+    if (tid == 0 && ncclShmem.work.header.isLast && ncclShmem.work.header.inFifo && !ncclShmem.work.header.ackAfterRun) {
       *ncclShmem.channel.workFifoDone = ncclShmem.work.header.doneAcks;
     }
 
     __syncwarp();
     if (ncclShmem.work.header.type == ncclWorkTypeColl) {
       if (tid < NCCL_MAX_WORK_ELEMENTS) ncclRedopPtrDeref(&ncclShmem.work.elems[tid]);
+      // The segment table of an AllGatherv or ReduceScatterv is read at every step,
+      // keep it out of the fifo. Such a work has a single element.
+      if (tid < WARP_SIZE && ncclShmem.work.elems[0].vColl && ncclShmem.comm.nRanks <= NCCL_COLL_V_SHMEM_RANKS) {
+        const struct ncclCollVSeg* table = (const struct ncclCollVSeg*)(workHead + ncclShmem.work.elems[0].vTable);
+        for (int r=tid; r<ncclShmem.comm.nRanks; r+=WARP_SIZE) ncclShmem.collVTable[r] = table[r];
+      }
     } else if (ncclShmem.work.header.type == ncclWorkTypeRegColl) {
       if (tid < NCCL_MAX_WORK_ELEMENTS_REG) ncclRedopPtrDeref(&ncclShmem.work.regElems[tid].elem);
     }
@@ -358,7 +387,13 @@ __forceinline__ __device__ void ncclKernelMain(struct ncclDevComm* comm, struct
 
     int workIxNext = ncclShmem.work.header.workNext;
     __synclds();
-    if (ncclShmem.work.header.isLast) break;
+    if (ncclShmem.work.header.isLast) {
+      // The table of an AllGatherv or ReduceScatterv stays in the fifo until now
+      if (tid == 0 && ncclShmem.work.header.inFifo && ncclShmem.work.header.ackAfterRun) {
+        *ncclShmem.channel.workFifoDone = ncclShmem.work.header.doneAcks;
+      }
+      break;
+    }
 
     copyToShmem16(tid, &ncclShmem.work, workHead + workIxNext, sizeof(ncclWork));
 
@@ -27,10 +27,14 @@ inline __device__ int loadInt(int* ptr) {
   return v;
 }
 
+// Whether sums of half and bfloat16 carry their partial sums in fp32, defined
+// in common.h with ncclShmem.
+__device__ __forceinline__ bool reduceAccFp32();
+
 template<typename RedFn, typename T, int Unroll, int BytePerPack,
          int MultimemSrcs, int MinSrcs, int MaxSrcs,
          int MultimemDsts, int MinDsts, int MaxDsts, int PreOpSrcs,
-         typename IntBytes, typename SrcPtrFn, typename DstPtrFn>
+         bool AccFp32, typename IntBytes, typename SrcPtrFn, typename DstPtrFn>
 __device__ __forceinline__ void reduceCopyPacks(
     int nThreads, int &thread,
     uint64_t redArg, uint64_t *preOpArgs, bool postOp,
@@ -64,6 +68,7 @@ __device__ __forceinline__ void reduceCopyPacks(
   nHunksAhead -= warp;
 
   RedFn redFn(redArg);
+  using AccFn = Apply_AccFp32<RedFn, BytePerPack>;
   uintptr_t minSrcs[MinSrcs + !MinSrcs];
   uintptr_t minDsts[MinDsts + !MinDsts];
   #pragma unroll
@@ -77,6 +82,7 @@ __device__ __forceinline__ void reduceCopyPacks(
   // can be handled or not.
   while (Unroll==1 ? (BytePerPack <= threadBytesAhead) : (0 < nHunksAhead)) {
     BytePack<BytePerPack> acc[Unroll];
+    typename AccFn::Acc accF[AccFp32 ? Unroll : 1];
 
     { RedFn preFn(0 < PreOpSrcs ? preOpArgs[0] : 0);
       #pragma unroll Unroll
@@ -84,6 +90,8 @@ __device__ __forceinline__ void reduceCopyPacks(
         if (0 < MultimemSrcs) {
           // applyLoadMultimem uses relaxed semantics for same reason we use volatile below.
           acc[u] = applyLoadMultimem<RedFn, BytePerPack>(redFn, minSrcs[0]);
+        } else if (AccFp32) {
+          accF[u] = AccFn::load(ld_volatile_global<BytePerPack>(minSrcs[0]), 0 < PreOpSrcs ? FuncAccFp32<RedFn>::scale(preFn) : 1.0f);
         } else {
           // Use volatile loads in case credits are polled for with volatile (instead of acquire).
           acc[u] = ld_volatile_global<BytePerPack>(minSrcs[0]);
@@ -110,8 +118,12 @@ __device__ __forceinline__ void reduceCopyPacks(
       }
       #pragma unroll Unroll
       for (int u=0; u < Unroll; u++) {
-        if (s < PreOpSrcs) tmp[u] = applyPreOp(preFn, tmp[u]);
-        acc[u] = applyReduce(redFn, acc[u], tmp[u]);
+        if (AccFp32) {
+          accF[u] = AccFn::reduce(accF[u], tmp[u], s < PreOpSrcs ? FuncAccFp32<RedFn>::scale(preFn) : 1.0f);
+        } else {
+          if (s < PreOpSrcs) tmp[u] = applyPreOp(preFn, tmp[u]);
+          acc[u] = applyReduce(redFn, acc[u], tmp[u]);
+        }
       }
     }
 
@@ -127,11 +139,21 @@ __device__ __forceinline__ void reduceCopyPacks(
       }
       #pragma unroll Unroll
       for (int u=0; u < Unroll; u++) {
-        if (s < PreOpSrcs) tmp[u] = applyPreOp(preFn, tmp[u]);
-        acc[u] = applyReduce(redFn, acc[u], tmp[u]);
+        if (AccFp32) {
+          accF[u] = AccFn::reduce(accF[u], tmp[u], s < PreOpSrcs ? FuncAccFp32<RedFn>::scale(preFn) : 1.0f);
+        } else {
+          if (s < PreOpSrcs) tmp[u] = applyPreOp(preFn, tmp[u]);
+          acc[u] = applyReduce(redFn, acc[u], tmp[u]);
+        }
       }
     }
 
+    if (AccFp32) {
+      #pragma unroll Unroll
+      for (int u=0; u < Unroll; u++)
+        acc[u] = AccFn::store(accF[u]);
+    }
+
     if (postOp) {
       #pragma unroll Unroll
       for (int u=0; u < Unroll; u++)
@@ -185,8 +207,8 @@ __device__ __forceinline__ void reduceCopyPacks(
 template<int Unroll, typename RedFn, typename T,
          int MultimemSrcs, int MinSrcs, int MaxSrcs,
          int MultimemDsts, int MinDsts, int MaxDsts, int PreOpSrcs,
-         typename IntBytes, typename SrcPtrFn, typename DstPtrFn>
-__device__ __forceinline__ void reduceCopy(
+         bool AccFp32, typename IntBytes, typename SrcPtrFn, typename DstPtrFn>
+__device__ __forceinline__ void reduceCopyAcc(
     int thread, int nThreads,
     uint64_t redArg, uint64_t *preOpArgs, bool postOp,
     int nSrcs, SrcPtrFn const &srcPtrFn, int nDsts, DstPtrFn const &dstPtrFn,
@@ -219,19 +241,19 @@ __device__ __forceinline__ void reduceCopy(
     if (aligned) {
 #if defined(__gfx90a__)
       reduceCopyPacks<RedFn, T, ((MinSrcs > 1) ? 2 : Unroll), BigPackSize,
-        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
         (nThreads, thread, redArg, preOpArgs, postOp,
          nSrcs, srcPtrFn, nDsts, dstPtrFn, nBytesBehind, nBytesAhead);
 #else
       reduceCopyPacks<RedFn, T, Unroll*((MinSrcs == 1 && MinDsts == 1) ? 2 : 1), BigPackSize,
-        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
         (nThreads, /*&*/thread, redArg, preOpArgs, postOp,
          nSrcs, srcPtrFn, nDsts, dstPtrFn, /*&*/nBytesBehind, /*&*/nBytesAhead);
 #endif
       if (nBytesAhead == 0) return;
 
       reduceCopyPacks<RedFn, T, /*Unroll=*/1, BigPackSize,
-        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+        MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
         (nThreads, /*&*/thread, redArg, preOpArgs, postOp,
          nSrcs, srcPtrFn, nDsts, dstPtrFn, /*&*/nBytesBehind, /*&*/nBytesAhead);
       if (nBytesAhead == 0) return;
@@ -241,29 +263,55 @@ __device__ __forceinline__ void reduceCopy(
 #if defined(__gfx90a__)
   if (MinSrcs > 1) {
     reduceCopyPacks<RedFn, T, Unroll/2*(16/sizeof(T))/2, sizeof(T),
-    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
     (nThreads, thread, redArg, preOpArgs, postOp,
      nSrcs, srcPtrFn, nDsts, dstPtrFn, nBytesBehind, nBytesAhead);
   } else {
     reduceCopyPacks<RedFn, T, Unroll*(16/sizeof(T))/2, /*BytePerPack=*/sizeof(T),
-    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
     (nThreads, /*&*/thread, redArg, preOpArgs, postOp,
      nSrcs, srcPtrFn, nDsts, dstPtrFn, /*&*/nBytesBehind, /*&*/nBytesAhead);
   }
 #else
   reduceCopyPacks<RedFn, T, Unroll*(16/sizeof(T))/2, /*BytePerPack=*/sizeof(T),
-    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
     (nThreads, /*&*/thread, redArg, preOpArgs, postOp,
      nSrcs, srcPtrFn, nDsts, dstPtrFn, /*&*/nBytesBehind, /*&*/nBytesAhead);
 #endif
   if (nBytesAhead == 0) return;
 
   reduceCopyPacks<RedFn, T, /*Unroll=*/1, /*BytePerPack=*/sizeof(T),
-    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs>
+    MultimemSrcs, MinSrcs, MaxSrcs, MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
     (nThreads, /*&*/thread, redArg, preOpArgs, postOp,
      nSrcs, srcPtrFn, nDsts, dstPtrFn, /*&*/nBytesBehind, /*&*/nBytesAhead);
 }
 
+template<int Unroll, typename RedFn, typename T,
+         int MultimemSrcs, int MinSrcs, int MaxSrcs,
+         int MultimemDsts, int MinDsts, int MaxDsts, int PreOpSrcs,
+         typename IntBytes, typename SrcPtrFn, typename DstPtrFn>
+__device__ __forceinline__ void reduceCopy(
+    int thread, int nThreads,
+    uint64_t redArg, uint64_t *preOpArgs, bool postOp,
+    int nSrcs, SrcPtrFn const &srcPtrFn, int nDsts, DstPtrFn const &dstPtrFn,
+    IntBytes nElts
+  ) {
+  // Only steps rounding more than once per element gain from fp32 partial sums
+  constexpr bool AccFp32 = FuncAccFp32<RedFn>::Enabled && MultimemSrcs == 0 &&
+                           (MaxSrcs > 2 || (MaxSrcs > 1 && PreOpSrcs > 0));
+  if (AccFp32 && reduceAccFp32()) {
+    reduceCopyAcc<Unroll, RedFn, T, MultimemSrcs, MinSrcs, MaxSrcs,
+      MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, AccFp32>
+      (thread, nThreads, redArg, preOpArgs, postOp,
+       nSrcs, srcPtrFn, nDsts, dstPtrFn, nElts);
+  } else {
+    reduceCopyAcc<Unroll, RedFn, T, MultimemSrcs, MinSrcs, MaxSrcs,
+      MultimemDsts, MinDsts, MaxDsts, PreOpSrcs, /*AccFp32=*/false>
+      (thread, nThreads, redArg, preOpArgs, postOp,
+       nSrcs, srcPtrFn, nDsts, dstPtrFn, nElts);
+  }
+}
+
 template<int Unroll, typename RedFn, typename T,
          int MultimemSrcs, int MinSrcs, int MaxSrcs,
          int MultimemDsts, int MinDsts, int MaxDsts, int PreOpSrcs,
@@ -435,6 +435,8 @@ private:
     dstElts += tid*EltPerLine;
     int offset = tid;
     int eltPerTrip = nthreads*EltPerLine;
+    // Only steps rounding more than once per element gain from fp32 partial sums
+    const bool accFp32 = FuncAccFp32<RedOp>::Enabled && RECV && SRC && (MaxRecv > 1 || SrcBuf == Input) && reduceAccFp32();
     while (nelem > 0) {
       int eltInLine = EltPerLine < nelem ? EltPerLine : nelem;
 
@@ -451,9 +453,18 @@ private:
       }
       if (SRC) {
         data = dl.loadFinish();
-        if (SrcBuf == Input) data = applyPreOp(redOp, data);
+        if (SrcBuf == Input && !accFp32) data = applyPreOp(redOp, data);
       }
-      if (RECV) {
+      if (RECV && accFp32) {
+        using AccFn = Apply_AccFp32<RedOp, sizeof(uint64_t)>;
+        typename AccFn::Acc acc = AccFn::load(toPack(data), SrcBuf == Input ? FuncAccFp32<RedOp>::scale(redOp) : 1.0f);
+        acc = AccFn::reduce(acc, toPack(peerData), 1.0f);
+        #pragma unroll MaxRecv
+        for (int i=1; i < MaxRecv && i < fan.nrecv(); i++) {
+          acc = AccFn::reduce(acc, toPack(readLLFinish(offset, line, i)), 1.0f);
+        }
+        data = fromPack<uint64_t>(AccFn::store(acc));
+      } else if (RECV) {
         data = !SRC ? peerData : applyReduce(redOp, peerData, data);
         #pragma unroll MaxRecv
         for (int i=1; i < MaxRecv && i < fan.nrecv(); i++) {
@@ -54,6 +54,52 @@ namespace {
       }
     }
   }
+
+  template<typename T, typename RedOp, typename Proto>
+#if defined(USE_INDIRECT_FUNCTION_CALL) && !defined(__gfx940__) && !defined(__gfx941__) && !defined(__gfx942__)
+  __device__ void runTree(ncclWorkElem *args) {
+#else
+  __device__ __attribute__((noinline)) void runTree(ncclWorkElem *args) {
+#endif
+    const int tid = threadIdx.x;
+    const int nthreads = (int)args->nWarps * WARP_SIZE;
+    ncclTree *tree = &ncclShmem.channel.tree;
+    const int toRoot = args->treeToRoot;
+    const size_t chunkCount = args->chunkCount;
+    const size_t channelCount = args->workCount;
+    const size_t gridOffset = args->workOffset;
+    size_t offset;
+    int nelem;
+
+    // Receive from all neighbours but the one leading to the root, send to that one
+    int sendPeer = -1;
+    int recvPeers[NCCL_MAX_TREE_ARITY+1];
+    int nrecv = 0;
+    for (int i=0; i<NCCL_MAX_TREE_ARITY; i++) {
+      if (tree->down[i] == -1) continue;
+      if (i == toRoot) sendPeer = tree->down[i];
+      else recvPeers[nrecv++] = tree->down[i];
+    }
+    if (toRoot == NCCL_TREE_ROOT_UP) sendPeer = tree->up;
+    else if (tree->up != -1) recvPeers[nrecv++] = tree->up;
+    for (int i=nrecv; i<NCCL_MAX_TREE_ARITY+1; i++) recvPeers[i] = -1;
+
+    Primitives<T, RedOp, FanAsymmetric<NCCL_MAX_TREE_ARITY+1, 1>, 0, Proto, 0>
+      prims(tid, nthreads, recvPeers, &sendPeer, args->sendbuff, args->recvbuff, args->redOpArg, 0, args->connIndex, args->connIndex);
+
+    for (size_t elemOffset = 0; elemOffset < channelCount; elemOffset += chunkCount) {
+      offset = gridOffset + elemOffset;
+      nelem = min(chunkCount, channelCount - elemOffset);
+
+      if (nrecv == 0) {
+        prims.send(offset, nelem);
+      } else if (sendPeer == -1) {
+        prims.recvReduceCopy(offset, offset, nelem, /*postOp=*/true);
+      } else {
+        prims.recvReduceSend(offset, nelem);
+      }
+    }
+  }
 }
 
 template<typename T, typename RedOp>
@@ -76,4 +122,25 @@ struct RunWorkElement<ncclFuncReduce, T, RedOp, NCCL_ALGO_RING, NCCL_PROTO_LL128
   __device__ __forceinline__ void run(ncclWorkElem *args) {
     runRing<T, RedOp, ProtoLL128>(args);
   }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncReduce, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_SIMPLE> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoSimple<1, 1>>(args);
+  }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncReduce, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_LL> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoLL>(args);
+  }
+};
+
+template<typename T, typename RedOp>
+struct RunWorkElement<ncclFuncReduce, T, RedOp, NCCL_ALGO_TREE, NCCL_PROTO_LL128> {
+  __device__ __forceinline__ void run(ncclWorkElem *args) {
+    runTree<T, RedOp, ProtoLL128>(args);
+  }
 };
\ No newline at end of file
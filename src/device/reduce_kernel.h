@@ -572,6 +572,79 @@ struct Apply_PostOp<FuncSumPostDiv<T>, /*EltPerPack=*/1> {
   }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Sums of half and bfloat16 with the partial sums of a reduce step carried in
+// fp32 (RCCL_REDUCE_ACC_FP32). Every source is widened, and scaled for ncclAvg,
+// once and the result is rounded once to the element type instead of after
+// every source. The host reference is ncclReduceAccStep in reduce_acc.h.
+
+// Other functions never take the fp32 path, the members only let it compile.
+template<typename Fn>
+struct FuncAccFp32 {
+  static constexpr bool Enabled = false;
+  __device__ static float scale(Fn fn) { return 1.0f; }
+  __device__ static float widen(BytePack<sizeof(typename Fn::EltType)> x) { return 0.0f; }
+  __device__ static BytePack<sizeof(typename Fn::EltType)> narrow(float x) { return {}; }
+};
+
+template<>
+struct FuncAccFp32<FuncSum<half>> {
+  static constexpr bool Enabled = true;
+  __device__ static float scale(FuncSum<half> fn) { return 1.0f; }
+  __device__ static float widen(BytePack<2> x) { return __half2float(fromPack<half>(x)); }
+  __device__ static BytePack<2> narrow(float x) { return toPack<half>(__float2half(x)); }
+};
+
+template<>
+struct FuncAccFp32<FuncPreMulSum<half>>: FuncAccFp32<FuncSum<half>> {
+  __device__ static float scale(FuncPreMulSum<half> fn) { return __half2float(fn.scalar.x); }
+};
+
+#if defined(RCCL_BFLOAT16) && !(__CUDA_ARCH__ >= 800)
+  template<>
+  struct FuncAccFp32<FuncSum<hip_bfloat16>> {
+    static constexpr bool Enabled = true;
+    __device__ static float scale(FuncSum<hip_bfloat16> fn) { return 1.0f; }
+    __device__ static float widen(BytePack<2> x) { return (float)(fromPack<hip_bfloat16>(x)); }
+    __device__ static BytePack<2> narrow(float x) { return toPack<hip_bfloat16>((hip_bfloat16)(x)); }
+  };
+
+  template<>
+  struct FuncAccFp32<FuncPreMulSum<hip_bfloat16>>: FuncAccFp32<FuncSum<hip_bfloat16>> {
+    __device__ static float scale(FuncPreMulSum<hip_bfloat16> fn) { return fn.scalar; }
+  };
+#endif
+
+// A pack of elements as fp32 partial sums. scale is 1 for sources without preOp.
+template<typename Fn, int BytePerPack>
+struct Apply_AccFp32 {
+  using T = typename Fn::EltType;
+  static constexpr int EltPerPack = BytePerPack/sizeof(T);
+  struct Acc { float elt[EltPerPack + !EltPerPack]; };
+  union Elts { BytePack<BytePerPack> pack; BytePack<sizeof(T)> elt[EltPerPack + !EltPerPack]; };
+
+  __device__ __forceinline__ static Acc load(BytePack<BytePerPack> a, float scale) {
+    Elts x; x.pack = a;
+    Acc acc;
+    #pragma unroll
+    for (int e=0; e < EltPerPack; e++) acc.elt[e] = FuncAccFp32<Fn>::widen(x.elt[e])*scale;
+    return acc;
+  }
+  // Products of two elements are exact in fp32, so contracting into an fma does not change the result
+  __device__ __forceinline__ static Acc reduce(Acc acc, BytePack<BytePerPack> b, float scale) {
+    Elts x; x.pack = b;
+    #pragma unroll
+    for (int e=0; e < EltPerPack; e++) acc.elt[e] += FuncAccFp32<Fn>::widen(x.elt[e])*scale;
+    return acc;
+  }
+  __device__ __forceinline__ static BytePack<BytePerPack> store(Acc acc) {
+    Elts x;
+    #pragma unroll
+    for (int e=0; e < EltPerPack; e++) x.elt[e] = FuncAccFp32<Fn>::narrow(acc.elt[e]);
+    return x.pack;
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Apply_LoadMultimem
 
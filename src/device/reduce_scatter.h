@@ -23,9 +23,11 @@ namespace {
     const size_t chunkCount = args->chunkCount;
     const int nranks = ncclShmem.comm.nRanks;
     size_t channelCount = args->workCount;
-    size_t gridOffset = args->workOffset;
+    // ReduceScatterv channels walk through their part of every segment instead
+    size_t gridOffset = args->vColl ? 0 : args->workOffset;
     size_t offset;
     size_t dataOffset;
+    size_t segOffset;
     size_t count = args->count;
     uint32_t nelem;
     int rankDest;
@@ -41,18 +43,21 @@ namespace {
       // step 0: push data to next GPU
       rankDest = ringRanks[nranks-1];
       offset = dataOffset + rankDest * count;
+      if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &segOffset);
       prims.send(offset, nelem);
 
       // k-2 steps: reduce and copy to next GPU
       for (int j=2; j<nranks; ++j) {
         rankDest = ringRanks[nranks-j];
         offset = dataOffset + rankDest * count;
+        if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &segOffset);
         prims.recvReduceSend(offset, nelem);
       }
 
       // step k-1: reduce this buffer and data, which will produce the final result
       rankDest = ringRanks[0];
       offset = dataOffset + rankDest * count;
+      if (args->vColl) nelem = collVChunk<T>(args, rankDest, elemOffset, chunkCount, &offset, &dataOffset);
       prims.recvReduceCopy(offset, dataOffset, nelem, /*postOp=*/true);
     }
   }
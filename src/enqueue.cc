@@ -50,12 +50,11 @@ NCCL_PARAM(L1SharedMemoryCarveout, "L1_SHARED_MEMORY_CARVEOUT", 0);
 
 static ncclResult_t initCollWorkElem(struct ncclInfo* collInfo, struct ncclWorkElem* work);
 static ncclResult_t setCollWorkElem(uint64_t workCount, uint64_t workOffset, size_t lastChunkCount, struct ncclWorkElem* work);
+static void setCollWorkElemTreeRoot(struct ncclComm* comm, struct ncclInfo* collInfo, int channelId, struct ncclWorkElem* work);
 static ncclResult_t initCollWorkElemReg(struct ncclComm* comm, struct ncclWorkElem* work, struct ncclChannel* channel, ncclRegBufferType regBufType, void* regBufSend[], void* regBufRecv[], struct ncclWorkElemReg* workElemReg);
 static ncclResult_t computeCollChunkInfo(struct ncclInfo* collInfo, size_t nBytes, int nChannels);
 static ncclResult_t initCollProxyOp(struct ncclInfo* collInfo, int channelId, uint64_t opCount, uint32_t nsteps, struct ncclProxyOp* proxyOp);
 static ncclResult_t getTunerInfo(struct ncclInfo* collInfo, int collNetSupport, int nvlsSupport, int numPipeOps);
-static ncclResult_t topoGetAlgoInfo(struct ncclInfo* collInfo, int collNetSupport, int nvlsSupport, int numPipeOps);
-static ncclResult_t getChannnelThreadInfo(struct ncclInfo* collInfo);
 static ncclResult_t computeCollWorkFunc(struct ncclInfo* collInfo);
 static ncclResult_t getPatternInfo(struct ncclInfo* collInfo);
 static ncclResult_t getLoopInfo(struct ncclInfo* collInfo);
@@ -125,10 +124,12 @@ static void appendWorkElemColl(
     int funcIndex, struct ncclWorkElem const *elem) {
   struct ncclKernelPlan::Channel* chan = &plan->channels[channelId];
   struct ncclWorkList* q = ncclIntruQueueTail(&chan->workQueue);
+  // Kernels load the segment table of a vColl element once per work, so it is not packed with others
   if (q && funcIndex == q->work.header.funcIndex
         && elem->nWarps == q->work.elems[0].nWarps
         && chan->nWorkElem < NCCL_MAX_WORK_ELEMENTS
-        && ncclWorkTypeColl == q->work.header.type) {
+        && ncclWorkTypeColl == q->work.header.type
+        && !elem->vColl && !q->work.elems[0].vColl) {
     int e = chan->nWorkElem++;
     q->work.elems[e] = *elem; // C++ struct assignment
     return;
@@ -442,6 +443,7 @@ static ncclResult_t addTunedCollToPlan(
     workCount = std::min(countPerChannels, remCount);
     NCCLCHECKGOTO(computeCollLastChunkInfo(collInfo, workCount, alignCount, &lastChunkCount), ret, fail);
     NCCLCHECKGOTO(setCollWorkElem(workCount, workOffset, lastChunkCount, &workElem), ret, fail);
+    setCollWorkElemTreeRoot(comm, collInfo, c, &workElem);
 
     // Add work elem
     *nWorkBudget += chans[c].nWork;
@@ -524,6 +526,7 @@ static ncclResult_t addCBDCollToPlan(
 
       NCCLCHECKGOTO(computeCollLastChunkInfo(collInfo, workCount, alignCount, &lastChunkCount), ret, fail);
       NCCLCHECKGOTO(setCollWorkElem(workCount, workOffset, lastChunkCount, &workElem), ret, fail);
+      setCollWorkElemTreeRoot(comm, collInfo, c, &workElem);
     }
 
     // Add work elem
@@ -570,6 +573,85 @@ fail:
   goto exit;
 }
 
+// AllGatherv and ReduceScatterv go around the ring on nChannels channels, each
+// moving the same part of every segment (see coll_v.h). Segments reach the kernel
+// as a table laid out in the work fifo ahead of the works of the plan.
+static ncclResult_t addVCollToPlan(
+    struct ncclComm* comm, struct ncclKernelPlan* plan, int usableChannels,
+    struct ncclInfo* collInfo, int* nWorkBudget
+  ) {
+  ncclResult_t ret = ncclSuccess;
+  struct ncclKernelPlan::Channel *chans = plan->channels;
+  struct ncclWorkElem workElem;
+  uint64_t opCount = uint64_t(plan->collOpCount++) << 1 | 0;
+  uint32_t typeSize = ncclTypeSize(collInfo->datatype);
+  uint64_t align = ncclCollVAlign(typeSize);
+  int nRanks = comm->nRanks;
+  int nTable = ncclCollVTableWorks(nRanks, sizeof(struct ncclWork));
+  int segsPerWork = sizeof(struct ncclWork) / sizeof(struct ncclCollVSeg);
+  int nChannels = std::min(collInfo->nChannels, usableChannels);
+  int order[MAXCHANNELS];
+  int rnChannels = 0;
+
+  // The table is read backward from the works, enqueue its last work first
+  for (int t = nTable-1; t >= 0; t--) {
+    struct ncclWorkList* q = ncclMemoryStackAlloc<struct ncclWorkList>(&comm->memScoped);
+    int nSegs = std::min(segsPerWork, nRanks - t*segsPerWork);
+    memcpy(&q->work, collInfo->vSegs + t*segsPerWork, nSegs*sizeof(struct ncclCollVSeg));
+    ncclIntruQueueEnqueue(&plan->vTableQueue, q);
+  }
+  plan->nVTableWork += nTable;
+  *nWorkBudget -= nTable;
+
+  NCCLCHECKGOTO(computeCollChunkInfo(collInfo, collInfo->nBytes, nChannels), ret, fail);
+  NCCLCHECKGOTO(initCollWorkElem(collInfo, &workElem), ret, fail);
+  workElem.vColl = 1;
+  workElem.vTable = -plan->nVTableWork;
+  workElem.vNParts = nChannels;
+
+  // Parts go to the least loaded channels, in the same order on all ranks
+  for (int c = 0; c < usableChannels; c++) order[c] = c;
+  std::stable_sort(order, order+usableChannels, [&](int a, int b) { return chans[a].collBytes < chans[b].collBytes; });
+
+  for (int part = 0; part < nChannels; part++) {
+    int c = order[part];
+    // Every part of the longest segment sets the steps of its channel
+    uint64_t workCount = ncclCollVPartMax(collInfo->vSegs, nRanks, part, nChannels, align);
+    if (workCount == 0) continue;
+    workElem.vPart = part;
+    workElem.workCount = workCount;
+
+    *nWorkBudget += chans[c].nWork;
+    appendWorkElemColl(comm, plan, c, collInfo->workFuncIndex, &workElem);
+    *nWorkBudget -= chans[c].nWork; // subtract delta of chans[c].nWork
+    ncclIntruQueueTail(&chans[c].workQueue)->work.header.ackAfterRun = 1;
+
+    uint32_t steps;
+    struct ncclProxyOp proxyOp;
+    NCCLCHECKGOTO(computeCollSteps(collInfo, workCount, &steps), ret, fail);
+    NCCLCHECKGOTO(initCollProxyOp(collInfo, c, opCount, steps, &proxyOp), ret, fail);
+    NCCLCHECKGOTO(addProxyOpIfNeeded(comm, plan, &proxyOp), ret, fail);
+
+    chans[c].collBytes += workCount * typeSize;
+    rnChannels++;
+  }
+
+  plan->threadPerBlock = std::max(plan->threadPerBlock, collInfo->nThreads);
+  if (!plan->kernelSpecialized) {
+    plan->kernelFn = ncclKerns[ncclGetKernelIndex(comm)].kernelFn;
+    plan->kernelSpecialized = ncclKerns[ncclGetKernelIndex(comm)].specialized;
+  }
+
+  if (comm->rank == 0) {
+    TRACE(NCCL_COLL, "vColl enqueue coll %s(%s, %s, %s, %s), nChannels %d, max count %ld (nbytes %ld), usableChannel %d, table works %d, chunkCount %d, funcIndex %d, nThreads %d", collInfo->opName, ncclOpToString(collInfo->op), ncclDatatypeToString(collInfo->datatype), ncclAlgoToString(collInfo->algorithm), ncclProtoToString(collInfo->protocol), rnChannels, collInfo->count, collInfo->nBytes, usableChannels, nTable, collInfo->chunkCount, collInfo->workFuncIndex, collInfo->nThreads);
+  }
+
+exit:
+  return ret;
+fail:
+  goto exit;
+}
+
 NCCL_PARAM(P2pLLThreshold, "P2P_LL_THRESHOLD", 16384);
 
 // Put p2p op in plan assuming there is space in nWorkBudget, so you must
@@ -799,6 +881,21 @@ static ncclResult_t scheduleCollTasksToPlan(
     while (!ncclIntruQueueEmpty(&tasks->collQueue)) {
       collInfo = ncclIntruQueueDequeue(&tasks->collQueue);
       if (collInfo->count == 0) continue;
+      if (collInfo->vSegs != nullptr) {
+        // AllGatherv and ReduceScatterv are neither aggregated nor tuned by the plugin
+        NCCLCHECK(ncclInfoSetDerived(collInfo, comm->nRanks));
+        NCCLCHECK(ncclTopoGetAlgoInfo(collInfo, 0, 0, 1));
+        NCCLCHECK(ncclTopoGetChannelThreadInfo(collInfo));
+        NCCLCHECK(computeCollWorkFunc(collInfo));
+        NCCLCHECK(getPatternInfo(collInfo));
+        usableChannels = std::max(usableChannels, comm->collChannels);
+        accChannels += collInfo->nChannels;
+        // substract collective which needs to be executed separately
+        totalCBDBytes -= collInfo->workBytes;
+        tasks->workBytesTotal -= collInfo->workBytes;
+        ncclIntruQueueEnqueue(&tasks->collVQueue, collInfo);
+        continue;
+      }
       if (collInfo->algorithm == NCCL_ALGO_UNDEF) {
         struct ncclInfo* aggInfo = ncclMemoryStackAlloc<struct ncclInfo>(&comm->memScoped);
         struct ncclInfo* nextInfo = collInfo->next;
@@ -807,7 +904,7 @@ static ncclResult_t scheduleCollTasksToPlan(
 
         memcpy(aggInfo, collInfo, sizeof(struct ncclInfo));
         while (nextInfo) {
-          if (nextInfo->coll == aggInfo->coll && nextInfo->opFull.op == aggInfo->opFull.op && nextInfo->datatype == aggInfo->datatype) {
+          if (nextInfo->coll == aggInfo->coll && nextInfo->opFull.op == aggInfo->opFull.op && nextInfo->datatype == aggInfo->datatype && nextInfo->vSegs == nullptr) {
             aggInfo->count += nextInfo->count;
             nextInfo = nextInfo->next;
           } else {
@@ -819,15 +916,15 @@ static ncclResult_t scheduleCollTasksToPlan(
         NCCLCHECK(getCollNetSupport(aggInfo, &collNetSupport));
         NCCLCHECK(ncclInfoSetDerived(aggInfo, comm->nRanks));
         NCCLCHECK(getTunerInfo(aggInfo, collNetSupport, nvlsSupport, 1));
-        NCCLCHECK(topoGetAlgoInfo(aggInfo, collNetSupport, nvlsSupport, 1));
-        NCCLCHECK(getChannnelThreadInfo(aggInfo));
+        NCCLCHECK(ncclTopoGetAlgoInfo(aggInfo, collNetSupport, nvlsSupport, 1));
+        NCCLCHECK(ncclTopoGetChannelThreadInfo(aggInfo));
         NCCLCHECK(computeCollWorkFunc(aggInfo));
         NCCLCHECK(getPatternInfo(aggInfo));
 
         // Try to assign algo and proto to all possible collectives
         nextInfo = collInfo;
         while (nextInfo) {
-          if (nextInfo->coll == aggInfo->coll && nextInfo->opFull.op == aggInfo->opFull.op && nextInfo->datatype == aggInfo->datatype) {
+          if (nextInfo->coll == aggInfo->coll && nextInfo->opFull.op == aggInfo->opFull.op && nextInfo->datatype == aggInfo->datatype && nextInfo->vSegs == nullptr) {
             NCCLCHECK(ncclInfoSetDerived(nextInfo, comm->nRanks));
             NCCLCHECK(getTunerInfo(nextInfo, collNetSupport, nvlsSupport, 1));
             nextInfo->algorithm = aggInfo->algorithm;
@@ -837,7 +934,7 @@ static ncclResult_t scheduleCollTasksToPlan(
             nextInfo->workFuncIndex = aggInfo->workFuncIndex;
             nextInfo->aggnBytes = aggInfo->nBytes;
 
-            NCCLCHECK(getChannnelThreadInfo(nextInfo));
+            NCCLCHECK(ncclTopoGetChannelThreadInfo(nextInfo));
             // if possible, start registration
             registerIntraNodeBuffers(comm, plan, nextInfo);
             // accumulate channels
@@ -911,6 +1008,16 @@ static ncclResult_t scheduleCollTasksToPlan(
     tasks->nTasksColl -= 1;
   }
 
+  // And AllGatherv/ReduceScatterv, which also need room for their table
+  while (!ncclIntruQueueEmpty(&tasks->collVQueue)) {
+    collInfo = ncclIntruQueueHead(&tasks->collVQueue);
+    if (*nWorkBudget < collInfo->nChannels + ncclCollVTableWorks(comm->nRanks, sizeof(struct ncclWork))) return ncclSuccess;
+
+    collInfo = ncclIntruQueueDequeue(&tasks->collVQueue);
+    NCCLCHECK(addVCollToPlan(comm, plan, tasks->usableChannels, collInfo, nWorkBudget));
+    tasks->nTasksColl -= 1;
+  }
+
   return ncclSuccess;
 }
 
@@ -1085,17 +1192,65 @@ static void waitWorkFifoAvailable(struct ncclComm* comm, uint32_t desiredSent) {
   }
 }
 
+// Minimum chunk size of the persistent work pool, in ncclWork (256KB).
+#define NCCL_PERSISTENT_WORK_CHUNK 1024
+
+static ncclResult_t persistentWorkChunkAlloc(struct ncclComm* comm, struct ncclWorkPoolChunk<struct ncclWork>** chunk, int capacity) {
+  ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemWorkFifo);
+  NCCLCHECK(ncclCalloc(chunk, 1));
+  (*chunk)->capacity = capacity;
+  NCCLCHECK(ncclCalloc(&(*chunk)->hostWork, capacity));
+  NCCLCHECK(ncclCudaMalloc(&(*chunk)->devWork, capacity));
+  return ncclSuccess;
+}
+
+static ncclResult_t persistentWorkChunkFree(struct ncclWorkPoolChunk<struct ncclWork>* chunk) {
+  NCCLCHECK(ncclCudaFree(chunk->devWork));
+  free(chunk->hostWork);
+  free(chunk);
+  return ncclSuccess;
+}
+
+static ncclResult_t persistentWorkAlloc(struct ncclComm* comm, struct ncclKernelPlan* plan, int nWork, struct ncclWork** hostWork) {
+  return ncclWorkPoolAlloc(&comm->persistentWork, nWork, NCCL_PERSISTENT_WORK_CHUNK,
+    [&](struct ncclWorkPoolChunk<struct ncclWork>** chunk, int capacity) { return persistentWorkChunkAlloc(comm, chunk, capacity); },
+    &plan->workChunk, hostWork, &plan->workHead);
+}
+
+static ncclResult_t persistentWorkFree(struct ncclComm* comm, struct ncclKernelPlan* plan) {
+  return ncclWorkPoolRelease(&comm->persistentWork, plan->workChunk, persistentWorkChunkFree);
+}
+
+// Upload all work written by persistent plans since the last call, one copy per chunk.
+static ncclResult_t persistentWorkUpload(struct ncclComm* comm) {
+  return ncclWorkPoolUpload(&comm->persistentWork, [](struct ncclWork* dst, struct ncclWork* src, int nWork) {
+    return ncclCudaMemcpy(dst, src, nWork);
+  });
+}
+
+ncclResult_t ncclPersistentWorkPoolDestruct(struct ncclComm* comm) {
+  struct ncclWorkPool<struct ncclWork>* pool = &comm->persistentWork;
+  if (pool->nPlans) {
+    INFO(NCCL_ALLOC, "Persistent work pool: %lu plans, %lu chunk allocations, %lu uploads", pool->nPlans, pool->nChunkAllocs, pool->nUploads);
+  }
+  return ncclWorkPoolDestroy(pool, persistentWorkChunkFree);
+}
+
 static ncclResult_t uploadWork(struct ncclComm* comm, struct ncclKernelPlan* plan) {
   bool persistent = plan->persistent;
   int channelUbound = plan->channelUbound;
   int nWork = 0;
   for (int c=0; c < channelUbound; c++) nWork += plan->channels[c].nWork;
+  // AllGatherv/ReduceScatterv tables go right before the first works
+  int nVTable = plan->nVTableWork;
 
   struct ncclWork* workHeap;
   if (!persistent) {
     workHeap = comm->workFifoHeap;
   } else {
-    workHeap = ncclMemoryStackAlloc<struct ncclWork>(&comm->memScoped, nWork);
+    // Uploaded with the other plans of this launch in ncclLaunchFinish()
+    NCCLCHECK(persistentWorkAlloc(comm, plan, nVTable + nWork, &workHeap));
+    plan->workHead += nVTable;
   }
   uint32_t ixMask = persistent ? ~uint32_t(0) : comm->workFifoDepth-1;
   uint32_t ixSent;
@@ -1105,18 +1260,23 @@ static ncclResult_t uploadWork(struct ncclComm* comm, struct ncclKernelPlan* pla
     ixSent = comm->workFifoSent;
     // First work for a channel has to be at workHeap+blockIdx.x which means
     // we cannot tolerate fifo wraparound. So round up to the wrap boundary
-    // if not doing so would incur crossing it.
-    if (((ixSent + plan->channelCount-1) & ixMask) < (ixSent & ixMask)) {
+    // if not doing so would incur crossing it. Tables are read at a negative
+    // offset from workHead so they must not cross it either.
+    if (((ixSent + nVTable + plan->channelCount-1) & ixMask) < (ixSent & ixMask)) {
       ixSent = (ixSent + ixMask) & ~ixMask;
       // Need to update workFifoSent so waitWorkFifoAvailable() knows we've
       // skipped those elements. Consider if all the channels report quiesced,
       // this way the skipped slots will be considered consumed as well.
       comm->workFifoSent = ixSent;
     }
-    waitWorkFifoAvailable(comm, ixSent + nWork);
+    waitWorkFifoAvailable(comm, ixSent + nVTable + nWork);
   }
-  uint32_t ixHead = ixSent;
-  ixSent += plan->channelCount;
+  uint32_t ixHead = ixSent + nVTable;
+  int t = 0;
+  for (struct ncclWorkList* q = ncclIntruQueueHead(&plan->vTableQueue); q != nullptr; q = q->next) {
+    workHeap[(ixHead - 1 - t++) & ixMask] = q->work; // C++ struct assignment
+  }
+  ixSent = ixHead + plan->channelCount;
   int channelsWithWork = 0; // number of channels below `c` with work structs.
   for (int c=0; c < channelUbound; c++) {
     struct ncclWorkList* q = ncclIntruQueueHead(&plan->channels[c].workQueue);
@@ -1143,9 +1303,6 @@ static ncclResult_t uploadWork(struct ncclComm* comm, struct ncclKernelPlan* pla
     comm->workFifoSent = ixSent;
     if (comm->workFifoHeapGdrHandle != nullptr) wc_store_fence();
     plan->workHead = &comm->devWorkFifoHeap[ixHead & ixMask];
-  } else {
-    NCCLCHECK(ncclCudaMalloc(&plan->workHead, nWork));
-    NCCLCHECK(ncclCudaMemcpy(plan->workHead, workHeap, nWork));
   }
   return ncclSuccess;
 }
@@ -1235,7 +1392,7 @@ static ncclResult_t reclaimPlan(struct ncclComm* comm, struct ncclCommCallback*
   struct ncclKernelPlan* plan = (struct ncclKernelPlan*)me; // cast from first member `reclaim`
   if (plan->persistent) {
     comm->persistentRefs -= 1;
-    NCCLCHECK(ncclCudaFree(plan->workHead));
+    NCCLCHECK(persistentWorkFree(comm, plan));
     for (int c=0; c < plan->channelUbound; c++) {
       struct ncclProxyOp* q = ncclIntruQueueHead(&plan->channels[c].proxyOpQueue);
       while (q != nullptr) {
@@ -1491,6 +1648,10 @@ ncclResult_t ncclLaunchFinish(struct ncclComm* comm) {
   // succeeded, and if it ncclLaunchPrepare didn't succeed we wouldn't be here.
   ncclMemoryStackPop(&comm->memScoped);
 
+  // The graph cannot run before we return, so persistent work can be uploaded last.
+  if (persistent) NCCLCHECKGOTO(persistentWorkUpload(comm), result, resume0);
+resume0:
+
   if (!ncclIntruQueueEmpty(&comm->planQueue)) {
     // Reset queue to empty without destroying plans since those will be sent
     // back to us for reclaiming via callbackQueue.
@@ -1539,68 +1700,9 @@ static inline ncclResult_t getCollNetSupport(struct ncclInfo* info, int* collNet
   return ncclSuccess;
 }
 
-// numPipeOps: number of pipelined ops. Can be greater than 1 in aggregation mode. Used to adjust latency.
-static ncclResult_t topoGetAlgoInfo(struct ncclInfo* collInfo, int collNetSupport, int nvlsSupport, int numPipeOps) {
-  struct ncclComm* comm = collInfo->comm;
-  if (comm->nRanks == 1 || collInfo->coll == ncclFuncAllToAllPivot) {
-    collInfo->algorithm = NCCL_ALGO_RING;
-    collInfo->protocol = NCCL_PROTO_SIMPLE;
-  }
-  else if (collInfo->algorithm == NCCL_ALGO_UNDEF || collInfo->protocol == NCCL_PROTO_UNDEF) {
-    float minTime = 3600000000.0; // Hopefully no operation will take an hour to complete.
-    float backupMinTime = 3600000000.0;
-    bool backup = false;
-    int backupAlgo = NCCL_ALGO_UNDEF; // back up algo and proto if no algo/proto is picked up.
-    int backupProto = NCCL_PROTO_UNDEF;
-    // Find algorithm / protocol.
-    collInfo->algorithm = -1;
-    collInfo->protocol = -1;
-    int nAlgos = NCCL_NUM_ALGORITHMS;
-    for (int a=0; a<nAlgos; a++) {
-      if ((a == NCCL_ALGO_COLLNET_DIRECT || a == NCCL_ALGO_COLLNET_CHAIN) && collNetSupport != 1) continue;
-      if ((a == NCCL_ALGO_NVLS || a == NCCL_ALGO_NVLS_TREE) && nvlsSupport != 1) continue;
-      if (a == NCCL_ALGO_NVLS && collNetSupport != 1 && comm->nNodes > 1) continue;
-      /* now we only support single-node NVLS allgather and reducescatter */
-      if (a == NCCL_ALGO_NVLS && (collInfo->coll == ncclFuncAllGather || collInfo->coll == ncclFuncReduceScatter) && comm->nNodes > 1) continue;
-
-      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
-        if (p == NCCL_PROTO_LL128 && collInfo->comm->topo->type != RCCL_TOPO_XGMI_ALL) continue;
-        float time;
-        NCCLCHECK(ncclTopoGetAlgoTime(collInfo, a, p, numPipeOps, &time, &backup));
-        if (!backup) {
-          if (time >= 0 && time < minTime) {
-            collInfo->algorithm = a;
-            collInfo->protocol = p;
-            minTime = time;
-          }
-        } else {
-          if (time >= 0 && time < backupMinTime) {
-            backupAlgo = a;
-            backupProto = p;
-            backupMinTime = time;
-          }
-        }
-      }
-    }
-
-    if (collInfo->algorithm == NCCL_ALGO_UNDEF || collInfo->protocol == NCCL_PROTO_UNDEF) {
-      if (backupAlgo == NCCL_ALGO_UNDEF || backupProto == NCCL_PROTO_UNDEF) {
-        WARN("Error : no algorithm/protocol available");
-        return ncclInternalError;
-      }
-      collInfo->algorithm = backupAlgo;
-      collInfo->protocol = backupProto;
-    }
-    if (comm->rank == 0) INFO(NCCL_TUNING, "%ld Bytes -> Algo %d proto %d time %f", collInfo->nBytes, collInfo->algorithm, collInfo->protocol, minTime);
-    TRACE(NCCL_COLL, "%ld Bytes -> Algo %d proto %d time %f", collInfo->nBytes, collInfo->algorithm, collInfo->protocol, minTime);
-  }
-
-  return ncclSuccess;
-}
-
 // Use the default topo-based tuner if tuner plugin is not successful.
 // Call the plugin first. Let it set algo+proto, and/or nChannels.
-// Then, topoGetAlgoInfo will set algo/proto if not set, then nChannels and nThreads based on algo/proto.
+// Then, ncclTopoGetAlgoInfo will set algo/proto if not set, then nChannels and nThreads based on algo/proto.
 // Finally, nChannels will be overriden by the plugin setting.
 static ncclResult_t getTunerInfo(struct ncclInfo* collInfo, int collNetSupport, int nvlsSupport, int numPipeOps) {
   collInfo->algorithm = NCCL_ALGO_UNDEF;
@@ -1611,6 +1713,11 @@ static ncclResult_t getTunerInfo(struct ncclInfo* collInfo, int collNetSupport,
           collInfo->coll, collInfo->nBytes,
           collNetSupport, nvlsSupport, numPipeOps,
           &collInfo->algorithm, &collInfo->protocol, &collInfo->nChannels));
+    if (collInfo->comm->treeRootDisabled && collInfo->algorithm == NCCL_ALGO_TREE &&
+        (collInfo->coll == ncclFuncBroadcast || collInfo->coll == ncclFuncReduce)) {
+      collInfo->algorithm = NCCL_ALGO_UNDEF;
+      collInfo->protocol = NCCL_PROTO_UNDEF;
+    }
   }
 
   /* We only honor nChannels decision when user sets the nChannels by tuner plugin or the coll picks
@@ -1622,79 +1729,6 @@ static ncclResult_t getTunerInfo(struct ncclInfo* collInfo, int collNetSupport,
   return ncclSuccess;
 }
 
-/* Compute nChannels and nThreads. */
-static ncclResult_t getChannnelThreadInfo(struct ncclInfo* collInfo) {
-  struct ncclComm *comm = collInfo->comm;
-  int nc = (collInfo->nChannels > 0) ? collInfo->nChannels : comm->nChannels;
-  int nt = comm->maxThreads[collInfo->algorithm][collInfo->protocol];
-  int threadThreshold = comm->threadThresholds[collInfo->algorithm][collInfo->protocol];
-  if (collInfo->algorithm == NCCL_ALGO_COLLNET_DIRECT) {
-    // CollNet channel tuning
-    int ncSwitch = 16;
-    bool flag = true;
-    while (ncSwitch >= 1 && flag) {
-      while ((flag = collInfo->nBytes < nc*nt*collInfo->comm->channels[0].collnetDirect.nHeads*threadThreshold) && nc > ncSwitch) {
-        if (nc == ncSwitch+ncSwitch/2) threadThreshold /= 2;
-        nc--;
-      }
-      ncSwitch /= 2;
-    }
-  } else if (collInfo->algorithm == NCCL_ALGO_NVLS || collInfo->algorithm == NCCL_ALGO_NVLS_TREE) {
-    // NVLS should not need more than 16 channels to get peak BW.
-    nc = comm->nvlsChannels;
-  } else {
-    // Ring/Tree channel tuning
-    while (collInfo->nBytes < nc*nt*threadThreshold) {
-      if (nc >= 2) nc--;
-#if defined(__HIP_PLATFORM_AMD__) || defined(__HIPCC__)
-      // do not reduce threads count on VEGA
-#else
-      else if ((nt % 128) == 0) nt/=2;
-#endif
-      else break;
-    }
-  }
-#if defined(__HIP_PLATFORM_AMD__) || defined(__HIPCC__)
-#else
-  if (collInfo->protocol == NCCL_PROTO_SIMPLE) {
-    if (collInfo->algorithm == NCCL_ALGO_RING) nt += WARP_SIZE; // Extra warp for sync
-    // More threads or sync warps needed due to split thread model
-    if (collInfo->algorithm == NCCL_ALGO_TREE) nt += 4*WARP_SIZE;
-  }
-  nt = nt/WARP_SIZE < 3 ? 3*WARP_SIZE : nt;
-#endif
-  if (collInfo->coll == ncclFuncAllReduce && comm->topo->pivotA2ANumBiRings == 3) {
-    static int userTuneInput = -2;
-    if (userTuneInput == -2) {
-      const char *protoStr = getenv("NCCL_PROTO");
-      const char *algoStr = getenv("NCCL_ALGO");
-      if (!protoStr && !algoStr)
-        userTuneInput = 0;
-      else
-        userTuneInput = 1;
-    }
-    collInfo->nChannels = nc;
-    if (!userTuneInput) {
-      // always respect user settings
-      if (collInfo->nBytes <= 2200008) {
-        collInfo->protocol = NCCL_PROTO_LL;
-        collInfo->algorithm = NCCL_ALGO_TREE;
-        collInfo->nChannels = std::min(24, comm->nChannels);
-      } else {
-        collInfo->protocol = NCCL_PROTO_SIMPLE;
-        collInfo->algorithm = NCCL_ALGO_RING;
-      }
-    }
-  } else if (collInfo->coll == ncclFuncAllReduce && comm->topo->treeDefined == 1) {
-    collInfo->algorithm = NCCL_ALGO_TREE;
-    collInfo->nChannels = nc;
-  } else {
-    collInfo->nChannels = nc;
-  }
-  collInfo->nThreads = nt;
-  return ncclSuccess;
-}
-
 static ncclResult_t getPatternInfo(struct ncclInfo* collInfo) {
   switch (collInfo->coll) {
     case ncclFuncBroadcast:
@@ -1773,6 +1807,13 @@ static ncclResult_t setCollWorkElem(uint64_t workCount, uint64_t workOffset, siz
   return ncclSuccess;
 }
 
+// Tree Broadcast and Reduce follow the neighbour leading to the root, which depends on the channel
+static void setCollWorkElemTreeRoot(struct ncclComm* comm, struct ncclInfo* collInfo, int channelId, struct ncclWorkElem* work) {
+  if (collInfo->algorithm != NCCL_ALGO_TREE) return;
+  if (collInfo->coll != ncclFuncBroadcast && collInfo->coll != ncclFuncReduce) return;
+  work->treeToRoot = comm->treeToRoot[channelId*comm->nRanks + collInfo->root];
+}
+
 static ncclResult_t initCollWorkElemReg(struct ncclComm* comm, struct ncclWorkElem* work, struct ncclChannel* channel, ncclRegBufferType regBufType, void* regBufSend[], void* regBufRecv[], struct ncclWorkElemReg* workElemReg) {
   if (regBufType == NCCL_IPC_REG_BUFFER) {
     workElemReg->elem = *work;
@@ -1817,7 +1858,7 @@ static ncclResult_t computeCollChunkInfo(struct ncclInfo* collInfo, size_t nByte
   if (collInfo->protocol == NCCL_PROTO_LL128) chunkSize = (chunkSize / NCCL_LL128_LINEELEMS) * NCCL_LL128_DATAELEMS;
 
   if (collInfo->algorithm == NCCL_ALGO_TREE && collInfo->protocol == NCCL_PROTO_SIMPLE) {
-    if (collInfo->pattern == ncclPatternTreeUpDown) {
+    if (collInfo->pattern == ncclPatternTreeUpDown || collInfo->pattern == ncclPatternTreeUp || collInfo->pattern == ncclPatternTreeDown) {
       // Optimize chunkSize / nSteps
       while (collInfo->nBytes / (collInfo->nChannels*chunkSize) < collInfo->comm->channels[0].tree.depth*8 && chunkSize > 131072) chunkSize /= 2;
       while (collInfo->nBytes / (collInfo->nChannels*chunkSize) < collInfo->comm->channels[0].tree.depth*4 && chunkSize > 65536) chunkSize /= 2;
@@ -2085,9 +2126,16 @@ static ncclResult_t taskAppend(struct ncclComm* comm, struct ncclInfo* info) {
     // Copy reduction op state from op handle into info struct here since the
     // op handle may be destroyed before ncclGroupEnd().
     NCCLCHECK(hostToDevRedOp(&info->opFull, info->op, info->datatype, comm));
+    // AllGatherv, ReduceScatterv: elements of the kernel per user element, as
+    // ArgsCheck turned AllGather counts into bytes
+    size_t vUnit = info->vCounts ? info->count / ncclCollVMaxCount(info->vCounts, comm->nRanks) : 0;
 
     if (comm->nRanks == 1) {
-      NCCLCHECK(ncclLaunchOneRank(info->recvbuff, info->sendbuff, info->count, info->opFull, info->datatype, info->stream));
+      void* recvbuff = info->recvbuff;
+      const void* sendbuff = info->sendbuff;
+      if (info->vCounts && info->coll == ncclFuncAllGather) recvbuff = (char*)recvbuff + info->vDispls[0]*vUnit*ncclTypeSize(info->datatype);
+      if (info->vCounts && info->coll == ncclFuncReduceScatter) sendbuff = (const char*)sendbuff + info->vDispls[0]*vUnit*ncclTypeSize(info->datatype);
+      NCCLCHECK(ncclLaunchOneRank(recvbuff, sendbuff, info->count, info->opFull, info->datatype, info->stream));
       return ncclSuccess;
     } else {
       // Must be in thread local group before tasks can be alloc'd in `comm->memScoped`.
@@ -2099,6 +2147,15 @@ static ncclResult_t taskAppend(struct ncclComm* comm, struct ncclInfo* info) {
       info->protocol = NCCL_PROTO_UNDEF;
       info->userTuned = false;
       memcpy(t, info, sizeof(struct ncclInfo));
+      if (info->vCounts != nullptr) {
+        // User arrays are only valid during the call
+        t->vSegs = ncclMemoryStackAlloc<struct ncclCollVSeg>(&comm->memScoped, comm->nRanks);
+        for (int r = 0; r < comm->nRanks; r++) {
+          t->vSegs[r].count = info->vCounts[r]*vUnit;
+          t->vSegs[r].displ = info->vDispls[r]*vUnit;
+        }
+        t->vCounts = t->vDispls = nullptr;
+      }
       ncclIntruQueueSortEnqueue(&tasks->collQueue, t, collCmp);
       tasks->workBytesTotal += info->count * ncclTypeSize(info->datatype);
       tasks->nTasksColl += 1;
@@ -13,6 +13,65 @@
 
 #include "msccl/msccl_lifecycle.h"
 
+/******************************************************************/
+/********************** Global graph limits ***********************/
+/******************************************************************/
+
+void ncclTopoReduceGraphInfo(struct ncclTopoGraph* graph, struct ncclTopoGraphInfo* info, int rank, struct ncclTopoGraphLimits* limits) {
+  graph->nChannels = std::min(info->nChannels, graph->nChannels);
+  graph->sameChannels = std::min(info->sameChannels, graph->sameChannels);
+  graph->bwIntra = std::min(info->bwIntra, graph->bwIntra);
+  graph->bwInter = std::min(info->bwInter, graph->bwInter);
+  graph->typeIntra = std::max(info->typeIntra, graph->typeIntra);
+  graph->typeInter = std::max(info->typeInter, graph->typeInter);
+  if (limits) ncclTopoGraphLimitsUpdate(limits, info, rank);
+}
+
+static void graphLimitPrint(struct ncclComm* comm, char* line, int size, const char* algo, const char* name,
+    struct ncclTopoGraphLimit* limit, bool isType) {
+  if (limit->rank == -1 || limit->value == limit->best) return;
+  int offset = strlen(line);
+  int r = limit->rank;
+  if (isType) {
+    snprintf(line+offset, size-offset, " %s %s %s->%s (rank %d node %d busId %lx host %lx)", algo, name,
+        topoPathTypeStr[(int)limit->best], topoPathTypeStr[(int)limit->value], r,
+        comm->rankToNode ? comm->rankToNode[r] : -1, comm->peerInfo[r].busId, comm->peerInfo[r].hostHash);
+  } else {
+    snprintf(line+offset, size-offset, " %s %s %g->%g (rank %d node %d busId %lx host %lx)", algo, name,
+        limit->best, limit->value, r, comm->rankToNode ? comm->rankToNode[r] : -1,
+        comm->peerInfo[r].busId, comm->peerInfo[r].hostHash);
+  }
+}
+
+ncclResult_t ncclTopoPrintGraphLimits(struct ncclComm* comm) {
+  if (comm->rank != 0) return ncclSuccess;
+  char line[2048];
+  line[0] = '\0';
+  struct ncclTopoGraphLimits limits, prev;
+  for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+    NCCLCHECK(ncclTopoGetGraphLimits(comm, a, &limits));
+    // CollNet and NVLS algorithms share their graph
+    bool shared = a > 0 && memcmp(&limits, &prev, sizeof(limits)) == 0;
+    prev = limits;
+    if (shared) continue;
+    graphLimitPrint(comm, line, sizeof(line), ncclAlgoStr[a], "nChannels", &limits.nChannels, false);
+    graphLimitPrint(comm, line, sizeof(line), ncclAlgoStr[a], "bwIntra", &limits.bwIntra, false);
+    graphLimitPrint(comm, line, sizeof(line), ncclAlgoStr[a], "bwInter", &limits.bwInter, false);
+    graphLimitPrint(comm, line, sizeof(line), ncclAlgoStr[a], "typeIntra", &limits.typeIntra, true);
+    graphLimitPrint(comm, line, sizeof(line), ncclAlgoStr[a], "typeInter", &limits.typeInter, true);
+  }
+  if (line[0]) INFO(NCCL_INIT|NCCL_GRAPH, "Graphs reduced by other ranks (best->global):%s", line);
+  return ncclSuccess;
+}
+
+ncclResult_t ncclTopoGetGraphLimits(struct ncclComm* comm, int algorithm, struct ncclTopoGraphLimits* limits) {
+  if (!ncclTopoGraphLimitsGet(comm->graphLimits, NCCL_NUM_ALGORITHMS, algorithm, limits)) {
+    WARN("Invalid algorithm %d", algorithm);
+    return ncclInvalidArgument;
+  }
+  return ncclSuccess;
+}
+
 /******************************************************************/
 /********************* Internode connection ***********************/
 /******************************************************************/
@@ -0,0 +1,150 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#include "core.h"
+#include "comm.h"
+#include "graph.h"
+#include "bootstrap.h"
+#include "node_order.h"
+
+// 0: rank order, 1: order nodes by the latency measured through the bootstrap network,
+// 2: by the matrix of RCCL_NODE_ORDER_FILE
+RCCL_PARAM(NodeOrder, "NODE_ORDER", 0);
+RCCL_PARAM(NodeOrderReps, "NODE_ORDER_REPS", 4);
+
+#define NODE_ORDER_TAG 0x4e4f0000
+#define NODE_ORDER_HOSTLEN 64
+// Bandwidth entries of the file are converted to the time to move this many bytes
+#define NODE_ORDER_BW_BYTES (1 << 20)
+
+struct nodeOrderHost {
+  char name[NODE_ORDER_HOSTLEN];
+};
+
+// Ping the leaders of the nodes at distance 1, 2, 4, ... in both directions.
+// Everyone sends its ping first so that no rank waits on another one's reply.
+static ncclResult_t nodeOrderMeasure(struct ncclComm* comm, int* nodesFirstRank, float* row) {
+  int nNodes = comm->nNodes, node = comm->rankToNode[comm->rank];
+  int reps = std::max(1, (int)rcclParamNodeOrderReps());
+  int step = 0;
+  for (int s=1; s<nNodes; s<<=1, step++) {
+    int up = nodesFirstRank[(node+s)%nNodes], dn = nodesFirstRank[(node-s+nNodes)%nNodes];
+    for (int rep=0; rep<reps; rep++) {
+      int tag = NODE_ORDER_TAG + (step*reps + rep)*2;
+      int ping = 0, pong = 0;
+      uint64_t t0 = clockNano();
+      NCCLCHECK(bootstrapSend(comm->bootstrap, up, tag, &ping, sizeof(int)));
+      NCCLCHECK(bootstrapRecv(comm->bootstrap, dn, tag, &ping, sizeof(int)));
+      NCCLCHECK(bootstrapSend(comm->bootstrap, dn, tag+1, &pong, sizeof(int)));
+      NCCLCHECK(bootstrapRecv(comm->bootstrap, up, tag+1, &pong, sizeof(int)));
+      float us = (clockNano() - t0) / 1000.0f;
+      // The first round trips also wait for the other leaders to start
+      float* entry = row + (node+s)%nNodes;
+      if (*entry < 0 || us < *entry) *entry = us;
+    }
+  }
+  return ncclSuccess;
+}
+
+// Lines are "<host> <host> <latency us> [<bandwidth GB/s>]", '#' starts a comment.
+// Errors leave the row unknown rather than failing, the other ranks are waiting for it.
+static ncclResult_t nodeOrderReadFile(struct ncclComm* comm, struct nodeOrderHost* hosts, int* nodesFirstRank, float* row) {
+  const char* file = ncclGetEnv("RCCL_NODE_ORDER_FILE");
+  if (file == NULL) {
+    WARN("RCCL_NODE_ORDER=2 requires RCCL_NODE_ORDER_FILE");
+    return ncclSuccess;
+  }
+  FILE* f = fopen(file, "r");
+  if (f == NULL) {
+    WARN("Unable to open node latency file %s : %s", file, strerror(errno));
+    return ncclSuccess;
+  }
+  const char* me = hosts[comm->rank].name;
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    char a[NODE_ORDER_HOSTLEN], b[NODE_ORDER_HOSTLEN];
+    float lat, bw = 0;
+    if (sscanf(line, "%63s %63s %f %f", a, b, &lat, &bw) < 3) continue;
+    const char* other = strcmp(a, me) == 0 ? b : strcmp(b, me) == 0 ? a : NULL;
+    if (other == NULL) continue;
+    float cost = lat + (bw > 0 ? NODE_ORDER_BW_BYTES / (bw * 1e3f) : 0);
+    for (int n=0; n<comm->nNodes; n++) {
+      if (strcmp(hosts[nodesFirstRank[n]].name, other) == 0 && (row[n] < 0 || cost < row[n])) row[n] = cost;
+    }
+  }
+  fclose(f);
+  return ncclSuccess;
+}
+
+// Reorder the nodes of the communicator so that rings and trees keep neighbours
+// close in the network. Must be called by all ranks before localRanks are computed.
+ncclResult_t ncclTopoOrderNodes(struct ncclComm* comm, int* nodesFirstRank, int* nodesTreePatterns) {
+  int mode = rcclParamNodeOrder();
+  int nNodes = comm->nNodes, nRanks = comm->nRanks;
+  if (mode == 0 || nNodes <= 2) return ncclSuccess;
+  if (nNodes > NCCL_NODE_ORDER_MAX_NODES) {
+    INFO(NCCL_INIT, "RCCL_NODE_ORDER ignored, %d nodes is more than %d", nNodes, NCCL_NODE_ORDER_MAX_NODES);
+    return ncclSuccess;
+  }
+  ncclResult_t ret = ncclSuccess;
+  struct nodeOrderHost* hosts = NULL;
+  float* rows = NULL;
+  int *order = NULL, *position = NULL, *firstRanks = NULL, *patterns = NULL;
+  int node = comm->rankToNode[comm->rank];
+  bool leader = nodesFirstRank[node] == comm->rank;
+  float* cost;
+  NCCLCHECKGOTO(ncclCalloc(&hosts, nRanks), ret, exit);
+  NCCLCHECKGOTO(getHostName(hosts[comm->rank].name, NODE_ORDER_HOSTLEN, '.'), ret, exit);
+  NCCLCHECKGOTO(bootstrapAllGather(comm->bootstrap, hosts, sizeof(struct nodeOrderHost)), ret, exit);
+
+  // Each node leader fills its row, then every rank builds the same matrix
+  NCCLCHECKGOTO(ncclCalloc(&rows, (size_t)nRanks*nNodes + (size_t)nNodes*nNodes), ret, exit);
+  for (int n=0; n<nNodes; n++) rows[comm->rank*nNodes+n] = -1;
+  if (leader && mode == 1) {
+    NCCLCHECKGOTO(nodeOrderMeasure(comm, nodesFirstRank, rows+comm->rank*nNodes), ret, exit);
+  } else if (leader) {
+    NCCLCHECKGOTO(nodeOrderReadFile(comm, hosts, nodesFirstRank, rows+comm->rank*nNodes), ret, exit);
+  }
+  NCCLCHECKGOTO(bootstrapAllGather(comm->bootstrap, rows, nNodes*sizeof(float)), ret, exit);
+  cost = rows + (size_t)nRanks*nNodes;
+  for (int n=0; n<nNodes; n++) memcpy(cost+n*nNodes, rows+nodesFirstRank[n]*nNodes, nNodes*sizeof(float));
+  if (!ncclNodeOrderComplete(nNodes, cost)) {
+    INFO(NCCL_INIT, "RCCL_NODE_ORDER ignored, the node latency matrix is incomplete");
+    goto exit;
+  }
+
+  NCCLCHECKGOTO(ncclCalloc(&order, nNodes), ret, exit);
+  if (!ncclNodeOrderCompute(nNodes, cost, order)) {
+    INFO(NCCL_INIT, "RCCL_NODE_ORDER keeps rank order, cost %g", ncclNodeOrderCost(nNodes, cost, order));
+    goto exit;
+  }
+  NCCLCHECKGOTO(ncclCalloc(&position, nNodes), ret, exit);
+  NCCLCHECKGOTO(ncclCalloc(&firstRanks, nNodes), ret, exit);
+  NCCLCHECKGOTO(ncclCalloc(&patterns, nNodes), ret, exit);
+  for (int p=0; p<nNodes; p++) position[p] = p;
+  INFO(NCCL_INIT, "RCCL_NODE_ORDER reordered %d nodes, cost %g -> %g", nNodes, ncclNodeOrderCost(nNodes, cost, position),
+      ncclNodeOrderCost(nNodes, cost, order));
+  for (int p=0; p<nNodes; p++) {
+    position[order[p]] = p;
+    firstRanks[p] = nodesFirstRank[order[p]];
+    patterns[p] = nodesTreePatterns[order[p]];
+    if (comm->rank == 0) TRACE(NCCL_INIT, "Node position %d : node %d rank %d host %s", p, order[p], firstRanks[p], hosts[firstRanks[p]].name);
+  }
+  memcpy(nodesFirstRank, firstRanks, nNodes*sizeof(int));
+  memcpy(nodesTreePatterns, patterns, nNodes*sizeof(int));
+  for (int r=0; r<nRanks; r++) comm->rankToNode[r] = position[comm->rankToNode[r]];
+
+exit:
+  free(hosts);
+  free(rows);
+  free(order);
+  free(position);
+  free(firstRanks);
+  free(patterns);
+  return ret;
+}
@@ -592,6 +592,33 @@ static bool rcclPathOverride(struct ncclTopoSystem* system, uint64_t distance) {
   }
 }
 
+// Pick the GPU relaying traffic from GPU g to NIC n (PXN = PCI + NVLink). Any
+// GPU connected to the NIC through PCI and to g through NVLink can relay, if it
+// has higher bandwidth to the NIC or avoids going through a CPU. Among the ones
+// with the highest bandwidth, pick the one which relays the least traffic so
+// far (starting with the GPU local to the NIC), so that a single GPU does not
+// proxy all the traffic of the node. This only depends on the topology, so all
+// ranks make the same choice.
+static ncclResult_t selectPxnGpu(struct ncclTopoSystem* system, int g, int n, int localGpuIndex, float* load, int* relay) {
+  struct ncclTopoNode* gpu = system->nodes[GPU].nodes+g;
+  *relay = -1;
+  for (int i=-1; i<system->nodes[GPU].count; i++) {
+    int p = i == -1 ? localGpuIndex : i;
+    if (p == g || (i != -1 && p == localGpuIndex)) continue;
+    struct ncclTopoNode* peerNode = system->nodes[GPU].nodes+p;
+    if (peerNode->paths[NET][n].type > PATH_PXB || peerNode->paths[GPU][g].type > PATH_NVL) continue;
+    if (peerNode->paths[NET][n].bw <= gpu->paths[NET][n].bw && gpu->paths[NET][n].type <= PATH_PXB) continue;
+    if (*relay == -1) {
+      *relay = p;
+      continue;
+    }
+    float bw = peerNode->paths[NET][n].bw;
+    float relayBw = system->nodes[GPU].nodes[*relay].paths[NET][n].bw;
+    if (bw > relayBw || (bw == relayBw && load[p] < load[*relay])) *relay = p;
+  }
+  return ncclSuccess;
+}
+
 ncclResult_t ncclTopoComputePaths(struct ncclTopoSystem* system, struct ncclComm* comm) {
   // Precompute paths between GPUs/NICs.
 
@@ -671,6 +698,7 @@ ncclResult_t ncclTopoComputePaths(struct ncclTopoSystem* system, struct ncclComm
 #endif
 
   // Update paths for NICs (no GPU Direct, PXN, ...)
+  float pxnLoad[NCCL_TOPO_MAX_NODES] = { 0 };
   for (int n=0; n<system->nodes[NET].count; n++) {
     struct ncclTopoNode* netNode = system->nodes[NET].nodes+n;
 
@@ -681,17 +709,16 @@ ncclResult_t ncclTopoComputePaths(struct ncclTopoSystem* system, struct ncclComm
         int localGpuIndex;
         NCCLCHECK(ncclTopoGetLocalGpu(system, system->nodes[NET].nodes[n].id, &localGpuIndex));
         if (localGpuIndex != g && localGpuIndex != -1) {
-          // PXN = PCI + NVLink.
-          struct ncclTopoNode* peerNode = system->nodes[GPU].nodes+localGpuIndex;
-          // Only use PXN for NIC n if remote GPU p ...
-          if (peerNode->paths[NET][n].type <= PATH_PXB && // Is connected to the NIC through PCI
-              peerNode->paths[GPU][g].type <= PATH_NVL && // Is connected to us through NVLink
-              (peerNode->paths[NET][n].bw > gpu->paths[NET][n].bw || // Has either higher BW to that NIC
-               gpu->paths[NET][n].type > PATH_PXB))                  // or avoids going through a CPU
-          // We can use that GPU as relay to communicate with that NIC.
-          // Only enabling it in the GPU->NIC direction for now to favor
-          // receiving locally and sending remotely (consistent with net.cc)
-          NCCLCHECK(addInterStep(system, GPU, localGpuIndex, GPU, g, NET, n));
+          int relay;
+          NCCLCHECK(selectPxnGpu(system, g, n, localGpuIndex, pxnLoad, &relay));
+          if (relay != -1) {
+            // We can use that GPU as relay to communicate with that NIC.
+            // Only enabling it in the GPU->NIC direction for now to favor
+            // receiving locally and sending remotely (consistent with net.cc)
+            NCCLCHECK(addInterStep(system, GPU, relay, GPU, g, NET, n));
+            pxnLoad[relay] += gpu->paths[NET][n].bw;
+            TRACE(NCCL_GRAPH, "PXN GPU %d -> NET %d through GPU %d (load %g)", g, n, relay, pxnLoad[relay]);
+          }
         }
       }
       // Update path when we dont want to / can't use GPU Direct RDMA.
@@ -814,6 +841,15 @@ ncclResult_t ncclTopoTrimSystem(struct ncclTopoSystem* system, struct ncclComm*
 
 void ncclTopoFree(struct ncclTopoSystem* system) {
   for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) ncclTopoRemovePathType(system, t);
+  if (system->nodePool) {
+    free(system->nodePool);
+    free(system->linkPool);
+  } else {
+    for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+      for (int n=0; n<system->nodes[t].count; n++) free(system->nodes[t].nodes[n].links);
+      free(system->nodes[t].nodes);
+    }
+  }
   free(system);
 }
 
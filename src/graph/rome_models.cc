@@ -1201,11 +1201,11 @@ ncclResult_t parseChordalRing(struct ncclTopoSystem* system, struct ncclTopoGrap
     int sum = ngpus*(ngpus-1)/2 - node->gpu.dev;
     int count = 0;
     for (int n = 0; n<ngpus; n++) {
-      struct ncclTopoLink* link;
-      for (link = node->links; link->remNode; link++) {
-        if (link->remNode->gpu.dev == n) break;
+      struct ncclTopoLink* link = NULL;
+      for (int l=0; l<node->nlinks; l++) {
+        if (node->links[l].remNode->gpu.dev == n) { link = node->links+l; break; }
       }
-      if (!link->remNode) continue;
+      if (link == NULL) continue;
       if (link->type != LINK_NVL) continue;
       sum -= system->nodes[GPU].nodes[n].gpu.dev;
       count ++;
@@ -1342,11 +1342,11 @@ static ncclResult_t parseRomeSystem(struct ncclTopoSystem* system, struct rcclRo
     int count = 0;
     for (n = 0; n < romeTopo->nGpus; n++) {
       romeTopo->connMatrix[i*romeTopo->nGpus+n] = 0;
-      struct ncclTopoLink* link;
-      for (link = node->links; link->remNode; link++) {
-        if (link->remNode->gpu.dev == n) break;
+      struct ncclTopoLink* link = NULL;
+      for (int l=0; l<node->nlinks; l++) {
+        if (node->links[l].remNode->gpu.dev == n) { link = node->links+l; break; }
       }
-      if (!link->remNode) continue;
+      if (link == NULL) continue;
       if (link->type != LINK_NVL) continue;
       romeTopo->connMatrix[i*romeTopo->nGpus+n] = link->bw/ncclTopoXGMISpeed(node->gpu.gcn);
       count ++;
@@ -1391,7 +1391,7 @@ static ncclResult_t parseRomeSystem(struct ncclTopoSystem* system, struct rcclRo
     }
   }
 
-  const char* romeModelFile = getenv("RCCL_DUMP_ROME_MODEL_FILE");
+  const char* romeModelFile = ncclGetEnv("RCCL_DUMP_ROME_MODEL_FILE");
   if (romeModelFile) {
     INFO(NCCL_ENV, "RCCL_DUMP_ROME_MODEL_FILE set by environment to %s", romeModelFile);
     FILE* file = fopen(romeModelFile, "w");
@@ -1628,6 +1628,7 @@ ncclResult_t parseRome4P2H(struct ncclTopoSystem* system, struct ncclTopoGraph*
     }
   }
   INFO(NCCL_GRAPH, "%s", line);
+  system->romeModel = i;
   parseOptions(system, romeTopoModels[i].options);
 
   // create 4P2H based on reference and remapped ids
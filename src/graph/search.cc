@@ -929,17 +929,22 @@ ncclResult_t ncclTopoCompute(ncclTopoSystem* system, struct ncclTopoGraph* graph
   if (str) {
     INFO(NCCL_ENV, "NCCL_GRAPH_FILE set by environment to %s", str);
     struct ncclXml* xml;
-    NCCLCHECK(ncclCalloc(&xml, 1));
+    NCCLCHECK(xmlAlloc(&xml));
     NCCLCHECK(ncclTopoGetXmlGraphFromFile(str, xml));
+    if (xml->maxIndex == 0 || xml->nodes[0] == NULL) {
+      WARN("NCCL_GRAPH_FILE %s has no <graphs> root element", str);
+      xmlFree(xml);
+      return ncclInvalidUsage;
+    }
     int nChannels;
-    NCCLCHECK(ncclTopoGetGraphFromXml(xml->nodes, system, graph, &nChannels));
+    NCCLCHECK(ncclTopoGetGraphFromXml(xml->nodes[0], system, graph, &nChannels));
     INFO(NCCL_GRAPH, "Search %d : %d channels loaded from XML graph", graph->id, nChannels);
-    free(xml);
+    xmlFree(xml);
     if (graph->nChannels > 0) return ncclSuccess;
   }
 
-  str = getenv("NCCL_RINGS");
-  char* strTrees = getenv("RCCL_TREES");
+  str = ncclGetEnv("NCCL_RINGS");
+  const char* strTrees = ncclGetEnv("RCCL_TREES");
 
   if (str || strTrees) {
     // user supplied topo
@@ -961,7 +966,7 @@ ncclResult_t ncclTopoCompute(ncclTopoSystem* system, struct ncclTopoGraph* graph
     NCCLCHECK(parseChordalRing(system, graph));
     if (graph->nChannels) return ncclSuccess;
     // try to match Rome 4P2H
-    const char *remap_str = getenv("NCCL_RINGS_REMAP");
+    const char *remap_str = ncclGetEnv("NCCL_RINGS_REMAP");
     NCCLCHECK(parseRome4P2H(system, graph, remap_str));
 
     if (graph->nChannels) return ncclSuccess;
@@ -1174,10 +1179,10 @@ ncclResult_t ncclTopoDumpGraphs(struct ncclTopoSystem* system, int ngraphs, stru
   if (str) {
     INFO(NCCL_ENV, "NCCL_GRAPH_DUMP_FILE set by environment to %s", str);
     struct ncclXml* xml;
-    NCCLCHECK(ncclCalloc(&xml, 1));
+    NCCLCHECK(xmlAlloc(&xml));
     NCCLCHECK(ncclTopoGetXmlFromGraphs(ngraphs, graphs, system, xml));
     NCCLCHECK(ncclTopoDumpXmlToFile(str, xml));
-    free(xml);
+    xmlFree(xml);
   }
   return ncclSuccess;
 }
@@ -1264,6 +1269,12 @@ ncclResult_t ncclTopoGetNetDev(struct ncclComm* comm, int rank, struct ncclTopoG
         int n, g1, g2;
         NCCLCHECK(ncclTopoIdToIndex(comm->topo, NET, netDev, &n));
         NCCLCHECK(ncclTopoRankToIndex(comm->topo, rank, &g1));
+        if (comm->topo->nodes[GPU].nodes[g1].paths[NET][n].type == PATH_PXN) {
+          // Use the relay GPU chosen when computing paths, which balances PXN traffic.
+          *dev = netDev;
+          NCCLCHECK(ncclTopoGetIntermediateRank(comm->topo, rank, *dev, proxyRank));
+          return ncclSuccess;
+        }
         NCCLCHECK(ncclTopoGetLocalGpu(comm->topo, netDev, &g2));
         if (g2 != -1) {
           struct ncclTopoNode* peerGpu = comm->topo->nodes[GPU].nodes+g2;
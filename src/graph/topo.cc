@@ -105,6 +105,11 @@ ncclResult_t ncclTopoGetNode(struct ncclTopoSystem* system, struct ncclTopoNode*
 }
 
 ncclResult_t ncclTopoCreateNode(struct ncclTopoSystem* system, struct ncclTopoNode** node, int type, uint64_t id) {
+  if (system->nodePool) {
+    WARN("Error : tried to create a node of type %d after the topology was compacted", type);
+    return ncclInternalError;
+  }
+  if (system->nodes[type].nodes == NULL) NCCLCHECK(ncclCalloc(&system->nodes[type].nodes, NCCL_TOPO_MAX_NODES));
   if (system->nodes[type].count == NCCL_TOPO_MAX_NODES) {
     WARN("Error : tried to create too many nodes of type %d", type);
     return ncclInternalError;
@@ -113,6 +118,7 @@ ncclResult_t ncclTopoCreateNode(struct ncclTopoSystem* system, struct ncclTopoNo
   system->nodes[type].count++;
   n->type = type;
   n->id = id;
+  NCCLCHECK(ncclCalloc(&n->links, NCCL_TOPO_MAX_LINKS));
   if (type == GPU) {
     // Create link to itself (used in some corner cases)
     n->nlinks=1;
@@ -154,18 +160,30 @@ ncclResult_t ncclTopoRemoveNode(struct ncclTopoSystem* system, int type, int ind
       }
     }
   }
+  // Scratch links are owned by the node until the system is compacted
+  if (system->nodePool == NULL) free(delNode->links);
   memmove(delNode, delNode+1, (system->nodes[type].count-index-1)*sizeof(struct ncclTopoNode));
   system->nodes[type].count--;
   return ncclSuccess;
 }
 
+static ncclResult_t ncclTopoAddLink(struct ncclTopoNode* node, struct ncclTopoLink** link) {
+  if (node->nlinks == NCCL_TOPO_MAX_LINKS) {
+    WARN("Error : too many links for node %s/%lx (max %d)", topoNodeTypeStr[node->type], node->id, NCCL_TOPO_MAX_LINKS);
+    return ncclInternalError;
+  }
+  *link = node->links+node->nlinks++;
+  memset(*link, 0, sizeof(struct ncclTopoLink));
+  return ncclSuccess;
+}
+
 ncclResult_t ncclTopoConnectNodes(struct ncclTopoNode* node, struct ncclTopoNode* remNode, int type, float bw) {
   // Aggregate links into higher bw for NVLink
-  struct ncclTopoLink* link;
-  for (link = node->links; link->remNode; link++) {
-    if (link->remNode == remNode && link->type == type) break;
+  struct ncclTopoLink* link = NULL;
+  for (int l=0; l<node->nlinks; l++) {
+    if (node->links[l].remNode == remNode && node->links[l].type == type) { link = node->links+l; break; }
   }
-  if (link->remNode == NULL) node->nlinks++;
+  if (link == NULL) NCCLCHECK(ncclTopoAddLink(node, &link));
   link->type = type;
   link->remNode = remNode;
   link->bw += bw;
@@ -182,6 +200,55 @@ ncclResult_t ncclTopoConnectNodes(struct ncclTopoNode* node, struct ncclTopoNode
   return ncclSuccess;
 }
 
+// Move all nodes and links from the fixed size arrays used while building the
+// system into two contiguous pools. Nodes of a given type stay contiguous (and
+// in the same order), and the links of each node become a contiguous range, so
+// that path computation and search walk a small, cache resident structure.
+ncclResult_t ncclTopoCompactSystem(struct ncclTopoSystem* system) {
+  if (system->nodePool) return ncclSuccess;
+  int nNodes = 0, nLinks = 0;
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    nNodes += system->nodes[t].count;
+    for (int n=0; n<system->nodes[t].count; n++) nLinks += system->nodes[t].nodes[n].nlinks;
+  }
+  struct ncclTopoNode* nodePool;
+  struct ncclTopoLink* linkPool;
+  NCCLCHECK(ncclCalloc(&nodePool, std::max(nNodes, 1)));
+  NCCLCHECK(ncclCalloc(&linkPool, std::max(nLinks, 1)));
+
+  struct ncclTopoNode* nodes[NCCL_TOPO_NODE_TYPES];
+  int nodeOffset = 0;
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    nodes[t] = nodePool+nodeOffset;
+    if (system->nodes[t].count) memcpy(nodes[t], system->nodes[t].nodes, system->nodes[t].count*sizeof(struct ncclTopoNode));
+    nodeOffset += system->nodes[t].count;
+  }
+  int linkOffset = 0;
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    for (int n=0; n<system->nodes[t].count; n++) {
+      struct ncclTopoNode* node = nodes[t]+n;
+      struct ncclTopoLink* links = linkPool+linkOffset;
+      for (int l=0; l<node->nlinks; l++) {
+        struct ncclTopoNode* remNode = node->links[l].remNode;
+        links[l] = node->links[l];
+        links[l].remNode = nodes[remNode->type] + (remNode - system->nodes[remNode->type].nodes);
+      }
+      free(node->links);
+      node->links = links;
+      linkOffset += node->nlinks;
+    }
+  }
+  for (int t=0; t<NCCL_TOPO_NODE_TYPES; t++) {
+    free(system->nodes[t].nodes);
+    system->nodes[t].nodes = nodes[t];
+  }
+  system->nodePool = nodePool;
+  system->linkPool = linkPool;
+  TRACE(NCCL_GRAPH, "Topology compacted to %d nodes and %d links (%ld bytes)", nNodes, nLinks,
+      nNodes*sizeof(struct ncclTopoNode)+nLinks*sizeof(struct ncclTopoLink));
+  return ncclSuccess;
+}
+
 // BCM Gen4 Switches present themselves as a two-level hierarchical switch
 // even though they're supposed to sustain full BW across all ports.
 // Flatten the switch as this extra level can break the search and make
@@ -224,8 +291,9 @@ ncclResult_t ncclTopoFlattenBcmSwitches(struct ncclTopoSystem* system) {
           struct ncclTopoNode* remNode = sub->links[l].remNode;
           if (remNode == pciSwitch) continue;
           // Add link from parent PCI switch -> PCI device
-          memcpy(pciSwitch->links+pciSwitch->nlinks, sub->links+l, sizeof(struct ncclTopoLink));
-          pciSwitch->nlinks++;
+          struct ncclTopoLink* link;
+          NCCLCHECK(ncclTopoAddLink(pciSwitch, &link));
+          memcpy(link, sub->links+l, sizeof(struct ncclTopoLink));
           // Update link from PCI device -> parent PCI switch
           for (int rl=0; rl<remNode->nlinks; rl++) {
             if (remNode->links[rl].remNode == sub) {
@@ -309,7 +377,7 @@ static ncclResult_t ncclTopoSort(struct ncclTopoNode* node, struct ncclTopoNode*
     while (node->links[l].remNode != upNode) l++;
     struct ncclTopoLink upLink;
     memcpy(&upLink, node->links+l, sizeof(struct ncclTopoLink));
-    while (node->links[l+1].remNode) {
+    while (l+1 < node->nlinks) {
       memcpy(node->links+l, node->links+l+1, sizeof(struct ncclTopoLink));
       l++;
     }
@@ -679,6 +747,7 @@ ncclResult_t ncclTopoGetSystemFromXml(struct ncclXml* xml, struct ncclTopoSystem
   NCCLCHECK(ncclTopoFlattenBcmSwitches(*topoSystem));
   NCCLCHECK(ncclTopoConnectCpus(*topoSystem));
   NCCLCHECK(ncclTopoSortSystem(*topoSystem));
+  NCCLCHECK(ncclTopoCompactSystem(*topoSystem));
 
   return ncclSuccess;
 }
@@ -687,40 +756,28 @@ NCCL_PARAM(TopoDumpFileRank, "TOPO_DUMP_FILE_RANK", 0);
 
 // Only set values if not already set
 static ncclResult_t xmlInitAttrInt(struct ncclXmlNode* node, const char* attrName, const int value) {
-  int index;
-  NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    snprintf(node->attrs[index].value, MAX_STR_LEN, "%d", value);
-  }
+  char strValue[MAX_STR_LEN+1];
+  snprintf(strValue, MAX_STR_LEN, "%d", value);
+  NCCLCHECK(xmlSetAttrIfUnset(node, attrName, strValue));
   return ncclSuccess;
 }
 static ncclResult_t xmlInitAttrUint64(struct ncclXmlNode* node, const char* attrName, const uint64_t value) {
-  int index;
-  NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    snprintf(node->attrs[index].value, MAX_STR_LEN, "0x%lx", value);
-  }
+  char strValue[MAX_STR_LEN+1];
+  snprintf(strValue, MAX_STR_LEN, "0x%lx", value);
+  NCCLCHECK(xmlSetAttrIfUnset(node, attrName, strValue));
   return ncclSuccess;
 }
 static ncclResult_t xmlInitAttrFloat(struct ncclXmlNode* node, const char* attrName, const float value) {
-  int index;
-  NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    snprintf(node->attrs[index].value, MAX_STR_LEN, "%f", value);
-  }
+  char strValue[MAX_STR_LEN+1];
+  snprintf(strValue, MAX_STR_LEN, "%f", value);
+  NCCLCHECK(xmlSetAttrIfUnset(node, attrName, strValue));
   return ncclSuccess;
 }
 
 
 ncclResult_t ncclTopoGetSystem(struct ncclComm* comm, struct ncclTopoSystem** system) {
   struct ncclXml* xml;
-  NCCLCHECK(ncclCalloc(&xml, 1));
+  NCCLCHECK(xmlAlloc(&xml));
   const char* xmlTopoFile = ncclGetEnv("NCCL_TOPO_FILE");
   if (xmlTopoFile) {
     INFO(NCCL_ENV, "NCCL_TOPO_FILE set by environment to %s", xmlTopoFile);
@@ -801,7 +858,7 @@ ncclResult_t ncclTopoGetSystem(struct ncclComm* comm, struct ncclTopoSystem** sy
   }
 
   NCCLCHECK(ncclTopoGetSystemFromXml(xml, system));
-  free(xml);
+  xmlFree(xml);
   return ncclSuccess;
 }
 
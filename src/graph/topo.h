@@ -98,11 +98,13 @@ struct ncclTopoLink {
 
 #define NCCL_TOPO_MAX_HOPS (NCCL_TOPO_MAX_NODES*NCCL_TOPO_NODE_TYPES)
 
+// Keep count/bw/type ahead of the hop list so that path checks during the
+// search only touch the first cache line of each path.
 struct ncclTopoLinkList {
-  struct ncclTopoLink* list[NCCL_TOPO_MAX_HOPS];
   int count;
   float bw;
   int type;
+  struct ncclTopoLink* list[NCCL_TOPO_MAX_HOPS];
 };
 
 #define NCCL_TOPO_CPU_INTEL_BDW 1
@@ -153,7 +155,9 @@ struct ncclTopoNode {
     }pci;
   };
   int nlinks;
-  struct ncclTopoLink links[NCCL_TOPO_MAX_LINKS];
+  // Links are a range of ncclTopoSystem::linkPool once the system is built,
+  // and a NCCL_TOPO_MAX_LINKS scratch array while it is being built.
+  struct ncclTopoLink* links;
   // Pre-computed paths to GPUs and NICs
   struct ncclTopoLinkList* paths[NCCL_TOPO_NODE_TYPES];
   // Used during search
@@ -162,11 +166,15 @@ struct ncclTopoNode {
 
 struct ncclTopoNodeSet {
   int count;
-  struct ncclTopoNode nodes[NCCL_TOPO_MAX_NODES];
+  struct ncclTopoNode* nodes;
 };
 
 struct ncclTopoSystem {
   struct ncclTopoNodeSet nodes[NCCL_TOPO_NODE_TYPES];
+  // Compact storage for all nodes (grouped by type) and all links (grouped by
+  // node), sized by ncclTopoCompactSystem. NULL while the system is being built.
+  struct ncclTopoNode* nodePool;
+  struct ncclTopoLink* linkPool;
   float maxBw;
   float totalBw;
   int type;
@@ -180,6 +188,8 @@ struct ncclTopoSystem {
   bool ll128Enabled;
   float baseBw;
   bool mscclEnabled;
+  // Index of the Rome model matched during graph search, -1 if none
+  int romeModel;
 
   // [RCCL] Track hostIdx and number of hosts to support rail-optimized rings/trees
   int nHosts;
@@ -190,6 +200,7 @@ ncclResult_t ncclTopoGetNode(struct ncclTopoSystem* system, struct ncclTopoNode*
 ncclResult_t ncclTopoCreateNode(struct ncclTopoSystem* system, struct ncclTopoNode** node, int type, uint64_t id);
 ncclResult_t ncclTopoRemoveNode(struct ncclTopoSystem* system, int type, int id);
 ncclResult_t ncclTopoConnectNodes(struct ncclTopoNode* node, struct ncclTopoNode* remNode, int type, float bw);
+ncclResult_t ncclTopoCompactSystem(struct ncclTopoSystem* system);
 ncclResult_t ncclTopoPrintPaths(struct ncclTopoSystem* system);
 ncclResult_t ncclTopoLoadSystem(const char* xmlTopoFile, struct ncclTopoSystem* system);
 ncclResult_t ncclTopoGetIntermediateRank(struct ncclTopoSystem* system, int rank, int netDev, int* intermediateRank);
@@ -290,6 +290,8 @@ static const double perChMaxTreeBws[3][3] = {
 
 // Network post overhead in ns (1000 = 1 us)
 NCCL_PARAM(NetOverhead, "NET_OVERHEAD", -2);
+// Broadcast and Reduce on trees, opt-in
+RCCL_PARAM(TreeBcastReduce, "TREE_BCAST_REDUCE", 0);
 
 static float getNetOverhead(struct ncclComm* comm) {
   if (ncclParamNetOverhead() != -2) return ncclParamNetOverhead() * .001;
@@ -357,8 +359,8 @@ ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCom
       nNodes;
 
     for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
-      if (coll == ncclFuncBroadcast && a != NCCL_ALGO_RING) continue;
-      if (coll == ncclFuncReduce && a != NCCL_ALGO_RING) continue;
+      if (coll == ncclFuncBroadcast && a != NCCL_ALGO_RING && a != NCCL_ALGO_TREE) continue;
+      if (coll == ncclFuncReduce && a != NCCL_ALGO_RING && a != NCCL_ALGO_TREE) continue;
       if (coll == ncclFuncReduceScatter && a != NCCL_ALGO_RING && a != NCCL_ALGO_NVLS && a != NCCL_ALGO_COLLNET_DIRECT) continue;
       if (coll == ncclFuncAllGather && a != NCCL_ALGO_RING && a != NCCL_ALGO_NVLS && a != NCCL_ALGO_COLLNET_DIRECT) continue;
 
@@ -419,6 +421,8 @@ ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCom
           float ratio = 1.0f;
           if (a == NCCL_ALGO_RING) ratio *= (1.0 * nRanks) / nsteps;
           else if (a == NCCL_ALGO_NVLS || a == NCCL_ALGO_NVLS_TREE) ratio *= 5.0/6.0;
+          // Broadcast and Reduce cross the tree once, but inner nodes of the inter-node tree feed two children
+          else if (a == NCCL_ALGO_TREE && (coll == ncclFuncBroadcast || coll == ncclFuncReduce)) ratio *= nNodes <= 2 ? 1.0 : .5;
           else ratio *= .5;
           busBw *= ratio;
         }
@@ -453,6 +457,7 @@ ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCom
             comm->latencies[coll][a][p] += (nsteps-nInterSteps)*intraLat + nInterSteps*interLat;
           }
         } else if (a == NCCL_ALGO_TREE) {
+          // Broadcast and Reduce from any root may go up to the top of the tree and back down
           comm->latencies[coll][a][p] +=
             2 * ((nRanks/nNodes-1) * intraLat + log2i(nNodes) * interLat);
         } else if (a == NCCL_ALGO_COLLNET_DIRECT) {
@@ -534,6 +539,7 @@ ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCom
     }
     if (pEnable == 0) comm->bandwidths[c][a][p] = 0;
     if (algoEnable[a] == 0) comm->bandwidths[c][a][p] = 0;
+    if ((comm->treeRootDisabled || !rcclParamTreeBcastReduce()) && a == NCCL_ALGO_TREE && (c == ncclFuncBroadcast || c == ncclFuncReduce)) comm->bandwidths[c][a][p] = 0;
   }
 
   for (int c = 0; c < NCCL_NUM_FUNCTIONS; c++) {
@@ -671,4 +677,149 @@ ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int proto
   int latCount = algorithm == NCCL_ALGO_RING ? numPipeOps : DIVUP(numPipeOps, NCCL_MAX_WORK_ELEMENTS);
   *time = lat * latCount + (info->nBytes) / (1000 * bw);
   return ncclSuccess;
-}
\ No newline at end of file
+}
+
+// numPipeOps: number of pipelined ops. Can be greater than 1 in aggregation mode. Used to adjust latency.
+// LL128 rounds after every source, so it is kept off the reductions RCCL_REDUCE_ACC_FP32 changes:
+// tree steps adding several children, and ncclAvg. Ring sums add two values per step and keep it.
+static bool reduceAccFp32SkipLL128(struct ncclInfo* collInfo, int algorithm) {
+  if (!collInfo->comm->reduceAccFp32) return false;
+  if (collInfo->coll != ncclFuncAllReduce && collInfo->coll != ncclFuncReduce && collInfo->coll != ncclFuncReduceScatter) return false;
+  if (collInfo->datatype != ncclFloat16 && collInfo->datatype != ncclBfloat16) return false;
+  if (collInfo->op == ncclAvg) return true;
+  return collInfo->op == ncclSum && algorithm != NCCL_ALGO_RING;
+}
+
+ncclResult_t ncclTopoGetAlgoInfo(struct ncclInfo* collInfo, int collNetSupport, int nvlsSupport, int numPipeOps) {
+  struct ncclComm* comm = collInfo->comm;
+  if (comm->nRanks == 1 || collInfo->coll == ncclFuncAllToAllPivot) {
+    collInfo->algorithm = NCCL_ALGO_RING;
+    collInfo->protocol = NCCL_PROTO_SIMPLE;
+  }
+  else if (collInfo->algorithm == NCCL_ALGO_UNDEF || collInfo->protocol == NCCL_PROTO_UNDEF) {
+    float minTime = 3600000000.0; // Hopefully no operation will take an hour to complete.
+    float backupMinTime = 3600000000.0;
+    bool backup = false;
+    int backupAlgo = NCCL_ALGO_UNDEF; // back up algo and proto if no algo/proto is picked up.
+    int backupProto = NCCL_PROTO_UNDEF;
+    // Find algorithm / protocol.
+    collInfo->algorithm = -1;
+    collInfo->protocol = -1;
+    int nAlgos = NCCL_NUM_ALGORITHMS;
+    for (int a=0; a<nAlgos; a++) {
+      if ((a == NCCL_ALGO_COLLNET_DIRECT || a == NCCL_ALGO_COLLNET_CHAIN) && collNetSupport != 1) continue;
+      if ((a == NCCL_ALGO_NVLS || a == NCCL_ALGO_NVLS_TREE) && nvlsSupport != 1) continue;
+      if (a == NCCL_ALGO_NVLS && collNetSupport != 1 && comm->nNodes > 1) continue;
+      /* now we only support single-node NVLS allgather and reducescatter */
+      if (a == NCCL_ALGO_NVLS && (collInfo->coll == ncclFuncAllGather || collInfo->coll == ncclFuncReduceScatter) && comm->nNodes > 1) continue;
+      /* AllGatherv and ReduceScatterv only run on the ring, timed as their longest segment on every rank */
+      if (collInfo->vSegs != nullptr && a != NCCL_ALGO_RING) continue;
+
+      bool skipLL128 = reduceAccFp32SkipLL128(collInfo, a);
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        if (p == NCCL_PROTO_LL128 && (collInfo->comm->topo->type != RCCL_TOPO_XGMI_ALL || skipLL128)) continue;
+        float time;
+        NCCLCHECK(ncclTopoGetAlgoTime(collInfo, a, p, numPipeOps, &time, &backup));
+        if (!backup) {
+          if (time >= 0 && time < minTime) {
+            collInfo->algorithm = a;
+            collInfo->protocol = p;
+            minTime = time;
+          }
+        } else {
+          if (time >= 0 && time < backupMinTime) {
+            backupAlgo = a;
+            backupProto = p;
+            backupMinTime = time;
+          }
+        }
+      }
+    }
+
+    if (collInfo->algorithm == NCCL_ALGO_UNDEF || collInfo->protocol == NCCL_PROTO_UNDEF) {
+      if (backupAlgo == NCCL_ALGO_UNDEF || backupProto == NCCL_PROTO_UNDEF) {
+        WARN("Error : no algorithm/protocol available");
+        return ncclInternalError;
+      }
+      collInfo->algorithm = backupAlgo;
+      collInfo->protocol = backupProto;
+    }
+    if (comm->rank == 0) INFO(NCCL_TUNING, "%ld Bytes -> Algo %d proto %d time %f", collInfo->nBytes, collInfo->algorithm, collInfo->protocol, minTime);
+    TRACE(NCCL_COLL, "%ld Bytes -> Algo %d proto %d time %f", collInfo->nBytes, collInfo->algorithm, collInfo->protocol, minTime);
+  }
+
+  return ncclSuccess;
+}
+
+/* Compute nChannels and nThreads. */
+ncclResult_t ncclTopoGetChannelThreadInfo(struct ncclInfo* collInfo) {
+  struct ncclComm *comm = collInfo->comm;
+  int nc = (collInfo->nChannels > 0) ? collInfo->nChannels : comm->nChannels;
+  int nt = comm->maxThreads[collInfo->algorithm][collInfo->protocol];
+  int threadThreshold = comm->threadThresholds[collInfo->algorithm][collInfo->protocol];
+  if (collInfo->algorithm == NCCL_ALGO_COLLNET_DIRECT) {
+    // CollNet channel tuning
+    int ncSwitch = 16;
+    bool flag = true;
+    while (ncSwitch >= 1 && flag) {
+      while ((flag = collInfo->nBytes < nc*nt*collInfo->comm->channels[0].collnetDirect.nHeads*threadThreshold) && nc > ncSwitch) {
+        if (nc == ncSwitch+ncSwitch/2) threadThreshold /= 2;
+        nc--;
+      }
+      ncSwitch /= 2;
+    }
+  } else if (collInfo->algorithm == NCCL_ALGO_NVLS || collInfo->algorithm == NCCL_ALGO_NVLS_TREE) {
+    // NVLS should not need more than 16 channels to get peak BW.
+    nc = comm->nvlsChannels;
+  } else {
+    // Ring/Tree channel tuning
+    while (collInfo->nBytes < nc*nt*threadThreshold) {
+      if (nc >= 2) nc--;
+#if defined(__HIP_PLATFORM_AMD__) || defined(__HIPCC__)
+      // do not reduce threads count on VEGA
+#else
+      else if ((nt % 128) == 0) nt/=2;
+#endif
+      else break;
+    }
+  }
+#if defined(__HIP_PLATFORM_AMD__) || defined(__HIPCC__)
+#else
+  if (collInfo->protocol == NCCL_PROTO_SIMPLE) {
+    if (collInfo->algorithm == NCCL_ALGO_RING) nt += WARP_SIZE; // Extra warp for sync
+    // More threads or sync warps needed due to split thread model
+    if (collInfo->algorithm == NCCL_ALGO_TREE) nt += 4*WARP_SIZE;
+  }
+  nt = nt/WARP_SIZE < 3 ? 3*WARP_SIZE : nt;
+#endif
+  if (collInfo->coll == ncclFuncAllReduce && comm->topo->pivotA2ANumBiRings == 3) {
+    static int userTuneInput = -2;
+    if (userTuneInput == -2) {
+      const char *protoStr = ncclGetEnv("NCCL_PROTO");
+      const char *algoStr = ncclGetEnv("NCCL_ALGO");
+      if (!protoStr && !algoStr)
+        userTuneInput = 0;
+      else
+        userTuneInput = 1;
+    }
+    collInfo->nChannels = nc;
+    if (!userTuneInput) {
+      // always respect user settings
+      if (collInfo->nBytes <= 2200008) {
+        collInfo->protocol = NCCL_PROTO_LL;
+        collInfo->algorithm = NCCL_ALGO_TREE;
+        collInfo->nChannels = std::min(24, comm->nChannels);
+      } else {
+        collInfo->protocol = NCCL_PROTO_SIMPLE;
+        collInfo->algorithm = NCCL_ALGO_RING;
+      }
+    }
+  } else if (collInfo->coll == ncclFuncAllReduce && comm->topo->treeDefined == 1) {
+    collInfo->algorithm = NCCL_ALGO_TREE;
+    collInfo->nChannels = nc;
+  } else {
+    collInfo->nChannels = nc;
+  }
+  collInfo->nThreads = nt;
+  return ncclSuccess;
+}
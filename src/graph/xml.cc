@@ -20,6 +20,147 @@
 #include <cpuid.h>
 #endif
 
+/*****************/
+/* XML Allocator */
+/*****************/
+
+// Arena chunks are never freed individually, only all at once by xmlFree.
+#define XML_CHUNK_SIZE (64*1024)
+#define XML_ALIGN 16
+
+struct ncclXmlChunk {
+  struct ncclXmlChunk* next;
+  size_t size;
+  size_t used;
+};
+
+ncclResult_t xmlAlloc(struct ncclXml** xml) {
+  NCCLCHECK(ncclCalloc(xml, 1));
+  return ncclSuccess;
+}
+
+void xmlFree(struct ncclXml* xml) {
+  if (xml == NULL) return;
+  struct ncclXmlChunk* chunk = xml->chunks;
+  while (chunk) {
+    struct ncclXmlChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(xml->nodes);
+  free(xml->strings);
+  free(xml);
+}
+
+ncclResult_t xmlArenaAlloc(struct ncclXml* xml, size_t size, void** ptr) {
+  const size_t header = ROUNDUP(sizeof(struct ncclXmlChunk), XML_ALIGN);
+  size = ROUNDUP(size, XML_ALIGN);
+  struct ncclXmlChunk* chunk = xml->chunks;
+  if (chunk == NULL || chunk->used + size > chunk->size) {
+    size_t chunkSize = std::max((size_t)XML_CHUNK_SIZE, header + size);
+    char* mem;
+    NCCLCHECK(ncclCalloc(&mem, chunkSize));
+    chunk = (struct ncclXmlChunk*)mem;
+    chunk->size = chunkSize;
+    chunk->used = header;
+    chunk->next = xml->chunks;
+    xml->chunks = chunk;
+  }
+  *ptr = ((char*)chunk) + chunk->used;
+  chunk->used += size;
+  return ncclSuccess;
+}
+
+static uint64_t xmlStrHash(const char* str, size_t len) {
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i=0; i<len; i++) hash = (hash ^ (unsigned char)str[i]) * 0x100000001b3;
+  return hash;
+}
+
+static ncclResult_t xmlInternInsert(const char** strings, int maxStrings, const char* str) {
+  int slot = xmlStrHash(str, strlen(str)) & (maxStrings-1);
+  while (strings[slot]) slot = (slot+1) & (maxStrings-1);
+  strings[slot] = str;
+  return ncclSuccess;
+}
+
+// Return a pointer to a unique arena copy of str, truncated to MAX_STR_LEN chars.
+ncclResult_t xmlIntern(struct ncclXml* xml, const char* str, const char** interned) {
+  size_t len = strnlen(str, MAX_STR_LEN);
+  if (2*(xml->nStrings+1) > xml->maxStrings) {
+    int maxStrings = xml->maxStrings ? 2*xml->maxStrings : 256;
+    const char** strings;
+    NCCLCHECK(ncclCalloc(&strings, maxStrings));
+    for (int i=0; i<xml->maxStrings; i++) {
+      if (xml->strings[i]) NCCLCHECK(xmlInternInsert(strings, maxStrings, xml->strings[i]));
+    }
+    free(xml->strings);
+    xml->strings = strings;
+    xml->maxStrings = maxStrings;
+  }
+  int slot = xmlStrHash(str, len) & (xml->maxStrings-1);
+  while (xml->strings[slot]) {
+    const char* s = xml->strings[slot];
+    if (strncmp(s, str, len) == 0 && s[len] == '\0') {
+      *interned = s;
+      return ncclSuccess;
+    }
+    slot = (slot+1) & (xml->maxStrings-1);
+  }
+  char* copy;
+  NCCLCHECK(xmlArenaAlloc(xml, len+1, (void**)&copy));
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  xml->strings[slot] = copy;
+  xml->nStrings++;
+  *interned = copy;
+  return ncclSuccess;
+}
+
+ncclResult_t xmlNewNode(struct ncclXml* xml, const char* name, struct ncclXmlNode** node) {
+  struct ncclXmlNode* n;
+  NCCLCHECK(xmlArenaAlloc(xml, sizeof(struct ncclXmlNode), (void**)&n));
+  n->xml = xml;
+  NCCLCHECK(xmlIntern(xml, name, &n->name));
+  *node = n;
+  return ncclSuccess;
+}
+
+ncclResult_t xmlRegisterNode(struct ncclXml* xml, struct ncclXmlNode* node) {
+  if (xml->maxIndex == xml->maxNodes) {
+    int maxNodes = xml->maxNodes ? 2*xml->maxNodes : 64;
+    NCCLCHECK(ncclRealloc(&xml->nodes, xml->maxNodes, maxNodes));
+    xml->maxNodes = maxNodes;
+  }
+  xml->nodes[xml->maxIndex++] = node;
+  return ncclSuccess;
+}
+
+// Attribute and sub lists grow geometrically inside the arena; the old
+// array is simply abandoned.
+ncclResult_t xmlReserveAttrs(struct ncclXmlNode* node, int nAttrs) {
+  if (nAttrs <= node->maxAttrs) return ncclSuccess;
+  int maxAttrs = std::max(nAttrs, node->maxAttrs ? 2*node->maxAttrs : 4);
+  struct ncclXmlAttr* attrs;
+  NCCLCHECK(xmlArenaAlloc(node->xml, maxAttrs*sizeof(struct ncclXmlAttr), (void**)&attrs));
+  if (node->nAttrs) memcpy(attrs, node->attrs, node->nAttrs*sizeof(struct ncclXmlAttr));
+  node->attrs = attrs;
+  node->maxAttrs = maxAttrs;
+  return ncclSuccess;
+}
+
+ncclResult_t xmlReserveSubs(struct ncclXmlNode* node, int nSubs) {
+  if (nSubs <= node->maxSubs) return ncclSuccess;
+  int maxSubs = std::max(nSubs, node->maxSubs ? 2*node->maxSubs : 4);
+  struct ncclXmlNode** subs;
+  NCCLCHECK(xmlArenaAlloc(node->xml, maxSubs*sizeof(struct ncclXmlNode*), (void**)&subs));
+  if (node->nSubs) memcpy(subs, node->subs, node->nSubs*sizeof(struct ncclXmlNode*));
+  node->subs = subs;
+  node->maxSubs = maxSubs;
+  return ncclSuccess;
+}
+
 /*******************/
 /* XML File Parser */
 /*******************/
@@ -112,6 +253,7 @@ ncclResult_t xmlSkipComment(FILE* file, char* start, char next) {
 
 ncclResult_t xmlGetNode(FILE* file, struct ncclXmlNode* node) {
   node->type = NODE_TYPE_NONE;
+  node->nAttrs = 0;
   char c = ' ';
   while (c == ' ' || c == '\n' || c == '\r') {
     if (fread(&c, 1, 1, file) == 0) return ncclSuccess;
@@ -121,38 +263,38 @@ ncclResult_t xmlGetNode(FILE* file, struct ncclXmlNode* node) {
     return ncclInternalError;
   }
   // Read XML element name
-  NCCLCHECK(xmlGetToken(file, node->name, NULL, &c));
+  char name[MAX_STR_LEN+1];
+  NCCLCHECK(xmlGetToken(file, name, NULL, &c));
 
   // Check for comments
-  if (strncmp(node->name, "!--", 3) == 0) {
-    NCCLCHECK(xmlSkipComment(file, node->name+3, c));
+  if (strncmp(name, "!--", 3) == 0) {
+    NCCLCHECK(xmlSkipComment(file, name+3, c));
     return xmlGetNode(file, node);
   }
 
   // Check for closing tag
-  if (node->name[0] == '\0' && c == '/') {
+  if (name[0] == '\0' && c == '/') {
     node->type = NODE_TYPE_CLOSE;
     // Re-read the name, we got '/' in the first call
-    NCCLCHECK(xmlGetToken(file, node->name, NULL, &c));
+    NCCLCHECK(xmlGetToken(file, name, NULL, &c));
     if (c != '>') {
-      WARN("XML Parse error : unexpected trailing %c in closing tag %s", c, node->name);
+      WARN("XML Parse error : unexpected trailing %c in closing tag %s", c, name);
       return ncclInternalError;
     }
+    NCCLCHECK(xmlIntern(node->xml, name, &node->name));
     return ncclSuccess;
   }
 
   node->type = NODE_TYPE_OPEN;
+  NCCLCHECK(xmlIntern(node->xml, name, &node->name));
 
   // Get Attributes
-  int a = 0;
   while (c == ' ') {
-    NCCLCHECK(xmlGetToken(file, node->attrs[a].key, node->attrs[a].value, &c));
-    if (a == MAX_ATTR_COUNT) {
-      INFO(NCCL_GRAPH, "XML Parse : Ignoring extra attributes (max %d)", MAX_ATTR_COUNT);
-      // Actually we need to still consume the extra attributes so we have an extra one.
-    } else a++;
+    char key[MAX_STR_LEN+1], value[MAX_STR_LEN+1];
+    key[0] = value[0] = '\0';
+    NCCLCHECK(xmlGetToken(file, key, value, &c));
+    NCCLCHECK(xmlAddAttr(node, key, value));
   }
-  node->nAttrs = a;
   if (c == '/') {
     node->type = NODE_TYPE_SINGLE;
     char str[MAX_STR_LEN];
@@ -174,13 +316,13 @@ struct xmlHandler {
 
 ncclResult_t xmlLoadSub(FILE* file, struct ncclXml* xml, struct ncclXmlNode* head, struct xmlHandler handlers[], int nHandlers) {
   if (head && head->type == NODE_TYPE_SINGLE) return ncclSuccess;
+  // Nodes are only registered in the tree once a handler accepts them, so the
+  // scratch node is reused for closing tags and ignored elements.
+  struct ncclXmlNode* node = NULL;
   while (1) {
-    if (xml->maxIndex == MAX_NODES) {
-      WARN("Error : XML parser is limited to 1024 nodes");
-      return ncclInternalError;
-    }
-    struct ncclXmlNode* node = xml->nodes+xml->maxIndex;
-    memset(node, 0, sizeof(struct ncclXmlNode));
+    if (node == NULL) NCCLCHECK(xmlNewNode(xml, "", &node));
+    node->nSubs = 0;
+    node->parent = NULL;
     NCCLCHECK(xmlGetNode(file, node));
     if (node->type == NODE_TYPE_NONE) {
       if (head) {
@@ -201,11 +343,12 @@ ncclResult_t xmlLoadSub(FILE* file, struct ncclXml* xml, struct ncclXmlNode* hea
     int found = 0;
     for (int h=0; h<nHandlers; h++) {
       if (strcmp(node->name, handlers[h].name) == 0) {
-        if (head) head->subs[head->nSubs++] = node;
+        if (head) NCCLCHECK(xmlInsertSub(head, head->nSubs, node));
         node->parent = head;
-        node->nSubs = 0;
-        xml->maxIndex++;
-        NCCLCHECK(handlers[h].func(file, xml, node));
+        NCCLCHECK(xmlRegisterNode(xml, node));
+        struct ncclXmlNode* sub = node;
+        node = NULL;
+        NCCLCHECK(handlers[h].func(file, xml, sub));
         found = 1;
         break;
       }
@@ -247,7 +390,12 @@ ncclResult_t ncclTopoDumpXmlToFile(const char* xmlTopoFile, struct ncclXml* xml)
     WARN("Unable to open %s, not dumping topology.", xmlTopoFile);
     return ncclSuccess;
   }
-  NCCLCHECK(ncclTopoDumpXmlRec(0, file, xml->nodes));
+  if (xml->maxIndex == 0 || xml->nodes[0] == NULL) {
+    WARN("Topology XML is empty, not dumping it to %s", xmlTopoFile);
+    fclose(file);
+    return ncclInvalidUsage;
+  }
+  NCCLCHECK(ncclTopoDumpXmlRec(0, file, xml->nodes[0]));
   fclose(file);
   return ncclSuccess;
 }
@@ -616,9 +764,7 @@ ncclResult_t ncclTopoGetXmlFromSys(struct ncclXmlNode* pciNode, struct ncclXml*
       NCCLCHECK(xmlGetAttr(parent->subs[s], "busid", &busId));
       if (busId != NULL && strcmp(newBusId, busId) < 0) { subIndex = s; break; }
     }
-    for (int s = parent->nSubs; s > subIndex; s--) parent->subs[s] = parent->subs[s-1];
-    parent->subs[subIndex] = pciNode;
-    parent->nSubs++;
+    NCCLCHECK(xmlInsertSub(parent, subIndex, pciNode));
   }
   if (strcmp(parent->name, "pci") == 0) {
     NCCLCHECK(ncclTopoGetXmlFromSys(parent, xml));
@@ -930,19 +1076,21 @@ ncclResult_t ncclTopoTrimXmlRec(struct ncclXmlNode* node) {
   if (str && strcmp(str, "1") == 0) {
     NCCLCHECK(xmlUnsetAttr(node, "keep"));
   } else {
-    // Copy nSubs and subs as they could change as we trim recursively.
-    struct ncclXmlNode* subs[MAX_SUBS];
-    int nSubs = node->nSubs;
-    memcpy(subs, node->subs, node->nSubs*sizeof(struct ncclXmlNode*));
-    for (int s=0; s<nSubs; s++) {
-      NCCLCHECK(ncclTopoTrimXmlRec(subs[s]));
+    // Walk subs backwards : trimming a sub can only remove that sub from
+    // our list, which leaves the entries we have yet to visit in place.
+    for (int s=node->nSubs-1; s>=0; s--) {
+      NCCLCHECK(ncclTopoTrimXmlRec(node->subs[s]));
     }
     if (node->nSubs == 0) NCCLCHECK(xmlRemoveNode(node));
   }
   return ncclSuccess;
 }
 ncclResult_t ncclTopoTrimXml(struct ncclXml* xml) {
-  NCCLCHECK(ncclTopoTrimXmlRec(xml->nodes));
+  if (xml->maxIndex == 0 || xml->nodes[0] == NULL) {
+    WARN("Topology XML has no <system> root element");
+    return ncclInvalidUsage;
+  }
+  NCCLCHECK(ncclTopoTrimXmlRec(xml->nodes[0]));
   return ncclSuccess;
 }
 
@@ -14,35 +14,57 @@
 #include <stdlib.h>
 #include "archinfo.h"
 
-// A few constraints to make the implementation easy
+// Maximum length of a single name, attribute key or attribute value
 #define MAX_STR_LEN 255
-#define MAX_ATTR_COUNT 16
-#define MAX_SUBS 512	//Changed the value from 32 to 512 for CPX mode
-#define MAX_NODES 8192 //Changed the value from 1024 to 8192 for CPX mode
 
 #define NODE_TYPE_NONE 0
 #define NODE_TYPE_OPEN 1
 #define NODE_TYPE_CLOSE 2
 #define NODE_TYPE_SINGLE 3
 
+// Nodes, attribute lists, child lists and strings all live in an arena owned by
+// the ncclXml they belong to. Names, keys and values are interned, so nodes only
+// hold pointers and the tree is sized by the real topology instead of fixed limits.
+struct ncclXmlAttr {
+  const char* key;
+  const char* value;
+};
+
 struct ncclXmlNode {
-  char name[MAX_STR_LEN+1];
-  struct {
-    char key[MAX_STR_LEN+1];
-    char value[MAX_STR_LEN+1];
-  } attrs[MAX_ATTR_COUNT+1]; // Need an extra one to consume extra params
+  const char* name;
+  struct ncclXmlAttr* attrs;
   int nAttrs;
+  int maxAttrs;
   int type;
   struct ncclXmlNode* parent;
-  struct ncclXmlNode* subs[MAX_SUBS];
+  struct ncclXmlNode** subs;
   int nSubs;
+  int maxSubs;
+  struct ncclXml* xml;
 };
 
+struct ncclXmlChunk;
+
 struct ncclXml {
-  struct ncclXmlNode nodes[MAX_NODES];
+  struct ncclXmlNode** nodes; // Nodes in creation order, nodes[0] is the top node
   int maxIndex;
+  int maxNodes;
+  struct ncclXmlChunk* chunks;
+  const char** strings; // Open addressing hash table of interned strings
+  int nStrings;
+  int maxStrings;
 };
 
+/* Allocation functions */
+ncclResult_t xmlAlloc(struct ncclXml** xml);
+void xmlFree(struct ncclXml* xml);
+ncclResult_t xmlArenaAlloc(struct ncclXml* xml, size_t size, void** ptr);
+ncclResult_t xmlIntern(struct ncclXml* xml, const char* str, const char** interned);
+ncclResult_t xmlNewNode(struct ncclXml* xml, const char* name, struct ncclXmlNode** node);
+ncclResult_t xmlRegisterNode(struct ncclXml* xml, struct ncclXmlNode* node);
+ncclResult_t xmlReserveAttrs(struct ncclXmlNode* node, int nAttrs);
+ncclResult_t xmlReserveSubs(struct ncclXmlNode* node, int nSubs);
+
 /* File functions */
 #define NCCL_TOPO_XML_VERSION 2
 ncclResult_t ncclTopoGetXmlFromFile(const char* xmlTopoFile, struct ncclXml* xml, int warn);
@@ -116,7 +138,7 @@ static ncclResult_t xmlGetAttrFloat(struct ncclXmlNode* node, const char* attrNa
 static ncclResult_t xmlFindTag(struct ncclXml* xml, const char* tagName, struct ncclXmlNode** node) {
   *node = NULL;
   for (int i=0; i<xml->maxIndex; i++) {
-    struct ncclXmlNode* n = xml->nodes+i;
+    struct ncclXmlNode* n = xml->nodes[i];
     if (strcmp(n->name, tagName) == 0) {
       *node = n;
       return ncclSuccess;
@@ -128,7 +150,7 @@ static ncclResult_t xmlFindTag(struct ncclXml* xml, const char* tagName, struct
 static ncclResult_t xmlFindTagKv(struct ncclXml* xml, const char* tagName, struct ncclXmlNode** node, const char* attrName, const char* attrValue) {
   *node = NULL;
   for (int i=0; i<xml->maxIndex; i++) {
-    struct ncclXmlNode* n = xml->nodes+i;
+    struct ncclXmlNode* n = xml->nodes[i];
     if (strcmp(n->name, tagName) == 0) {
       const char* value;
       NCCLCHECK(xmlGetAttr(n, attrName, &value));
@@ -141,16 +163,21 @@ static ncclResult_t xmlFindTagKv(struct ncclXml* xml, const char* tagName, struc
   return ncclSuccess;
 }
 
+// Append a new attribute without checking whether the key already exists
+static ncclResult_t xmlAddAttr(struct ncclXmlNode* node, const char* attrName, const char* value) {
+  NCCLCHECK(xmlReserveAttrs(node, node->nAttrs+1));
+  struct ncclXmlAttr* attr = node->attrs+node->nAttrs;
+  NCCLCHECK(xmlIntern(node->xml, attrName, &attr->key));
+  NCCLCHECK(xmlIntern(node->xml, value, &attr->value));
+  node->nAttrs++;
+  return ncclSuccess;
+}
+
 static ncclResult_t xmlSetAttr(struct ncclXmlNode* node, const char* attrName, const char* value) {
   int index;
   NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    node->attrs[index].key[MAX_STR_LEN] = '\0';
-  }
-  strncpy(node->attrs[index].value, value, MAX_STR_LEN);
-  node->attrs[index].value[MAX_STR_LEN] = '\0';
+  if (index == -1) return xmlAddAttr(node, attrName, value);
+  NCCLCHECK(xmlIntern(node->xml, value, &node->attrs[index].value));
   return ncclSuccess;
 }
 
@@ -158,48 +185,26 @@ static ncclResult_t xmlSetAttrIfUnset(struct ncclXmlNode* node, const char* attr
   int index;
   NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
   if (index != -1) return ncclSuccess;
-  index = node->nAttrs++;
-  strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-  node->attrs[index].key[MAX_STR_LEN] = '\0';
-  strncpy(node->attrs[index].value, value, MAX_STR_LEN);
-  node->attrs[index].value[MAX_STR_LEN] = '\0';
-  return ncclSuccess;
+  return xmlAddAttr(node, attrName, value);
 }
 
 static ncclResult_t xmlSetAttrInt(struct ncclXmlNode* node, const char* attrName, const int value) {
-  int index;
-  NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    node->attrs[index].key[MAX_STR_LEN] = '\0';
-  }
-  snprintf(node->attrs[index].value, MAX_STR_LEN, "%d", value);
-  node->attrs[index].value[MAX_STR_LEN] = '\0';
-  return ncclSuccess;
+  char strValue[MAX_STR_LEN+1];
+  snprintf(strValue, MAX_STR_LEN, "%d", value);
+  return xmlSetAttr(node, attrName, strValue);
 }
 
 static ncclResult_t xmlSetAttrFloat(struct ncclXmlNode* node, const char* attrName, const float value) {
-  int index;
-  NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
-  if (index == -1) {
-    index = node->nAttrs++;
-    strncpy(node->attrs[index].key, attrName, MAX_STR_LEN);
-    node->attrs[index].key[MAX_STR_LEN] = '\0';
-  }
-  snprintf(node->attrs[index].value, MAX_STR_LEN, "%g", value);
-  node->attrs[index].value[MAX_STR_LEN] = '\0';
-  return ncclSuccess;
+  char strValue[MAX_STR_LEN+1];
+  snprintf(strValue, MAX_STR_LEN, "%g", value);
+  return xmlSetAttr(node, attrName, strValue);
 }
 
 static ncclResult_t xmlUnsetAttr(struct ncclXmlNode* node, const char* attrName) {
   int index;
   NCCLCHECK(xmlGetAttrIndex(node, attrName, &index));
   if (index == -1) return ncclSuccess;
-  for (int i=index+1; i<node->nAttrs; i++) {
-    strcpy(node->attrs[i-1].key, node->attrs[i].key);
-    strcpy(node->attrs[i-1].value, node->attrs[i].value);
-  }
+  for (int i=index+1; i<node->nAttrs; i++) node->attrs[i-1] = node->attrs[i];
   node->nAttrs--;
   return ncclSuccess;
 }
@@ -237,19 +242,22 @@ static ncclResult_t xmlGetSubKvInt(struct ncclXmlNode* node, const char* subName
   return ncclSuccess;
 }
 
+// Insert sub at position index in the list of children of parent
+static ncclResult_t xmlInsertSub(struct ncclXmlNode* parent, int index, struct ncclXmlNode* sub) {
+  NCCLCHECK(xmlReserveSubs(parent, parent->nSubs+1));
+  for (int s = parent->nSubs; s > index; s--) parent->subs[s] = parent->subs[s-1];
+  parent->subs[index] = sub;
+  parent->nSubs++;
+  return ncclSuccess;
+}
+
 static ncclResult_t xmlAddNode(struct ncclXml* xml, struct ncclXmlNode* parent, const char* subName, struct ncclXmlNode** sub) {
-  if (xml->maxIndex == MAX_NODES) {
-    WARN("Error : too many XML nodes (max %d)", MAX_NODES);
-    return ncclInternalError;
-  }
-  struct ncclXmlNode* s = xml->nodes+xml->maxIndex++;
-  s->nSubs = 0;
-  s->nAttrs = 0;
-  *sub = s;
+  struct ncclXmlNode* s;
+  NCCLCHECK(xmlNewNode(xml, subName, &s));
+  NCCLCHECK(xmlRegisterNode(xml, s));
   s->parent = parent;
-  if (parent) parent->subs[parent->nSubs++] = s;
-  strncpy(s->name, subName, MAX_STR_LEN);
-  s->name[MAX_STR_LEN] = '\0';
+  if (parent) NCCLCHECK(xmlInsertSub(parent, parent->nSubs, s));
+  *sub = s;
   return ncclSuccess;
 }
 
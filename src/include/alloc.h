@@ -21,6 +21,58 @@
 
 uint64_t clockNano(); // from utils.h with which we have a circular dependency
 
+// Per-communicator memory accounting. Allocators charge the account bound to
+// the calling thread (if any) under the category selected on that thread.
+enum ncclMemKind {
+  ncclMemKindDevice = 0,
+  ncclMemKindHostPinned = 1,
+  ncclMemKindHost = 2,
+  NCCL_NUM_MEM_KINDS = 3
+};
+
+// Matches ncclNumMemCategories from nccl.h
+#define NCCL_NUM_MEM_CATEGORIES 10
+
+struct ncclMemAccount {
+  uint64_t bytes[NCCL_NUM_MEM_KINDS][NCCL_NUM_MEM_CATEGORIES];
+};
+
+extern __thread struct ncclMemAccount* ncclMemAccountCurrent;
+extern __thread int ncclMemCategoryCurrent;
+
+static inline void ncclMemAccountAdd(struct ncclMemAccount* account, int kind, int category, size_t size) {
+  __atomic_fetch_add(&account->bytes[kind][category], size, __ATOMIC_RELAXED);
+}
+
+// Returns memory of known size to an account, e.g. when a runtime pool shrinks.
+static inline void ncclMemAccountRelease(struct ncclMemAccount* account, int kind, int category, size_t size) {
+  __atomic_fetch_sub(&account->bytes[kind][category], size, __ATOMIC_RELAXED);
+}
+
+// Charge the allocation at ptr to the account bound to this thread and remember it,
+// so that ncclMemAccountUncharge returns its bytes when it is freed.
+void ncclMemAccountCharge(const void* ptr, int kind, size_t size);
+void ncclMemAccountUncharge(const void* ptr);
+// Forget the allocations still charged to account, before the account itself goes away.
+void ncclMemAccountForget(struct ncclMemAccount* account);
+
+// Binds `account` to this thread (nullptr keeps the current binding) and
+// selects `category` until the guard goes out of scope.
+struct ncclMemAccountGuard {
+  struct ncclMemAccount* savedAccount;
+  int savedCategory;
+  ncclMemAccountGuard(struct ncclMemAccount* account, int category) {
+    savedAccount = ncclMemAccountCurrent;
+    savedCategory = ncclMemCategoryCurrent;
+    if (account) ncclMemAccountCurrent = account;
+    ncclMemCategoryCurrent = category;
+  }
+  ~ncclMemAccountGuard() {
+    ncclMemAccountCurrent = savedAccount;
+    ncclMemCategoryCurrent = savedCategory;
+  }
+};
+
 template <typename T>
 ncclResult_t ncclCudaHostCallocDebug(T** ptr, size_t nelem, const char *filefunc, int line) {
   ncclResult_t result = ncclSuccess;
@@ -38,6 +90,7 @@ ncclResult_t ncclCudaHostCallocDebug(T** ptr, size_t nelem, const char *filefunc
   } else
     CUDACHECKGOTO(hipHostMalloc(ptr, nelem*sizeof(T), cudaHostAllocMapped), result, finish);
   memset(*ptr, 0, nelem*sizeof(T));
+  ncclMemAccountCharge(*ptr, ncclMemKindHostPinned, nelem*sizeof(T));
 finish:
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   if (*ptr == nullptr) WARN("Failed to CUDA host alloc %ld bytes", nelem*sizeof(T));
@@ -47,6 +100,7 @@ finish:
 #define ncclCudaHostCalloc(...) ncclCudaHostCallocDebug(__VA_ARGS__, __FILE__, __LINE__)
 
 inline ncclResult_t ncclCudaHostFree(void* ptr) {
+  ncclMemAccountUncharge(ptr);
   CUDACHECK(cudaFreeHost(ptr));
   return ncclSuccess;
 }
@@ -135,6 +189,7 @@ static inline ncclResult_t ncclCuMemAlloc(void **ptr, CUmemGenericAllocationHand
   accessDesc.flags = CU_MEM_ACCESS_FLAGS_PROT_READWRITE;
   CUCHECK(cuMemSetAccess((CUdeviceptr)*ptr, size, &accessDesc, 1));
   if (handlep) *handlep = handle;
+  ncclMemAccountCharge(*ptr, ncclMemKindDevice, size);
   TRACE(NCCL_ALLOC, "CuMem Alloc Size %zi pointer %p handle %llx", size, *ptr, handle);
   return result;
 }
@@ -142,6 +197,7 @@ static inline ncclResult_t ncclCuMemAlloc(void **ptr, CUmemGenericAllocationHand
 static inline ncclResult_t ncclCuMemFree(void *ptr) {
   if (ptr == NULL) return ncclSuccess;
   ncclResult_t result = ncclSuccess;
+  ncclMemAccountUncharge(ptr);
   CUmemGenericAllocationHandle handle;
   size_t size = 0;
   CUCHECK(cuMemRetainAllocationHandle(&handle, ptr));
@@ -176,6 +232,7 @@ ncclResult_t ncclCudaMallocDebug(const char *filefunc, int line, T** ptr, size_t
   *ptr = nullptr;
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   CUDACHECKGOTO(hipExtMallocWithFlags((void**)ptr, nelem*sizeof(T), flags), result, finish);
+  ncclMemAccountCharge(*ptr, ncclMemKindDevice, nelem*sizeof(T));
 finish:
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   if (*ptr == nullptr) WARN("Failed to CUDA malloc %ld bytes", nelem*sizeof(T));
@@ -205,6 +262,7 @@ ncclResult_t ncclCudaCallocDebug(const char *filefunc, int line, T** ptr, size_t
     __atomic_fetch_add(&allocTracker[dev].totalAlloc, 1, __ATOMIC_RELAXED);
     __atomic_fetch_add(&allocTracker[dev].totalAllocSize, nelem*sizeof(T), __ATOMIC_RELAXED);
   }
+  ncclMemAccountCharge(*ptr, ncclMemKindDevice, nelem*sizeof(T));
 finish:
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   if (*ptr == nullptr) WARN("Failed to CUDA calloc %ld bytes", nelem*sizeof(T));
@@ -227,6 +285,7 @@ ncclResult_t ncclCudaCallocAsyncDebug(const char *filefunc, int line, T** ptr, s
     __atomic_fetch_add(&allocTracker[dev].totalAlloc, 1, __ATOMIC_RELAXED);
     __atomic_fetch_add(&allocTracker[dev].totalAllocSize, nelem*sizeof(T), __ATOMIC_RELAXED);
   }
+  ncclMemAccountCharge(*ptr, ncclMemKindDevice, nelem*sizeof(T));
 finish:
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   if (*ptr == nullptr) WARN("Failed to CUDA calloc async %ld bytes", nelem*sizeof(T));
@@ -267,6 +326,7 @@ ncclResult_t ncclCudaFree(T* ptr) {
   ncclResult_t result = ncclSuccess;
   cudaStreamCaptureMode mode = cudaStreamCaptureModeRelaxed;
   TRACE(NCCL_ALLOC, "Cuda Free pointer %p", ptr);
+  ncclMemAccountUncharge(ptr);
   CUDACHECK(cudaThreadExchangeStreamCaptureMode(&mode));
   if (ncclCuMemEnable()) {
     NCCLCHECKGOTO(ncclCuMemFree((void *)ptr), result, finish);
@@ -31,7 +31,7 @@
 #define RCCL_API_TRACE_VERSION_MAJOR 0
 
 // should be increased every time new members are added to existing dispatch tables
-#define RCCL_API_TRACE_VERSION_PATCH 0
+#define RCCL_API_TRACE_VERSION_PATCH 2
 
 #if !defined(RCCL_EXTERN_C_INIT)
 #    ifdef __cplusplus
@@ -154,6 +154,19 @@ typedef ncclResult_t (*ncclCommRegister_fn_t)(const ncclComm_t comm, void* buff,
 
 typedef ncclResult_t (*ncclCommDeregister_fn_t)(const ncclComm_t comm, void* handle);
 
+typedef ncclResult_t (*ncclCommGetMemUsage_fn_t)(const ncclComm_t comm,
+                                                 ncclMemUsage_t*  usage);
+
+typedef ncclResult_t (*ncclAllGatherv_fn_t)(const void* sendbuff, size_t sendcount,
+                                            void* recvbuff, const size_t recvcounts[],
+                                            const size_t rdispls[], ncclDataType_t datatype,
+                                            ncclComm_t comm, hipStream_t stream);
+
+typedef ncclResult_t (*ncclReduceScatterv_fn_t)(
+    const void* sendbuff, const size_t sendcounts[], const size_t sdispls[],
+    void* recvbuff, size_t recvcount, ncclDataType_t datatype, ncclRedOp_t op,
+    ncclComm_t comm, hipStream_t stream);
+
 typedef struct rcclApiFuncTable
 {
     uint64_t                      size;
@@ -194,6 +207,9 @@ typedef struct rcclApiFuncTable
     mscclUnloadAlgo_fn_t          mscclUnloadAlgo_fn;
     ncclCommRegister_fn_t         ncclCommRegister_fn;
     ncclCommDeregister_fn_t       ncclCommDeregister_fn;
+    ncclCommGetMemUsage_fn_t      ncclCommGetMemUsage_fn;
+    ncclAllGatherv_fn_t           ncclAllGatherv_fn;
+    ncclReduceScatterv_fn_t       ncclReduceScatterv_fn;
 
 } rcclApiFuncTable;
 
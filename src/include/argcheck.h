@@ -9,9 +9,13 @@
 
 #include "core.h"
 #include "info.h"
+#include "ptr_cache.h"
 
 ncclResult_t PtrCheck(void* ptr, const char* opname, const char* ptrname);
 ncclResult_t ArgsCheck(struct ncclInfo* info);
 ncclResult_t CudaPtrCheck(const void* pointer, struct ncclComm* comm, const char* ptrname, const char* opname);
 
+// Known allocation ranges, filled by ncclMemAlloc, ncclCommRegister and CudaPtrCheck misses
+extern struct ncclPtrCache ncclPtrCacheGlobal;
+
 #endif
@@ -0,0 +1,131 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_BACKEND_SELECT_H_
+#define NCCL_BACKEND_SELECT_H_
+
+#include <float.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// Choice between the collective backends of a communicator. Timed backends provide
+// an estimated time for an operation and the cheapest one that can run it wins.
+// Untimed backends only tell whether they can run it: they have no model comparable
+// to RCCL's and keep their fixed place, taking the operation over from RCCL but not
+// from a faster timed backend. RCCL can run everything and is used when no other
+// backend can, or when no estimate is available at all. Decisions are cached per
+// operation.
+enum ncclBackend {
+  ncclBackendRccl = 0,
+  ncclBackendMscclpp = 1,
+  ncclBackendMsccl = 2,
+  ncclNumBackends = 3
+};
+
+static const char* const ncclBackendStr[ncclNumBackends] = { "RCCL", "MSCCL++", "MSCCL" };
+
+struct ncclBackendOp {
+  int func;           // mscclFunc_t
+  int dataType;
+  int redOp;
+  size_t nBytes;      // count * type size, as passed by the user
+  bool inPlace;
+  void* args;         // Opaque to the selector, passed to the providers but not part of the cache key
+};
+
+// Estimated time of op in us, negative when the backend cannot run it. The value of
+// an untimed backend is only compared against 0.
+typedef float (*ncclBackendCostFn)(void* ctx, const struct ncclBackendOp* op);
+
+#define NCCL_BACKEND_CACHE_SIZE 256
+
+struct ncclBackendCacheEntry {
+  struct ncclBackendOp op;
+  unsigned eligible;
+  int backend;        // -1 for an empty entry
+};
+
+struct ncclBackendSelector {
+  bool ready;
+  ncclBackendCostFn cost[ncclNumBackends];
+  void* ctx[ncclNumBackends];
+  bool timed[ncclNumBackends];
+  int forced;         // Backend to use whenever it can run the operation, -1 for none
+  struct ncclBackendCacheEntry cache[NCCL_BACKEND_CACHE_SIZE];
+  uint64_t hits, misses;
+};
+
+// forced is a backend name (case insensitive), NULL or an empty string for none.
+// Returns false when the name is unknown.
+static inline bool ncclBackendSelectorInit(struct ncclBackendSelector* sel, const char* forced) {
+  memset(sel, 0, sizeof(*sel));
+  for (int i=0; i<NCCL_BACKEND_CACHE_SIZE; i++) sel->cache[i].backend = -1;
+  sel->forced = -1;
+  sel->ready = true;
+  if (forced == NULL || forced[0] == '\0') return true;
+  for (int b=0; b<ncclNumBackends; b++) {
+    if (strcasecmp(forced, ncclBackendStr[b]) == 0) sel->forced = b;
+  }
+  if (strcasecmp(forced, "MSCCLPP") == 0) sel->forced = ncclBackendMscclpp;
+  return sel->forced != -1;
+}
+
+static inline void ncclBackendSetProvider(struct ncclBackendSelector* sel, int backend, ncclBackendCostFn cost, void* ctx, bool timed) {
+  sel->cost[backend] = cost;
+  sel->ctx[backend] = ctx;
+  sel->timed[backend] = timed;
+}
+
+static inline uint32_t ncclBackendHash(const struct ncclBackendOp* op, unsigned eligible) {
+  uint64_t h = op->nBytes * 0x9e3779b97f4a7c15ULL;
+  h ^= ((uint64_t)op->func << 40) ^ ((uint64_t)op->dataType << 32) ^ ((uint64_t)(uint32_t)op->redOp << 8) ^
+       ((uint64_t)op->inPlace << 4) ^ eligible;
+  h ^= h >> 29;
+  return (uint32_t)(h % NCCL_BACKEND_CACHE_SIZE);
+}
+
+// Pick the backend of op among the eligible ones (bitmask of 1<<backend, RCCL is
+// always eligible). Conditions that depend on more than op, like buffer types or
+// graph capture, must be reflected in eligible.
+static inline int ncclBackendSelect(struct ncclBackendSelector* sel, const struct ncclBackendOp* op, unsigned eligible) {
+  eligible |= 1u << ncclBackendRccl;
+  struct ncclBackendCacheEntry* e = sel->cache + ncclBackendHash(op, eligible);
+  if (e->backend != -1 && e->eligible == eligible && e->op.func == op->func && e->op.nBytes == op->nBytes &&
+      e->op.dataType == op->dataType && e->op.redOp == op->redOp && e->op.inPlace == op->inPlace) {
+    sel->hits++;
+    return e->backend;
+  }
+  sel->misses++;
+  float time[ncclNumBackends];
+  for (int b=0; b<ncclNumBackends; b++) {
+    time[b] = -1;
+    if ((eligible & (1u << b)) && sel->cost[b]) time[b] = sel->cost[b](sel->ctx[b], op);
+  }
+  int best = ncclBackendRccl;
+  if (sel->forced != -1 && time[sel->forced] >= 0) {
+    best = sel->forced;
+  } else if (sel->forced != ncclBackendRccl) {
+    // Without an RCCL estimate, any backend that can run the operation is preferred
+    float bestTime = time[ncclBackendRccl] < 0 ? FLT_MAX : time[ncclBackendRccl];
+    for (int b=0; b<ncclNumBackends; b++) {
+      if (b == ncclBackendRccl || !sel->timed[b] || time[b] < 0 || time[b] >= bestTime) continue;
+      best = b;
+      bestTime = time[b];
+    }
+    for (int b=0; b<ncclNumBackends && best == ncclBackendRccl; b++) {
+      if (b != ncclBackendRccl && !sel->timed[b] && time[b] >= 0) best = b;
+    }
+  }
+  e->op = *op;
+  e->op.args = NULL;
+  e->eligible = eligible;
+  e->backend = best;
+  return best;
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_COLL_NET_SOCKET_H_
+#define NCCL_COLL_NET_SOCKET_H_
+
+// Host reduction of the software CollNet over sockets (transport/coll_net_socket.cc).
+// The root receives the contribution of every other rank into its own scratch buffer
+// and reduces them into the result in rank order as they complete, so that results
+// do not depend on the arrival order.
+
+enum ncclCollNetSocketOp {
+  ncclCollNetSocketSum = 0,
+  ncclCollNetSocketProd = 1,
+  ncclCollNetSocketMax = 2,
+  ncclCollNetSocketMin = 3
+};
+
+template<typename T>
+static inline void ncclCollNetSocketReduceType(T* dst, const T* src, int count, int op) {
+  switch (op) {
+    case ncclCollNetSocketSum:  for (int i=0; i<count; i++) dst[i] = dst[i] + src[i]; break;
+    case ncclCollNetSocketProd: for (int i=0; i<count; i++) dst[i] = dst[i] * src[i]; break;
+    case ncclCollNetSocketMax:  for (int i=0; i<count; i++) dst[i] = dst[i] < src[i] ? src[i] : dst[i]; break;
+    case ncclCollNetSocketMin:  for (int i=0; i<count; i++) dst[i] = src[i] < dst[i] ? src[i] : dst[i]; break;
+    default: break;
+  }
+}
+
+// Reduce the contributions of ranks [*nReduced, nranks) that are fully received,
+// offsets[r] being the bytes received from rank r out of size, stopping at the
+// first one still in flight. reduce(r) reduces the contribution of rank r into the
+// result. Returns whether all ranks are reduced.
+template<typename Reduce>
+static inline bool ncclCollNetSocketReduceArrived(int nranks, const int* offsets, int size, int* nReduced, Reduce reduce) {
+  while (*nReduced < nranks && offsets[*nReduced] == size) {
+    reduce(*nReduced);
+    (*nReduced)++;
+  }
+  return *nReduced == nranks;
+}
+
+#endif
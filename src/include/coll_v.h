@@ -0,0 +1,164 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_COLL_V_H_
+#define NCCL_COLL_V_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "align.h"
+
+// AllGatherv and ReduceScatterv on the ring. Rank r owns the segment of count[r]
+// elements at displ[r] of the large buffer (the output of AllGatherv, the input
+// of ReduceScatterv). Every segment is cut into the same nParts parts, one per
+// channel, so that channels get the same share of the data however uneven the
+// segments are. A channel moves its part of all segments together: iteration k
+// of its ring moves chunk k of the part of every rank, an empty chunk when that
+// part is shorter, so that neighbours always agree on the size of a step.
+//
+// Counts and displacements are in elements of the kernel (bytes for AllGatherv)
+// and reach the kernel as a table of nRanks entries in the work fifo.
+
+struct ncclCollVSeg {
+  uint64_t count;
+  uint64_t displ;
+};
+
+// Parts start on this many bytes
+#define NCCL_COLL_V_ALIGN 16
+
+static inline __host__ __device__ uint64_t ncclCollVAlign(int eltSize) {
+  return eltSize < NCCL_COLL_V_ALIGN ? NCCL_COLL_V_ALIGN/eltSize : 1;
+}
+
+// Part of a segment of count elements, [*beg, *end)
+static inline __host__ __device__ void ncclCollVPart(uint64_t count, int part, int nParts, uint64_t align, uint64_t* beg, uint64_t* end) {
+  uint64_t per = divUp(divUp(count, (uint64_t)nParts), align) * align;
+  uint64_t b = per*part;
+  *beg = b < count ? b : count;
+  *end = b+per < count ? b+per : count;
+}
+
+// Chunk elemOffset of a part, at *offset in the segment. Returns its size, 0 past the end of the part.
+static inline __host__ __device__ uint64_t ncclCollVChunk(uint64_t count, int part, int nParts, uint64_t align,
+    uint64_t elemOffset, uint64_t chunkCount, uint64_t* offset) {
+  uint64_t beg, end;
+  ncclCollVPart(count, part, nParts, align, &beg, &end);
+  *offset = beg + elemOffset;
+  if (end - beg <= elemOffset) return 0;
+  return end - beg - elemOffset < chunkCount ? end - beg - elemOffset : chunkCount;
+}
+
+static inline uint64_t ncclCollVMaxCount(const size_t* counts, int nRanks) {
+  uint64_t max = 0;
+  for (int r=0; r<nRanks; r++) max = counts[r] > max ? counts[r] : max;
+  return max;
+}
+
+// Elements a channel walks through: its longest part over all segments
+static inline uint64_t ncclCollVPartMax(const struct ncclCollVSeg* segs, int nRanks, int part, int nParts, uint64_t align) {
+  uint64_t max = 0;
+  for (int r=0; r<nRanks; r++) {
+    uint64_t beg, end;
+    ncclCollVPart(segs[r].count, part, nParts, align, &beg, &end);
+    max = end-beg > max ? end-beg : max;
+  }
+  return max;
+}
+
+// Kernels copy the table to shared memory when it has at most this many entries,
+// once per work, rather than read it from the fifo at every step
+#define NCCL_COLL_V_SHMEM_RANKS 128
+
+// Work fifo slots taken by the table of one collective
+static inline int ncclCollVTableWorks(int nRanks, int workSize) {
+  return (int)divUp((int)(nRanks*sizeof(struct ncclCollVSeg)), workSize);
+}
+
+// Reference data flow of the ring on nRanks ranks with userRanks starting at each
+// rank, following the steps of the kernels on every part and chunk. Rank r holds
+// value r*bufSize+i at index i of its input, which is its segment for AllGatherv
+// and the whole large buffer of bufSize elements for ReduceScatterv (reduce).
+// Returns false when neighbours disagree on the size of a step, or when an output
+// element is wrong or written more than once.
+static inline bool ncclCollVSimulate(int nRanks, const struct ncclCollVSeg* segs, uint64_t bufSize,
+    int nParts, uint64_t align, uint64_t chunkCount, bool reduce) {
+  // One step in flight on each link: its size and data
+  uint64_t* inFlight = (uint64_t*)calloc((size_t)nRanks, sizeof(uint64_t));
+  uint64_t* linkData = (uint64_t*)calloc((size_t)nRanks*chunkCount, sizeof(uint64_t));
+  uint64_t* nextData = (uint64_t*)calloc((size_t)nRanks*chunkCount, sizeof(uint64_t));
+  uint64_t* nextSize = (uint64_t*)calloc((size_t)nRanks, sizeof(uint64_t));
+  // Output of every rank and the number of times each element got written
+  uint64_t outSize = reduce ? 0 : bufSize;
+  for (int r=0; r<nRanks && reduce; r++) outSize = segs[r].count > outSize ? segs[r].count : outSize;
+  uint64_t* out = (uint64_t*)calloc((size_t)nRanks*outSize+1, sizeof(uint64_t));
+  int* written = (int*)calloc((size_t)nRanks*outSize+1, sizeof(int));
+  bool valid = inFlight && linkData && nextData && nextSize && out && written;
+  for (int part=0; part<nParts && valid; part++) {
+    uint64_t workCount = ncclCollVPartMax(segs, nRanks, part, nParts, align);
+    for (uint64_t elemOffset=0; elemOffset<workCount && valid; elemOffset+=chunkCount) {
+      for (int step=0; step<nRanks && valid; step++) {
+        for (int r=0; r<nRanks && valid; r++) {
+          // Segment moved by rank r at this step
+          int s = reduce ? (r-step-1+2*nRanks)%nRanks : (r-step+nRanks)%nRanks;
+          uint64_t off;
+          uint64_t nelem = ncclCollVChunk(segs[s].count, part, nParts, align, elemOffset, chunkCount, &off);
+          uint64_t* in = linkData + (size_t)((r-1+nRanks)%nRanks)*chunkCount;
+          uint64_t* send = nextData + (size_t)r*chunkCount;
+          if (step > 0 && inFlight[(r-1+nRanks)%nRanks] != nelem) valid = false;
+          for (uint64_t i=0; i<nelem && valid; i++) {
+            uint64_t v;
+            if (reduce) {
+              v = (uint64_t)r*bufSize + segs[s].displ + off + i;
+              if (step > 0) v += in[i];
+            } else {
+              v = step == 0 ? (uint64_t)r*bufSize + off + i : in[i];
+            }
+            send[i] = v;
+            // AllGatherv keeps every segment, ReduceScatterv its own at the last step
+            if (!reduce || step == nRanks-1) {
+              size_t o = (size_t)r*outSize + (reduce ? off + i : segs[s].displ + off + i);
+              if (reduce ? off + i >= outSize : segs[s].displ + off + i >= bufSize) {
+                valid = false;
+              } else {
+                out[o] = v;
+                written[o]++;
+              }
+            }
+          }
+          nextSize[r] = nelem;
+        }
+        // Sends of this step are received at the next one
+        uint64_t* t = linkData; linkData = nextData; nextData = t;
+        for (int r=0; r<nRanks; r++) inFlight[r] = nextSize[r];
+      }
+    }
+  }
+  for (int r=0; r<nRanks && valid; r++) {
+    for (int s=0; s<nRanks && valid; s++) {
+      if (reduce && s != r) continue;
+      for (uint64_t i=0; i<segs[s].count && valid; i++) {
+        size_t o = (size_t)r*outSize + (reduce ? i : segs[s].displ + i);
+        uint64_t expected = 0;
+        if (reduce) {
+          for (int q=0; q<nRanks; q++) expected += (uint64_t)q*bufSize + segs[r].displ + i;
+        } else {
+          expected = (uint64_t)s*bufSize + i;
+        }
+        if (written[o] != 1 || out[o] != expected) valid = false;
+      }
+    }
+  }
+  free(inFlight);
+  free(linkData);
+  free(nextData);
+  free(nextSize);
+  free(out);
+  free(written);
+  return valid;
+}
+
+#endif
@@ -16,6 +16,8 @@
 #include "strongstream.h"
 #include "nccl_net.h"
 #include "register.h"
+#include "backend_select.h"
+#include "work_pool.h"
 
 #if defined(__HIP_PLATFORM_AMD__) || defined(__HIPCC__)
 #define HIPRT_CB
@@ -194,11 +196,16 @@ struct ncclKernelPlan {
   int threadPerBlock;
   // workHeap fields are null until uploadWorkFifo() or preparePersistentKernel()
   struct ncclWork* workHead;
+  struct ncclWorkPoolChunk<struct ncclWork>* workChunk; // persistent plans: pool chunk holding workHead
 
   int collOpCount; // zero based for this plan
 
   struct ncclIntruQueue<struct ncclPointerList, &ncclPointerList::next> ipcMemQueue;
   struct ncclIntruQueue<struct ncclNvlsMcHandleList, &ncclNvlsMcHandleList::next> nvlsMcHandleQueue;
+  // Tables of the AllGatherv and ReduceScatterv of the plan, laid out in the fifo
+  // backward from workHead, each collective in reverse order
+  struct ncclIntruQueue<struct ncclWorkList, &ncclWorkList::next> vTableQueue;
+  int nVTableWork;
 
   struct Channel {
     int nWork;
@@ -215,6 +222,11 @@ struct ncclKernelPlan {
 
 struct ncclComm {
   struct ncclMemoryStack memPermanent, memScoped;
+  // Memory allocated on behalf of this communicator (see ncclCommGetMemUsage)
+  struct ncclMemAccount memAccount;
+  size_t memBudget;
+  // RCCL_REDUCE_ACC_FP32, mirrored in ncclDevComm
+  bool reduceAccFp32;
   // List of destructors to run when comm is destructed
   struct ncclDestructor* destructorHead;
 
@@ -270,6 +282,10 @@ struct ncclComm {
   int collChannels; // enqueue nChannels
   int nvlsChannels; // enqueue nChannels
   int collNetChannels;
+  // Neighbour leading to each root on the tree of each channel, [channel*nRanks+root]
+  uint8_t* treeToRoot;
+  // Set when RCCL_TREE_BCAST_REDUCE is off or a tree does not connect all ranks; Broadcast and Reduce then only use rings
+  bool treeRootDisabled;
   // Channels (per peer) for p2p
   int p2pnChannels;
   int p2pnChannelsPerPeer;
@@ -281,6 +297,7 @@ struct ncclComm {
   // Buffer sizes
   int buffSizes[NCCL_NUM_PROTOCOLS];
   int p2pChunkSize;
+  int p2pSharedSteps; // Slots per channel in the shared net buffer pool
 
   // Algorithm/Protocols thresholds
   ssize_t threadThresholds[NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
@@ -289,6 +306,9 @@ struct ncclComm {
   float ringbdw[NCCL_NUM_FUNCTIONS][NCCL_NUM_PROTOCOLS];
   int maxThreads[NCCL_NUM_ALGORITHMS][NCCL_NUM_PROTOCOLS];
 
+  // Ranks which determined the global graphs
+  struct ncclTopoGraphLimits graphLimits[NCCL_NUM_ALGORITHMS];
+
   /* This attribute can indicate the states of communicators and return code of
    * asynchronous NCCL operations. */
   ncclResult_t asyncResult;
@@ -330,6 +350,7 @@ struct ncclComm {
 
   struct ncclProxyState* proxyState;
   int proxyRefCountOld; /* store proxy post-atomic-sub refcount */
+  struct ncclProxyBatch proxyBatch; // proxy calls queued by ncclProxyBatchBegin()
   // Whether this communicator uses collNet
   int collNetSupport;
   uint8_t collNetSupportMatrix[4/*sum,prod,min,max*/][ncclNumTypes];
@@ -359,9 +380,16 @@ struct ncclComm {
   // Subset of those in groupNext list. Holds 0x1 if not needing preconnect.
   struct ncclComm* preconnectNext;
   int persistentRefs; // number of persistent plan-lists capturing this comm
+  // Device storage for the work of persistent plans, uploaded once per launch
+  struct ncclWorkPool<struct ncclWork> persistentWork;
   struct ncclTasks tasks;
 
   hipStream_t sideStream; // [RCCL] Cached non-captured stream
+  // [RCCL] Staging buffer of intermediate ranks in tree Gather/Scatter, grown on demand
+  void* gatherTreeBuff;
+  size_t gatherTreeBuffSize;
+  // [RCCL] Tree Gather/Scatter schedule of this rank per root, NULL until first used
+  struct ncclGatherTreeSchedule** gatherTreeSchedules;
 
   // user-created reduction ops
   int userRedOpCapacity, userRedOpFreeHead;
@@ -402,6 +430,8 @@ struct ncclComm {
 
   // Whether this comm is compatible with MSCCL
   bool mscclCompatible;
+  // [RCCL] Choice between RCCL, MSCCL and MSCCL++ for operations going through MSCCL
+  struct ncclBackendSelector backendSelect;
   // group job to support multi-thread FT
   struct ncclGroupJob *groupJob;
 
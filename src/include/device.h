@@ -15,6 +15,8 @@
 #include "nccl_common.h"
 #include "align.h"
 #include "collectives.h"
+#include "tree_root.h"
+#include "coll_v.h"
 #if defined(ENABLE_NPKIT)
 #include "npkit/npkit_struct.h"
 #endif
@@ -161,6 +163,7 @@ struct ncclTree {
   int up;
   int down[NCCL_MAX_TREE_ARITY];
 };
+static_assert(NCCL_TREE_ROOT_MAX_DOWN == NCCL_MAX_TREE_ARITY, "Tree Broadcast/Reduce direction does not match the tree arity");
 
 #define NCCL_MAX_DIRECT_ARITY 7
 struct ncclDirect {
@@ -227,6 +230,7 @@ struct ncclWorkHeader {
   uint16_t funcIndex;
   uint8_t isLast:1; // last work for this kernel
   uint8_t inFifo:1; // is this work in the fifo
+  uint8_t ackAfterRun:1; // reads the table of an AllGatherv/ReduceScatterv in the fifo, ack once done
   enum ncclWorkType type;
 };
 
@@ -235,6 +239,10 @@ struct ncclWorkElem {
     uint8_t flagBits;
     struct {
       uint8_t isUsed:1, redOpArgIsPtr:1, regUsed:1, oneNode:1;
+      // Tree Broadcast/Reduce: neighbour leading to the root on this channel, see tree_root.h
+      uint8_t treeToRoot:3;
+      // AllGatherv or ReduceScatterv, see coll_v.h
+      uint8_t vColl:1;
     };
   };
   uint8_t nWarps;
@@ -259,6 +267,13 @@ struct ncclWorkElem {
       // Instead, it needs the number of bidirectional rings.
       uint16_t pivotA2ANumBiRings;
     };
+    struct {
+      // AllGatherv, ReduceScatterv: offset of the table of segments from the kernel argument
+      // workHead, in ncclWork, and part of every segment done by this channel
+      int32_t vTable;
+      uint16_t vPart;
+      uint16_t vNParts;
+    };
   };
 };
 
@@ -410,6 +425,8 @@ struct ncclDevComm {
   int nNodes;
   int buffSizes[NCCL_NUM_PROTOCOLS];
   int p2pChunkSize;
+  // Carry the partial sums of half and bfloat16 in fp32 within a reduce step
+  bool reduceAccFp32;
 
   // Operation list for aggregation
   int workFifoDepth;
@@ -557,19 +574,19 @@ inline int ncclDevFuncId(int coll, int devRedOp, int type, int algo, int proto)
     if (coll == ncclFuncAllToAllPivot) break;
     row += 1;
 
-    // RING / <all_protos> / Sum / int8_t
+    // TREE/RING / <all_protos> / Sum / int8_t
     if (coll == ncclFuncBroadcast) {
-      row += proto;
+      row += algo * NCCL_NUM_PROTOCOLS + proto;
       break;
     }
-    row += NCCL_NUM_PROTOCOLS;
+    row += 2 * NCCL_NUM_PROTOCOLS;
 
-    // RING / <all_protos> / <all_redops> / <all_types>
+    // TREE/RING / <all_protos> / <all_redops> / <all_types>
     if (coll == ncclFuncReduce) {
-      row += ((proto * ncclNumDevRedOps + devRedOp) * ncclNumTypes + type) - NCCL_NUM_FLOATS * proto; 
+      row += (((algo * NCCL_NUM_PROTOCOLS + proto) * ncclNumDevRedOps + devRedOp) * ncclNumTypes + type) - NCCL_NUM_FLOATS * (algo * NCCL_NUM_PROTOCOLS + proto);
       break;
     }
-    row += NCCL_NUM_PROTOCOLS * (ncclNumDevRedOps * ncclNumTypes - NCCL_NUM_FLOATS);
+    row += 2 * NCCL_NUM_PROTOCOLS * (ncclNumDevRedOps * ncclNumTypes - NCCL_NUM_FLOATS);
 
     // RING / <all_protos> / <all_redops> / <all_types>
     if (coll == ncclFuncReduceScatter) {
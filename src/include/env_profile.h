@@ -0,0 +1,93 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_ENV_PROFILE_H_
+#define NCCL_ENV_PROFILE_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// Profile sections of rccl.conf files are selected by a hardware fingerprint:
+//   [arch=gfx942,gpus=8,nics=8,xgmi=1,model=3]
+// A section matches when all of its keys match; arch is a prefix match as in
+// IsArchMatch, other keys are integers, "*" matches anything.
+
+#define RCCL_ENV_MODEL_UNKNOWN (-2)
+
+struct rcclEnvFingerprint {
+  char arch[64];  // gcnArchName of the GPU
+  int nGpus;      // GPUs in the node
+  int nNics;      // NICs in the node
+  int xgmi;       // 1 when all GPUs are connected through XGMI
+  int model;      // Matched Rome model index, -1 for none, RCCL_ENV_MODEL_UNKNOWN before graph search
+};
+
+enum rcclEnvMatch { rcclEnvNoMatch = 0, rcclEnvMatch = 1, rcclEnvDefer = 2 };
+
+// Precedence of conf file values, lower wins. The environment always wins.
+// A matching profile section overrides the flat KEY=VALUE lines of its file.
+static inline int rcclEnvRank(int fileIndex, bool profile) {
+  return 2*fileIndex + (profile ? 0 : 1);
+}
+
+#define RCCL_ENV_RANK_ENVIRONMENT (-1)
+#define RCCL_ENV_RANK_UNSET 1000
+
+// currentRank is the rank of the file value that set the variable, RCCL_ENV_RANK_ENVIRONMENT
+// when the user set it, RCCL_ENV_RANK_UNSET when nothing did.
+static inline bool rcclEnvOverrides(int newRank, int currentRank) {
+  return currentRank != RCCL_ENV_RANK_ENVIRONMENT && newRank < currentRank;
+}
+
+// Evaluate a section selector (the text between the brackets). Sections with a model
+// key are deferred until the model is known. *specificity is the number of keys.
+static inline enum rcclEnvMatch rcclEnvSectionMatch(const char* selector, const struct rcclEnvFingerprint* fp, int* specificity) {
+  enum rcclEnvMatch result = rcclEnvMatch;
+  int keys = 0;
+  const char* p = selector;
+  while (*p) {
+    while (*p == ' ' || *p == ',') p++;
+    if (*p == '\0') break;
+    const char* key = p;
+    while (*p && *p != '=' && *p != ',') p++;
+    if (*p != '=') return rcclEnvNoMatch;
+    size_t keyLen = p - key;
+    const char* value = ++p;
+    while (*p && *p != ',') p++;
+    size_t valueLen = p - value;
+    while (valueLen && value[valueLen-1] == ' ') valueLen--;
+    while (keyLen && key[keyLen-1] == ' ') keyLen--;
+    keys++;
+    if (valueLen == 1 && value[0] == '*') continue;
+
+    char v[64];
+    if (valueLen == 0 || valueLen >= sizeof(v)) return rcclEnvNoMatch;
+    memcpy(v, value, valueLen);
+    v[valueLen] = '\0';
+    char* end;
+    long n = strtol(v, &end, 0);
+    bool isInt = *end == '\0';
+    if (keyLen == 4 && strncmp(key, "arch", 4) == 0) {
+      if (strncmp(fp->arch, v, valueLen) != 0) return rcclEnvNoMatch;
+    } else if (keyLen == 4 && strncmp(key, "gpus", 4) == 0) {
+      if (!isInt || n != fp->nGpus) return rcclEnvNoMatch;
+    } else if (keyLen == 4 && strncmp(key, "nics", 4) == 0) {
+      if (!isInt || n != fp->nNics) return rcclEnvNoMatch;
+    } else if (keyLen == 4 && strncmp(key, "xgmi", 4) == 0) {
+      if (!isInt || n != fp->xgmi) return rcclEnvNoMatch;
+    } else if (keyLen == 5 && strncmp(key, "model", 5) == 0) {
+      if (!isInt) return rcclEnvNoMatch;
+      if (fp->model == RCCL_ENV_MODEL_UNKNOWN) result = rcclEnvDefer;
+      else if (n != fp->model) return rcclEnvNoMatch;
+    } else {
+      return rcclEnvNoMatch;
+    }
+  }
+  if (specificity) *specificity = keys;
+  return result;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_GATHER_TREE_H_
+#define NCCL_GATHER_TREE_H_
+
+// Topology-aware k-nomial schedule for Gather and Scatter. Ranks are placed in
+// positions with the root first and the ranks of each node contiguous, the node
+// leader (lowest rank, or the root) first. Ranks of a node gather to their leader
+// with a k-nomial tree of radix intraRadix, then leaders gather to the root with
+// a tree of radix interRadix. Every subtree covers a contiguous range of positions.
+// Scatter runs the same schedule backwards.
+
+struct ncclGatherTreeXfer {
+  int peer;
+  // Positions [first, first+count) of the order
+  int first;
+  int count;
+};
+
+struct ncclGatherTreePlan {
+  // Parent and own subtree, peer is -1 at the root
+  struct ncclGatherTreeXfer up;
+  int nChildren;
+  // Caller provided, nRanks-1 entries are always enough
+  struct ncclGatherTreeXfer* children;
+};
+
+// Schedule of this rank for one root, built once and kept by the communicator
+struct ncclGatherTreeSchedule {
+  int* order;
+  struct ncclGatherTreePlan plan;
+};
+
+// order[position] = rank and nodeStart[j] = first position of the j-th node, with
+// nodeStart[nNodes] = nRanks. The node of the root comes first, its ranks starting
+// from the root and wrapping around, the other nodes follow in node order.
+static inline void ncclGatherTreeOrder(int nRanks, const int* rankToNode, int nNodes, int root, int* order, int* nodeStart) {
+  // Count the ranks of each node, j-th node counted in nodeStart[j+1]
+  int rootNode = rankToNode[root];
+  for (int j=0; j<=nNodes; j++) nodeStart[j] = 0;
+  for (int r=0; r<nRanks; r++) nodeStart[(rankToNode[r] - rootNode + nNodes) % nNodes + 1]++;
+  for (int j=1; j<=nNodes; j++) nodeStart[j] += nodeStart[j-1];
+  // Place ranks using nodeStart[j] as the cursor of the j-th node, which ends on
+  // the start of the next one, then shift the starts back
+  for (int i=0; i<nRanks; i++) {
+    int r = (root + i) % nRanks;
+    if (rankToNode[r] == rootNode) order[nodeStart[0]++] = r;
+  }
+  for (int r=0; r<nRanks; r++) {
+    int j = (rankToNode[r] - rootNode + nNodes) % nNodes;
+    if (j != 0) order[nodeStart[j]++] = r;
+  }
+  for (int j=nNodes; j>0; j--) nodeStart[j] = nodeStart[j-1];
+  nodeStart[0] = 0;
+}
+
+// Parent of position i > 0 in a k-nomial tree rooted at 0. span is set to the
+// size of the subtree of i, before clipping to the number of positions.
+static inline int ncclGatherTreeParent(int i, int radix, int* span) {
+  int s = 1;
+  while ((i / s) % radix == 0) s *= radix;
+  *span = s;
+  return i - ((i / s) % radix) * s;
+}
+
+// Children of position i in a k-nomial tree over n positions, calls fn(child, span)
+template<typename F>
+static inline void ncclGatherTreeChildren(int i, int n, int radix, F fn) {
+  for (long s=1; s<n; s*=radix) {
+    if (i % (s*radix) != 0) break;
+    for (int d=1; d<radix && i+d*s<n; d++) fn((int)(i+d*s), (int)s);
+  }
+}
+
+// Schedule of rank at position pos. A radix below 2 means all ranks of a node
+// (or all leaders) talk to their leader (or the root) directly.
+static inline void ncclGatherTreeBuild(int nNodes, const int* order, const int* nodeStart, int pos,
+    int intraRadix, int interRadix, struct ncclGatherTreePlan* plan) {
+  int j = 0;
+  while (nodeStart[j+1] <= pos) j++;
+  int base = nodeStart[j], m = nodeStart[j+1] - base, i = pos - base;
+  int kIntra = intraRadix < 2 ? (m < 2 ? 2 : m) : intraRadix;
+  int kInter = interRadix < 2 ? (nNodes < 2 ? 2 : nNodes) : interRadix;
+  plan->nChildren = 0;
+  ncclGatherTreeChildren(i, m, kIntra, [&](int c, int s) {
+    struct ncclGatherTreeXfer x = { order[base+c], base+c, s < m-c ? s : m-c };
+    plan->children[plan->nChildren++] = x;
+  });
+  if (i == 0) {
+    ncclGatherTreeChildren(j, nNodes, kInter, [&](int c, int s) {
+      int end = c+s < nNodes ? c+s : nNodes;
+      struct ncclGatherTreeXfer x = { order[nodeStart[c]], nodeStart[c], nodeStart[end]-nodeStart[c] };
+      plan->children[plan->nChildren++] = x;
+    });
+  }
+  int s;
+  if (i != 0) {
+    int p = ncclGatherTreeParent(i, kIntra, &s);
+    plan->up.peer = order[base+p];
+    plan->up.first = pos;
+    plan->up.count = s < m-i ? s : m-i;
+  } else if (j != 0) {
+    int p = ncclGatherTreeParent(j, kInter, &s);
+    int end = j+s < nNodes ? j+s : nNodes;
+    plan->up.peer = order[nodeStart[p]];
+    plan->up.first = base;
+    plan->up.count = nodeStart[end] - base;
+  } else {
+    plan->up.peer = -1;
+    plan->up.first = 0;
+    plan->up.count = nodeStart[nNodes];
+  }
+}
+
+#endif
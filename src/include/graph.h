@@ -15,6 +15,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <sched.h>
+#include "graph_limits.h"
 
 ncclResult_t ncclTopoCudaPath(int cudaDev, char** path);
 
@@ -118,6 +119,15 @@ struct ncclTopoRanks {
 
 ncclResult_t ncclTopoPreset(struct ncclComm* comm, struct ncclTopoGraph** graphs, struct ncclTopoRanks* topoRanks);
 
+// Reduce the graph info of one rank into graph, and record it in limits if not NULL
+void ncclTopoReduceGraphInfo(struct ncclTopoGraph* graph, struct ncclTopoGraphInfo* info, int rank, struct ncclTopoGraphLimits* limits);
+// Print which ranks reduced the global graphs, if any, as a single line
+ncclResult_t ncclTopoPrintGraphLimits(struct ncclComm* comm);
+// Global limits of the graph of an algorithm and the ranks which set them
+ncclResult_t ncclTopoGetGraphLimits(struct ncclComm* comm, int algorithm, struct ncclTopoGraphLimits* limits);
+
+// Reorder nodes by network distance (RCCL_NODE_ORDER), permuting firstRanks, treePatterns and comm->rankToNode
+ncclResult_t ncclTopoOrderNodes(struct ncclComm* comm, int* firstRanks, int* treePatterns);
 ncclResult_t ncclTopoPostset(struct ncclComm* comm, int* firstRanks, int* treePatterns,
     struct ncclTopoRanks** allTopoRanks, int* rings, struct ncclTopoGraph** graphs, int nc);
 ncclResult_t ncclTreeBasePostset(struct ncclComm* comm, struct ncclTopoGraph* treeGraph);
@@ -125,5 +135,8 @@ ncclResult_t ncclTreeBasePostset(struct ncclComm* comm, struct ncclTopoGraph* tr
 ncclResult_t ncclTopoTuneModel(struct ncclComm* comm, int minCompCap, int maxCompCap, struct ncclTopoGraph** graphs);
 #include "info.h"
 ncclResult_t ncclTopoGetAlgoTime(struct ncclInfo* info, int algorithm, int protocol, int numPipeOps, float* time, bool* backup = NULL);
+// Pick algorithm/protocol (unless already set), then nChannels/nThreads, as done at enqueue time
+ncclResult_t ncclTopoGetAlgoInfo(struct ncclInfo* info, int collNetSupport, int nvlsSupport, int numPipeOps);
+ncclResult_t ncclTopoGetChannelThreadInfo(struct ncclInfo* info);
 
 #endif
@@ -0,0 +1,80 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_GRAPH_LIMITS_H_
+#define NCCL_GRAPH_LIMITS_H_
+
+// Graph attributes exchanged between ranks after the search
+struct ncclTopoGraphInfo {
+  int pattern;
+  int nChannels;
+  int sameChannels;
+  float bwIntra;
+  float bwInter;
+  int typeIntra;
+  int typeInter;
+};
+
+// The global graph uses the lowest nChannels/bandwidth and the worst path
+// type found by any rank. Keep track of which rank determined each value.
+struct ncclTopoGraphLimit {
+  float value;  // Global value, i.e. the local value of 'rank'
+  int rank;     // First rank with the global value, -1 if not set
+  float best;   // Best local value across ranks
+  int bestRank;
+};
+
+struct ncclTopoGraphLimits {
+  struct ncclTopoGraphLimit nChannels;
+  struct ncclTopoGraphLimit bwIntra;
+  struct ncclTopoGraphLimit bwInter;
+  struct ncclTopoGraphLimit typeIntra;
+  struct ncclTopoGraphLimit typeInter;
+};
+
+static inline void ncclTopoGraphLimitsReset(struct ncclTopoGraphLimits* limits) {
+  struct ncclTopoGraphLimit* l[] = { &limits->nChannels, &limits->bwIntra, &limits->bwInter, &limits->typeIntra, &limits->typeInter };
+  for (int i=0; i<5; i++) {
+    l[i]->value = l[i]->best = 0;
+    l[i]->rank = l[i]->bestRank = -1;
+  }
+}
+
+// For path types, higher values are worse.
+static inline void ncclTopoGraphLimitUpdate(struct ncclTopoGraphLimit* limit, float value, int rank, bool higherIsBetter) {
+  if (limit->rank == -1) {
+    limit->value = limit->best = value;
+    limit->rank = limit->bestRank = rank;
+    return;
+  }
+  if (higherIsBetter ? value < limit->value : value > limit->value) {
+    limit->value = value;
+    limit->rank = rank;
+  }
+  if (higherIsBetter ? value > limit->best : value < limit->best) {
+    limit->best = value;
+    limit->bestRank = rank;
+  }
+}
+
+// Record the graph info of one rank, in the order ranks are reduced into the global graph
+static inline void ncclTopoGraphLimitsUpdate(struct ncclTopoGraphLimits* limits, const struct ncclTopoGraphInfo* info, int rank) {
+  ncclTopoGraphLimitUpdate(&limits->nChannels, info->nChannels, rank, true);
+  ncclTopoGraphLimitUpdate(&limits->bwIntra, info->bwIntra, rank, true);
+  ncclTopoGraphLimitUpdate(&limits->bwInter, info->bwInter, rank, true);
+  ncclTopoGraphLimitUpdate(&limits->typeIntra, info->typeIntra, rank, false);
+  ncclTopoGraphLimitUpdate(&limits->typeInter, info->typeInter, rank, false);
+}
+
+// Copy the limits of one algorithm out of the per-algorithm array. Returns false
+// when algorithm is not in [0, nAlgorithms).
+static inline bool ncclTopoGraphLimitsGet(const struct ncclTopoGraphLimits* all, int nAlgorithms, int algorithm, struct ncclTopoGraphLimits* limits) {
+  if (algorithm < 0 || algorithm >= nAlgorithms) return false;
+  *limits = all[algorithm];
+  return true;
+}
+
+#endif
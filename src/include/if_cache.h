@@ -0,0 +1,75 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_IF_CACHE_H_
+#define NCCL_IF_CACHE_H_
+
+#include <string.h>
+#include <mutex>
+
+// Process-wide cache of the ordered list of network interfaces. The list is scanned
+// again when one of the settings it depends on changes: the socket family,
+// NCCL_SOCKET_IFNAME and NCCL_COMM_ID. An empty list is not kept, so we keep looking
+// until an interface comes up. Callers asking for fewer interfaces or shorter names
+// get a prefix of the cached list, which is what a scan of their own would return.
+// Templated on the address type so that it can be unit tested without sockets.
+
+#define NCCL_IF_CACHE_ENV_SIZE 256
+
+template<typename Addr, int NameSize, int MaxIfs>
+struct ncclIfCache {
+  std::mutex lock;
+  bool valid = false;
+  int family;
+  char ifName[NCCL_IF_CACHE_ENV_SIZE];
+  char commId[NCCL_IF_CACHE_ENV_SIZE];
+  int nIfs;
+  char names[NameSize*MaxIfs];
+  Addr addrs[MaxIfs];
+};
+
+static inline void ncclIfCacheCopyEnv(char* dst, const char* env) {
+  dst[0] = '\0';
+  if (env) strncpy(dst, env, NCCL_IF_CACHE_ENV_SIZE-1);
+  dst[NCCL_IF_CACHE_ENV_SIZE-1] = '\0';
+}
+
+// scan(names, addrs, nameSize, maxIfs) lists the interfaces and returns their number.
+// *cached tells whether the list came from the cache.
+template<typename Addr, int NameSize, int MaxIfs, typename Scan>
+static inline int ncclIfCacheGet(struct ncclIfCache<Addr, NameSize, MaxIfs>* cache, int family, const char* ifNameEnv, const char* commIdEnv,
+                                 Scan scan, char* ifNames, Addr* ifAddrs, int ifNameMaxSize, int maxIfs, bool* cached) {
+  char ifName[NCCL_IF_CACHE_ENV_SIZE], commId[NCCL_IF_CACHE_ENV_SIZE];
+  ncclIfCacheCopyEnv(ifName, ifNameEnv);
+  ncclIfCacheCopyEnv(commId, commIdEnv);
+
+  std::lock_guard<std::mutex> lock(cache->lock);
+  *cached = cache->valid && cache->family == family && strcmp(cache->ifName, ifName) == 0 && strcmp(cache->commId, commId) == 0;
+  if (!*cached) {
+    cache->nIfs = scan(cache->names, cache->addrs, NameSize, MaxIfs);
+    cache->family = family;
+    strcpy(cache->ifName, ifName);
+    strcpy(cache->commId, commId);
+    cache->valid = cache->nIfs > 0;
+  }
+  int nIfs = cache->nIfs < maxIfs ? cache->nIfs : maxIfs;
+  for (int i=0; i<nIfs; i++) {
+    char* name = ifNames+i*ifNameMaxSize;
+    strncpy(name, cache->names+i*NameSize, ifNameMaxSize-1);
+    name[ifNameMaxSize-1] = '\0';
+    memcpy(ifAddrs+i, cache->addrs+i, sizeof(Addr));
+  }
+  return nIfs;
+}
+
+// Drop the cached list, the next call scans again
+template<typename Addr, int NameSize, int MaxIfs>
+static inline void ncclIfCacheReset(struct ncclIfCache<Addr, NameSize, MaxIfs>* cache) {
+  std::lock_guard<std::mutex> lock(cache->lock);
+  cache->valid = false;
+}
+
+#endif
@@ -55,6 +55,9 @@ struct ncclInfo {
   // Algorithm details
   int chunkSteps;
   int sliceSteps;
+  // AllGatherv, ReduceScatterv: counts and displacements of every rank, valid during the call only
+  const size_t* vCounts;
+  const size_t* vDispls;
   // Computed later
   ncclDevRedOpFull opFull;
   ncclPattern_t pattern;
@@ -77,6 +80,7 @@ struct ncclInfo {
   int algorithm;
   int protocol;
   bool userTuned;
+  struct ncclCollVSeg* vSegs; // AllGatherv, ReduceScatterv: segments of the tasks, in elements of the kernel
   struct ncclInfo *next;
 };
 
@@ -139,6 +143,8 @@ struct ncclTasks {
   struct ncclIntruQueue<struct ncclInfo, &ncclInfo::next> collCBDQueue;
   // Queue for collnet
   struct ncclIntruQueue<struct ncclInfo, &ncclInfo::next> collnetQueue;
+  // Queue for AllGatherv and ReduceScatterv
+  struct ncclIntruQueue<struct ncclInfo, &ncclInfo::next> collVQueue;
   size_t workBytesTotal;
   int usableChannels;
   bool sorted;
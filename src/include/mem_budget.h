@@ -0,0 +1,82 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_MEM_BUDGET_H_
+#define NCCL_MEM_BUDGET_H_
+
+#include <stdint.h>
+
+// Estimate of the device memory of the protocol buffers of a communicator, and the
+// fitting of it into RCCL_MEM_BUDGET. These only depend on their arguments so they
+// can be unit tested on hosts without a GPU.
+
+// Ring prev/next and tree up/down connections each hold one buffer per protocol.
+#define NCCL_MEM_BUDGET_CONNS_PER_CHANNEL 4
+#define NCCL_MEM_BUDGET_MIN_BUFFSIZE (1 << 18) /* 256KiB */
+
+struct ncclMemBudget {
+  int64_t budget;         // Bytes, 0 is unlimited
+  int nProtos;
+  int simpleProto;        // Index of the protocol whose buffer may shrink
+  int* buffSizes;         // Per protocol, updated by the fit
+  const bool* protoUsed;  // Protocols that allocate buffers, e.g. LL128 only when enabled
+  // Send/recv connections: a send and a receive buffer of nSteps chunks per peer and
+  // channel. Only the buffer of the simple protocol is allocated for them.
+  int nPeers;
+  int p2pChannelsPerPeer;
+  int p2pChunkSize;
+  int nSteps;
+};
+
+// Collective buffers of nChannels channels
+static inline int64_t ncclMemBudgetCollBytes(const struct ncclMemBudget* b, int nChannels) {
+  int64_t connBytes = 0;
+  for (int p=0; p<b->nProtos; p++) if (b->protoUsed[p]) connBytes += b->buffSizes[p];
+  return (int64_t)nChannels * NCCL_MEM_BUDGET_CONNS_PER_CHANNEL * connBytes;
+}
+
+// Send/recv buffers of all peers, each capped to the simple buffer like P2P connections
+static inline int64_t ncclMemBudgetP2pBytes(const struct ncclMemBudget* b) {
+  int64_t perConn = (int64_t)b->nSteps * b->p2pChunkSize;
+  if (perConn > b->buffSizes[b->simpleProto]) perConn = b->buffSizes[b->simpleProto];
+  int perPeer = b->p2pChannelsPerPeer < 1 ? 1 : b->p2pChannelsPerPeer;
+  return 2 * (int64_t)b->nPeers * perPeer * perConn;
+}
+
+static inline int64_t ncclMemBudgetEstimate(const struct ncclMemBudget* b, int nChannels) {
+  return ncclMemBudgetCollBytes(b, nChannels) + ncclMemBudgetP2pBytes(b);
+}
+
+// Fit the buffers of *nChannels channels into the budget: halve the simple buffer
+// down to NCCL_MEM_BUDGET_MIN_BUFFSIZE first, then the channel count down to
+// minChannels. Returns the resulting estimate, which is still above the budget
+// when it cannot be met.
+static inline int64_t ncclMemBudgetFit(struct ncclMemBudget* b, int* nChannels, int minChannels) {
+  if (minChannels < 1) minChannels = 1;
+  int64_t estimate = ncclMemBudgetEstimate(b, *nChannels);
+  if (b->budget <= 0) return estimate;
+  while (estimate > b->budget && b->buffSizes[b->simpleProto]/2 >= NCCL_MEM_BUDGET_MIN_BUFFSIZE) {
+    b->buffSizes[b->simpleProto] /= 2;
+    estimate = ncclMemBudgetEstimate(b, *nChannels);
+  }
+  while (estimate > b->budget && *nChannels/2 >= minChannels) {
+    *nChannels /= 2;
+    estimate = ncclMemBudgetEstimate(b, *nChannels);
+  }
+  return estimate;
+}
+
+// Postset doubles the channels of the graph search and then duplicates them up to
+// nc times as many. Cap both so that the final count stays within maxChannels.
+static inline void ncclMemBudgetCapChannels(int maxChannels, int* searchChannels, int* nc) {
+  if (maxChannels < 1) maxChannels = 1;
+  int n = *searchChannels;
+  if (2*n > maxChannels) n = maxChannels/2 < 1 ? 1 : maxChannels/2;
+  *searchChannels = n;
+  if ((int64_t)*nc * n > maxChannels) *nc = maxChannels/n < 1 ? 1 : maxChannels/n;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_NET_FLUSH_H_
+#define NCCL_NET_FLUSH_H_
+
+#include <stdint.h>
+
+// Coalescing of the GDR flushes of the NET receive proxy. Steps of a group of receives
+// in [flushed, received) wait for a flush, steps in [transmitted, flushed) wait for it
+// to complete before they are handed to the GPU. One flush covers all the steps
+// received since the previous one, and every covered slot of requests[] holds its
+// request. Templated on the sub and on the net calls so that they can be unit tested
+// with a mock plugin.
+
+// Move the flush frontier up to the received steps. Steps needing no flush pass right
+// away; otherwise flush(&request) issues one flush for all of them, unless maxFlushes
+// (0 is no limit) are already in flight. Sets *progress when the frontier moved, and
+// returns the error of flush.
+template<typename Sub, typename Flush>
+static inline auto ncclNetFlushAdvance(Sub* subGroup, int sliceSteps, int maxFlushes, Flush flush, int* progress) -> decltype(flush((void**)0)) {
+  typedef decltype(flush((void**)0)) Ret;
+  const int nSlots = sizeof(subGroup->requests)/sizeof(subGroup->requests[0]);
+  *progress = 0;
+  if (subGroup->received <= subGroup->flushed) return Ret();
+  if (subGroup->flushNeeded) {
+    if (maxFlushes && subGroup->flushesInFlight >= maxFlushes) return Ret();
+    void* request = NULL;
+    Ret ret = flush(&request);
+    if (ret != Ret()) return ret;
+    for (uint64_t step=subGroup->flushed; step<subGroup->received; step+=sliceSteps) subGroup->requests[step%nSlots] = request;
+    if (request) subGroup->flushesInFlight++;
+    subGroup->flushNeeded = 0;
+  }
+  subGroup->flushed = subGroup->received;
+  *progress = 1;
+  return Ret();
+}
+
+// Whether the first step not transmitted yet can be handed to the GPU. test(request,
+// &done) tests the flush covering it; once done, the request is freed and released
+// from all the steps it covered.
+template<typename Sub, typename Test>
+static inline auto ncclNetFlushTest(Sub* subGroup, int sliceSteps, Test test, int* done) -> decltype(test((void*)0, (int*)0)) {
+  typedef decltype(test((void*)0, (int*)0)) Ret;
+  const int nSlots = sizeof(subGroup->requests)/sizeof(subGroup->requests[0]);
+  *done = 0;
+  if (subGroup->flushed <= subGroup->transmitted) return Ret();
+  uint64_t step = subGroup->transmitted;
+  void* request = subGroup->requests[step%nSlots];
+  *done = 1;
+  if (request == NULL) return Ret();
+  Ret ret = test(request, done);
+  if (ret != Ret() || !*done) return ret;
+  for (uint64_t next=step; next<subGroup->flushed && subGroup->requests[next%nSlots] == request; next+=sliceSteps)
+    subGroup->requests[next%nSlots] = NULL;
+  subGroup->flushesInFlight--;
+  return Ret();
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_NODE_ORDER_H_
+#define NCCL_NODE_ORDER_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+// Inter-node order of rings and trees from a node to node cost matrix (latency in us,
+// negative when unknown). Rings connect consecutive positions and trees are built by
+// ncclGetDtree on positions, so nodes behind the same leaf switch should be contiguous
+// and aligned on the power of two subtrees. Only depends on its arguments so that every
+// rank computes the same order from the same matrix.
+
+#define NCCL_NODE_ORDER_MAX_NODES 512
+// Minimum relative gain over rank order for the new order to be used
+#define NCCL_NODE_ORDER_MIN_GAIN 0.05f
+#define NCCL_NODE_ORDER_MAX_PASSES 64
+
+// Parent of rank in the btree of ncclGetBtree, -1 for the root
+static inline int ncclNodeOrderBtreeParent(int nranks, int rank) {
+  if (rank == 0) return -1;
+  int bit;
+  for (bit=1; bit<nranks; bit<<=1) {
+    if (bit & rank) break;
+  }
+  int up = (rank ^ bit) | (bit << 1);
+  if (up >= nranks) up = rank ^ bit;
+  return up;
+}
+
+// Parent of rank in the second tree of ncclGetDtree
+static inline int ncclNodeOrderDtreeParent(int nranks, int rank) {
+  if (nranks % 2 == 1) {
+    int u = ncclNodeOrderBtreeParent(nranks, (rank-1+nranks) % nranks);
+    return u == -1 ? -1 : (u+1) % nranks;
+  }
+  int u = ncclNodeOrderBtreeParent(nranks, nranks-1-rank);
+  return u == -1 ? -1 : nranks-1-u;
+}
+
+// Fill unknown entries with the shortest path through measured ones and make the
+// matrix symmetric. Returns false when some node cannot be reached.
+static inline bool ncclNodeOrderComplete(int n, float* cost) {
+  for (int i=0; i<n; i++) {
+    cost[i*n+i] = 0;
+    for (int j=0; j<i; j++) {
+      float a = cost[i*n+j], b = cost[j*n+i];
+      float c = a < 0 ? b : b < 0 ? a : (a < b ? a : b);
+      cost[i*n+j] = cost[j*n+i] = c;
+    }
+  }
+  for (int k=0; k<n; k++) {
+    for (int i=0; i<n; i++) {
+      float ik = cost[i*n+k];
+      if (ik < 0) continue;
+      for (int j=0; j<n; j++) {
+        float kj = cost[k*n+j];
+        if (kj < 0) continue;
+        if (cost[i*n+j] < 0 || ik + kj < cost[i*n+j]) cost[i*n+j] = ik + kj;
+      }
+    }
+  }
+  for (int i=0; i<n*n; i++) if (cost[i] < 0) return false;
+  return true;
+}
+
+static inline float ncclNodeOrderRingCost(int n, const float* cost, const int* order) {
+  float total = 0;
+  for (int p=0; p<n; p++) total += cost[order[p]*n + order[(p+1)%n]];
+  return total;
+}
+
+// Cost of the edges of both trees
+static inline float ncclNodeOrderTreeCost(int n, const float* cost, const int* order) {
+  float total = 0;
+  for (int p=0; p<n; p++) {
+    int u0 = ncclNodeOrderBtreeParent(n, p), u1 = ncclNodeOrderDtreeParent(n, p);
+    if (u0 != -1) total += cost[order[p]*n + order[u0]];
+    if (u1 != -1) total += cost[order[p]*n + order[u1]];
+  }
+  return total;
+}
+
+static inline float ncclNodeOrderCost(int n, const float* cost, const int* order) {
+  return ncclNodeOrderRingCost(n, cost, order) + ncclNodeOrderTreeCost(n, cost, order);
+}
+
+// Compute order[position] = node from a complete cost matrix. The ring is built
+// greedily from node 0 and improved with 2-opt, then rotated and oriented to
+// minimize the tree cost. Rank order is kept unless the new order is cheaper by
+// NCCL_NODE_ORDER_MIN_GAIN. Returns true when the order differs from rank order.
+static inline bool ncclNodeOrderCompute(int n, const float* cost, int* order) {
+  for (int p=0; p<n; p++) order[p] = p;
+  if (n <= 2) return false;
+  int* ring = (int*)malloc(2*n*sizeof(int));
+  char* used = (char*)calloc(n, 1);
+  if (ring == NULL || used == NULL) {
+    free(ring);
+    free(used);
+    return false;
+  }
+  // Nearest neighbour, lowest index on ties
+  ring[0] = 0;
+  used[0] = 1;
+  for (int p=1; p<n; p++) {
+    int last = ring[p-1], next = -1;
+    for (int j=0; j<n; j++) {
+      if (used[j]) continue;
+      if (next == -1 || cost[last*n+j] < cost[last*n+next]) next = j;
+    }
+    ring[p] = next;
+    used[next] = 1;
+  }
+  // 2-opt: reverse ring[i+1..j] when it shortens the ring
+  for (int pass=0; pass<NCCL_NODE_ORDER_MAX_PASSES; pass++) {
+    bool improved = false;
+    for (int i=0; i<n-1; i++) {
+      for (int j=i+2; j<n; j++) {
+        int a = ring[i], b = ring[i+1], c = ring[j], d = ring[(j+1)%n];
+        if (a == d) continue;
+        float delta = cost[a*n+c] + cost[b*n+d] - cost[a*n+b] - cost[c*n+d];
+        if (delta < -1e-6f * (cost[a*n+b] + cost[c*n+d])) {
+          for (int lo=i+1, hi=j; lo<hi; lo++, hi--) {
+            int t = ring[lo];
+            ring[lo] = ring[hi];
+            ring[hi] = t;
+          }
+          improved = true;
+        }
+      }
+    }
+    if (!improved) break;
+  }
+  // Rotation and direction with the cheapest trees
+  int* candidate = ring+n;
+  float bestCost = -1;
+  int bestShift = 0, bestDir = 1;
+  for (int dir=1; dir>=-1; dir-=2) {
+    for (int shift=0; shift<n; shift++) {
+      for (int p=0; p<n; p++) candidate[p] = ring[((shift + dir*p) % n + n) % n];
+      float c = ncclNodeOrderTreeCost(n, cost, candidate);
+      if (bestCost < 0 || c < bestCost) {
+        bestCost = c;
+        bestShift = shift;
+        bestDir = dir;
+      }
+    }
+  }
+  for (int p=0; p<n; p++) candidate[p] = ring[((bestShift + bestDir*p) % n + n) % n];
+  float rankOrderCost = ncclNodeOrderCost(n, cost, order);
+  bool changed = false;
+  if (ncclNodeOrderCost(n, cost, candidate) < rankOrderCost * (1 - NCCL_NODE_ORDER_MIN_GAIN)) {
+    for (int p=0; p<n; p++) {
+      changed |= candidate[p] != p;
+      order[p] = candidate[p];
+    }
+  }
+  free(ring);
+  free(used);
+  return changed;
+}
+
+#endif
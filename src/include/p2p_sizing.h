@@ -0,0 +1,59 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_P2P_SIZING_H_
+#define NCCL_P2P_SIZING_H_
+
+#include <stdint.h>
+
+// Buffer sizing for send/recv connections. These only depend on their arguments
+// so they can be unit tested on hosts without a GPU.
+
+#define NCCL_P2P_MIN_CHUNKSIZE (1 << 15) /* 32 KiB */
+// Minimum number of slots per channel in the shared network buffer pool.
+#define NCCL_SHARED_STEPS 16
+// Minimum number of shared buffer slots each active peer should get per channel.
+#define NCCL_P2P_SHARED_MIN_DEPTH 2
+
+static inline int ncclP2pPow2Floor(int64_t v) {
+  int pow2 = 1;
+  while ((int64_t)pow2*2 <= v && pow2 < (1 << 30)) pow2 <<= 1;
+  return pow2;
+}
+
+// Shrink the P2P chunk size so that nPeers*nChannelsPerPeer send and receive
+// connections of nSteps chunks each fit into inflightBytes. The result is a power
+// of two, never larger than chunkSize, and never below NCCL_P2P_MIN_CHUNKSIZE
+// unless chunkSize already is. inflightBytes <= 0 disables the limit.
+static inline int ncclP2pComputeChunkSize(int chunkSize, int64_t inflightBytes, int nPeers, int nChannelsPerPeer, int nSteps) {
+  if (inflightBytes <= 0 || nPeers <= 0) return chunkSize;
+  if (nChannelsPerPeer < 1) nChannelsPerPeer = 1;
+  int64_t perChunk = inflightBytes / (2 * (int64_t)nPeers * nChannelsPerPeer * nSteps);
+  if (perChunk >= chunkSize) return chunkSize;
+  int sized = ncclP2pPow2Floor(perChunk);
+  int minChunk = chunkSize < NCCL_P2P_MIN_CHUNKSIZE ? chunkSize : NCCL_P2P_MIN_CHUNKSIZE;
+  return sized < minChunk ? minChunk : sized;
+}
+
+// Number of slots per channel in the shared network buffer pool. Each of the peers
+// expected to be active on a channel gets NCCL_P2P_SHARED_MIN_DEPTH slots, within
+// [minSteps, maxSteps]. Growing stops once the pool of one direction
+// (nChannels*steps*chunkSize) would exceed half of inflightBytes, or when slot
+// offsets would no longer fit in an int. inflightBytes <= 0 returns minSteps.
+static inline int ncclP2pComputeSharedSteps(int nActivePeers, int nChannelsPerPeer, int nChannels, int chunkSize,
+    int64_t inflightBytes, int minSteps, int maxSteps) {
+  if (inflightBytes <= 0) return minSteps;
+  if (nChannels < 1) nChannels = 1;
+  if (nChannelsPerPeer < 1) nChannelsPerPeer = 1;
+  int64_t perChannel = ((int64_t)nActivePeers * nChannelsPerPeer + nChannels - 1) / nChannels;
+  int64_t maxPool = inflightBytes / 2 < INT32_MAX ? inflightBytes / 2 : INT32_MAX;
+  int steps = minSteps;
+  while (steps*2 <= maxSteps && steps < perChannel * NCCL_P2P_SHARED_MIN_DEPTH &&
+         (int64_t)nChannels * steps * 2 * chunkSize <= maxPool) steps <<= 1;
+  return steps;
+}
+
+#endif
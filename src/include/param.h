@@ -9,10 +9,14 @@
 #define NCCL_PARAM_H_
 
 #include <stdint.h>
+#include "env_profile.h"
 
 const char* userHomeDir();
 void setEnvFile(const char* fileName);
 void initEnv();
+// Apply the conf file profile sections matching fp, each section at most once per process.
+// Params already read from a variable that a profile sets are read again on next use.
+void ncclApplyEnvProfiles(const struct rcclEnvFingerprint* fp);
 const char *ncclGetEnv(const char *name);
 
 void ncclLoadParam(char const* env, int64_t deftVal, int64_t uninitialized, int64_t* cache);
@@ -17,6 +17,8 @@
 #include <pthread.h>
 #include "shm.h"
 #include "p2p.h"
+#include "alloc.h"
+#include "proxy_batch.h"
 
 enum ncclProxyOpState { ncclProxyOpNone, ncclProxyOpReady, ncclProxyOpProgress };
 enum { proxyRecv=0, proxySend=1 };
@@ -81,6 +83,12 @@ struct ncclProxySubArgs {
   void* profilingEvents[NCCL_STEPS];
   void* recvRequestsCache[NCCL_STEPS];
   int recvRequestsSubCount;
+  // NET recv: steps in [flushed, received) wait for a coalesced GDR flush.
+  // flushNeeded and flushesInFlight are kept in the first sub of a group.
+  int flushNeeded;
+  int flushesInFlight;
+  void* flushPtr;
+  int flushSize;
 
 #if defined(ENABLE_NPKIT) && defined(ENABLE_NPKIT_EVENT_NET_SEND_ENTRY) && defined(ENABLE_NPKIT_EVENT_NET_SEND_EXIT)
   int npKitSizesFifo[NCCL_STEPS];
@@ -205,6 +213,9 @@ struct ncclProxyLocalPeer {
   int tpLocalRank;
   ncclProxyAsyncOp* asyncOps;
   int asyncOpCounter;
+  // Connections created by the Init ops of the batch being received
+  void** batchConns;
+  int batchIndex;
 };
 
 // Common response header for all proxyOps
@@ -233,6 +244,7 @@ struct ncclProxyState {
   int cudaDev;
   int p2pnChannels;
   int p2pChunkSize;
+  int p2pSharedSteps;
   int nChannels;
   int buffSizes[NCCL_NUM_PROTOCOLS];
   bool allocP2pNetLLBuffers;
@@ -262,6 +274,9 @@ struct ncclProxyState {
 
   // Queue of expected responses from the proxy
   struct ncclExpectedProxyResponse* expectedResponses;
+
+  // Memory allocated by the proxy service thread
+  struct ncclMemAccount memAccount;
 };
 
 enum proxyConnectState {
@@ -312,6 +327,7 @@ enum ncclProxyMsgType {
   ncclProxyMsgAbort = 7,
   ncclProxyMsgStop = 8,
   ncclProxyMsgGetFd = 9, // cuMem API support (UDS)
+  ncclProxyMsgBatch = 10,
 };
 
 // This function is called by a client of the proxy that needs to invoke any of the non-progress proxyOp types
@@ -323,6 +339,14 @@ ncclResult_t ncclProxyCallAsync(struct ncclComm* comm, struct ncclProxyConnector
 ncclResult_t ncclProxyCallBlocking(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize);
 ncclResult_t ncclPollProxyResponse(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, void* respBuff, void* opId);
 
+// Between ncclProxyBatchBegin() and ncclProxyBatchEnd(), ncclProxyConnect() and ncclProxyCallDeferred() only
+// queue their requests. ncclProxyBatchEnd() sends them as one ncclProxyMsgBatch message per proxy and waits
+// for all responses, so proxyConn and respBuff must stay valid until then. Any other call to a proxy sends
+// the queue first. Outside of a batch, ncclProxyCallDeferred() is ncclProxyCallBlocking().
+ncclResult_t ncclProxyBatchBegin(struct ncclComm* comm);
+ncclResult_t ncclProxyCallDeferred(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize);
+ncclResult_t ncclProxyBatchEnd(struct ncclComm* comm);
+
 // UDS support
 ncclResult_t ncclProxyClientGetFdBlocking(struct ncclComm* comm, int rank, void *handle, int* convertedFd);
 
@@ -0,0 +1,196 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_PROXY_BATCH_H_
+#define NCCL_PROXY_BATCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Client side queue of the proxy calls made between ncclProxyBatchBegin() and
+// ncclProxyBatchEnd(), and the wire format of the ncclProxyMsgBatch message carrying
+// them: the message type, a count, then each call as ncclProxyCallAsync() sends it
+// (type, connection, reqSize, respSize, request, opId). A call on a connector whose
+// Init is queued in the same batch names that Init by its position in the message,
+// as an odd connection value. These only use the C library so they can be unit
+// tested without a proxy.
+
+struct ncclProxyConnector;
+
+struct ncclProxyDeferredCall {
+  struct ncclProxyConnector* proxyConn;
+  int tpLocalRank;  // proxy the call goes to
+  void* connection; // proxyConn->connection when queued, NULL until its Init is answered
+  int type;
+  int reqSize, respSize;
+  char* reqBuff;    // copy of the request, owned by the queue
+  void* respBuff;   // caller's buffer, or owned by the queue for an Init
+  int isInit;
+  int pendingInit;  // index of the queued Init creating the connection, or -1
+  int batchIndex;   // position within the message to its proxy, -1 until packed
+  int transport, send; // Init only
+};
+
+struct ncclProxyBatch {
+  int active;
+  int count, size;
+  struct ncclProxyDeferredCall* calls;
+};
+
+enum ncclProxyBatchResult {
+  ncclProxyBatchOk = 0,
+  ncclProxyBatchNoMemory = 1,
+  ncclProxyBatchNotConnected = 2, // no connection and no queued Init for the connector
+};
+
+// Queue a call, copying reqBuff. The response of an Init goes to a buffer owned by the
+// queue; other responses are written to respBuff, which must stay valid until the flush.
+static inline int ncclProxyBatchPush(struct ncclProxyBatch* batch, struct ncclProxyConnector* proxyConn, int tpLocalRank,
+                                     void* connection, int type, int isInit, const void* reqBuff, int reqSize,
+                                     void* respBuff, int respSize, struct ncclProxyDeferredCall** call) {
+  int pendingInit = -1;
+  if (!isInit && connection == NULL) {
+    for (int i=batch->count-1; i>=0 && pendingInit == -1; i--) {
+      if (batch->calls[i].isInit && batch->calls[i].proxyConn == proxyConn) pendingInit = i;
+    }
+    if (pendingInit == -1) return ncclProxyBatchNotConnected;
+  }
+  if (batch->count == batch->size) {
+    int newSize = batch->size ? 2*batch->size : 64;
+    struct ncclProxyDeferredCall* calls = (struct ncclProxyDeferredCall*)realloc(batch->calls, newSize*sizeof(*calls));
+    if (calls == NULL) return ncclProxyBatchNoMemory;
+    batch->calls = calls;
+    batch->size = newSize;
+  }
+  struct ncclProxyDeferredCall* c = batch->calls+batch->count;
+  memset(c, 0, sizeof(*c));
+  c->proxyConn = proxyConn;
+  c->tpLocalRank = tpLocalRank;
+  c->connection = connection;
+  c->type = type;
+  c->reqSize = reqSize;
+  c->respSize = respSize;
+  c->respBuff = respBuff;
+  c->isInit = isInit;
+  c->pendingInit = pendingInit;
+  c->batchIndex = -1;
+  if (reqSize) {
+    if ((c->reqBuff = (char*)malloc(reqSize)) == NULL) return ncclProxyBatchNoMemory;
+    memcpy(c->reqBuff, reqBuff, reqSize);
+  }
+  if (isInit && (c->respBuff = calloc(1, respSize)) == NULL) {
+    free(c->reqBuff);
+    return ncclProxyBatchNoMemory;
+  }
+  batch->count++;
+  if (call) *call = c;
+  return ncclProxyBatchOk;
+}
+
+// Free what the first count calls own. Flushes take the calls off the queue before
+// waiting for their responses, so they pass the count they took.
+static inline void ncclProxyBatchRelease(struct ncclProxyBatch* batch, int count) {
+  for (int i=0; i<count; i++) {
+    free(batch->calls[i].reqBuff);
+    batch->calls[i].reqBuff = NULL;
+    if (batch->calls[i].isInit) free(batch->calls[i].respBuff);
+    batch->calls[i].respBuff = NULL;
+  }
+}
+
+// Drop the calls still queued and the queue itself, at teardown or after a failure.
+// Returns the number of calls dropped.
+static inline int ncclProxyBatchFree(struct ncclProxyBatch* batch) {
+  int dropped = batch->count;
+  if (batch->calls) ncclProxyBatchRelease(batch, batch->count);
+  free(batch->calls);
+  memset(batch, 0, sizeof(*batch));
+  return dropped;
+}
+
+// Connection value naming the Init at position index of the same message
+static inline void* ncclProxyBatchInitRef(int index) {
+  return (void*)(((uintptr_t)index << 1) | 1);
+}
+
+// Resolve a connection received in a batch against the connections created by the
+// first nInits calls of that batch. Returns 0 when it names an Init that is unknown.
+static inline int ncclProxyBatchResolve(void* connection, void* const* batchConns, int nInits, void** resolved) {
+  if (((uintptr_t)connection & 1) == 0) {
+    *resolved = connection;
+    return 1;
+  }
+  int index = (int)((uintptr_t)connection >> 1);
+  if (index >= nInits || batchConns[index] == NULL) return 0;
+  *resolved = batchConns[index];
+  return 1;
+}
+
+static inline size_t ncclProxyBatchEntrySize(int reqSize) {
+  return 3*sizeof(int) + 2*sizeof(void*) + reqSize;
+}
+
+// Read and drop the next nEntries calls of a batch message with recv(buf, size), so
+// that the stream stays in sync when the proxy gives up on a batch. Returns the first
+// error of recv.
+template<typename Recv>
+static inline auto ncclProxyBatchSkip(int nEntries, Recv recv) -> decltype(recv((void*)0, 0)) {
+  typedef decltype(recv((void*)0, 0)) Ret;
+  char buf[256];
+  for (int i=0; i<nEntries; i++) {
+    int type, reqSize, respSize;
+    void *connection, *opId;
+    Ret ret;
+    if ((ret = recv(&type, sizeof(int))) != Ret()) return ret;
+    if ((ret = recv(&connection, sizeof(void*))) != Ret()) return ret;
+    if ((ret = recv(&reqSize, sizeof(int))) != Ret()) return ret;
+    if ((ret = recv(&respSize, sizeof(int))) != Ret()) return ret;
+    for (int offset=0; offset<reqSize; offset+=sizeof(buf)) {
+      int size = reqSize-offset < (int)sizeof(buf) ? reqSize-offset : (int)sizeof(buf);
+      if ((ret = recv(buf, size)) != Ret()) return ret;
+    }
+    if ((ret = recv(&opId, sizeof(void*))) != Ret()) return ret;
+  }
+  return Ret();
+}
+
+// Pack the message to the proxy of calls[first], the first call not packed yet: every
+// call to that proxy, in queue order. Without msg, only returns the size and numbers
+// the calls; pack with msg afterwards. opIds are the addresses of the calls.
+static inline size_t ncclProxyBatchPack(struct ncclProxyBatch* batch, int count, int first, int batchType, char* msg, int* nCalls) {
+  int tpLocalRank = batch->calls[first].tpLocalRank;
+  size_t size = 2*sizeof(int);
+  int n = 0;
+  char* ptr = msg ? msg + size : NULL;
+  for (int i=first; i<count; i++) {
+    struct ncclProxyDeferredCall* c = batch->calls+i;
+    if (c->tpLocalRank != tpLocalRank) continue;
+    n++;
+    if (msg == NULL) {
+      c->batchIndex = n-1;
+      size += ncclProxyBatchEntrySize(c->reqSize);
+      continue;
+    }
+    void* connection = c->pendingInit == -1 ? c->connection : ncclProxyBatchInitRef(batch->calls[c->pendingInit].batchIndex);
+    void* opId = c;
+    memcpy(ptr, &c->type, sizeof(int)); ptr += sizeof(int);
+    memcpy(ptr, &connection, sizeof(void*)); ptr += sizeof(void*);
+    memcpy(ptr, &c->reqSize, sizeof(int)); ptr += sizeof(int);
+    memcpy(ptr, &c->respSize, sizeof(int)); ptr += sizeof(int);
+    if (c->reqSize) { memcpy(ptr, c->reqBuff, c->reqSize); ptr += c->reqSize; }
+    memcpy(ptr, &opId, sizeof(void*)); ptr += sizeof(void*);
+  }
+  if (msg) {
+    memcpy(msg, &batchType, sizeof(int));
+    memcpy(msg+sizeof(int), &n, sizeof(int));
+    size = ptr - msg;
+  }
+  if (nCalls) *nCalls = n;
+  return size;
+}
+
+#endif
@@ -0,0 +1,168 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_PTR_CACHE_H_
+#define NCCL_PTR_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+
+// Cache of known allocation ranges used by pointer validation. Lookups are lock-free:
+// entries are kept sorted by base address and protected by a sequence counter, readers
+// retry when a writer was active. Inserts and erases are serialized by a mutex.
+// Only valid ranges are cached; a pointer that fails the query is checked again
+// next time and the stale range that contained it, if any, is expired.
+//
+// Memory freed outside of NCCL is not seen by the cache. Ranges found by a query are
+// therefore only trusted within the epoch they were validated in: on a hit from an
+// older epoch the pointer is queried again, and its allocation base and size replace
+// the cached range, or expire it when the pointer is no longer valid. Ranges NCCL
+// allocates or registers itself are erased when they are freed or deregistered and
+// are trusted until then.
+
+#define NCCL_PTR_CACHE_SIZE 1024
+
+// Epoch of the ranges allocated or registered by NCCL
+#define NCCL_PTR_CACHE_OWNED UINT64_MAX
+
+// Returns 0 and the allocation range and device (-1 for host memory) containing ptr,
+// non-zero when ptr is not a valid pointer.
+typedef int (*ncclPtrQuery_t)(const void* ptr, uintptr_t* base, size_t* size, int* dev);
+
+struct ncclPtrCacheEntry {
+  std::atomic<uintptr_t> base;
+  std::atomic<uintptr_t> end;
+  std::atomic<int> dev;
+  std::atomic<uint64_t> epoch;
+};
+
+struct ncclPtrCache {
+  std::atomic<uint64_t> seq;
+  std::atomic<uint64_t> checks;
+  std::atomic<int> count;
+  std::mutex lock;
+  struct ncclPtrCacheEntry entries[NCCL_PTR_CACHE_SIZE];
+};
+
+static inline bool ncclPtrCacheFind(struct ncclPtrCache* cache, uintptr_t addr, int* dev, uint64_t* epoch) {
+  while (true) {
+    uint64_t seq = cache->seq.load(std::memory_order_acquire);
+    if (seq & 1) continue;
+    int lo = 0, hi = cache->count.load(std::memory_order_relaxed) - 1;
+    bool found = false;
+    int foundDev = -1;
+    uint64_t foundEpoch = 0;
+    while (lo <= hi) {
+      int mid = (lo + hi) / 2;
+      uintptr_t base = cache->entries[mid].base.load(std::memory_order_relaxed);
+      if (addr < base) { hi = mid - 1; continue; }
+      if (addr >= cache->entries[mid].end.load(std::memory_order_relaxed)) { lo = mid + 1; continue; }
+      foundDev = cache->entries[mid].dev.load(std::memory_order_relaxed);
+      foundEpoch = cache->entries[mid].epoch.load(std::memory_order_relaxed);
+      found = true;
+      break;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (cache->seq.load(std::memory_order_relaxed) != seq) continue;
+    if (found) {
+      *dev = foundDev;
+      *epoch = foundEpoch;
+    }
+    return found;
+  }
+}
+
+// Must be called with cache->lock held.
+static inline void ncclPtrCacheRemoveLocked(struct ncclPtrCache* cache, int index) {
+  int count = cache->count.load(std::memory_order_relaxed);
+  for (int i = index; i < count - 1; i++) {
+    cache->entries[i].base.store(cache->entries[i+1].base.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[i].end.store(cache->entries[i+1].end.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[i].dev.store(cache->entries[i+1].dev.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[i].epoch.store(cache->entries[i+1].epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+  cache->count.store(count - 1, std::memory_order_relaxed);
+}
+
+static inline void ncclPtrCacheWriteBegin(struct ncclPtrCache* cache) {
+  cache->seq.store(cache->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+static inline void ncclPtrCacheWriteEnd(struct ncclPtrCache* cache) {
+  cache->seq.store(cache->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Record [base, base+size) as valid memory of device dev, validated in epoch.
+// Overlapping ranges are replaced since the memory they described has been freed.
+// When the cache is full it is emptied and refilled on demand.
+static inline void ncclPtrCacheInsert(struct ncclPtrCache* cache, const void* ptr, size_t size, int dev, uint64_t epoch) {
+  uintptr_t base = (uintptr_t)ptr, end = base + (size ? size : 1);
+  std::lock_guard<std::mutex> guard(cache->lock);
+  ncclPtrCacheWriteBegin(cache);
+  int count = cache->count.load(std::memory_order_relaxed);
+  for (int i = count - 1; i >= 0; i--) {
+    if (cache->entries[i].base.load(std::memory_order_relaxed) < end &&
+        base < cache->entries[i].end.load(std::memory_order_relaxed)) ncclPtrCacheRemoveLocked(cache, i);
+  }
+  count = cache->count.load(std::memory_order_relaxed);
+  if (count == NCCL_PTR_CACHE_SIZE) count = 0;
+  int index = count;
+  while (index > 0 && cache->entries[index-1].base.load(std::memory_order_relaxed) > base) {
+    cache->entries[index].base.store(cache->entries[index-1].base.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[index].end.store(cache->entries[index-1].end.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[index].dev.store(cache->entries[index-1].dev.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    cache->entries[index].epoch.store(cache->entries[index-1].epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    index--;
+  }
+  cache->entries[index].base.store(base, std::memory_order_relaxed);
+  cache->entries[index].end.store(end, std::memory_order_relaxed);
+  cache->entries[index].dev.store(dev, std::memory_order_relaxed);
+  cache->entries[index].epoch.store(epoch, std::memory_order_relaxed);
+  cache->count.store(count + 1, std::memory_order_relaxed);
+  ncclPtrCacheWriteEnd(cache);
+}
+
+// Forget the ranges overlapping [ptr, ptr+size), e.g. when it is freed or deregistered.
+static inline void ncclPtrCacheErase(struct ncclPtrCache* cache, const void* ptr, size_t size) {
+  uintptr_t base = (uintptr_t)ptr, end = base + (size ? size : 1);
+  std::lock_guard<std::mutex> guard(cache->lock);
+  ncclPtrCacheWriteBegin(cache);
+  int count = cache->count.load(std::memory_order_relaxed);
+  for (int i = count - 1; i >= 0; i--) {
+    if (cache->entries[i].base.load(std::memory_order_relaxed) < end &&
+        base < cache->entries[i].end.load(std::memory_order_relaxed)) ncclPtrCacheRemoveLocked(cache, i);
+  }
+  ncclPtrCacheWriteEnd(cache);
+}
+
+// Epoch of a new check: it advances every interval checks, or at every check for 0,
+// which leaves only the ranges owned by NCCL cached.
+static inline uint64_t ncclPtrCacheNextEpoch(struct ncclPtrCache* cache, uint64_t interval) {
+  uint64_t n = cache->checks.fetch_add(1, std::memory_order_relaxed);
+  return interval ? n / interval : n;
+}
+
+// Returns 0 and the device of ptr (-1 for host memory) if it is valid, the query
+// result otherwise. A cached range is trusted if NCCL owns it or it was validated in
+// this epoch, and it is memory of expectedDev or host memory: any other device may be
+// a range freed outside of NCCL and reused. Otherwise ptr is queried again, and its
+// range is refreshed if ptr is valid and expired if not.
+static inline int ncclPtrCacheCheck(struct ncclPtrCache* cache, const void* ptr, ncclPtrQuery_t query, int expectedDev, uint64_t epoch, int* dev) {
+  uint64_t cachedEpoch;
+  bool cached = ncclPtrCacheFind(cache, (uintptr_t)ptr, dev, &cachedEpoch);
+  if (cached && (cachedEpoch == NCCL_PTR_CACHE_OWNED || cachedEpoch == epoch) && (*dev == expectedDev || *dev == -1)) return 0;
+  uintptr_t base;
+  size_t size;
+  int ret = query(ptr, &base, &size, dev);
+  if (ret == 0) ncclPtrCacheInsert(cache, (const void*)base, size, *dev, epoch);
+  else if (cached) ncclPtrCacheErase(cache, ptr, 1);
+  return ret;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_REDUCE_ACC_H_
+#define NCCL_REDUCE_ACC_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Host reference of one reduce step of a sum on half or bfloat16, with partial
+// sums rounded to the element type after every source (the default) or carried
+// in fp32 and rounded once (RCCL_REDUCE_ACC_FP32). A step reduces its sources in
+// order, the first nPreOp of them being multiplied by scale first (ncclAvg).
+// Conversions round to nearest even like __float2half and hip_bfloat16, so the
+// results are bit exact with the kernels.
+
+enum ncclReduceAccType {
+  ncclReduceAccHalf = 0,
+  ncclReduceAccBfloat16 = 1
+};
+
+static inline float ncclReduceAccBitsToFloat(uint32_t u) {
+  float f;
+  memcpy(&f, &u, sizeof(f));
+  return f;
+}
+
+static inline uint32_t ncclReduceAccFloatToBits(float f) {
+  uint32_t u;
+  memcpy(&u, &f, sizeof(u));
+  return u;
+}
+
+static inline float ncclReduceAccBf16ToFloat(uint16_t x) {
+  return ncclReduceAccBitsToFloat((uint32_t)x << 16);
+}
+
+static inline uint16_t ncclReduceAccFloatToBf16(float f) {
+  uint32_t u = ncclReduceAccFloatToBits(f);
+  if ((u & 0x7f800000) != 0x7f800000) {
+    u += 0x7fff + ((u >> 16) & 1);
+  } else if (u & 0xffff) {
+    // Keep NaNs that only have low mantissa bits
+    u |= 0x10000;
+  }
+  return (uint16_t)(u >> 16);
+}
+
+static inline float ncclReduceAccHalfToFloat(uint16_t x) {
+  uint32_t sign = (uint32_t)(x & 0x8000) << 16, exp = (x >> 10) & 0x1f, man = x & 0x3ff;
+  if (exp == 0x1f) return ncclReduceAccBitsToFloat(sign | 0x7f800000 | (man << 13));
+  if (exp == 0) {
+    // Subnormal, man * 2^-24
+    float f = (float)man * ncclReduceAccBitsToFloat(0x33800000);
+    return sign ? -f : f;
+  }
+  return ncclReduceAccBitsToFloat(sign | ((exp + 112) << 23) | (man << 13));
+}
+
+static inline uint16_t ncclReduceAccFloatToHalf(float f) {
+  uint32_t u = ncclReduceAccFloatToBits(f);
+  uint16_t sign = (uint16_t)((u >> 16) & 0x8000);
+  uint32_t abs = u & 0x7fffffff;
+  if (abs >= 0x7f800000) return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  // 65520 and above round to infinity
+  if (abs >= 0x477ff000) return sign | 0x7c00;
+  int exp = (int)(abs >> 23) - 127;
+  uint32_t man = (abs & 0x7fffff) | 0x800000;
+  // Bits dropped below the 10 bits of mantissa, more for subnormals
+  int shift = exp >= -14 ? 13 : 13 + (-14 - exp);
+  if (shift > 24) return sign;
+  uint32_t half = man >> shift, rem = man & ((1u << shift) - 1), mid = 1u << (shift - 1);
+  if (rem > mid || (rem == mid && (half & 1))) half++;
+  // The implicit bit (or a subnormal rounding up) carries into the exponent
+  if (exp >= -14) half += (uint32_t)(exp + 14) << 10;
+  return sign | (uint16_t)half;
+}
+
+static inline float ncclReduceAccToFloat(int type, uint16_t x) {
+  return type == ncclReduceAccBfloat16 ? ncclReduceAccBf16ToFloat(x) : ncclReduceAccHalfToFloat(x);
+}
+
+static inline uint16_t ncclReduceAccFromFloat(int type, float f) {
+  return type == ncclReduceAccBfloat16 ? ncclReduceAccFloatToBf16(f) : ncclReduceAccFloatToHalf(f);
+}
+
+// Sum of nSrcs elements in the order of the kernels. scale is the ncclAvg scalar
+// as an element of type, converted to float.
+static inline uint16_t ncclReduceAccStep(int type, int nSrcs, const uint16_t* srcs, int nPreOp, float scale, bool fp32) {
+  float acc = 0;
+  uint16_t elt = 0;
+  for (int s=0; s<nSrcs; s++) {
+    float x = ncclReduceAccToFloat(type, srcs[s]);
+    // Products of two elements are exact in fp32
+    if (s < nPreOp) x = fp32 ? x*scale : ncclReduceAccToFloat(type, ncclReduceAccFromFloat(type, x*scale));
+    if (fp32) {
+      acc = s == 0 ? x : acc + x;
+    } else {
+      elt = ncclReduceAccFromFloat(type, s == 0 ? x : ncclReduceAccToFloat(type, elt) + x);
+    }
+  }
+  return fp32 ? ncclReduceAccFromFloat(type, acc) : elt;
+}
+
+#endif
@@ -17,8 +17,8 @@
 
 #define MAX_IFS 16
 #define MAX_IF_NAME_SIZE 16
-#define SLEEP_INT            1000 // connection retry sleep interval in usec
-#define RETRY_REFUSED_TIMES   2e4 // connection refused retry times before reporting a timeout (20 sec)
+#define SLEEP_INT            1000 // initial connection retry sleep interval in usec
+#define RETRY_REFUSED_TIMES   2e4 // connection refused retries are given RETRY_REFUSED_TIMES*SLEEP_INT usec of backoff (20 sec)
 #define RETRY_TIMEDOUT_TIMES    3 // connection timed out retry times (each one can take 20s)
 #define SOCKET_NAME_MAXLEN (NI_MAXHOST+NI_MAXSERV)
 #define NCCL_SOCKET_MAGIC 0x564ab9f2fc4b9d6cULL
@@ -57,6 +57,9 @@ struct ncclSocket {
   int acceptFd;
   int timedOutRetries;
   int refusedRetries;
+  uint64_t retrySleptUs;   // Total backoff for this connect
+  uint64_t retryAtNs;      // Async sockets: next connect attempt
+  uint64_t connectStartNs;
   union ncclSocketAddress addr;
   volatile uint32_t* abortFlag;
   int asyncFlag;
@@ -70,6 +73,8 @@ const char *ncclSocketToString(union ncclSocketAddress *addr, char *buf, const i
 ncclResult_t ncclSocketGetAddrFromString(union ncclSocketAddress* ua, const char* ip_port_pair);
 int ncclFindInterfaceMatchSubnet(char* ifNames, union ncclSocketAddress* localAddrs, union ncclSocketAddress* remoteAddr, int ifNameMaxSize, int maxIfs);
 int ncclFindInterfaces(char* ifNames, union ncclSocketAddress *ifAddrs, int ifNameMaxSize, int maxIfs);
+// Make the next ncclFindInterfaces scan the interfaces again
+void ncclSocketResetInterfaceCache();
 
 // Initialize a socket
 ncclResult_t ncclSocketInit(struct ncclSocket* sock, union ncclSocketAddress* addr = NULL, uint64_t magic = NCCL_SOCKET_MAGIC, enum ncclSocketType type = ncclSocketTypeUnknown, volatile uint32_t* abortFlag = NULL, int asyncFlag = 0);
@@ -94,4 +99,14 @@ ncclResult_t ncclSocketSend(struct ncclSocket* sock, void* ptr, int size);
 ncclResult_t ncclSocketRecv(struct ncclSocket* sock, void* ptr, int size);
 ncclResult_t ncclSocketTryRecv(struct ncclSocket* sock, void* ptr, int size, int* closed, bool blocking);
 ncclResult_t ncclSocketClose(struct ncclSocket* sock);
+
+// Process-wide connect counters
+struct ncclSocketStats {
+  uint64_t connects;
+  uint64_t refusedRetries;
+  uint64_t timedOutRetries;
+  uint64_t backoffUs;
+  uint64_t maxConnectUs;
+};
+void ncclSocketGetStats(struct ncclSocketStats* stats);
 #endif
@@ -0,0 +1,425 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_STEP_SIM_H_
+#define NCCL_STEP_SIM_H_
+
+#include <stdint.h>
+#include <math.h>
+#include <map>
+#include <queue>
+#include <vector>
+
+// Step-level discrete-event simulation of the ring, tree and collnet chain
+// schedules of the device code (all_reduce.h, all_gather.h, reduce_scatter.h,
+// sendrecv.h).
+//
+// Every thread group of every rank and channel runs the same sequence of
+// primitives as the kernel. Each primitive moves its data in slices of
+// sliceSteps buffer steps; a slice can start once the data it receives has
+// arrived and the receiver of its send has freed enough of its NCCL_STEPS
+// slots. Data crosses links which are serialized per link id, so channels
+// sharing a NIC compete for it. Host-only and dependency free, so it can be
+// driven by topo_expl and unit tested without a GPU.
+
+// Same order as NCCL_PROTO_* and NCCL_ALGO_*
+enum ncclSimProto { ncclSimProtoLL = 0, ncclSimProtoLL128 = 1, ncclSimProtoSimple = 2 };
+enum ncclSimAlgo { ncclSimAlgoTree = 0, ncclSimAlgoRing = 1, ncclSimAlgoCollNetChain = 3 };
+enum ncclSimColl { ncclSimAllReduce, ncclSimAllGather, ncclSimReduceScatter, ncclSimSendRecv };
+
+struct ncclSimLink {
+  int id;        // Links with the same id share their bandwidth
+  double bw;     // GB/s, i.e. bytes per ns
+  double latUs;  // Latency from the end of a transfer to its arrival
+  bool net;      // Data goes through the proxy
+};
+
+// Describe the link used by channel to send from rank src to rank dst. dst is
+// nRanks for the CollNet network, src is nRanks for data coming back from it.
+typedef void (*ncclSimLinkFn_t)(void* ctx, int channel, int src, int dst, struct ncclSimLink* link);
+
+struct ncclSimParams {
+  enum ncclSimColl coll;
+  enum ncclSimAlgo algorithm;
+  enum ncclSimProto protocol;
+  int nRanks;
+  int nChannels;
+  int64_t nBytes;     // Bytes of the operation as in ncclInfo::nBytes
+  int chunkSize;      // Data bytes per primitive call, as computed at enqueue time
+  int stepSize;       // Bytes of one buffer step, buffSizes[protocol]/NCCL_STEPS
+  int chunkSteps;
+  int sliceSteps;
+  int nSteps;         // NCCL_STEPS
+  double stepLatUs;   // GPU time to wait for and post one slice
+  double proxyLatUs;  // Proxy overhead added to every slice sent over a net link
+  double launchUs;    // Kernel launch and work fetch
+
+  // Per channel topology: ring order [nChannels][nRanks], or tree/chain
+  // parent [nChannels][nRanks] and children [nChannels][nRanks][3], -1 for none.
+  // CollNet chain heads have nRanks as parent. ncclSimSendRecv sends from the
+  // first to the second rank of each ring, one chunk per step.
+  const int* rings;
+  const int* treeUp;
+  const int* treeDn;
+
+  ncclSimLinkFn_t linkFn;
+  void* linkCtx;
+};
+
+struct ncclSimLinkStats {
+  int id;
+  double bw;
+  int64_t bytes;   // Bytes on the wire, including LL/LL128 flags
+  double busyUs;
+  double util;     // busyUs over the simulated time
+};
+
+struct ncclSimResult {
+  double timeUs;
+  int64_t nSlices;
+  std::vector<struct ncclSimLinkStats> links;
+};
+
+#define NCCL_SIM_MAX_ARITY 3
+
+// Bytes on the wire for nBytes of data
+static inline double ncclSimWireBytes(enum ncclSimProto protocol, int64_t nBytes) {
+  if (protocol == ncclSimProtoLL) return 2.0*nBytes;              // 8 bytes of flags for 8 bytes of data
+  if (protocol == ncclSimProtoLL128) return nBytes*16.0/15.0;     // 1 flag element per 16 in a 128 byte line
+  return (double)nBytes;
+}
+
+struct ncclSimOp {
+  int nRecv, nSend;
+  int recv[NCCL_SIM_MAX_ARITY+1];
+  int send[NCCL_SIM_MAX_ARITY+1];
+  int64_t bytes;
+};
+
+struct ncclSimConn {
+  int link;              // Index in ncclSimState::links
+  double latUs;          // Link latency, plus the proxy overhead for net links
+  int sender, receiver;  // Agents
+  std::vector<double> arrival;   // Per slice, when the data is in the receive buffer
+  std::vector<double> consumed;  // Per slice, when the receiver freed its slots
+};
+
+// One thread group of one rank on one channel
+struct ncclSimAgent {
+  std::vector<struct ncclSimOp> ops;
+  size_t op;
+  int slice;
+  double time;
+  bool queued;
+};
+
+struct ncclSimState {
+  const struct ncclSimParams* params;
+  int slicesPerChunk;
+  int sliceBytes;
+  int depth;  // Slices in flight per connection
+  std::vector<struct ncclSimAgent> agents;
+  std::vector<struct ncclSimConn> conns;
+  std::vector<struct ncclSimLinkStats> links;
+  std::vector<double> linkFree;
+  std::map<int, int> linkIndex;
+  std::map<int64_t, int> connIndex;
+};
+
+static inline int ncclSimConnGet(struct ncclSimState* s, int channel, int group, int src, int dst) {
+  const struct ncclSimParams* p = s->params;
+  int64_t key = (((int64_t)channel*2 + group)*(p->nRanks+1) + src)*(p->nRanks+1) + dst;
+  auto it = s->connIndex.find(key);
+  if (it != s->connIndex.end()) return it->second;
+  struct ncclSimLink link = { -1, 1.0, 0.0, false };
+  p->linkFn(p->linkCtx, channel, src, dst, &link);
+  auto lit = s->linkIndex.find(link.id);
+  int l;
+  if (lit == s->linkIndex.end()) {
+    l = s->links.size();
+    s->linkIndex[link.id] = l;
+    s->links.push_back({ link.id, link.bw, 0, 0.0, 0.0 });
+    s->linkFree.push_back(0.0);
+  } else {
+    l = lit->second;
+  }
+  struct ncclSimConn conn;
+  conn.link = l;
+  conn.latUs = link.latUs + (link.net ? p->proxyLatUs : 0);
+  conn.sender = conn.receiver = -1;
+  s->conns.push_back(conn);
+  int c = s->conns.size()-1;
+  s->connIndex[key] = c;
+  return c;
+}
+
+static inline int ncclSimAgentNew(struct ncclSimState* s) {
+  struct ncclSimAgent agent;
+  agent.op = 0;
+  agent.slice = 0;
+  agent.time = 0;
+  agent.queued = false;
+  s->agents.push_back(agent);
+  return s->agents.size()-1;
+}
+
+static inline void ncclSimAddOp(struct ncclSimState* s, int agent, int64_t bytes,
+    int nRecv, const int* recv, int nSend, const int* send) {
+  struct ncclSimOp op;
+  op.nRecv = nRecv;
+  op.nSend = nSend;
+  for (int i=0; i<nRecv; i++) {
+    op.recv[i] = recv[i];
+    s->conns[recv[i]].receiver = agent;
+  }
+  for (int i=0; i<nSend; i++) {
+    op.send[i] = send[i];
+    s->conns[send[i]].sender = agent;
+  }
+  op.bytes = bytes < 0 ? 0 : bytes;
+  s->agents[agent].ops.push_back(op);
+}
+
+static inline int64_t ncclSimMin(int64_t a, int64_t b) { return a < b ? a : b; }
+static inline int64_t ncclSimDivUp(int64_t a, int64_t b) { return (a + b - 1) / b; }
+
+// Bytes handled by a channel when nBytes is split evenly, as the enqueue code does
+static inline int64_t ncclSimChannelBytes(int64_t nBytes, int nChannels, int channel) {
+  int64_t perChannel = ncclSimDivUp(nBytes, nChannels);
+  int64_t start = perChannel*channel;
+  return start >= nBytes ? 0 : ncclSimMin(perChannel, nBytes - start);
+}
+
+static inline void ncclSimBuildRing(struct ncclSimState* s, int c) {
+  const struct ncclSimParams* p = s->params;
+  int nranks = p->nRanks;
+  const int* ring = p->rings + c*nranks;
+  int64_t perRank = p->coll == ncclSimAllReduce ? p->nBytes : p->nBytes / nranks;
+  int64_t channelBytes = ncclSimChannelBytes(perRank, p->nChannels, c);
+  int64_t chunk = p->chunkSize;
+  for (int ix=0; ix<nranks; ix++) {
+    int rank = ring[ix];
+    int prev = ring[(ix+nranks-1)%nranks], next = ring[(ix+1)%nranks];
+    int a = ncclSimAgentNew(s);
+    int recv = ncclSimConnGet(s, c, 0, prev, rank);
+    int send = ncclSimConnGet(s, c, 0, rank, next);
+    if (p->coll != ncclSimAllReduce) {
+      // send, nranks-2 x recv(Reduce)CopySend, recv(ReduceCopy)
+      for (int64_t off = 0; off < channelBytes; off += chunk) {
+        int64_t nelem = ncclSimMin(chunk, channelBytes - off);
+        ncclSimAddOp(s, a, nelem, 0, NULL, 1, &send);
+        for (int j=1; j<nranks-1; j++) ncclSimAddOp(s, a, nelem, 1, &recv, 1, &send);
+        ncclSimAddOp(s, a, nelem, 1, &recv, 0, NULL);
+      }
+      continue;
+    }
+    // runRing in all_reduce.h
+    int64_t loop = nranks*chunk;
+    for (int64_t off = 0; off < channelBytes; off += loop) {
+      int64_t rem = channelBytes - off;
+      int64_t chunkBytes = rem < loop ? ncclSimDivUp(rem, nranks) : chunk;
+      auto nelem = [&](int chunkIdx) { return ncclSimMin(chunkBytes, rem - chunkIdx*chunkBytes); };
+      ncclSimAddOp(s, a, nelem((ix+nranks-1)%nranks), 0, NULL, 1, &send);
+      for (int j=2; j<nranks; j++) ncclSimAddOp(s, a, nelem((ix+nranks-j)%nranks), 1, &recv, 1, &send);
+      ncclSimAddOp(s, a, nelem(ix), 1, &recv, 1, &send);
+      for (int j=1; j<nranks-1; j++) ncclSimAddOp(s, a, nelem((ix+nranks-j)%nranks), 1, &recv, 1, &send);
+      ncclSimAddOp(s, a, nelem((ix+1)%nranks), 1, &recv, 0, NULL);
+    }
+  }
+}
+
+static inline void ncclSimBuildP2p(struct ncclSimState* s, int c) {
+  const struct ncclSimParams* p = s->params;
+  int src = p->rings[c*p->nRanks], dst = p->rings[c*p->nRanks+1];
+  int64_t channelBytes = ncclSimChannelBytes(p->nBytes, p->nChannels, c);
+  int conn = ncclSimConnGet(s, c, 0, src, dst);
+  int sender = ncclSimAgentNew(s);
+  int receiver = ncclSimAgentNew(s);
+  for (int64_t off = 0; off < channelBytes; off += p->chunkSize) {
+    int64_t nelem = ncclSimMin(p->chunkSize, channelBytes - off);
+    ncclSimAddOp(s, sender, nelem, 0, NULL, 1, &conn);
+    ncclSimAddOp(s, receiver, nelem, 1, &conn, 0, NULL);
+  }
+}
+
+// runTreeUpDown (Simple), runTreeSplit (LL/LL128) and the CollNet chain of all_reduce.h
+static inline void ncclSimBuildTree(struct ncclSimState* s, int c) {
+  const struct ncclSimParams* p = s->params;
+  int nranks = p->nRanks;
+  bool chain = p->algorithm == ncclSimAlgoCollNetChain;
+  bool split = chain || p->protocol != ncclSimProtoSimple;
+  int64_t channelBytes = 0;
+  std::vector<int64_t> pieces;
+  if (chain) {
+    // Chunks are dealt to channels round robin
+    for (int64_t off = (int64_t)c*p->chunkSize; off < p->nBytes; off += (int64_t)p->nChannels*p->chunkSize)
+      pieces.push_back(ncclSimMin(p->chunkSize, p->nBytes - off));
+  } else {
+    channelBytes = ncclSimChannelBytes(p->nBytes, p->nChannels, c);
+    for (int64_t off = 0; off < channelBytes; off += p->chunkSize) pieces.push_back(ncclSimMin(p->chunkSize, channelBytes - off));
+  }
+
+  // Reduce goes through group 0 connections, broadcast through group 1
+  for (int rank=0; rank<nranks; rank++) {
+    int up = p->treeUp[c*nranks+rank];
+    int upC[1] = { -1 }, upDnC[1] = { -1 }, dnUpC[NCCL_SIM_MAX_ARITY], dnC[NCCL_SIM_MAX_ARITY];
+    int nDn = 0;
+    for (int i=0; i<NCCL_SIM_MAX_ARITY; i++) {
+      int d = p->treeDn[(c*nranks+rank)*NCCL_SIM_MAX_ARITY+i];
+      if (d < 0) continue;
+      dnUpC[nDn] = ncclSimConnGet(s, c, 0, d, rank);
+      dnC[nDn] = ncclSimConnGet(s, c, 1, rank, d);
+      nDn++;
+    }
+    int nUp = 0;
+    if (up >= 0) {
+      upC[0] = ncclSimConnGet(s, c, 0, rank, up);
+      upDnC[0] = ncclSimConnGet(s, c, 1, up, rank);
+      nUp = 1;
+    }
+    if (!split) {
+      int a = ncclSimAgentNew(s);
+      for (int64_t b : pieces) ncclSimAddOp(s, a, b, nDn, dnUpC, nUp, upC);
+      for (int64_t b : pieces) ncclSimAddOp(s, a, b, nUp, upDnC, nDn, dnC);
+    } else if (nUp == 0) {
+      // Root reduces and broadcasts in one pass
+      int a = ncclSimAgentNew(s);
+      for (int64_t b : pieces) ncclSimAddOp(s, a, b, nDn, dnUpC, nDn, dnC);
+    } else {
+      int reduce = ncclSimAgentNew(s);
+      int bcast = ncclSimAgentNew(s);
+      for (int64_t b : pieces) ncclSimAddOp(s, reduce, b, nDn, dnUpC, nUp, upC);
+      for (int64_t b : pieces) ncclSimAddOp(s, bcast, b, nUp, upDnC, nDn, dnC);
+    }
+  }
+
+  if (chain) {
+    // The network reduces the contributions of all chain heads and returns the result
+    std::vector<int> in, out;
+    for (int rank=0; rank<nranks; rank++) {
+      if (p->treeUp[c*nranks+rank] != nranks) continue;
+      in.push_back(ncclSimConnGet(s, c, 0, rank, nranks));
+      out.push_back(ncclSimConnGet(s, c, 1, nranks, rank));
+    }
+    if (in.size() == 0) return;
+    int a = ncclSimAgentNew(s);
+    for (size_t i = 0; i < in.size(); i += NCCL_SIM_MAX_ARITY+1) {
+      // Ops have a bounded fan, use one network agent per group of heads
+      if (i) a = ncclSimAgentNew(s);
+      int n = (int)ncclSimMin(NCCL_SIM_MAX_ARITY+1, in.size()-i);
+      for (int64_t b : pieces) ncclSimAddOp(s, a, b, n, in.data()+i, n, out.data()+i);
+    }
+  }
+}
+
+// Earliest time the next slice of an agent can start, or -1 if it is waiting
+// for a slice that has not been simulated yet.
+static inline double ncclSimReady(struct ncclSimState* s, struct ncclSimAgent* agent) {
+  if (agent->op == agent->ops.size()) return -1;
+  struct ncclSimOp* op = &agent->ops[agent->op];
+  double t = agent->time;
+  for (int i=0; i<op->nRecv; i++) {
+    struct ncclSimConn* conn = &s->conns[op->recv[i]];
+    size_t idx = conn->consumed.size();
+    if (conn->arrival.size() <= idx) return -1;
+    t = fmax(t, conn->arrival[idx]);
+  }
+  for (int i=0; i<op->nSend; i++) {
+    struct ncclSimConn* conn = &s->conns[op->send[i]];
+    size_t idx = conn->arrival.size();
+    if (idx >= (size_t)s->depth) {
+      // The freed slots are signalled back over the same link
+      if (conn->consumed.size() <= idx - s->depth) return -1;
+      t = fmax(t, conn->consumed[idx - s->depth] + conn->latUs);
+    }
+  }
+  return t;
+}
+
+typedef std::pair<double, int> ncclSimEvent;
+
+static inline void ncclSimEnqueue(struct ncclSimState* s,
+    std::priority_queue<ncclSimEvent, std::vector<ncclSimEvent>, std::greater<ncclSimEvent>>& queue, int a) {
+  if (a < 0 || s->agents[a].queued) return;
+  double t = ncclSimReady(s, &s->agents[a]);
+  if (t < 0) return;
+  s->agents[a].queued = true;
+  queue.push(ncclSimEvent(t, a));
+}
+
+// Returns 0 on success, -1 if the schedule deadlocks (inconsistent topology).
+static inline int ncclSimRun(const struct ncclSimParams* params, struct ncclSimResult* result) {
+  struct ncclSimState s;
+  s.params = params;
+  s.sliceBytes = params->protocol == ncclSimProtoSimple ? params->stepSize*params->sliceSteps : params->chunkSize;
+  s.slicesPerChunk = params->protocol == ncclSimProtoSimple ? params->chunkSteps/params->sliceSteps : 1;
+  if (s.slicesPerChunk < 1) s.slicesPerChunk = 1;
+  s.depth = params->nSteps / (params->protocol == ncclSimProtoSimple ? params->sliceSteps : 1);
+  if (s.depth < 1) s.depth = 1;
+
+  for (int c=0; c<params->nChannels; c++) {
+    if (params->coll == ncclSimSendRecv) ncclSimBuildP2p(&s, c);
+    else if (params->algorithm == ncclSimAlgoRing) ncclSimBuildRing(&s, c);
+    else ncclSimBuildTree(&s, c);
+  }
+
+  std::priority_queue<ncclSimEvent, std::vector<ncclSimEvent>, std::greater<ncclSimEvent>> queue;
+  for (size_t a=0; a<s.agents.size(); a++) ncclSimEnqueue(&s, queue, a);
+
+  int64_t nSlices = 0;
+  double end = 0;
+  while (!queue.empty()) {
+    int a = queue.top().second;
+    double start = queue.top().first;
+    queue.pop();
+    struct ncclSimAgent* agent = &s.agents[a];
+    agent->queued = false;
+    struct ncclSimOp* op = &agent->ops[agent->op];
+
+    // Data of this slice; slices past the end of the data still go through
+    // the step protocol, with no payload.
+    int64_t offset = (int64_t)agent->slice*s.sliceBytes;
+    int64_t bytes = offset >= op->bytes ? 0 : ncclSimMin(s.sliceBytes, op->bytes - offset);
+    double wire = ncclSimWireBytes(params->protocol, bytes);
+    double t0 = start + params->stepLatUs;
+    double done = t0;
+    for (int i=0; i<op->nSend; i++) {
+      int c = op->send[i];
+      struct ncclSimConn* conn = &s.conns[c];
+      int l = conn->link;
+      double txStart = fmax(t0, s.linkFree[l]);
+      double txUs = wire / (s.links[l].bw * 1e3);
+      double txEnd = txStart + txUs;
+      s.linkFree[l] = txEnd;
+      s.links[l].busyUs += txUs;
+      s.links[l].bytes += (int64_t)wire;
+      conn->arrival.push_back(txEnd + conn->latUs);
+      done = fmax(done, txEnd);
+    }
+    for (int i=0; i<op->nRecv; i++) s.conns[op->recv[i]].consumed.push_back(done);
+    agent->time = done;
+    end = fmax(end, done);
+    nSlices++;
+    if (++agent->slice == s.slicesPerChunk) {
+      agent->slice = 0;
+      agent->op++;
+    }
+
+    ncclSimEnqueue(&s, queue, a);
+    for (int i=0; i<op->nSend; i++) ncclSimEnqueue(&s, queue, s.conns[op->send[i]].receiver);
+    for (int i=0; i<op->nRecv; i++) ncclSimEnqueue(&s, queue, s.conns[op->recv[i]].sender);
+  }
+
+  for (auto& agent : s.agents) if (agent.op != agent.ops.size()) return -1;
+
+  result->timeUs = params->launchUs + end;
+  result->nSlices = nSlices;
+  result->links = s.links;
+  for (auto& link : result->links) link.util = end > 0 ? link.busyUs / end : 0;
+  return 0;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_TREE_ROOT_H_
+#define NCCL_TREE_ROOT_H_
+
+#include <stdlib.h>
+
+// Broadcast and Reduce on the trees of the communicator with any rank as root.
+// Broadcast receives from the neighbour leading to the root (or reads its input at
+// the root) and sends to all other neighbours, Reduce receives from all other
+// neighbours and sends toward the root. The neighbour leading to the root is its
+// index in tree.down, NCCL_TREE_ROOT_UP for tree.up or NCCL_TREE_ROOT_SELF at the
+// root, which fits in 3 bits of ncclWorkElem.
+
+#define NCCL_TREE_ROOT_MAX_DOWN 3 // NCCL_MAX_TREE_ARITY
+#define NCCL_TREE_ROOT_UP NCCL_TREE_ROOT_MAX_DOWN
+#define NCCL_TREE_ROOT_SELF 7
+
+// Neighbour of rank leading to root, given the parent of every rank (-1 at the top
+// of the tree) and the children of rank. Returns -1 when the tree does not connect
+// rank and root.
+static inline int ncclTreeToRoot(int nRanks, const int* parent, int rank, const int* down, int root) {
+  if (root == rank) return NCCL_TREE_ROOT_SELF;
+  int prev = root, cur = parent[root];
+  for (int hops=0; cur != -1 && hops < nRanks; hops++) {
+    if (cur == rank) {
+      for (int i=0; i<NCCL_TREE_ROOT_MAX_DOWN; i++) {
+        if (down[i] == prev) return i;
+      }
+      return -1;
+    }
+    prev = cur;
+    cur = parent[cur];
+  }
+  // rank is not above root, so root is behind our parent
+  return cur == -1 && parent[rank] != -1 ? NCCL_TREE_ROOT_UP : -1;
+}
+
+// Whether parent (-1 at the top) forms a single tree over all ranks. Only depends on
+// the parents, so all ranks agree on it.
+static inline bool ncclTreeRootConnected(int nRanks, const int* parent) {
+  int tops = 0;
+  for (int r=0; r<nRanks; r++) {
+    if (parent[r] < -1 || parent[r] >= nRanks) return false;
+    if (parent[r] == -1) tops++;
+    int cur = r, hops = 0;
+    while (cur != -1 && hops++ <= nRanks) cur = parent[cur];
+    if (cur != -1) return false; // cycle
+  }
+  return tops == 1;
+}
+
+// Rank of the neighbour leading to the root, -1 at the root
+static inline int ncclTreeRootPeer(int up, const int* down, int dir) {
+  if (dir == NCCL_TREE_ROOT_UP) return up;
+  return dir >= 0 && dir < NCCL_TREE_ROOT_MAX_DOWN ? down[dir] : -1;
+}
+
+// Reference data flow of a Broadcast (reduce=false) or a Reduce of nChunks chunks,
+// each rank following the rule of the kernels on the trees given by parent and down
+// (NCCL_TREE_ROOT_MAX_DOWN entries per rank). A link moves one chunk per round and a
+// rank forwards a chunk the round after it got it (for Reduce, after it got it from
+// all its other neighbours). Returns the number of rounds, or -1 when a rank gets a
+// chunk from the wrong neighbour, out of order or more than once, when the flow
+// stalls, or when the root of a Reduce does not get every contribution exactly once.
+static inline int ncclTreeRootSimulate(int nRanks, const int* parent, const int* down, int root, int nChunks, bool reduce) {
+  const int nb = NCCL_TREE_ROOT_MAX_DOWN+1; // down[], then up
+  int* peers = (int*)malloc((size_t)nRanks*nb*sizeof(int));
+  int* got = (int*)calloc((size_t)nRanks*nb, sizeof(int)); // chunks received from each neighbour
+  int* state = (int*)malloc((size_t)nRanks*3*sizeof(int));
+  long* acc = (long*)calloc((size_t)2*nRanks*nChunks, sizeof(long)); // contributions and sum of their ranks
+  int rounds = -1;
+  if (peers == NULL || got == NULL || state == NULL || acc == NULL) {
+    free(peers); free(got); free(state); free(acc);
+    return -1;
+  }
+  int* toward = state;       // index in peers, -1 at the root
+  int* sent = state+nRanks;
+  int* sending = state+2*nRanks;
+  bool valid = true;
+  for (int r=0; r<nRanks && valid; r++) {
+    for (int i=0; i<nb-1; i++) peers[r*nb+i] = down[r*(nb-1)+i];
+    peers[r*nb+nb-1] = parent[r];
+    for (int i=0; i<nb-1; i++) {
+      if (peers[r*nb+i] >= 0 && parent[peers[r*nb+i]] != r) valid = false;
+    }
+    int dir = ncclTreeToRoot(nRanks, parent, r, down+r*(nb-1), root);
+    if (dir < 0) valid = false;
+    toward[r] = dir == NCCL_TREE_ROOT_SELF ? -1 : dir;
+    sent[r] = 0;
+    for (int k=0; k<nChunks; k++) {
+      acc[(r*nChunks+k)*2] = 1;
+      acc[(r*nChunks+k)*2+1] = r;
+    }
+  }
+  for (int round=0; valid; round++) {
+    // Chunks available to forward at the start of the round
+    bool complete = true, progress = false;
+    for (int r=0; r<nRanks; r++) {
+      int avail = nChunks;
+      for (int i=0; i<nb; i++) {
+        if (peers[r*nb+i] < 0 || (reduce ? i == toward[r] : i != toward[r])) continue;
+        if (got[r*nb+i] < avail) avail = got[r*nb+i];
+      }
+      if ((reduce ? r == root : true) && avail < nChunks) complete = false;
+      sending[r] = sent[r] < avail && (reduce ? r != root : true) ? sent[r] : -1;
+    }
+    if (complete) {
+      rounds = round;
+      break;
+    }
+    for (int s=0; s<nRanks && valid; s++) {
+      int k = sending[s];
+      if (k == -1) continue;
+      for (int i=0; i<nb; i++) {
+        int t = peers[s*nb+i];
+        if (t < 0 || (reduce ? i != toward[s] : i == toward[s])) continue;
+        int j = 0;
+        while (j < nb && peers[t*nb+j] != s) j++;
+        // The receiver must expect the chunk from s, and get it in order
+        if (j == nb || (reduce ? j == toward[t] : j != toward[t]) || got[t*nb+j] != k) {
+          valid = false;
+          break;
+        }
+        got[t*nb+j]++;
+        if (reduce) {
+          acc[(t*nChunks+k)*2] += acc[(s*nChunks+k)*2];
+          acc[(t*nChunks+k)*2+1] += acc[(s*nChunks+k)*2+1];
+        }
+        progress = true;
+      }
+      sent[s]++;
+    }
+    if (!progress) valid = false;
+  }
+  if (valid && reduce) {
+    for (int k=0; k<nChunks; k++) {
+      if (acc[(root*nChunks+k)*2] != nRanks || acc[(root*nChunks+k)*2+1] != (long)nRanks*(nRanks-1)/2) valid = false;
+    }
+  }
+  free(peers);
+  free(got);
+  free(state);
+  free(acc);
+  return valid ? rounds : -1;
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+#ifndef NCCL_WORK_POOL_H_
+#define NCCL_WORK_POOL_H_
+
+#include <stdint.h>
+
+// Device storage for the work arrays of persistent (graph captured) plans.
+// Plans sub-allocate from the most recent chunk; the work is written to the
+// host copy and uploaded once per launch. A chunk is freed when the last plan
+// using it is released. Templated on the work type and on the allocation and
+// copy calls so that the counters can be unit tested without a GPU.
+
+template<typename Work>
+struct ncclWorkPoolChunk {
+  struct ncclWorkPoolChunk* next;
+  Work* devWork;
+  Work* hostWork;
+  int capacity; // in Work
+  int used;
+  int live;     // plans still referencing this chunk
+  int dirtyBeg, dirtyEnd; // range written since the last upload
+};
+
+template<typename Work>
+struct ncclWorkPool {
+  struct ncclWorkPoolChunk<Work>* chunks; // chunks[0] is the one we allocate from
+  uint64_t nPlans;
+  uint64_t nChunkAllocs;
+  uint64_t nChunkFrees;
+  uint64_t nUploads;
+};
+
+// Reserve nWork contiguous works for a plan, in a new chunk of at least minChunk
+// works when the current one is full. alloc(&chunk, capacity) returns a zeroed
+// chunk with its host and device arrays.
+template<typename Work, typename Alloc>
+static inline auto ncclWorkPoolAlloc(struct ncclWorkPool<Work>* pool, int nWork, int minChunk, Alloc alloc,
+                                     struct ncclWorkPoolChunk<Work>** chunkOut, Work** hostWork, Work** devWork)
+    -> decltype(alloc((struct ncclWorkPoolChunk<Work>**)0, 0)) {
+  typedef decltype(alloc((struct ncclWorkPoolChunk<Work>**)0, 0)) Ret;
+  struct ncclWorkPoolChunk<Work>* chunk = pool->chunks;
+  if (chunk == nullptr || chunk->capacity - chunk->used < nWork) {
+    Ret ret = alloc(&chunk, nWork > minChunk ? nWork : minChunk);
+    if (ret != Ret()) return ret;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->nChunkAllocs++;
+  }
+  if (chunk->dirtyEnd == chunk->dirtyBeg) chunk->dirtyBeg = chunk->used;
+  *hostWork = chunk->hostWork + chunk->used;
+  *devWork = chunk->devWork + chunk->used;
+  *chunkOut = chunk;
+  chunk->used += nWork;
+  chunk->dirtyEnd = chunk->used;
+  chunk->live++;
+  pool->nPlans++;
+  return Ret();
+}
+
+// Drop the reference of a plan to its chunk. The current chunk is rewound once
+// idle, older ones are freed with freeChunk(chunk).
+template<typename Work, typename Free>
+static inline auto ncclWorkPoolRelease(struct ncclWorkPool<Work>* pool, struct ncclWorkPoolChunk<Work>* chunk, Free freeChunk)
+    -> decltype(freeChunk(chunk)) {
+  typedef decltype(freeChunk(chunk)) Ret;
+  if (chunk == nullptr || --chunk->live != 0) return Ret();
+  if (chunk == pool->chunks) {
+    // Still the current chunk: start over from its beginning.
+    chunk->used = chunk->dirtyBeg = chunk->dirtyEnd = 0;
+    return Ret();
+  }
+  struct ncclWorkPoolChunk<Work>** prev = &pool->chunks;
+  while (*prev != chunk) prev = &(*prev)->next;
+  *prev = chunk->next;
+  pool->nChunkFrees++;
+  return freeChunk(chunk);
+}
+
+// Upload all work written since the last call, copy(dst, src, nWork) once per chunk.
+template<typename Work, typename Copy>
+static inline auto ncclWorkPoolUpload(struct ncclWorkPool<Work>* pool, Copy copy) -> decltype(copy((Work*)0, (Work*)0, 0)) {
+  typedef decltype(copy((Work*)0, (Work*)0, 0)) Ret;
+  for (struct ncclWorkPoolChunk<Work>* chunk = pool->chunks; chunk != nullptr; chunk = chunk->next) {
+    if (chunk->dirtyEnd == chunk->dirtyBeg) continue;
+    Ret ret = copy(chunk->devWork+chunk->dirtyBeg, chunk->hostWork+chunk->dirtyBeg, chunk->dirtyEnd-chunk->dirtyBeg);
+    if (ret != Ret()) return ret;
+    chunk->dirtyBeg = chunk->dirtyEnd;
+    pool->nUploads++;
+  }
+  return Ret();
+}
+
+// Free all the chunks left, at communicator destruction
+template<typename Work, typename Free>
+static inline auto ncclWorkPoolDestroy(struct ncclWorkPool<Work>* pool, Free freeChunk) -> decltype(freeChunk(pool->chunks)) {
+  typedef decltype(freeChunk(pool->chunks)) Ret;
+  while (pool->chunks != nullptr) {
+    struct ncclWorkPoolChunk<Work>* chunk = pool->chunks;
+    pool->chunks = chunk->next;
+    pool->nChunkFrees++;
+    Ret ret = freeChunk(chunk);
+    if (ret != Ret()) return ret;
+  }
+  return Ret();
+}
+
+#endif
@@ -42,6 +42,9 @@
 // [RCCL]
 #include "git_version.h"
 #include "rccl_vars.h"
+#include "p2p_sizing.h"
+#include "mem_budget.h"
+#include "gather_tree.h"
 #include "hip_rocm_version_info.h"
 //#include "clique/CliqueManager.h"
 //#include <hsa/hsa_ext_amd.h>
@@ -322,7 +325,7 @@ void ncclCommPushCudaFree(struct ncclComm* comm, void* obj) {
 }
 
 static ncclResult_t ncclDestructorFnCudaHostFree(struct ncclDestructor* dtor) {
-  CUDACHECK(cudaFreeHost(dtor->obj));
+  NCCLCHECK(ncclCudaHostFree(dtor->obj));
   return ncclSuccess;
 }
 void ncclCommPushCudaHostFree(struct ncclComm* comm, void* obj) {
@@ -399,7 +402,17 @@ static ncclResult_t commFree(ncclComm_t comm) {
   }
   free(comm->rankToNode);
   free(comm->rankToLocalRank);
+  free(comm->treeToRoot);
   free(comm->collNetHeads);
+  if (comm->gatherTreeSchedules) {
+    for (int r=0; r<comm->nRanks; r++) {
+      if (comm->gatherTreeSchedules[r] == NULL) continue;
+      free(comm->gatherTreeSchedules[r]->order);
+      free(comm->gatherTreeSchedules[r]->plan.children);
+      free(comm->gatherTreeSchedules[r]);
+    }
+    free(comm->gatherTreeSchedules);
+  }
 
   if (comm->bootstrap)
     NCCLCHECK(bootstrapClose(comm->bootstrap));
@@ -410,6 +423,9 @@ static ncclResult_t commFree(ncclComm_t comm) {
   if (comm->doneEvent != NULL)
     CUDACHECK(hipEventDestroy(comm->doneEvent));
 
+  NCCLCHECK(ncclPersistentWorkPoolDestruct(comm));
+  (void)ncclProxyBatchFree(&comm->proxyBatch);
+
   if (comm->sharedRes) {
     if (ncclAtomicRefCountDecrement(&comm->sharedRes->refCount) == 0) {
       for (int c=0; c<MAXCHANNELS; c++) {
@@ -449,6 +465,7 @@ static ncclResult_t commFree(ncclComm_t comm) {
 
   NCCLCHECK(ncclRegCleanup(comm));
 
+  ncclMemAccountForget(&comm->memAccount);
   commPoison(comm); // poison comm before free to avoid comm reuse.
   free(comm);
 
@@ -464,6 +481,10 @@ NCCL_PARAM(DisableGraphHelper, "GRAPH_HELPER_DISABLE", 0);
 // GDRCOPY support: FIFO_ENABLE when enabled locates a workFifo in CUDA memory
 NCCL_PARAM(GdrCopyFifoEnable, "GDRCOPY_FIFO_ENABLE", 1);
 NCCL_PARAM(WorkFifoDepth, "WORK_FIFO_DEPTH", 256<<10);
+// Sum half and bfloat16 with fp32 partial sums in every reduce step. Ring steps add
+// two values and round once either way, so only ncclAvg (no rounding of the scaled
+// input) and tree steps with several children change; ring sums are left as they are.
+RCCL_PARAM(ReduceAccFp32, "REDUCE_ACC_FP32", 0);
 enum ncclLaunchMode ncclParamLaunchMode;
 
 
@@ -632,6 +653,8 @@ static ncclResult_t devCommSetup(ncclComm_t comm) {
     tmpCommAndChans.comm.buffSizes[p] = comm->buffSizes[p];
   }
   tmpCommAndChans.comm.p2pChunkSize = comm->p2pChunkSize;
+  comm->reduceAccFp32 = tmpCommAndChans.comm.reduceAccFp32 = rcclParamReduceAccFp32() != 0;
+  if (comm->reduceAccFp32 && comm->rank == 0) INFO(NCCL_INIT, "RCCL_REDUCE_ACC_FP32 set, half and bfloat16 sums carry fp32 partial sums, tree sums and averages skip LL128");
   tmpCommAndChans.comm.channels = &devCommAndChans->channels[0];
 
   comm->workFifoDepth = ncclParamWorkFifoDepth();
@@ -641,21 +664,24 @@ static ncclResult_t devCommSetup(ncclComm_t comm) {
   }
   tmpCommAndChans.comm.workFifoDepth = comm->workFifoDepth;
 
-  if (ncclGdrCopy != NULL && ncclParamGdrCopyFifoEnable() == 1) {
-    // The workFifoHeap lives in GDR mapped CUDA memory.
-    NCCLCHECKGOTO(ncclGdrCudaCalloc(&comm->workFifoHeap, &comm->devWorkFifoHeap, comm->workFifoDepth, &comm->workFifoHeapGdrHandle, comm->sideStream), ret, fail);
-    ncclCommPushCudaGdrFree(comm, comm->workFifoHeapGdrHandle);
-  } else {
-    // The workFifoHeap lives in cudaHost memory.
-    comm->workFifoHeapGdrHandle = nullptr;
-    NCCLCHECKGOTO(ncclCudaHostCalloc(&comm->workFifoHeap, comm->workFifoDepth), ret, fail);
-    ncclCommPushCudaHostFree(comm, comm->workFifoHeap);
-    comm->devWorkFifoHeap = comm->workFifoHeap;
-  }
-  tmpCommAndChans.comm.workFifoHeap = comm->devWorkFifoHeap;
+  {
+    ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemWorkFifo);
+    if (ncclGdrCopy != NULL && ncclParamGdrCopyFifoEnable() == 1) {
+      // The workFifoHeap lives in GDR mapped CUDA memory.
+      NCCLCHECKGOTO(ncclGdrCudaCalloc(&comm->workFifoHeap, &comm->devWorkFifoHeap, comm->workFifoDepth, &comm->workFifoHeapGdrHandle, comm->sideStream), ret, fail);
+      ncclCommPushCudaGdrFree(comm, comm->workFifoHeapGdrHandle);
+    } else {
+      // The workFifoHeap lives in cudaHost memory.
+      comm->workFifoHeapGdrHandle = nullptr;
+      NCCLCHECKGOTO(ncclCudaHostCalloc(&comm->workFifoHeap, comm->workFifoDepth), ret, fail);
+      ncclCommPushCudaHostFree(comm, comm->workFifoHeap);
+      comm->devWorkFifoHeap = comm->workFifoHeap;
+    }
+    tmpCommAndChans.comm.workFifoHeap = comm->devWorkFifoHeap;
 
-  NCCLCHECKGOTO(ncclCudaHostCalloc(&comm->workFifoDone, MAXCHANNELS), ret, fail);
-  ncclCommPushCudaHostFree(comm, comm->workFifoDone);
+    NCCLCHECKGOTO(ncclCudaHostCalloc(&comm->workFifoDone, MAXCHANNELS), ret, fail);
+    ncclCommPushCudaHostFree(comm, comm->workFifoDone);
+  }
   comm->workFifoSent = 0;
   comm->workFifoAckdMin = 0;
 
@@ -837,6 +863,55 @@ NCCL_PARAM(P2pNetChunkSize, "P2P_NET_CHUNKSIZE", (1 << 17)); /* 128 kB */
 NCCL_PARAM(P2pPciChunkSize, "P2P_PCI_CHUNKSIZE", (1 << 17)); /* 128 kB */
 NCCL_PARAM(P2pNvlChunkSize, "P2P_NVL_CHUNKSIZE", (1 << 19)); /* 512 kB */
 
+// Device memory budget in bytes for protocol buffers, 0 means unlimited.
+// Must be set identically on all ranks since it changes the channel count.
+RCCL_PARAM(MemBudget, "MEM_BUDGET", 0);
+
+static void memBudgetInit(struct ncclComm* comm, bool* protoUsed, struct ncclMemBudget* b) {
+  for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) protoUsed[p] = p != NCCL_PROTO_LL128 || comm->topo->ll128Enabled;
+  b->budget = comm->memBudget;
+  b->nProtos = NCCL_NUM_PROTOCOLS;
+  b->simpleProto = NCCL_PROTO_SIMPLE;
+  b->buffSizes = comm->buffSizes;
+  b->protoUsed = protoUsed;
+  b->nPeers = comm->nRanks-1;
+  b->p2pChannelsPerPeer = 1;
+  b->p2pChunkSize = std::min(comm->p2pChunkSize, NCCL_P2P_MIN_CHUNKSIZE);
+  b->nSteps = NCCL_STEPS;
+}
+
+// Fit the protocol buffers into RCCL_MEM_BUDGET before Postset duplicates the channels:
+// halve the SIMPLE buffer down to NCCL_MEM_BUDGET_MIN_BUFFSIZE first, then the channel
+// count down to minCTAs. Send/recv connections are counted at their smallest size here,
+// computeP2pBuffSizes fits them into what the collective buffers leave.
+static ncclResult_t applyMemBudget(struct ncclComm* comm, struct ncclTopoGraph** graphs, int* nc) {
+  comm->memBudget = std::max(rcclParamMemBudget(), (int64_t)0);
+  if (comm->memBudget == 0) return ncclSuccess;
+
+  bool protoUsed[NCCL_NUM_PROTOCOLS];
+  struct ncclMemBudget b;
+  memBudgetInit(comm, protoUsed, &b);
+  int buffSize = comm->buffSizes[NCCL_PROTO_SIMPLE];
+  int searchChannels = comm->nChannels, ncOrig = *nc;
+  // Postset doubles the searched channels, then duplicates them up to nc times as many
+  int nChannels = std::max(2*searchChannels, *nc*searchChannels);
+  int expected = nChannels;
+  int64_t estimate = ncclMemBudgetFit(&b, &nChannels, comm->config.minCTAs);
+  ncclMemBudgetCapChannels(nChannels, &searchChannels, nc);
+  if (comm->p2pChunkSize * NCCL_STEPS > comm->buffSizes[NCCL_PROTO_SIMPLE]) comm->p2pChunkSize = comm->buffSizes[NCCL_PROTO_SIMPLE]/NCCL_STEPS;
+  // Keep the graphs consistent so tuning does not assume the bandwidth of dropped channels
+  comm->nChannels = searchChannels;
+  for (int a : { NCCL_ALGO_TREE, NCCL_ALGO_RING }) graphs[a]->nChannels = std::min(graphs[a]->nChannels, comm->nChannels);
+
+  if (estimate > (int64_t)comm->memBudget) {
+    WARN("RCCL_MEM_BUDGET %zu cannot be met, buffers need %ld bytes with %d channels and buffsize %d",
+         comm->memBudget, estimate, nChannels, comm->buffSizes[NCCL_PROTO_SIMPLE]);
+  }
+  INFO(NCCL_INIT, "RCCL_MEM_BUDGET %zu: buffsize %d -> %d, channels %d -> %d (search %d, nc %d -> %d), estimated buffers %ld bytes",
+       comm->memBudget, buffSize, comm->buffSizes[NCCL_PROTO_SIMPLE], expected, nChannels, searchChannels, ncOrig, *nc, estimate);
+  return ncclSuccess;
+}
+
 static ncclResult_t computeBuffSizes(struct ncclComm* comm) {
   int cpuArch, cpuVendor, cpuModel;
   NCCLCHECK(ncclTopoCpuType(comm->topo, &cpuArch, &cpuVendor, &cpuModel));
@@ -855,6 +930,27 @@ static ncclResult_t computeBuffSizes(struct ncclComm* comm) {
 
   // Make sure P2P chunksize is not larger than coll chunksize.
   if (comm->p2pChunkSize * NCCL_STEPS > comm->buffSizes[NCCL_PROTO_SIMPLE]) comm->p2pChunkSize = comm->buffSizes[NCCL_PROTO_SIMPLE]/NCCL_STEPS;
+  return ncclSuccess;
+}
+
+// Target for the bytes in flight across all send/recv connections of a rank, 0 disables.
+// Must be set identically on all ranks since peers have to agree on the P2P chunk size.
+RCCL_PARAM(P2pInflightBytes, "P2P_INFLIGHT_BYTES", (1LL << 30)); /* 1 GiB */
+
+// Scale the P2P chunk size and the shared net buffer pool with the number of peers.
+// Needs p2pnChannelsPerPeer, so this runs after ncclTopoComputeP2pChannels.
+static ncclResult_t computeP2pBuffSizes(struct ncclComm* comm) {
+  int64_t inflightBytes = rcclParamP2pInflightBytes();
+  if (comm->memBudget) {
+    // Send/recv buffers get what the collective buffers leave of RCCL_MEM_BUDGET
+    bool protoUsed[NCCL_NUM_PROTOCOLS];
+    struct ncclMemBudget b;
+    memBudgetInit(comm, protoUsed, &b);
+    int64_t left = std::max((int64_t)comm->memBudget - ncclMemBudgetCollBytes(&b, comm->nChannels), (int64_t)1);
+    inflightBytes = inflightBytes > 0 ? std::min(inflightBytes, left) : left;
+  }
+  int chunkSize = comm->p2pChunkSize;
+  comm->p2pChunkSize = ncclP2pComputeChunkSize(chunkSize, inflightBytes, comm->nRanks-1, comm->p2pnChannelsPerPeer, NCCL_STEPS);
 
   if (comm->sharedRes->owner != comm) {
     /* make sure split comm p2pChunkSize won't exceed shared p2pChunkSize. */
@@ -863,7 +959,12 @@ static ncclResult_t computeBuffSizes(struct ncclComm* comm) {
     comm->sharedRes->tpP2pChunkSize = comm->p2pChunkSize;
   }
 
-  INFO(NCCL_INIT, "P2P Chunksize set to %d", comm->p2pChunkSize);
+  int nNetPeers = comm->p2pNet ? comm->nRanks-1 : comm->nRanks-comm->localRanks;
+  comm->p2pSharedSteps = ncclP2pComputeSharedSteps(nNetPeers, comm->p2pnChannelsPerPeer, comm->p2pnChannels, comm->p2pChunkSize,
+      inflightBytes, NCCL_SHARED_STEPS, NCCL_STEPS*NCCL_PROXY_MAX_SUBS);
+
+  INFO(NCCL_INIT, "P2P Chunksize set to %d (%d peers x %d channels, inflight target %ld), shared steps %d",
+       comm->p2pChunkSize, comm->nRanks-1, comm->p2pnChannelsPerPeer, inflightBytes, comm->p2pSharedSteps);
   return ncclSuccess;
 }
 
@@ -1107,6 +1208,99 @@ fail:
 // MNNVL: Flag to indicate whether to enable Multi-Node NVLink
 NCCL_PARAM(MNNVL, "MNNVL", -2);
 
+RCCL_PARAM(GraphCommonSearch, "GRAPH_COMMON_SEARCH", 0);
+
+// Agree on the number of ring and tree channels every rank can build, then
+// search again on ranks which found more. A graph searched for fewer channels
+// can have more bandwidth per channel than the first channels of a larger
+// graph, which is what the global reduction would otherwise keep.
+static ncclResult_t commonGraphSearch(struct ncclComm* comm, struct ncclTopoGraph* ringGraph, struct ncclTopoGraph* treeGraph) {
+  ncclResult_t ret = ncclSuccess;
+  int* nChannels = NULL;
+  int ringChannels = ringGraph->nChannels;
+  int treeChannels = treeGraph->nChannels;
+  NCCLCHECK(ncclCalloc(&nChannels, 2*comm->nRanks));
+  nChannels[2*comm->rank] = ringGraph->nChannels;
+  nChannels[2*comm->rank+1] = treeGraph->nChannels;
+  NCCLCHECKGOTO(bootstrapAllGather(comm->bootstrap, nChannels, 2*sizeof(int)), ret, exit);
+  for (int r=0; r<comm->nRanks; r++) {
+    ringChannels = std::min(ringChannels, nChannels[2*r]);
+    treeChannels = std::min(treeChannels, nChannels[2*r+1]);
+  }
+  if (ringChannels < ringGraph->nChannels) {
+    INFO(NCCL_INIT|NCCL_GRAPH, "Searching ring graph again for the %d channels common to all ranks (found %d)", ringChannels, ringGraph->nChannels);
+    memset(ringGraph, 0, sizeof(struct ncclTopoGraph));
+    ringGraph->id = 0;
+    ringGraph->pattern = NCCL_TOPO_PATTERN_RING;
+    ringGraph->minChannels = 1;
+    ringGraph->maxChannels = ringChannels;
+    NCCLCHECKGOTO(ncclTopoCompute(comm->topo, ringGraph), ret, exit);
+    NCCLCHECKGOTO(ncclTopoPrintGraph(comm->topo, ringGraph), ret, exit);
+  }
+  treeChannels = std::min(treeChannels, ringGraph->nChannels);
+  if (treeChannels < treeGraph->nChannels) {
+    INFO(NCCL_INIT|NCCL_GRAPH, "Searching tree graph again for the %d channels common to all ranks (found %d)", treeChannels, treeGraph->nChannels);
+    memset(treeGraph, 0, sizeof(struct ncclTopoGraph));
+    treeGraph->id = 1;
+    treeGraph->pattern = NCCL_TOPO_PATTERN_BALANCED_TREE;
+    treeGraph->collNet = 0;
+    treeGraph->minChannels = comm->topo->nodes[NET].count != 0 ? 1 : treeChannels;
+    treeGraph->maxChannels = treeChannels;
+    NCCLCHECKGOTO(ncclTopoCompute(comm->topo, treeGraph), ret, exit);
+    NCCLCHECKGOTO(ncclTopoPrintGraph(comm->topo, treeGraph), ret, exit);
+  }
+exit:
+  free(nChannels);
+  return ret;
+}
+
+// Hardware fingerprint selecting the rccl.conf profile sections
+static void getEnvFingerprint(struct ncclComm* comm, struct rcclEnvFingerprint* fp) {
+  struct ncclTopoSystem* system = comm->topo;
+  memset(fp, 0, sizeof(*fp));
+  if (system->nodes[GPU].count && system->nodes[GPU].nodes[0].gpu.gcn) strncpy(fp->arch, system->nodes[GPU].nodes[0].gpu.gcn, sizeof(fp->arch)-1);
+  fp->nGpus = system->nodes[GPU].count;
+  fp->nNics = system->nodes[NET].count;
+  fp->xgmi = (system->type & RCCL_TOPO_XGMI_ALL) ? 1 : 0;
+  fp->model = RCCL_ENV_MODEL_UNKNOWN;
+  INFO(NCCL_INIT|NCCL_ENV, "Hardware fingerprint arch=%s,gpus=%d,nics=%d,xgmi=%d", fp->arch, fp->nGpus, fp->nNics, fp->xgmi);
+}
+
+// Neighbour leading to each root on the tree of each channel, for Broadcast and Reduce on trees
+static ncclResult_t setupTreeToRoot(struct ncclComm* comm) {
+  ncclResult_t ret = ncclSuccess;
+  int nRanks = comm->nRanks, nChannels = comm->nChannels;
+  int *ups = NULL, *parent = NULL;
+  NCCLCHECKGOTO(ncclCalloc(&comm->treeToRoot, (size_t)nChannels*nRanks), ret, exit);
+  NCCLCHECKGOTO(ncclCalloc(&ups, (size_t)nRanks*nChannels), ret, exit);
+  NCCLCHECKGOTO(ncclCalloc(&parent, nRanks), ret, exit);
+  for (int c=0; c<nChannels; c++) ups[comm->rank*nChannels+c] = comm->channels[c].tree.up;
+  NCCLCHECKGOTO(bootstrapAllGather(comm->bootstrap, ups, nChannels*sizeof(int)), ret, exit);
+  for (int c=0; c<nChannels; c++) {
+    struct ncclTree* tree = &comm->channels[c].tree;
+    for (int r=0; r<nRanks; r++) parent[r] = ups[r*nChannels+c];
+    if (!ncclTreeRootConnected(nRanks, parent)) {
+      INFO(NCCL_INIT, "Tree on channel %d does not connect all ranks, Broadcast and Reduce will only use rings", c);
+      comm->treeRootDisabled = true;
+      goto exit;
+    }
+    for (int root=0; root<nRanks; root++) {
+      int dir = ncclTreeToRoot(nRanks, parent, comm->rank, tree->down, root);
+      if (dir < 0) {
+        // Our children disagree with their parents, which other ranks cannot see
+        WARN("Tree on channel %d: rank %d does not list its children, cannot reach rank %d", c, comm->rank, root);
+        ret = ncclInternalError;
+        goto exit;
+      }
+      comm->treeToRoot[c*nRanks+root] = dir;
+    }
+  }
+exit:
+  free(ups);
+  free(parent);
+  return ret;
+}
+
 static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* parent = NULL) {
   // We use 2 AllGathers
   // 1. { peerInfo, comm, compCap}
@@ -1122,18 +1316,8 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   struct ncclTopoGraph nvlsGraph;
   struct ncclTopoGraph* graphs[] = { &treeGraph, &ringGraph, &collNetGraph, &collNetGraph, &nvlsGraph, &nvlsGraph };
 
-  struct graphInfo {
-    int pattern;
-    int nChannels;
-    int sameChannels;
-    float bwIntra;
-    float bwInter;
-    int typeIntra;
-    int typeInter;
-  };
-
   struct allGatherInfo {
-    struct graphInfo graphInfo[NCCL_NUM_ALGORITHMS];
+    struct ncclTopoGraphInfo graphInfo[NCCL_NUM_ALGORITHMS];
     struct ncclTopoRanks topoRanks;
     int nc;
     bool pivotA2AEnabled;
@@ -1149,8 +1333,10 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   int* nvbPeers = NULL;
   struct ncclProxyConnector proxyConn;
   int* pxnPeers = NULL;
+  struct ncclProxyConnector* pxnConns = NULL;
   int *topParentLocalRanks = NULL;
   int tpProxyRank;
+  struct rcclEnvFingerprint envFingerprint;
 
   int highestTransportType = TRANSPORT_P2P;
   bool needsProxy = false;
@@ -1293,8 +1479,13 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   comm->topo->mscclEnabled = false;
   // Topology hint if tree has been defined by model or User
   comm->topo->treeDefined = false;
+  comm->topo->romeModel = -1;
   // Compute paths between GPUs and NICs
   NCCLCHECKGOTO(ncclTopoComputePaths(comm->topo, comm), ret, fail);
+  // Apply the conf file profiles matching this node, before trimming removes the GPUs and
+  // NICs of other processes. Sections keyed on the Rome model wait for the graph search.
+  getEnvFingerprint(comm, &envFingerprint);
+  ncclApplyEnvProfiles(&envFingerprint);
   // Remove inaccessible GPUs and unused NICs
   NCCLCHECKGOTO(ncclTopoTrimSystem(comm->topo, comm), ret, fail);
   // Recompute paths after trimming
@@ -1355,6 +1546,8 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   ringGraph.maxChannels = MAXCHANNELS/2;
   NCCLCHECKGOTO(ncclTopoCompute(comm->topo, &ringGraph), ret, fail);
   NCCLCHECKGOTO(ncclTopoPrintGraph(comm->topo, &ringGraph), ret, fail);
+  envFingerprint.model = comm->topo->romeModel;
+  ncclApplyEnvProfiles(&envFingerprint);
 
   memset(&treeGraph, 0, sizeof(struct ncclTopoGraph));
   treeGraph.id = 1;
@@ -1365,6 +1558,10 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   NCCLCHECKGOTO(ncclTopoCompute(comm->topo, &treeGraph), ret, fail);
   NCCLCHECKGOTO(ncclTopoPrintGraph(comm->topo, &treeGraph), ret, fail);
 
+  if (rcclParamGraphCommonSearch() && nranks > 1) {
+    NCCLCHECKGOTO(commonGraphSearch(comm, &ringGraph, &treeGraph), ret, fail);
+  }
+
   memset(&collNetGraph, 0, sizeof(struct ncclTopoGraph));
   collNetGraph.id = 2;
   collNetGraph.pattern = NCCL_TOPO_PATTERN_TREE;
@@ -1488,6 +1685,7 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
     }
     comm->rankToNode[r] = node;
   }
+  NCCLCHECKGOTO(ncclTopoOrderNodes(comm, nodesFirstRank, nodesTreePatterns), ret, fail);
   // Now that we know nNodes, alloc nodeRanks and compute localRanks for each node
   NCCLCHECKGOTO(ncclCalloc(&comm->nodeRanks, comm->nNodes), ret, fail);
   NCCLCHECKGOTO(ncclCalloc(&comm->rankToLocalRank, comm->nRanks), ret, fail);
@@ -1529,6 +1727,7 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   NCCLCHECKGOTO(ncclCalloc(&allTopoRanks, comm->nRanks), ret, fail);
   int nc;
   nc = allGather3Data[0].nc;
+  for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) ncclTopoGraphLimitsReset(comm->graphLimits+a);
   for (int i=0; i<nranks; i++) {
     allTopoRanks[i] = &allGather3Data[i].topoRanks;
     nc = std::min(allGather3Data[i].nc, nc);
@@ -1537,20 +1736,18 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
     comm->topo->ll128Enabled = comm->topo->ll128Enabled && allGather3Data[i].ll128Enabled;
     comm->topo->mscclEnabled = comm->topo->mscclEnabled && allGather3Data[i].mscclEnabled;
     for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
-      graphs[a]->nChannels = std::min(allGather3Data[i].graphInfo[a].nChannels, graphs[a]->nChannels);
-      graphs[a]->sameChannels = std::min(allGather3Data[i].graphInfo[a].sameChannels, graphs[a]->sameChannels);
-      graphs[a]->bwIntra = std::min(allGather3Data[i].graphInfo[a].bwIntra, graphs[a]->bwIntra);
-      graphs[a]->bwInter = std::min(allGather3Data[i].graphInfo[a].bwInter, graphs[a]->bwInter);
-      graphs[a]->typeIntra = std::max(allGather3Data[i].graphInfo[a].typeIntra, graphs[a]->typeIntra);
-      graphs[a]->typeInter = std::max(allGather3Data[i].graphInfo[a].typeInter, graphs[a]->typeInter);
+      ncclTopoReduceGraphInfo(graphs[a], allGather3Data[i].graphInfo+a, i, comm->graphLimits+a);
     }
     if (graphs[NCCL_ALGO_COLLNET_CHAIN]->nChannels == 0) comm->collNetSupport = 0;
     if (graphs[NCCL_ALGO_NVLS]->nChannels == 0) comm->nvlsSupport = 0;
   }
+  NCCLCHECKGOTO(ncclTopoPrintGraphLimits(comm), ret, fail);
 
   comm->nChannels = treeGraph.nChannels = ringGraph.nChannels =
     (comm->topo->nodes[GPU].count != comm->topo->nRanks && comm->topo->nodes[NET].count)
     ? std::min(treeGraph.nChannels, ringGraph.nChannels) : ringGraph.nChannels;
+  NCCLCHECKGOTO(computeBuffSizes(comm), ret, fail);
+  NCCLCHECKGOTO(applyMemBudget(comm, graphs, &nc), ret, fail);
   if (comm->nChannels < nChannelsOrig) {
     // We started duplicating channels during Preset(), so we need to move the
     // duplicated channels since we have removed some.
@@ -1594,10 +1791,9 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   line[4095] = '\0';
   INFO(NCCL_INIT, "Trees%s comm %p nRanks %02d busId %lx", line, comm, comm->nRanks, comm->busId);
 
-  NCCLCHECKGOTO(computeBuffSizes(comm), ret, fail);
-
   // Compute nChannels per peer for p2p
   NCCLCHECKGOTO(ncclTopoComputeP2pChannels(comm), ret, fail);
+  NCCLCHECKGOTO(computeP2pBuffSizes(comm), ret, fail);
 
   /* until now, all info of comm should be known. We can initialize shared resources and
    * map localRanks to top parent local ranks. NOTE: this shareRes init must be put before
@@ -1654,6 +1850,8 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
   }
   NCCLCHECKGOTO(ncclTransportP2pSetup(comm, &treeGraph, 0, &highestTransportType, &needsProxy), ret, fail);
   mscclNeedsProxy |= needsProxy;
+  if (!rcclParamTreeBcastReduce()) comm->treeRootDisabled = true;
+  else if (comm->nRanks > 1) NCCLCHECKGOTO(setupTreeToRoot(comm), ret, fail);
   INFO(NCCL_INIT, "Connected all trees");
 
   // Setup NVLS
@@ -1749,21 +1947,24 @@ static ncclResult_t initTransportsRank(struct ncclComm* comm, struct ncclComm* p
     NCCLCHECKGOTO(ncclTransportP2pSetup(comm, NULL, 1), ret, fail);
   }
 
-  // Connect to local net proxy
+  // Connect to local net proxy, one batch for all proxies
+  NCCLCHECKGOTO(ncclProxyBatchBegin(comm), ret, fail);
   tpProxyRank = comm->topParentRanks[comm->rank];
   NCCLCHECKGOTO(ncclProxyConnect(comm, TRANSPORT_NET, 1, tpProxyRank, &proxyConn), ret, fail);
-  NCCLCHECKGOTO(ncclProxyCallBlocking(comm, &proxyConn, ncclProxyMsgSharedInit, &comm->p2pnChannels, sizeof(int), NULL, 0), ret, fail);
+  NCCLCHECKGOTO(ncclProxyCallDeferred(comm, &proxyConn, ncclProxyMsgSharedInit, &comm->p2pnChannels, sizeof(int), NULL, 0), ret, fail);
 
   // Then to remote ones when using PXN
   if (ncclPxnDisable(comm) == 0) {
     int nranks;
     NCCLCHECKGOTO(ncclTopoGetPxnRanks(comm, &pxnPeers, &nranks), ret, fail);
+    NCCLCHECKGOTO(ncclCalloc(&pxnConns, nranks), ret, fail);
     for (int r=0; r<nranks; r++) {
       tpProxyRank = comm->topParentRanks[pxnPeers[r]];
-      NCCLCHECKGOTO(ncclProxyConnect(comm, TRANSPORT_NET, 1, tpProxyRank, &proxyConn), ret, fail);
-      NCCLCHECKGOTO(ncclProxyCallBlocking(comm, &proxyConn, ncclProxyMsgSharedInit, &comm->p2pnChannels, sizeof(int), NULL, 0), ret, fail);
+      NCCLCHECKGOTO(ncclProxyConnect(comm, TRANSPORT_NET, 1, tpProxyRank, pxnConns+r), ret, fail);
+      NCCLCHECKGOTO(ncclProxyCallDeferred(comm, pxnConns+r, ncclProxyMsgSharedInit, &comm->p2pnChannels, sizeof(int), NULL, 0), ret, fail);
     }
   }
+  NCCLCHECKGOTO(ncclProxyBatchEnd(comm), ret, fail);
 
   if (comm->intraRank == 0) { // Load ncclParamLaunchMode
     const char* str = ncclGetEnv("NCCL_LAUNCH_MODE");
@@ -1811,8 +2012,10 @@ exit:
   free(rings);
   free(nvbPeers);
   free(pxnPeers);
+  free(pxnConns);
   return ret;
 fail:
+  if (comm->proxyBatch.active) (void)ncclProxyBatchEnd(comm);
   goto exit;
 }
 
@@ -1909,6 +2112,7 @@ static ncclResult_t ncclCommInitRankFunc(struct ncclAsyncJob* job_) {
   int cudaArch;
   int64_t stackSize;
   hipDeviceProp_t devProp;
+  ncclMemAccountGuard memGuard(comm ? &comm->memAccount : NULL, ncclMemOther);
 
   CUDACHECKGOTO(cudaSetDevice(cudaDev), res, fail);
   CUDACHECKGOTO(cudaDeviceGetAttribute(&archMajor, cudaDevAttrComputeCapabilityMajor, cudaDev), res, fail);
@@ -2423,10 +2627,9 @@ fail:
   goto exit;
 }
 
-static ncclResult_t commCleanup(ncclComm_t comm) {
+static ncclResult_t commCleanupDevice(ncclComm_t comm) {
   int savedDevice;
   int commDevice = comm->cudaDev;
-  bool mscclEnabledForTopo = comm->topo->mscclEnabled;
 
   CUDACHECK(cudaGetDevice(&savedDevice));
   if (savedDevice != commDevice) {
@@ -2443,7 +2646,11 @@ static ncclResult_t commCleanup(ncclComm_t comm) {
   if (savedDevice != commDevice) {
     CUDACHECK(cudaSetDevice(savedDevice));
   }
+  return ncclSuccess;
+}
 
+// Process-wide cleanup following commFree(); comm is gone by then.
+static ncclResult_t commCleanupTail(int rank, bool mscclEnabledForTopo) {
 #if defined(ENABLE_NPKIT)
   // Dump NPKit events and shutdown
   const char* npkitDumpDir = getenv("NPKIT_DUMP_DIR");
@@ -2456,12 +2663,99 @@ static ncclResult_t commCleanup(ncclComm_t comm) {
 #endif
 
   if (mscclEnabled() && (mscclEnabledForTopo || mscclForceEnabled())) {
-    NCCLCHECK(mscclTeardown(comm->rank));
+    NCCLCHECK(mscclTeardown(rank));
   }
 
   return ncclSuccess;
 }
 
+static ncclResult_t commCleanup(ncclComm_t comm) {
+  int rank = comm->rank;
+  bool mscclEnabledForTopo = comm->topo->mscclEnabled;
+  NCCLCHECK(commCleanupDevice(comm));
+  NCCLCHECK(commCleanupTail(rank, mscclEnabledForTopo));
+  return ncclSuccess;
+}
+
+// Free all communicators of the process in parallel, one thread per device.
+// Each commFree() mostly waits for its proxy thread and device frees, which
+// do not depend on each other once all proxies have been stopped.
+// RCCL_PARALLEL_DESTROY=1 enables it. It is read at every destroy, like
+// NCCL_COLLNET_ENABLE at init, so that it can differ between the cliques of a process.
+static bool parallelDestroyEnabled() {
+  const char* env = ncclGetEnv("RCCL_PARALLEL_DESTROY");
+  return env != NULL && strcmp(env, "1") == 0;
+}
+
+struct commCleanupJob {
+  pthread_t thread;
+  ncclComm_t comm;
+  int rank;
+  bool mscclEnabledForTopo;
+  ncclResult_t ret;
+};
+
+static void* commCleanupThreadMain(void* args) {
+  struct commCleanupJob* job = (struct commCleanupJob*)args;
+  job->ret = commCleanupDevice(job->comm);
+  return NULL;
+}
+
+static ncclResult_t commCleanupAll(ncclComm_t intracomm0) {
+  ncclResult_t ret = ncclSuccess;
+  struct commCleanupJob* jobs = NULL;
+  int nComms = 0;
+  bool parallel = intracomm0->intraNext != NULL && parallelDestroyEnabled();
+  uint64_t t0 = clockNano();
+
+  for (ncclComm_t c = intracomm0; c; c = c->intraNext) nComms++;
+  if (parallel && ncclCalloc(&jobs, nComms) != ncclSuccess) parallel = false;
+
+  if (parallel) {
+    int n = 0;
+    // Gather everything first: the last commFree() may free intracomm0
+    for (ncclComm_t c = intracomm0; c; c = c->intraNext, n++) {
+      jobs[n].comm = c;
+      jobs[n].rank = c->rank;
+      jobs[n].mscclEnabledForTopo = c->topo->mscclEnabled;
+    }
+    for (n = 0; n < nComms; n++) {
+      if (pthread_create(&jobs[n].thread, NULL, commCleanupThreadMain, jobs+n) != 0) {
+        jobs[n].thread = 0;
+        jobs[n].ret = commCleanupDevice(jobs[n].comm);
+      }
+    }
+    for (n = 0; n < nComms; n++) {
+      if (jobs[n].thread) pthread_join(jobs[n].thread, NULL);
+      if (jobs[n].ret != ncclSuccess) {
+        WARN("commReclaim: cleanup comm %p rank %d failed in destroy/abort, error %d", jobs[n].comm, jobs[n].rank, jobs[n].ret);
+        ret = jobs[n].ret;
+      }
+    }
+    for (n = 0; n < nComms; n++) {
+      ncclResult_t res = commCleanupTail(jobs[n].rank, jobs[n].mscclEnabledForTopo);
+      if (res != ncclSuccess) ret = res;
+    }
+    free(jobs);
+  } else {
+    ncclComm_t curIntraComm;
+    ncclComm_t nextIntraComm = intracomm0;
+    while (nextIntraComm) {
+      curIntraComm = nextIntraComm;
+      int curRank = curIntraComm->rank;
+      nextIntraComm = nextIntraComm->intraNext;
+
+      ncclResult_t res = commCleanup(curIntraComm);
+      if (res != ncclSuccess) {
+        WARN("commReclaim: cleanup comm %p rank %d failed in destroy/abort, error %d", curIntraComm, curRank, res);
+        ret = res;
+      }
+    }
+  }
+  INFO(NCCL_INIT, "Freed %d communicator(s) of this process in %.2f ms%s", nComms, (clockNano()-t0)/1e6, parallel ? " in parallel" : "");
+  return ret;
+}
+
 static ncclResult_t commFinalize(ncclComm_t comm, bool userCalled) {
   ncclResult_t ret = ncclSuccess;
   struct ncclCommFinalizeAsyncJob *job = NULL;
@@ -2578,16 +2872,7 @@ static ncclResult_t commReclaim(ncclComm_t comm) {
       }
 
       /* free local resources. */
-      nextIntraComm = intracomm0;
-      while (nextIntraComm) {
-        curIntraComm = nextIntraComm;
-        curRank = curIntraComm->rank;
-        nextIntraComm = nextIntraComm->intraNext;
-
-        if ((ret = commCleanup(curIntraComm)) != ncclSuccess) {
-          WARN("commReclaim: cleanup comm %p rank %d failed in destroy/abort, error %d", curIntraComm, curRank, ret);
-        }
-      }
+      ret = commCleanupAll(intracomm0);
     }
   }
 
@@ -2818,6 +3103,32 @@ ncclResult_t ncclCommUserRank_impl(const ncclComm_t comm, int* rank) {
   return ncclSuccess;
 }
 
+static_assert(NCCL_NUM_MEM_CATEGORIES == ncclNumMemCategories, "Memory account and ncclMemUsage_t categories must match");
+
+NCCL_API(ncclResult_t, ncclCommGetMemUsage, const ncclComm_t comm, ncclMemUsage_t* usage);
+ncclResult_t ncclCommGetMemUsage_impl(const ncclComm_t comm, ncclMemUsage_t* usage) {
+  NVTX3_FUNC_RANGE_IN(nccl_domain);
+
+  NCCLCHECK(PtrCheck(comm, "CommGetMemUsage", "comm"));
+  NCCLCHECK(PtrCheck(usage, "CommGetMemUsage", "usage"));
+
+  NCCLCHECK(ncclCommEnsureReady(comm));
+
+  memset(usage, 0, sizeof(*usage));
+  // Proxy allocations are shared by all communicators using this proxy.
+  struct ncclMemAccount* accounts[2] = { &comm->memAccount, comm->proxyState ? &comm->proxyState->memAccount : NULL };
+  for (struct ncclMemAccount* account : accounts) {
+    if (account == NULL) continue;
+    for (int c=0; c<ncclNumMemCategories; c++) {
+      usage->deviceBytes[c] += __atomic_load_n(&account->bytes[ncclMemKindDevice][c], __ATOMIC_RELAXED);
+      usage->hostPinnedBytes[c] += __atomic_load_n(&account->bytes[ncclMemKindHostPinned][c], __ATOMIC_RELAXED);
+      usage->hostBytes[c] += __atomic_load_n(&account->bytes[ncclMemKindHost][c], __ATOMIC_RELAXED);
+    }
+  }
+  usage->budget = comm->memBudget;
+  return ncclSuccess;
+}
+
 NCCL_API(ncclResult_t, ncclMemAlloc, void **ptr, size_t size);
 ncclResult_t  ncclMemAlloc_impl(void **ptr, size_t size) {
   NVTX3_FUNC_RANGE_IN(nccl_domain);
@@ -2890,6 +3201,10 @@ fallback:
   CUDACHECKGOTO(cudaMalloc(ptr, size), ret, fail);
 
 exit:
+  if (ret == ncclSuccess) {
+    int dev;
+    if (cudaGetDevice(&dev) == cudaSuccess) ncclPtrCacheInsert(&ncclPtrCacheGlobal, *ptr, size, dev, NCCL_PTR_CACHE_OWNED);
+  }
   return ret;
 fail:
   goto exit;
@@ -2902,6 +3217,7 @@ ncclResult_t  ncclMemFree_impl(void *ptr) {
   int saveDevice;
 
   CUDACHECK(cudaGetDevice(&saveDevice));
+  ncclPtrCacheErase(&ncclPtrCacheGlobal, ptr, 1);
 #if CUDART_VERSION >= 12010
   CUdevice ptrDev = 0;
   int mcSupport = 0;
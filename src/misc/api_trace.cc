@@ -153,6 +153,20 @@ ncclCommRegister_impl(const ncclComm_t comm, void* buff, size_t size, void** han
 ncclResult_t
 ncclCommDeregister_impl(const ncclComm_t comm, void* handle);
 
+ncclResult_t
+ncclCommGetMemUsage_impl(const ncclComm_t comm, ncclMemUsage_t* usage);
+
+ncclResult_t
+ncclAllGatherv_impl(const void* sendbuff, size_t sendcount, void* recvbuff,
+                    const size_t recvcounts[], const size_t rdispls[],
+                    ncclDataType_t datatype, ncclComm_t comm, hipStream_t stream);
+
+ncclResult_t
+ncclReduceScatterv_impl(const void* sendbuff, const size_t sendcounts[],
+                        const size_t sdispls[], void* recvbuff, size_t recvcount,
+                        ncclDataType_t datatype, ncclRedOp_t op, ncclComm_t comm,
+                        hipStream_t stream);
+
 namespace rccl
 {
 namespace
@@ -211,10 +225,13 @@ RCCL_ASSERT_OFFSET(rcclApiFuncTable, mscclRunAlgo_fn, 33);
 RCCL_ASSERT_OFFSET(rcclApiFuncTable, mscclUnloadAlgo_fn, 34);
 RCCL_ASSERT_OFFSET(rcclApiFuncTable, ncclCommRegister_fn, 35);
 RCCL_ASSERT_OFFSET(rcclApiFuncTable, ncclCommDeregister_fn, 36);
+RCCL_ASSERT_OFFSET(rcclApiFuncTable, ncclCommGetMemUsage_fn, 37);
+RCCL_ASSERT_OFFSET(rcclApiFuncTable, ncclAllGatherv_fn, 38);
+RCCL_ASSERT_OFFSET(rcclApiFuncTable, ncclReduceScatterv_fn, 39);
 
 #undef RCCL_ASSERT_OFFSET
 
-static_assert(sizeof(rcclApiFuncTable) == compute_table_size(37),
+static_assert(sizeof(rcclApiFuncTable) == compute_table_size(40),
               "Update table major/step version and add a new offset assertion if this "
               "fails to compile");
 
@@ -261,7 +278,10 @@ RcclGetFunctionTable_impl()
                                                &mscclRunAlgo_impl,
                                                &mscclUnloadAlgo_impl,
                                                &ncclCommRegister_impl,
-                                               &ncclCommDeregister_impl };
+                                               &ncclCommDeregister_impl,
+                                               &ncclCommGetMemUsage_impl,
+                                               &ncclAllGatherv_impl,
+                                               &ncclReduceScatterv_impl };
 
 #if defined(RCCL_ROCPROFILER_REGISTER) && RCCL_ROCPROFILER_REGISTER > 0
     std::array<void*, 1>                       table_array{ tbl };
@@ -395,6 +415,16 @@ NCCL_API(ncclResult_t, ncclCommRegister, const ncclComm_t comm, void* buff, size
 
 NCCL_API(ncclResult_t, ncclCommDeregister, const ncclComm_t comm, void* handle);
 
+NCCL_API(ncclResult_t, ncclCommGetMemUsage, const ncclComm_t comm, ncclMemUsage_t* usage);
+
+NCCL_API(ncclResult_t, ncclAllGatherv, const void* sendbuff, size_t sendcount, void* recvbuff,
+         const size_t recvcounts[], const size_t rdispls[], ncclDataType_t datatype,
+         ncclComm_t comm, hipStream_t stream);
+
+NCCL_API(ncclResult_t, ncclReduceScatterv, const void* sendbuff, const size_t sendcounts[],
+         const size_t sdispls[], void* recvbuff, size_t recvcount, ncclDataType_t datatype,
+         ncclRedOp_t op, ncclComm_t comm, hipStream_t stream);
+
 ncclResult_t
 ncclAllGather(const void* sendbuff, void* recvbuff, size_t sendcount,
               ncclDataType_t datatype, ncclComm_t comm, cudaStream_t stream)
@@ -654,3 +684,29 @@ ncclCommDeregister(const ncclComm_t comm, void* handle)
 {
     return ::rccl::RcclGetFunctionTable()->ncclCommDeregister_fn(comm, handle);
 }
+
+ncclResult_t
+ncclCommGetMemUsage(const ncclComm_t comm, ncclMemUsage_t* usage)
+{
+    return ::rccl::RcclGetFunctionTable()->ncclCommGetMemUsage_fn(comm, usage);
+}
+
+ncclResult_t
+ncclAllGatherv(const void* sendbuff, size_t sendcount, void* recvbuff,
+               const size_t recvcounts[], const size_t rdispls[], ncclDataType_t datatype,
+               ncclComm_t comm, hipStream_t stream)
+{
+    return ::rccl::RcclGetFunctionTable()->ncclAllGatherv_fn(sendbuff, sendcount, recvbuff,
+                                                             recvcounts, rdispls, datatype,
+                                                             comm, stream);
+}
+
+ncclResult_t
+ncclReduceScatterv(const void* sendbuff, const size_t sendcounts[], const size_t sdispls[],
+                   void* recvbuff, size_t recvcount, ncclDataType_t datatype,
+                   ncclRedOp_t op, ncclComm_t comm, hipStream_t stream)
+{
+    return ::rccl::RcclGetFunctionTable()->ncclReduceScatterv_fn(sendbuff, sendcounts, sdispls,
+                                                                 recvbuff, recvcount, datatype,
+                                                                 op, comm, stream);
+}
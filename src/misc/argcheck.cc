@@ -7,19 +7,45 @@
 #include "argcheck.h"
 #include "comm.h"
 
+struct ncclPtrCache ncclPtrCacheGlobal;
+
+static int cudaPtrQuery(const void* pointer, uintptr_t* base, size_t* size, int* dev) {
+  hipPointerAttribute_t attr;
+  hipError_t err = hipPointerGetAttributes(&attr, pointer);
+  if (err != hipSuccess || attr.devicePointer == NULL) return 1;
+#if ROCM_VERSION < 50500
+  *dev = attr.memoryType == hipMemoryTypeDevice ? attr.device : -1;
+#else
+  *dev = attr.type == hipMemoryTypeDevice ? attr.device : -1;
+#endif
+  // Cache the whole allocation when its range is known, the pointer alone otherwise
+  hipDeviceptr_t allocBase;
+  if (hipMemGetAddressRange(&allocBase, size, (hipDeviceptr_t)pointer) == hipSuccess &&
+      (uintptr_t)allocBase <= (uintptr_t)pointer && (uintptr_t)pointer < (uintptr_t)allocBase + *size) {
+    *base = (uintptr_t)allocBase;
+  } else {
+    (void)hipGetLastError();  // Not all allocations have a known range, e.g. host memory
+    *base = (uintptr_t)pointer;
+    *size = 1;
+  }
+  return 0;
+}
+
+// Number of pointer checks after which ranges that were not allocated or registered
+// through RCCL are validated again, 0 to query them at every check
+RCCL_PARAM(PtrCacheEpoch, "PTR_CACHE_EPOCH", 256);
+
 ncclResult_t CudaPtrCheck(const void* pointer, struct ncclComm* comm, const char* ptrname, const char* opname) {
-  cudaPointerAttributes attr;
-  cudaError_t err = cudaPointerGetAttributes(&attr, pointer);
-  if (err != cudaSuccess || attr.devicePointer == NULL) {
+  int dev;
+  // Memory freed with hipFree is not erased from the cache: ranges found by a query
+  // are validated again at the next epoch, or right away for a device other than ours.
+  uint64_t epoch = ncclPtrCacheNextEpoch(&ncclPtrCacheGlobal, rcclParamPtrCacheEpoch());
+  if (ncclPtrCacheCheck(&ncclPtrCacheGlobal, pointer, cudaPtrQuery, comm->cudaDev, epoch, &dev) != 0) {
     WARN("%s : %s %p is not a valid pointer", opname, ptrname, pointer);
     return ncclInvalidArgument;
   }
-#if ROCM_VERSION < 50500
-  if (attr.memoryType == cudaMemoryTypeDevice && attr.device != comm->cudaDev) {
-#else
-  if (attr.type == cudaMemoryTypeDevice && attr.device != comm->cudaDev) {
-#endif
-    WARN("%s : %s allocated on device %d mismatchs with NCCL device %d", opname, ptrname, attr.device, comm->cudaDev);
+  if (dev != -1 && dev != comm->cudaDev) {
+    WARN("%s : %s allocated on device %d mismatchs with NCCL device %d", opname, ptrname, dev, comm->cudaDev);
     return ncclInvalidArgument;
   }
   return ncclSuccess;
@@ -137,7 +137,7 @@ static ncclResult_t mscclInternalSchedulerInit(ncclComm_t comm, int* numChannels
     return ncclSuccess;
   }
 
-  const char* mscclAlgoDir = getenv(mscclAlgoDirEnv);
+  const char* mscclAlgoDir = ncclGetEnv(mscclAlgoDirEnv);
   const char* mscclAlgoShareDir = nullptr;
   std::string mscclAlgoDirStr;
   std::string mscclAlgoShareDirStr;
@@ -212,7 +212,7 @@ ncclResult_t mscclSchedulerInit(ncclComm_t comm, int* numChannelsRequired) {
   mscclStatus& status = mscclGetStatus(comm->rank);
   bool useInternalScheduler = false;
 
-  const char* mscclSchedulerPath = getenv(mscclSchedulerPathEnv);
+  const char* mscclSchedulerPath = ncclGetEnv(mscclSchedulerPathEnv);
   if (mscclSchedulerPath) {
     status.mscclSchedulerLib = dlopen(mscclSchedulerPath, RTLD_NOW | RTLD_LOCAL);
   } else {
@@ -496,6 +496,147 @@ static inline bool isMscclppAllReduceSupported(ncclDataType_t dataType, ncclRedO
 }
 #endif
 
+// Fixed cost of an MSCCL++ operation in us, its bandwidth is taken to be the one of RCCL rings
+RCCL_PARAM(MscclppLatency, "MSCCLPP_LATENCY", 3);
+
+static int mscclFuncToColl(int func) {
+  switch (func) {
+    case mscclFuncReduce: return ncclFuncReduce;
+    case mscclFuncBroadcast: return ncclFuncBroadcast;
+    case mscclFuncAllReduce: return ncclFuncAllReduce;
+    case mscclFuncReduceScatter: return ncclFuncReduceScatter;
+    case mscclFuncAllGather: return ncclFuncAllGather;
+    default: return -1;
+  }
+}
+
+// Bytes moved by the operation as counted by the RCCL tuning model
+static size_t mscclCollBytes(ncclComm_t comm, int coll, size_t nBytes) {
+  return nBytes * (coll == ncclFuncAllGather || coll == ncclFuncReduceScatter ? comm->nRanks : 1);
+}
+
+static float rcclBackendTime(void* ctx, const struct ncclBackendOp* op) {
+  ncclComm_t comm = (ncclComm_t)ctx;
+  int coll = mscclFuncToColl(op->func);
+  if (coll == -1) return -1;
+  struct ncclInfo info;
+  memset(&info, 0, sizeof(info));
+  info.coll = (ncclFunc_t)coll;
+  info.comm = comm;
+  info.nBytes = mscclCollBytes(comm, coll, op->nBytes);
+  float best = -1;
+  for (int a : { NCCL_ALGO_TREE, NCCL_ALGO_RING }) {
+    for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+      if (p == NCCL_PROTO_LL128 && comm->topo->type != RCCL_TOPO_XGMI_ALL) continue;
+      float time;
+      if (ncclTopoGetAlgoTime(&info, a, p, 1, &time) != ncclSuccess) continue;
+      if (time >= 0 && (best < 0 || time < best)) best = time;
+    }
+  }
+  return best;
+}
+
+#ifdef ENABLE_MSCCLPP
+static float mscclppBackendTime(void* ctx, const struct ncclBackendOp* op) {
+  ncclComm_t comm = (ncclComm_t)ctx;
+  if (op->func == mscclFuncAllReduce) {
+    if (!isMscclppAllReduceSupported((ncclDataType_t)op->dataType, (ncclRedOp_t)op->redOp)) return -1;
+  } else if (op->func != mscclFuncAllGather) {
+    return -1;
+  }
+  size_t bytes = mscclCollBytes(comm, mscclFuncToColl(op->func), op->nBytes);
+  // Beyond the threshold the MSCCL++ scratch buffers are too small
+  if (bytes > comm->mscclpp_threshold) return -1;
+  float bw = 0;
+  for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) bw = std::max(bw, comm->bandwidths[mscclFuncToColl(op->func)][NCCL_ALGO_RING][p]);
+  return rcclParamMscclppLatency() + (bw > 0 ? bytes / (1000 * bw) : 0);
+}
+#endif
+
+static float mscclBackendTime(void* ctx, const struct ncclBackendOp* op) {
+  struct mscclSavedSchedulerParam* param = (struct mscclSavedSchedulerParam*)op->args;
+  if (mscclSchedulerSelectAlgo(param) != ncclSuccess || !param->p.scheduled) return -1;
+  // XML algorithms are only scheduled within the size range they were measured
+  // faster than RCCL for, and there is no model of their time to compare with
+  // RCCL's: MSCCL is untimed and takes over any operation it has an algorithm for.
+  return 0;
+}
+
+static void mscclBackendSelectorInit(ncclComm_t comm) {
+  struct ncclBackendSelector* sel = &comm->backendSelect;
+  const char* forced = ncclGetEnv("RCCL_BACKEND");
+  if (!ncclBackendSelectorInit(sel, forced)) {
+    WARN("Ignoring RCCL_BACKEND=%s, expected RCCL, MSCCL or MSCCL++", forced);
+  }
+  ncclBackendSetProvider(sel, ncclBackendRccl, rcclBackendTime, comm, true);
+  ncclBackendSetProvider(sel, ncclBackendMsccl, mscclBackendTime, comm, false);
+#ifdef ENABLE_MSCCLPP
+  ncclBackendSetProvider(sel, ncclBackendMscclpp, mscclppBackendTime, comm, true);
+#endif
+}
+
+// Backends that can run this call, beyond what the operation itself tells
+static ncclResult_t mscclBackendEligible(const void* sendBuff, void* recvBuff, size_t nBytes,
+    ncclComm_t comm, hipStream_t stream, unsigned* eligible) {
+  *eligible = 0;
+#ifdef ENABLE_MSCCLPP
+  mscclThreadLocalStatus& threadLocalStatus = mscclGetThreadLocalStatus();
+  if (comm->mscclppCompatible) {
+    if (threadLocalStatus.captureStatus == mscclUnknownCaptureStatus) {
+      INFO(NCCL_COLL, "MSCCL++: reading capture status");
+      NCCLCHECK(mscclGetCaptureStatus(comm->rank, stream));
+    }
+
+    /* check if one rank per GPU and graph mode is enabled */
+    if ((threadLocalStatus.captureStatus != mscclNoCapture) && comm->mscclCompatible && nBytes > 0 && (nBytes & 31) == 0) {
+      bool isManagedBuffer = false;
+      if (sendBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(sendBuff)));
+      if (!isManagedBuffer && recvBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(recvBuff)));
+      /* MSCCL++ not enabled for managed memory buffers */
+      if (!isManagedBuffer) *eligible |= 1u << ncclBackendMscclpp;
+    }
+  }
+#endif
+  if (comm->mscclCompatible) *eligible |= 1u << ncclBackendMsccl;
+  return ncclSuccess;
+}
+
+// Pick the backend of the last saved operation. When it is MSCCL, the algorithm is scheduled.
+static ncclResult_t mscclSelectBackend(struct mscclSavedSchedulerParam* param, size_t nBytes, int* backend) {
+  ncclComm_t comm = param->comm;
+  struct ncclBackendSelector* sel = &comm->backendSelect;
+  if (!sel->ready) mscclBackendSelectorInit(comm);
+  unsigned eligible;
+  NCCLCHECK(mscclBackendEligible(param->p.sendBuff, param->p.recvBuff, nBytes, comm, param->stream, &eligible));
+  struct ncclBackendOp op = { param->p.func, param->p.dataType, param->p.op, nBytes, param->p.sendBuff == param->p.recvBuff, param };
+  param->p.scheduled = false;
+  *backend = ncclBackendSelect(sel, &op, eligible);
+  if (*backend == ncclBackendMsccl) {
+    // A cached decision has not asked the scheduler
+    if (!param->p.scheduled) NCCLCHECK(mscclSchedulerSelectAlgo(param));
+    if (!param->p.scheduled) *backend = ncclBackendRccl;
+  } else {
+    param->p.scheduled = false;
+  }
+  TRACE(NCCL_COLL, "%s of %zu bytes on %s", mscclFuncNames[param->p.func], nBytes, ncclBackendStr[*backend]);
+  return ncclSuccess;
+}
+
+#ifdef ENABLE_MSCCLPP
+static ncclResult_t mscclppRunSavedParam(struct mscclSavedSchedulerParam* param) {
+  ncclComm_t comm = param->comm;
+  INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d root %d comm %p [nranks=%d] stream %p",
+    param->p.func == mscclFuncAllReduce ? "mscclpp_ncclAllReduce" : "mscclpp_ncclAllGather", comm->opCount, param->p.sendBuff,
+    param->p.recvBuff, param->p.count, param->p.dataType, param->p.op, param->p.root, comm, comm->nRanks, param->stream);
+  if (param->p.func == mscclFuncAllReduce) {
+    NCCLCHECK(mscclpp_ncclAllReduce(param->p.sendBuff, param->p.recvBuff, param->p.count, param->p.dataType, param->p.op, comm->mscclpp_comm, param->stream));
+  } else {
+    NCCLCHECK(mscclpp_ncclAllGather(param->p.sendBuff, param->p.recvBuff, param->p.count, param->p.dataType, comm->mscclpp_comm, param->stream));
+  }
+  return ncclSuccess;
+}
+#endif
+
 ncclResult_t mscclEnqueueCheck(
     const void* sendBuff, const size_t sendCounts[], const size_t sDisPls[],
     void* recvBuff, const size_t recvCounts[], const size_t rDisPls[],
@@ -510,89 +651,38 @@ ncclResult_t mscclEnqueueCheck(
     &threadLocalStatus.savedSchedulerParams.back()));
 
   size_t nBytes = count * ncclTypeSize(dataType);
+  int backend = ncclBackendRccl;
 
   switch (threadLocalStatus.groupStatus) {
     case mscclNoGroup:
+      NCCLCHECK(mscclSelectBackend(&threadLocalStatus.savedSchedulerParams.back(), nBytes, &backend));
 #ifdef ENABLE_MSCCLPP
-      if (comm->mscclppCompatible) {
-        if (threadLocalStatus.captureStatus == mscclUnknownCaptureStatus) {
-          INFO(NCCL_COLL, "MSCCL++: reading capture status");
-          NCCLCHECK(mscclGetCaptureStatus(comm->rank, stream));
-        }
-
-        /* check if one rank per GPU and graph mode is enabled */
-        if ((threadLocalStatus.captureStatus != mscclNoCapture) && comm->mscclCompatible && nBytes > 0 && (nBytes & 31) == 0) {
-          bool isManagedBuffer = false;
-          if (sendBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(sendBuff)));
-          if (!isManagedBuffer && recvBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(recvBuff)));
-
-          if (isManagedBuffer) { /* MSCCL++ not enabled for managed memory buffers */ }
-          else if (func == mscclFuncAllReduce && nBytes <= comm->mscclpp_threshold && isMscclppAllReduceSupported(dataType, op)) {
-            INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d root %d comm %p [nranks=%d] stream %p",
-              "mscclpp_ncclAllReduce", comm->opCount, sendBuff, recvBuff, count, dataType, op, root, comm, comm->nRanks, stream);
-            NCCLCHECK(mscclpp_ncclAllReduce(sendBuff, recvBuff, count, dataType, op, comm->mscclpp_comm, stream));
-            threadLocalStatus.savedSchedulerParams.clear();
-            break;
-          }
-          else if (func == mscclFuncAllGather && nBytes * comm->nRanks <= comm->mscclpp_threshold) {
-            INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d root %d comm %p [nranks=%d] stream %p",
-              "mscclpp_ncclAllGather", comm->opCount, sendBuff, recvBuff, count, dataType, op, root, comm, comm->nRanks, stream);
-            NCCLCHECK(mscclpp_ncclAllGather(sendBuff, recvBuff, count, dataType, comm->mscclpp_comm, stream));
-            threadLocalStatus.savedSchedulerParams.clear();
-            break;
-          }
-        }
+      if (backend == ncclBackendMscclpp) {
+        NCCLCHECK(mscclppRunSavedParam(&threadLocalStatus.savedSchedulerParams.back()));
+        threadLocalStatus.savedSchedulerParams.clear();
+        break;
       }
 #endif
-      if (comm->mscclCompatible) {
-          NCCLCHECK(mscclSchedulerSelectAlgo(&threadLocalStatus.savedSchedulerParams.back()));
-          if (threadLocalStatus.savedSchedulerParams.back().p.scheduled) {
-            NCCLCHECK(mscclRunSavedParams());
-            break;
-          }
+      if (backend == ncclBackendMsccl) {
+        NCCLCHECK(mscclRunSavedParams());
+        break;
       }
       NCCLCHECK(mscclFallBackSavedParams());
       break;
     case mscclGroupSupportedOp:
+      NCCLCHECK(mscclSelectBackend(&threadLocalStatus.savedSchedulerParams.back(), nBytes, &backend));
 #ifdef ENABLE_MSCCLPP
-      if (comm->mscclppCompatible) {
-        if (threadLocalStatus.captureStatus == mscclUnknownCaptureStatus) {
-          INFO(NCCL_COLL, "MSCCL++: reading capture status");
-          NCCLCHECK(mscclGetCaptureStatus(comm->rank, stream));
-        }
-
-        /* check if one rank per GPU and graph mode is enabled */
-        if ((threadLocalStatus.captureStatus != mscclNoCapture) && comm->mscclCompatible && nBytes > 0 && (nBytes & 31) == 0) {
-          bool isManagedBuffer = false;
-          if (sendBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(sendBuff)));
-          if (!isManagedBuffer && recvBuff) CUDACHECK(hipPointerGetAttribute(&isManagedBuffer, HIP_POINTER_ATTRIBUTE_IS_MANAGED, const_cast<void*>(recvBuff)));
-
-          if (isManagedBuffer) { /* MSCCL++ not enabled for managed memory buffers */ }
-          else if (func == mscclFuncAllReduce && nBytes <= comm->mscclpp_threshold && isMscclppAllReduceSupported(dataType, op)) {
-            INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d root %d comm %p [nranks=%d] stream %p",
-              "mscclpp_ncclAllReduce", comm->opCount, sendBuff, recvBuff, count, dataType, op, root, comm, comm->nRanks, stream);
-            NCCLCHECK(mscclpp_ncclAllReduce(sendBuff, recvBuff, count, dataType, op, comm->mscclpp_comm, stream));
-            threadLocalStatus.savedSchedulerParams.clear();
-            break;
-          }
-          else if (func == mscclFuncAllGather && nBytes * comm->nRanks <= comm->mscclpp_threshold) {
-            INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d root %d comm %p [nranks=%d] stream %p",
-              "mscclpp_ncclAllGather", comm->opCount, sendBuff, recvBuff, count, dataType, op, root, comm, comm->nRanks, stream);
-            NCCLCHECK(mscclpp_ncclAllGather(sendBuff, recvBuff, count, dataType, comm->mscclpp_comm, stream));
-            threadLocalStatus.savedSchedulerParams.clear();
-            break;
-          }
-        }
+      if (backend == ncclBackendMscclpp) {
+        NCCLCHECK(mscclppRunSavedParam(&threadLocalStatus.savedSchedulerParams.back()));
+        threadLocalStatus.savedSchedulerParams.clear();
+        break;
       }
 #endif
-      if (comm->mscclCompatible) {
-          NCCLCHECK(mscclSchedulerSelectAlgo(&threadLocalStatus.savedSchedulerParams.back()));
-          if (threadLocalStatus.savedSchedulerParams.back().p.scheduled) {
-            // Only save counts and displs when there is suitable MSCCL algorithm for this
-            NCCLCHECK(mscclSaveCountsAndDispls(&threadLocalStatus.savedSchedulerParams.back()));
-            break;
-          }
-        }
+      if (backend == ncclBackendMsccl) {
+        // Only save counts and displs when there is suitable MSCCL algorithm for this
+        NCCLCHECK(mscclSaveCountsAndDispls(&threadLocalStatus.savedSchedulerParams.back()));
+        break;
+      }
       threadLocalStatus.groupStatus = mscclGroupUnsupportedOp;
       NCCLCHECK(mscclFallBackSavedParams());
     case mscclGroupUnsupportedOp:
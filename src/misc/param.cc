@@ -8,6 +8,7 @@
 #include "debug.h"
 
 #include <algorithm>
+#include <vector>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,7 +23,86 @@ const char* userHomeDir() {
   return pwUser == NULL ? NULL : pwUser->pw_dir;
 }
 
-void setEnvFile(const char* fileName) {
+// Values of the conf files. Flat KEY=VALUE lines are applied when the environment
+// is initialized; lines under a [selector] header are kept until the hardware
+// fingerprint is known, see ncclApplyEnvProfiles.
+// Profiles call setenv while other threads may be initializing communicators, so
+// ncclGetEnv takes envLock for reading and ncclApplyEnvProfiles for writing. Params
+// already loaded from a variable a profile sets are reloaded on their next use.
+struct envSection {
+  char* selector;
+  const char* fileName;
+  int fileIndex;
+  bool applied;
+};
+
+struct envEntry {
+  int section; // -1 for flat lines
+  char* name;
+  char* value;
+};
+
+struct envOrigin {
+  char* name;
+  int rank;
+  const char* source;
+};
+
+static const char* envFileNames[2];
+static struct envSection* envSections;
+static int envNSections;
+static struct envEntry* envEntries;
+static int envNEntries;
+static struct envOrigin* envOrigins;
+static int envNOrigins;
+static pthread_rwlock_t envLock = PTHREAD_RWLOCK_INITIALIZER;
+
+struct envParamCache {
+  const char* name;
+  int64_t* cache;
+  int64_t uninitialized;
+};
+static struct envParamCache* envParamCaches;
+static int envNParamCaches;
+static pthread_mutex_t paramLock = PTHREAD_MUTEX_INITIALIZER;
+
+template <typename T>
+static T* envAppend(T** array, int* count) {
+  if ((*count & (*count-1)) == 0) {
+    T* grown = (T*)realloc(*array, sizeof(T)*std::max(2*(*count), 8));
+    if (grown == NULL) return NULL;
+    *array = grown;
+  }
+  return *array + (*count)++;
+}
+
+static struct envOrigin* envFindOrigin(const char* name) {
+  for (int i=0; i<envNOrigins; i++) if (strcmp(envOrigins[i].name, name) == 0) return envOrigins+i;
+  return NULL;
+}
+
+static int envCurrentRank(const char* name) {
+  struct envOrigin* origin = envFindOrigin(name);
+  if (origin) return origin->rank;
+  return getenv(name) ? RCCL_ENV_RANK_ENVIRONMENT : RCCL_ENV_RANK_UNSET;
+}
+
+// Set name=value if it has precedence over the current value, remember where it came from.
+static bool envSetRanked(const char* name, const char* value, int rank, const char* source) {
+  if (!rcclEnvOverrides(rank, envCurrentRank(name))) return false;
+  setenv(name, value, 1);
+  struct envOrigin* origin = envFindOrigin(name);
+  if (origin == NULL) {
+    origin = envAppend(&envOrigins, &envNOrigins);
+    if (origin == NULL) return true;
+    origin->name = strdup(name);
+  }
+  origin->rank = rank;
+  origin->source = source;
+  return true;
+}
+
+static void parseEnvFile(const char* fileName, int fileIndex) {
   FILE * file = fopen(fileName, "r");
   if (file == NULL) return;
 
@@ -31,37 +111,131 @@ void setEnvFile(const char* fileName) {
   char envValue[1024];
   size_t n = 0;
   ssize_t read;
+  int section = -1;
   while ((read = getline(&line, &n, file)) != -1) {
     if (line[read-1] == '\n') line[read-1] = '\0';
+    if (line[0] == '[') {
+      char* close = strchr(line, ']');
+      struct envSection* sec = close ? envAppend(&envSections, &envNSections) : NULL;
+      if (sec == NULL) { section = -2; continue; } // Malformed header, skip its lines
+      *close = '\0';
+      sec->selector = strdup(line+1);
+      sec->fileName = fileName;
+      sec->fileIndex = fileIndex;
+      sec->applied = false;
+      section = envNSections-1;
+      continue;
+    }
+    if (section == -2) continue;
     int s=0; // Env Var Size
     while (line[s] != '\0' && line[s] != '=') s++;
     if (line[s] == '\0') continue;
     strncpy(envVar, line, std::min(1023,s));
-    envVar[s] = '\0';
+    envVar[std::min(1023,s)] = '\0';
     s++;
     strncpy(envValue, line+s, 1023);
     envValue[1023]='\0';
-    setenv(envVar, envValue, 0);
-    //printf("%s : %s->%s\n", fileName, envVar, envValue);
+    if (section == -1) {
+      envSetRanked(envVar, envValue, rcclEnvRank(fileIndex, false), fileName);
+      //printf("%s : %s->%s\n", fileName, envVar, envValue);
+    } else {
+      struct envEntry* entry = envAppend(&envEntries, &envNEntries);
+      if (entry == NULL) continue;
+      entry->section = section;
+      entry->name = strdup(envVar);
+      entry->value = strdup(envValue);
+    }
   }
   if (line) free(line);
   fclose(file);
 }
 
-void initEnv() {
-  char confFilePath[1024];
+void setEnvFile(const char* fileName) {
+  parseEnvFile(fileName, 0);
+}
+
+static char userConfFilePath[1024];
+
+static void initEnvOnce() {
   const char * userDir = userHomeDir();
   if (userDir) {
-    sprintf(confFilePath, "%s/.rccl.conf", userDir);
-    setEnvFile(confFilePath);
+    snprintf(userConfFilePath, sizeof(userConfFilePath), "%s/.rccl.conf", userDir);
+    envFileNames[0] = userConfFilePath;
+    parseEnvFile(envFileNames[0], 0);
+  }
+  envFileNames[1] = "/etc/rccl.conf";
+  parseEnvFile(envFileNames[1], 1);
+}
+
+void initEnv() {
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, initEnvOnce);
+}
+
+void ncclApplyEnvProfiles(const struct rcclEnvFingerprint* fp) {
+  // Outcome of each entry of the matching sections, logged once envLock is released
+  // since logging may itself read the environment
+  struct envApplied {
+    int entry;
+    int section;
+    const char* ignoredBy; // NULL when the value was set
+  };
+  std::vector<struct envApplied> applied;
+  pthread_rwlock_wrlock(&envLock);
+  // Most specific sections first, so they win over less specific ones of the same file
+  std::vector<int> order, specificity(envNSections);
+  for (int i=0; i<envNSections; i++) {
+    struct envSection* sec = envSections+i;
+    if (sec->applied) continue;
+    // Sections that do not match (yet) are evaluated again for the next fingerprint
+    if (rcclEnvSectionMatch(sec->selector, fp, &specificity[i]) != rcclEnvMatch) continue;
+    sec->applied = true;
+    order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    if (envSections[a].fileIndex != envSections[b].fileIndex) return envSections[a].fileIndex < envSections[b].fileIndex;
+    return specificity[a] > specificity[b];
+  });
+  for (int m=0; m<(int)order.size(); m++) {
+    struct envSection* sec = envSections+order[m];
+    for (int e=0; e<envNEntries; e++) {
+      if (envEntries[e].section != order[m]) continue;
+      struct envApplied a = { e, order[m], NULL };
+      if (!envSetRanked(envEntries[e].name, envEntries[e].value, rcclEnvRank(sec->fileIndex, true), sec->fileName)) {
+        struct envOrigin* origin = envFindOrigin(envEntries[e].name);
+        a.ignoredBy = origin ? origin->source : "environment";
+      }
+      applied.push_back(a);
+    }
+  }
+  pthread_rwlock_unlock(&envLock);
+  if (applied.empty()) return;
+
+  // ncclLoadParam reads the environment with paramLock held, take it after envLock is released
+  pthread_mutex_lock(&paramLock);
+  for (struct envApplied& a : applied) {
+    for (int p=0; p<envNParamCaches && a.ignoredBy == NULL; p++) {
+      if (strcmp(envParamCaches[p].name, envEntries[a.entry].name) == 0) {
+        __atomic_store_n(envParamCaches[p].cache, envParamCaches[p].uninitialized, __ATOMIC_RELAXED);
+      }
+    }
+  }
+  pthread_mutex_unlock(&paramLock);
+
+  for (struct envApplied& a : applied) {
+    struct envEntry* entry = envEntries+a.entry;
+    struct envSection* sec = envSections+a.section;
+    if (a.ignoredBy) {
+      INFO(NCCL_ENV, "%s=%s from profile [%s] of %s ignored, already set by %s", entry->name, entry->value,
+           sec->selector, sec->fileName, a.ignoredBy);
+    } else {
+      INFO(NCCL_ENV, "%s set to %s by profile [%s] of %s", entry->name, entry->value, sec->selector, sec->fileName);
+    }
   }
-  sprintf(confFilePath, "/etc/rccl.conf");
-  setEnvFile(confFilePath);
 }
 
 void ncclLoadParam(char const* env, int64_t deftVal, int64_t uninitialized, int64_t* cache) {
-  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-  pthread_mutex_lock(&mutex);
+  pthread_mutex_lock(&paramLock);
   if (__atomic_load_n(cache, __ATOMIC_RELAXED) == uninitialized) {
     const char* str = ncclGetEnv(env);
     int64_t value = deftVal;
@@ -75,13 +249,24 @@ void ncclLoadParam(char const* env, int64_t deftVal, int64_t uninitialized, int6
         INFO(NCCL_ENV,"%s set by environment to %lld.", env, (long long)value);
       }
     }
+    // Remember the cache so that a profile setting env later can invalidate it
+    bool known = false;
+    for (int p=0; p<envNParamCaches && !known; p++) known = envParamCaches[p].cache == cache;
+    struct envParamCache* entry = known ? NULL : envAppend(&envParamCaches, &envNParamCaches);
+    if (entry) {
+      entry->name = env;
+      entry->cache = cache;
+      entry->uninitialized = uninitialized;
+    }
     __atomic_store_n(cache, value, __ATOMIC_RELAXED);
   }
-  pthread_mutex_unlock(&mutex);
+  pthread_mutex_unlock(&paramLock);
 }
 
 const char *ncclGetEnv(const char *name) {
-  static pthread_once_t once = PTHREAD_ONCE_INIT;
-  pthread_once(&once, initEnv);
-  return getenv(name);
+  initEnv();
+  pthread_rwlock_rdlock(&envLock);
+  const char* value = getenv(name);
+  pthread_rwlock_unlock(&envLock);
+  return value;
 }
\ No newline at end of file
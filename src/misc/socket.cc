@@ -13,7 +13,10 @@
 #include <net/if.h>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <pthread.h>
+#include <algorithm>
 #include "param.h"
+#include "if_cache.h"
 
 static ncclResult_t socketProgressOpt(int op, struct ncclSocket* sock, void* ptr, int size, int* offset, int block, int* closed) {
   int bytes = 0;
@@ -322,13 +325,9 @@ ncclResult_t ncclSocketGetAddrFromString(union ncclSocketAddress* ua, const char
   return ncclSuccess;
 }
 
-int ncclFindInterfaces(char* ifNames, union ncclSocketAddress *ifAddrs, int ifNameMaxSize, int maxIfs) {
+static int scanInterfaces(const char* env, int sock_family, char* ifNames, union ncclSocketAddress *ifAddrs, int ifNameMaxSize, int maxIfs) {
   static int shownIfName = 0;
   int nIfs = 0;
-  // Allow user to force the INET socket family selection
-  int sock_family = envSocketFamily();
-  // User specified interface
-  const char* env = ncclGetEnv("NCCL_SOCKET_IFNAME");
   if (env && strlen(env) > 1) {
     INFO(NCCL_ENV, "NCCL_SOCKET_IFNAME set by environment to %s", env);
     // Specified by user : find or fail
@@ -358,6 +357,31 @@ int ncclFindInterfaces(char* ifNames, union ncclSocketAddress *ifAddrs, int ifNa
   return nIfs;
 }
 
+/* Interface discovery walks getifaddrs() several times and is reached from
+ * bootstrap, every network init and every communicator creation. Keep the
+ * result for the process and only scan again when the settings it depends on
+ * change.
+ */
+static struct ncclIfCache<union ncclSocketAddress, MAX_IF_NAME_SIZE, MAX_IFS> ifCache;
+
+int ncclFindInterfaces(char* ifNames, union ncclSocketAddress *ifAddrs, int ifNameMaxSize, int maxIfs) {
+  // Allow user to force the INET socket family selection
+  int sock_family = envSocketFamily();
+  // User specified interface
+  const char* env = ncclGetEnv("NCCL_SOCKET_IFNAME");
+  bool cached;
+  int nIfs = ncclIfCacheGet(&ifCache, sock_family, env, ncclGetEnv("NCCL_COMM_ID"),
+    [&](char* names, union ncclSocketAddress* addrs, int nameSize, int maxScan) {
+      return scanInterfaces(env, sock_family, names, addrs, nameSize, maxScan);
+    }, ifNames, ifAddrs, ifNameMaxSize, maxIfs, &cached);
+  if (cached) TRACE(NCCL_INIT|NCCL_NET, "NET : Using cached list of %d interfaces", nIfs);
+  return nIfs;
+}
+
+void ncclSocketResetInterfaceCache() {
+  ncclIfCacheReset(&ifCache);
+}
+
 ncclResult_t ncclSocketListen(struct ncclSocket* sock) {
   if (sock == NULL) {
     WARN("ncclSocketListen: pass NULL socket");
@@ -453,7 +477,45 @@ static ncclResult_t socketFinalizeAccept(struct ncclSocket* sock) {
   return ncclSuccess;
 }
 
+RCCL_PARAM(SocketRetrySleepMax, "SOCKET_RETRY_SLEEP_MAX", 32000);
+
+static struct ncclSocketStats socketStats;
+
+void ncclSocketGetStats(struct ncclSocketStats* stats) {
+  stats->connects = __atomic_load_n(&socketStats.connects, __ATOMIC_RELAXED);
+  stats->refusedRetries = __atomic_load_n(&socketStats.refusedRetries, __ATOMIC_RELAXED);
+  stats->timedOutRetries = __atomic_load_n(&socketStats.timedOutRetries, __ATOMIC_RELAXED);
+  stats->backoffUs = __atomic_load_n(&socketStats.backoffUs, __ATOMIC_RELAXED);
+  stats->maxConnectUs = __atomic_load_n(&socketStats.maxConnectUs, __ATOMIC_RELAXED);
+}
+
+/* Wait before retrying a refused or timed out connect. The delay doubles with
+ * each retry up to RCCL_SOCKET_RETRY_SLEEP_MAX usec and is randomized in
+ * [delay/2, delay] so that ranks started together do not retry in lockstep.
+ * A timeout usually means the listener backlog overflowed and our SYN was
+ * dropped, so it moves the backoff further than a refusal. Async sockets
+ * do not sleep; they just skip connect attempts until the delay has passed.
+ */
+static void socketBackoff(struct ncclSocket* sock) {
+  static __thread unsigned int seed = 0;
+  if (seed == 0) seed = (unsigned int)(clockNano() ^ syscall(SYS_gettid));
+  int step = std::min(sock->refusedRetries + 4*sock->timedOutRetries - 1, 20);
+  uint64_t delay = std::min((uint64_t)SLEEP_INT << step, (uint64_t)std::max(rcclParamSocketRetrySleepMax(), (int64_t)SLEEP_INT));
+  delay = delay/2 + rand_r(&seed) % (delay/2+1);
+  sock->retrySleptUs += delay;
+  __atomic_fetch_add(&socketStats.backoffUs, delay, __ATOMIC_RELAXED);
+  if (sock->asyncFlag) {
+    sock->retryAtNs = clockNano() + delay*1000;
+  } else {
+    usleep(delay);
+  }
+}
+
 static ncclResult_t socketStartConnect(struct ncclSocket* sock) {
+  if (sock->retryAtNs) {
+    if (clockNano() < sock->retryAtNs) return ncclSuccess;
+    sock->retryAtNs = 0;
+  }
   /* blocking/non-blocking connect() is determined by asyncFlag. */
   int ret = connect(sock->fd, &sock->addr.sa, sock->salen);
 
@@ -464,21 +526,24 @@ static ncclResult_t socketStartConnect(struct ncclSocket* sock) {
     sock->state = ncclSocketStateConnectPolling;
     return ncclSuccess;
   } else if (errno == ECONNREFUSED) {
-    if (++sock->refusedRetries == RETRY_REFUSED_TIMES) {
+    ++sock->refusedRetries;
+    __atomic_fetch_add(&socketStats.refusedRetries, 1, __ATOMIC_RELAXED);
+    if (sock->retrySleptUs >= RETRY_REFUSED_TIMES*SLEEP_INT) {
       sock->state = ncclSocketStateError;
       WARN("socketStartConnect: exceeded retries (%d)", sock->refusedRetries);
       return ncclRemoteError;
     }
-    usleep(SLEEP_INT);
-    if (sock->refusedRetries % 1000 == 0) INFO(NCCL_ALL, "Call to connect returned %s, retrying", strerror(errno));
+    if (sock->refusedRetries % 100 == 0) INFO(NCCL_ALL, "Call to connect returned %s, retrying", strerror(errno));
+    socketBackoff(sock);
     return ncclSuccess;
   } else if (errno == ETIMEDOUT) {
+    __atomic_fetch_add(&socketStats.timedOutRetries, 1, __ATOMIC_RELAXED);
     if (++sock->timedOutRetries == RETRY_TIMEDOUT_TIMES) {
       sock->state = ncclSocketStateError;
       WARN("socketStartConnect: exceeded timeouts (%d)", sock->timedOutRetries);
       return ncclRemoteError;
     }
-    usleep(SLEEP_INT);
+    socketBackoff(sock);
     return ncclSuccess;
   } else {
     char line[SOCKET_NAME_MAXLEN+1];
@@ -513,21 +578,24 @@ static ncclResult_t socketPollConnect(struct ncclSocket* sock) {
   if (ret == 0) {
     sock->state = ncclSocketStateConnected;
   } else if (ret == ECONNREFUSED) {
-    if (++sock->refusedRetries == RETRY_REFUSED_TIMES) {
+    ++sock->refusedRetries;
+    __atomic_fetch_add(&socketStats.refusedRetries, 1, __ATOMIC_RELAXED);
+    if (sock->retrySleptUs >= RETRY_REFUSED_TIMES*SLEEP_INT) {
       sock->state = ncclSocketStateError;
       WARN("socketPollConnect: exceeded retries (%d)", sock->refusedRetries);
       return ncclRemoteError;
     }
-    if (sock->refusedRetries % 1000 == 0) INFO(NCCL_ALL, "Call to connect returned %s, retrying", strerror(errno));
-    usleep(SLEEP_INT);
+    if (sock->refusedRetries % 100 == 0) INFO(NCCL_ALL, "Call to connect returned %s, retrying", strerror(ret));
+    socketBackoff(sock);
     sock->state = ncclSocketStateConnecting;
   } else if (ret == ETIMEDOUT) {
+    __atomic_fetch_add(&socketStats.timedOutRetries, 1, __ATOMIC_RELAXED);
     if (++sock->timedOutRetries == RETRY_TIMEDOUT_TIMES) {
       sock->state = ncclSocketStateError;
       WARN("socketPollConnect: exceeded timeouts (%d)", sock->timedOutRetries);
       return ncclRemoteError;
     }
-    usleep(SLEEP_INT);
+    socketBackoff(sock);
     sock->state = ncclSocketStateConnecting;
   } else if (ret != EINPROGRESS) {
     sock->state = ncclSocketStateError;
@@ -555,6 +623,10 @@ static ncclResult_t socketFinalizeConnect(struct ncclSocket* sock) {
   sent = 0;
   NCCLCHECK(socketWait(NCCL_SOCKET_SEND, sock, &sock->type, sizeof(sock->type), &sent));
   sock->state = ncclSocketStateReady;
+  uint64_t connectUs = (clockNano() - sock->connectStartNs) / 1000;
+  __atomic_fetch_add(&socketStats.connects, 1, __ATOMIC_RELAXED);
+  uint64_t maxUs = __atomic_load_n(&socketStats.maxConnectUs, __ATOMIC_RELAXED);
+  while (connectUs > maxUs && !__atomic_compare_exchange_n(&socketStats.maxConnectUs, &maxUs, connectUs, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
   return ncclSuccess;
 }
 
@@ -617,6 +689,7 @@ ncclResult_t ncclSocketConnect(struct ncclSocket* sock) {
   SYSCHECK(setsockopt(sock->fd, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(int)), "setsockopt");
 
   sock->state = ncclSocketStateConnecting;
+  sock->connectStartNs = clockNano();
   do {
     NCCLCHECK(socketProgressState(sock));
   } while (sock->asyncFlag == 0 &&
@@ -698,6 +771,9 @@ ncclResult_t ncclSocketInit(struct ncclSocket* sock, union ncclSocketAddress* ad
   if (sock == NULL) goto exit;
   sock->timedOutRetries = 0;
   sock->refusedRetries = 0;
+  sock->retrySleptUs = 0;
+  sock->retryAtNs = 0;
+  sock->connectStartNs = 0;
   sock->abortFlag = abortFlag;
   sock->asyncFlag = asyncFlag;
   sock->state = ncclSocketStateInitialized;
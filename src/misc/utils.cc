@@ -10,6 +10,8 @@
 #include "nvmlwrap.h"
 
 #include <stdlib.h>
+#include <mutex>
+#include <unordered_map>
 
 // Get current Compute Capability
 int ncclCudaCompCap() {
@@ -195,6 +197,46 @@ bool matchIfList(const char* string, int port, struct netIf* ifList, int listSiz
 
 __thread struct ncclThreadSignal ncclThreadSignalLocalInstance = ncclThreadSignalStaticInitializer();
 
+__thread struct ncclMemAccount* ncclMemAccountCurrent = nullptr;
+__thread int ncclMemCategoryCurrent = ncclMemOther;
+
+struct ncclMemCharge {
+  struct ncclMemAccount* account;
+  int kind;
+  int category;
+  size_t size;
+};
+// Allocated on first use, frees may still run from static destructors
+static std::unordered_map<uintptr_t, struct ncclMemCharge>* ncclMemCharges;
+static std::mutex ncclMemChargesLock;
+
+void ncclMemAccountCharge(const void* ptr, int kind, size_t size) {
+  struct ncclMemAccount* account = ncclMemAccountCurrent;
+  if (account == nullptr || ptr == nullptr) return;
+  ncclMemAccountAdd(account, kind, ncclMemCategoryCurrent, size);
+  std::lock_guard<std::mutex> lock(ncclMemChargesLock);
+  if (ncclMemCharges == nullptr) ncclMemCharges = new std::unordered_map<uintptr_t, struct ncclMemCharge>();
+  (*ncclMemCharges)[(uintptr_t)ptr] = { account, kind, ncclMemCategoryCurrent, size };
+}
+
+void ncclMemAccountUncharge(const void* ptr) {
+  std::lock_guard<std::mutex> lock(ncclMemChargesLock);
+  if (ncclMemCharges == nullptr || ptr == nullptr) return;
+  auto it = ncclMemCharges->find((uintptr_t)ptr);
+  if (it == ncclMemCharges->end()) return;
+  ncclMemAccountRelease(it->second.account, it->second.kind, it->second.category, it->second.size);
+  ncclMemCharges->erase(it);
+}
+
+void ncclMemAccountForget(struct ncclMemAccount* account) {
+  std::lock_guard<std::mutex> lock(ncclMemChargesLock);
+  if (ncclMemCharges == nullptr) return;
+  for (auto it = ncclMemCharges->begin(); it != ncclMemCharges->end(); ) {
+    if (it->second.account == account) it = ncclMemCharges->erase(it);
+    else it++;
+  }
+}
+
 void* ncclMemoryStack::allocateSpilled(struct ncclMemoryStack* me, size_t size, size_t align) {
   // `me->hunks` points to the top of the stack non-empty hunks. Hunks above
   // this (reachable via `->above`) are empty.
@@ -235,6 +277,7 @@ void* ncclMemoryStack::allocateSpilled(struct ncclMemoryStack* me, size_t size,
     INFO(NCCL_ALLOC, "%s:%d memory stack hunk malloc(%llu)", __FILE__, __LINE__, (unsigned long long)mallocSize);
     struct Hunk *top1 = (struct Hunk*)malloc(mallocSize);
     if (top1 == nullptr) goto malloc_exhausted;
+    ncclMemAccountCharge(top1, ncclMemKindHost, mallocSize);
     top1->size = nextSize;
     top1->above = nullptr;
     if (top) top->above = top1;
@@ -287,6 +330,7 @@ void ncclMemoryStackDestruct(struct ncclMemoryStack* me) {
   struct ncclMemoryStack::Hunk* h = me->stub.above;
   while (h != nullptr) {
     struct ncclMemoryStack::Hunk *h1 = h->above;
+    ncclMemAccountUncharge(h);
     free(h);
     h = h1;
   }
@@ -551,7 +551,18 @@ ncclResult_t ncclProxySaveOp(struct ncclComm* comm, struct ncclProxyOp* op, bool
       }
     } break;
   case ncclPatternTreeUp:
-  case ncclPatternTreeDown:
+  case ncclPatternTreeDown: {
+      // Broadcast (down) and Reduce (up) from any root: data flows through the
+      // neighbour leading to the root and all the other neighbours
+      struct ncclTree* tree = &channel->tree;
+      int toRoot = ncclTreeRootPeer(tree->up, tree->down, comm->treeToRoot[op->channelId*comm->nRanks + op->root]);
+      int fromRoot = op->pattern == ncclPatternTreeDown ? proxySend : proxyRecv;
+      for (int i=0; i<NCCL_MAX_TREE_ARITY; i++) {
+        if (tree->down[i] != toRoot) NCCLCHECK(SaveProxy(comm, channel, fromRoot, tree->down[i], op, 0, justInquire));
+      }
+      if (tree->up != toRoot) NCCLCHECK(SaveProxy(comm, channel, fromRoot, tree->up, op, 0, justInquire));
+      NCCLCHECK(SaveProxy(comm, channel, fromRoot == proxySend ? proxyRecv : proxySend, toRoot, op, 0, justInquire));
+    } break;
   case ncclPatternTreeUpDown: {
       if (op->pattern != ncclPatternTreeDown) { // Tree up
         struct ncclTree* tree = &channel->tree;
@@ -1022,6 +1033,27 @@ struct ncclProxyInitResp {
   char devShmPath[6]; // "XXXXXX" - May or may not be set
 };
 
+static ncclResult_t proxyConnectFinish(struct ncclComm* comm, int transport, int send, struct ncclProxyConnector* proxyConn, struct ncclProxyInitResp* resp) {
+  struct ncclProxyState* sharedProxyState = comm->proxyState;
+  proxyConn->connection = resp->connection;
+
+  // If we need proxy progress, map progress ops
+  struct ncclTransportComm* tcomm = send ? &ncclTransports[transport]->send : &ncclTransports[transport]->recv;
+  if (tcomm->proxyProgress) {
+    char poolPath[] = "/dev/shm/nccl-XXXXXX";
+    strncpy(poolPath+sizeof("/dev/shm/nccl-")-1, resp->devShmPath, sizeof("XXXXXX")-1);
+    struct ncclProxyOps* proxyOps = sharedProxyState->proxyOps + proxyConn->tpLocalRank;
+    if (proxyOps->pool == NULL) {
+      NCCLCHECK(ncclShmOpen(poolPath, sizeof(struct ncclProxyOpsPool), (void**)(&proxyOps->pool), NULL, 0, &proxyOps->handle));
+      proxyOps->nextOps = proxyOps->nextOpsEnd = proxyOps->freeOp = -1;
+    }
+  }
+  INFO(NCCL_NET|NCCL_PROXY, "Connected to proxy localRank %d -> connection %p", proxyConn->tpLocalRank, proxyConn->connection);
+  return ncclSuccess;
+}
+
+static ncclResult_t proxyBatchQueue(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize, struct ncclProxyDeferredCall** call);
+
 ncclResult_t ncclProxyConnect(struct ncclComm* comm, int transport, int send, int tpProxyRank, struct ncclProxyConnector* proxyConn) {
   struct ncclSocket* sock;
   int ready, proxyRank = -1;
@@ -1063,24 +1095,20 @@ ncclResult_t ncclProxyConnect(struct ncclComm* comm, int transport, int send, in
   req.tpRank = comm->topParentRanks[comm->rank];
   req.sameProcess = proxyConn->sameProcess;
 
+  if (comm->proxyBatch.active) {
+    // Completed by proxyConnectFinish() in ncclProxyBatchEnd()
+    struct ncclProxyDeferredCall* call;
+    NCCLCHECK(proxyBatchQueue(comm, proxyConn, ncclProxyMsgInit, &req, sizeof(req), NULL, sizeof(struct ncclProxyInitResp), &call));
+    call->transport = transport;
+    call->send = send;
+    return ncclSuccess;
+  }
+
   struct ncclProxyInitResp resp = {0};
   // This usually sends proxyConn->connection to identify which connection this is.
   // However, this is part of the response and therefore is ignored
   NCCLCHECK(ncclProxyCallBlocking(comm, proxyConn, ncclProxyMsgInit, &req, sizeof(req), &resp, sizeof(resp)));
-  proxyConn->connection = resp.connection;
-
-  // If we need proxy progress, map progress ops
-  struct ncclTransportComm* tcomm = send ? &ncclTransports[transport]->send : &ncclTransports[transport]->recv;
-  if (tcomm->proxyProgress) {
-    char poolPath[] = "/dev/shm/nccl-XXXXXX";
-    strncpy(poolPath+sizeof("/dev/shm/nccl-")-1, resp.devShmPath, sizeof("XXXXXX")-1);
-    struct ncclProxyOps* proxyOps = sharedProxyState->proxyOps + proxyConn->tpLocalRank;
-    if (proxyOps->pool == NULL) {
-      NCCLCHECK(ncclShmOpen(poolPath, sizeof(struct ncclProxyOpsPool), (void**)(&proxyOps->pool), NULL, 0, &proxyOps->handle));
-      proxyOps->nextOps = proxyOps->nextOpsEnd = proxyOps->freeOp = -1;
-    }
-  }
-  INFO(NCCL_NET|NCCL_PROXY, "Connected to proxy localRank %d -> connection %p", proxyConn->tpLocalRank, proxyConn->connection);
+  NCCLCHECK(proxyConnectFinish(comm, transport, send, proxyConn, &resp));
   return ncclSuccess;
 }
 
@@ -1141,13 +1169,17 @@ error:
   return ret;
 }
 
-const char* ncclProxyMsgTypeStr[] = { "Unknown", "Init", "SharedInit", "Setup", "Connect", "Start", "Close", "Abort", "Stop", "GetFd" };
+const char* ncclProxyMsgTypeStr[] = { "Unknown", "Init", "SharedInit", "Setup", "Connect", "Start", "Close", "Abort", "Stop", "GetFd", "Batch" };
+static ncclResult_t proxyBatchFlush(struct ncclComm* comm);
+
 ncclResult_t ncclProxyCallAsync(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, int respSize, void* opId) {
   struct ncclSocket* sock;
   ncclResult_t ret = ncclSuccess;
   struct ncclProxyState* sharedProxyState = comm->proxyState;
 
   if (sharedProxyState->peerSocks == NULL) return ncclInternalError;
+  // Keep the order of requests: anything queued goes first
+  if (comm->proxyBatch.count) NCCLCHECK(proxyBatchFlush(comm));
 
   sock = sharedProxyState->peerSocks + proxyConn->tpLocalRank;
   if (sock == NULL) return ncclInternalError;
@@ -1246,6 +1278,85 @@ fail:
   goto exit;
 }
 
+static ncclResult_t proxyBatchQueue(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize, struct ncclProxyDeferredCall** call) {
+  int res = ncclProxyBatchPush(&comm->proxyBatch, proxyConn, proxyConn->tpLocalRank, proxyConn->connection, type, type == ncclProxyMsgInit,
+                               reqBuff, reqSize, respBuff, respSize, call);
+  if (res == ncclProxyBatchNotConnected) {
+    // Until its Init is answered, proxyConn has no connection to name; the Init has to be queued first.
+    WARN("Proxy call %s queued on a connector which is not connected", ncclProxyMsgTypeStr[type]);
+    return ncclInternalError;
+  }
+  if (res != ncclProxyBatchOk) {
+    WARN("Failed to queue proxy call %s", ncclProxyMsgTypeStr[type]);
+    return ncclSystemError;
+  }
+  return ncclSuccess;
+}
+
+// Send all queued calls, one ncclProxyMsgBatch message per proxy, then wait for all responses.
+static ncclResult_t proxyBatchFlush(struct ncclComm* comm) {
+  ncclResult_t ret = ncclSuccess, res;
+  struct ncclProxyBatch* batch = &comm->proxyBatch;
+  struct ncclProxyState* sharedProxyState = comm->proxyState;
+  int count = batch->count;
+  int nMsgs = 0;
+  char* msg = NULL;
+  // Calls are answered before the batch can be reused
+  batch->count = 0;
+  if (count == 0) return ncclSuccess;
+
+  for (int first=0; first<count; first++) {
+    if (batch->calls[first].batchIndex != -1) continue;
+    int n;
+    size_t size = ncclProxyBatchPack(batch, count, first, ncclProxyMsgBatch, NULL, &n);
+    free(msg);
+    NCCLCHECKGOTO(ncclCalloc(&msg, size), ret, exit);
+    ncclProxyBatchPack(batch, count, first, ncclProxyMsgBatch, msg, NULL);
+    for (int i=first; i<count; i++) {
+      struct ncclProxyDeferredCall* c = batch->calls+i;
+      if (c->tpLocalRank == batch->calls[first].tpLocalRank) NCCLCHECKGOTO(expectedProxyResponseEnqueue(sharedProxyState, c, c->respSize), ret, exit);
+    }
+    NCCLCHECKGOTO(ncclSocketSend(sharedProxyState->peerSocks + batch->calls[first].tpLocalRank, msg, size), ret, exit);
+    nMsgs++;
+  }
+  INFO(NCCL_PROXY, "Sent %d proxy calls in %d batch messages", count, nMsgs);
+
+  for (int i=0; i<count; i++) {
+    struct ncclProxyDeferredCall* c = batch->calls+i;
+    do {
+      res = ncclPollProxyResponse(comm, c->proxyConn, c->respBuff, c);
+    } while (res == ncclInProgress);
+    if (res == ncclSuccess && c->isInit) {
+      res = proxyConnectFinish(comm, c->transport, c->send, c->proxyConn, (struct ncclProxyInitResp*)c->respBuff);
+    }
+    if (res != ncclSuccess && ret == ncclSuccess) {
+      WARN("Batched proxy call %s to localRank %d failed : %d", ncclProxyMsgTypeStr[c->type], c->tpLocalRank, res);
+      ret = res;
+    }
+  }
+exit:
+  ncclProxyBatchRelease(batch, count);
+  free(msg);
+  return ret;
+}
+
+ncclResult_t ncclProxyBatchBegin(struct ncclComm* comm) {
+  comm->proxyBatch.active = 1;
+  return ncclSuccess;
+}
+
+ncclResult_t ncclProxyCallDeferred(struct ncclComm* comm, struct ncclProxyConnector* proxyConn, int type, void* reqBuff, int reqSize, void* respBuff, int respSize) {
+  if (!comm->proxyBatch.active) return ncclProxyCallBlocking(comm, proxyConn, type, reqBuff, reqSize, respBuff, respSize);
+  NCCLCHECK(proxyBatchQueue(comm, proxyConn, type, reqBuff, reqSize, respBuff, respSize, NULL));
+  return ncclSuccess;
+}
+
+ncclResult_t ncclProxyBatchEnd(struct ncclComm* comm) {
+  comm->proxyBatch.active = 0;
+  NCCLCHECK(proxyBatchFlush(comm));
+  return ncclSuccess;
+}
+
 static ncclResult_t proxyProgressInit(struct ncclProxyState* proxyState) {
   struct ncclProxyProgressState* state = &proxyState->progressState;
   if (state->opsPool == NULL) {
@@ -1352,9 +1463,17 @@ error:
 #endif
 }
 
+// Memory category charged for allocations made while serving a setup/connect request
+static int proxyMemCategory(struct ncclProxyConnection* connection, int type) {
+  if (connection == NULL) return ncclMemOther;
+  if (type == ncclProxyMsgSharedInit || connection->shared) return ncclMemProxyShared;
+  return ncclMemBuffP2p + connection->transport;
+}
+
 static ncclResult_t proxyProgressAsync(struct ncclProxyAsyncOp* op, struct ncclProxyState* proxyState, int* asyncOpCount, struct ncclProxyLocalPeer* peer, struct ncclProxyConnectionPool* connectionPool) {
   int done = 1;
   ncclResult_t res = ncclInternalError;
+  ncclMemAccountGuard memGuard(&proxyState->memAccount, proxyMemCategory(op->connection, op->type));
   if (op->type == ncclProxyMsgSetup) {
     TRACE(NCCL_PROXY, "proxyProgressAsync::proxySetup() opId=%p", op->opId);
     res = op->connection->tcomm->proxySetup(op->connection, proxyState, op->reqBuff, op->reqSize, op->respBuff, op->respSize, &done);
@@ -1371,6 +1490,7 @@ static ncclResult_t proxyProgressAsync(struct ncclProxyAsyncOp* op, struct ncclP
   else if (op->type == ncclProxyMsgInit) {
     TRACE(NCCL_PROXY, "proxyProgressAsync::ncclProxyMsgInit opId=%p op.reqBuff=%p", op->opId, op->reqBuff);
     res = proxyConnInit(peer, connectionPool, proxyState, (ncclProxyInitReq*) op->reqBuff, (ncclProxyInitResp*) op->respBuff, &op->connection);
+    if (res == ncclSuccess && peer->batchConns) peer->batchConns[peer->batchIndex] = op->connection;
   } else return ncclInternalError;
 
   if (done) {
@@ -1405,6 +1525,14 @@ static ncclResult_t proxyProgressAsync(struct ncclProxyAsyncOp* op, struct ncclP
   return ncclInProgress;
 }
 
+// Answer a call that cannot run with an error, the way proxyProgressAsync answers
+static ncclResult_t proxyServiceReplyError(struct ncclSocket* sock, struct ncclProxyAsyncOp* op) {
+  ncclProxyRpcResponseHeader resp = {op->opId, ncclInternalError, op->respSize};
+  NCCLCHECK(ncclSocketSend(sock, &resp, sizeof(resp)));
+  if (op->respSize) NCCLCHECK(ncclSocketSend(sock, op->respBuff, op->respSize));
+  return ncclSuccess;
+}
+
 static ncclResult_t proxyServiceInitOp(int type, struct ncclProxyLocalPeer* peer, struct ncclProxyConnectionPool* connectionPool, struct ncclProxyState* proxyState, int* asyncOpCount) {
   struct ncclSocket* sock = &peer->sock;
   struct ncclProxyAsyncOp* asyncOp;
@@ -1412,7 +1540,6 @@ static ncclResult_t proxyServiceInitOp(int type, struct ncclProxyLocalPeer* peer
 
   asyncOp->type = type;
   NCCLCHECK(ncclSocketRecv(sock, &asyncOp->connection, sizeof(void*)));
-
   NCCLCHECK(ncclSocketRecv(sock, &asyncOp->reqSize, sizeof(int)));
   NCCLCHECK(ncclSocketRecv(sock, &asyncOp->respSize, sizeof(int)));
   if (asyncOp->reqSize) {
@@ -1425,6 +1552,22 @@ static ncclResult_t proxyServiceInitOp(int type, struct ncclProxyLocalPeer* peer
 
   if (asyncOp->respSize) NCCLCHECK(ncclCalloc(&asyncOp->respBuff, asyncOp->respSize));
 
+  if (peer->batchConns) {
+    // May name the connection created by an earlier Init of the same batch
+    void* connection;
+    if (!ncclProxyBatchResolve(asyncOp->connection, peer->batchConns, peer->batchIndex, &connection)) {
+      // That Init failed and got an error response; fail this call the same way and
+      // go on with the rest of the batch
+      WARN("[Proxy Service] Batched %s refers to invalid Init %d", ncclProxyMsgTypeStr[type], (int)((uintptr_t)asyncOp->connection >> 1));
+      ncclResult_t ret = proxyServiceReplyError(sock, asyncOp);
+      free(asyncOp->reqBuff);
+      free(asyncOp->respBuff);
+      free(asyncOp);
+      return ret;
+    }
+    asyncOp->connection = (struct ncclProxyConnection*)connection;
+  }
+
   asyncProxyOpEnqueue(peer, asyncOp);
 
   (*asyncOpCount)++;
@@ -1434,6 +1577,39 @@ static ncclResult_t proxyServiceInitOp(int type, struct ncclProxyLocalPeer* peer
 
 #include <poll.h>
 
+static bool proxyMatchOpType(int type);
+
+// A batch is a count followed by that many regular requests; they are all
+// initiated before we get back to polling.
+static ncclResult_t proxyServiceInitBatch(struct ncclProxyLocalPeer* peer, struct ncclProxyConnectionPool* connectionPool, struct ncclProxyState* proxyState, int* asyncOpCount) {
+  ncclResult_t ret = ncclSuccess;
+  int n;
+  NCCLCHECK(ncclSocketRecv(&peer->sock, &n, sizeof(int)));
+  if (n <= 0) return ncclSuccess;
+  NCCLCHECK(ncclCalloc(&peer->batchConns, n));
+  for (peer->batchIndex = 0; peer->batchIndex < n; peer->batchIndex++) {
+    int type;
+    NCCLCHECKGOTO(ncclSocketRecv(&peer->sock, &type, sizeof(int)), ret, exit);
+    if (!proxyMatchOpType(type) || type == ncclProxyMsgGetFd) {
+      WARN("[Proxy Service] Unexpected command %d in batch from localRank %d", type, peer->tpLocalRank);
+      ret = ncclInternalError;
+      goto exit;
+    }
+    ret = proxyServiceInitOp(type, peer, connectionPool, proxyState, asyncOpCount);
+    if (ret != ncclSuccess) {
+      // Read the calls left so that the stream stays in sync with the client
+      WARN("[Proxy Service] %s %d of batch from localRank %d failed, skipping the %d calls left", ncclProxyMsgTypeStr[type], peer->batchIndex, peer->tpLocalRank, n-1-peer->batchIndex);
+      ncclProxyBatchSkip(n-1-peer->batchIndex, [&](void* buf, int size) { return ncclSocketRecv(&peer->sock, buf, size); });
+      goto exit;
+    }
+  }
+  INFO(NCCL_PROXY, "[Proxy Service] Initiated batch of %d operations from localRank %d", n, peer->tpLocalRank);
+exit:
+  free(peer->batchConns);
+  peer->batchConns = NULL;
+  return ret;
+}
+
 static bool proxyMatchOpType(int type) {
   switch (type) {
     case ncclProxyMsgInit:
@@ -1557,6 +1733,8 @@ void* ncclProxyService(void* _args) {
             closeConn = 1;
           } else if (type == ncclProxyMsgClose) {
             closeConn = 1;
+          } else if (type == ncclProxyMsgBatch) {
+            res = proxyServiceInitBatch(peers+s, &connectionPool, proxyState, &asyncOpCount);
           } else if (proxyMatchOpType(type)) {
             res = proxyServiceInitOp(type, peers+s, &connectionPool, proxyState, &asyncOpCount);
           } else {
@@ -1691,6 +1869,7 @@ ncclResult_t ncclProxyCreate(struct ncclComm* comm) {
     proxyState->abortFlag = comm->abortFlag;
     proxyState->p2pnChannels = comm->p2pnChannels;
     proxyState->p2pChunkSize = comm->p2pChunkSize;
+    proxyState->p2pSharedSteps = comm->p2pSharedSteps;
     proxyState->nChannels = comm->nChannels;
     proxyState->allocP2pNetLLBuffers = comm->allocP2pNetLLBuffers;
     proxyState->dmaBufSupport = comm->dmaBufSupport;
@@ -1710,6 +1889,10 @@ ncclResult_t ncclProxyCreate(struct ncclComm* comm) {
 }
 
 ncclResult_t ncclProxyStop(struct ncclComm* comm) {
+  // Calls still queued, e.g. after a failed init, will not be answered anymore
+  int dropped = ncclProxyBatchFree(&comm->proxyBatch);
+  if (dropped) INFO(NCCL_PROXY, "Dropped %d queued proxy calls", dropped);
+
   if (comm->proxyState) {
     struct ncclProxyState* sharedProxyState = comm->proxyState;
 
@@ -1766,6 +1949,7 @@ ncclResult_t ncclProxyDestroy(struct ncclComm* comm) {
   free(sharedProxyState->proxyOps);
   free(sharedProxyState->sharedDevMems);
   expectedProxyResponseFree(sharedProxyState);
+  ncclMemAccountForget(&sharedProxyState->memAccount);
   free(sharedProxyState);
   return ncclSuccess;
 }
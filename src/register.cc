@@ -123,6 +123,7 @@ ncclResult_t ncclRegister(struct ncclComm* comm, void* data, size_t size, void**
       regSlot->refs = 1;
       NCCLCHECK(ncclNetRegister(comm, (void*)addr, pages*pageSize, regSlot));
       regSlot->state |= NET_REG_COMPLETE;
+      ncclMemAccountAdd(&comm->memAccount, ncclMemKindDevice, ncclMemRegistered, pages*pageSize);
       cache->population += 1;
       *handle = regSlot;
       return ncclSuccess;
@@ -156,6 +157,7 @@ ncclResult_t ncclCommRegister_impl(const ncclComm_t comm, void* buff, size_t siz
   NCCLCHECK(PtrCheck(comm, "ncclCommRegister", "comm"));
   if (comm->checkPointers) NCCLCHECK(CudaPtrCheck(buff, comm, "buff", "ncclCommRegister"));
   NCCLCHECK(ncclRegister(comm, buff, size, handle));
+  ncclPtrCacheInsert(&ncclPtrCacheGlobal, buff, size, comm->cudaDev, NCCL_PTR_CACHE_OWNED);
   return ncclSuccess;
 }
 
@@ -176,6 +178,8 @@ ncclResult_t ncclCommDeregister_impl(const ncclComm_t comm, void* handle) {
     NCCLCHECK(ncclNvlsDeregBuffer(&reg->mcHandle, reg->regAddr, reg->dev, reg->regSize));
     reg->regAddr = (CUdeviceptr)NULL;
   }
+  ncclMemAccountRelease(&comm->memAccount, ncclMemKindDevice, ncclMemRegistered, reg->pages*cache->pageSize);
+  ncclPtrCacheErase(&ncclPtrCacheGlobal, (void*)reg->addr, reg->pages*cache->pageSize);
   free(reg);
   memmove(cache->slots+slot, cache->slots+slot+1, (cache->population-slot-1)*sizeof(struct ncclReg*));
   cache->population -= 1;
@@ -18,6 +18,14 @@ struct ncclTransport* ncclTransports[NTRANSPORTS] = {
   &collNetTransport
 };
 
+// Memory category for protocol buffers allocated while setting up or connecting a connector
+static int transportMemCategory(struct ncclTransportComm* transportComm) {
+  for (int t=0; t<NTRANSPORTS; t++) {
+    if (transportComm == &ncclTransports[t]->send || transportComm == &ncclTransports[t]->recv) return ncclMemBuffP2p + t;
+  }
+  return ncclMemOther;
+}
+
 template <int type>
 static ncclResult_t selectTransport(struct ncclComm* comm, struct ncclTopoGraph* graph, struct ncclConnect* connect, int channelId, int peer, int connIndex, int* transportType, bool* needsProxy) {
   struct ncclPeerInfo* myInfo = comm->peerInfo+comm->rank;
@@ -42,6 +50,7 @@ static ncclResult_t selectTransport(struct ncclComm* comm, struct ncclTopoGraph*
     NCCLCHECK(transport->canConnect(&ret, comm->topo, graph, myInfo, peerInfo));
     if (ret) {
       connector->transportComm = transportComm;
+      ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemBuffP2p + t);
       NCCLCHECK(transportComm->setup(comm, graph, myInfo, peerInfo, connect, connector, channelId, connIndex));
       if (transportType) *transportType = t;
       if (needsProxy) *needsProxy = (transportComm->proxyProgress != NULL);
@@ -140,6 +149,8 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
     int sendChannels = 0, recvChannels = 0;
     int type;
     bool proxy;
+    // Proxy setup calls for all channels of this peer pair go out in one batch
+    NCCLCHECKGOTO(ncclProxyBatchBegin(comm), ret, fail);
     TIME_START(0);
     for (int c=0; c<MAXCHANNELS; c++) {
       //if (recvMask & (1UL<<c)) {
@@ -160,6 +171,8 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
       }
     }
     TIME_STOP(1);
+    // Setup responses are part of data[p], so they must be in before the exchange
+    NCCLCHECKGOTO(ncclProxyBatchEnd(comm), ret, fail);
 
     TIME_START(2);
     if (sendPeer == recvPeer) {
@@ -183,6 +196,7 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
       allChannelsConnected = false;
       while (!allChannelsConnected) {
         allChannelsConnected = true;
+        NCCLCHECKGOTO(ncclProxyBatchBegin(comm), ret, fail);
         for (int j=done+1; j<=i; j++) {
           int recvPeer = (comm->rank - j + comm->nRanks) % comm->nRanks;
           int sendPeer = (comm->rank + j) % comm->nRanks;
@@ -201,6 +215,7 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
               struct ncclConnector* conn = comm->channels[c].peers[sendPeer]->send + connIndex;
               // This connector hasn't completed connection yet
               if (conn->connected == 0) {
+                ncclMemAccountGuard memGuard(&comm->memAccount, transportMemCategory(conn->transportComm));
                 NCCLCHECKGOTO(conn->transportComm->connect(comm, sendData[p] + sendDataOffset++, 1, comm->rank, conn), ret, fail);
                 if (ret == ncclSuccess) {
                   conn->connected = 1;
@@ -220,6 +235,7 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
               struct ncclConnector* conn = comm->channels[c].peers[recvPeer]->recv + connIndex;
               // This connector hasn't completed connection yet
               if (conn->connected == 0) {
+                ncclMemAccountGuard memGuard(&comm->memAccount, transportMemCategory(conn->transportComm));
                 NCCLCHECKGOTO(conn->transportComm->connect(comm, recvData[p] + recvDataOffset++, 1, comm->rank, conn), ret, fail);
                 if (ret == ncclSuccess) {
                   conn->connected = 1;
@@ -245,6 +261,7 @@ ncclResult_t ncclTransportP2pSetup(struct ncclComm* comm, struct ncclTopoGraph*
             data[p] = NULL;
           }
         }
+        NCCLCHECKGOTO(ncclProxyBatchEnd(comm), ret, fail);
 	if (ncclParamReportConnectProgress() && comm->rank == 0) {
           struct timeval now;
           gettimeofday(&now, NULL);
@@ -315,6 +332,7 @@ exit:
   NCCLCHECK(ncclStrongStreamRelease(ncclCudaGraphNone(), &comm->sharedRes->hostStream));
   return ret;
 fail:
+  if (comm->proxyBatch.active) (void)ncclProxyBatchEnd(comm);
   goto exit;
 }
 
@@ -333,6 +351,7 @@ int ncclTransportCollNetSetup(struct ncclComm* comm, struct ncclTopoGraph* collN
     int collNetRank;
     ncclConnect connect;
   } sendrecvExchange;
+  ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemBuffCollNet);
 
   // check if we can connect to collnet, whose root is the nranks-th rank
   struct ncclPeerInfo *myInfo = comm->peerInfo+rank, *peerInfo = comm->peerInfo+nranks;
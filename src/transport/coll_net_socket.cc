@@ -0,0 +1,368 @@
+/*************************************************************************
+ * Copyright (c) 2024, Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// Software CollNet over TCP sockets.
+//
+// Emulates in-network reduction with a host aggregator so that the CollNet
+// setup, registration and proxy progress paths can be exercised without
+// switch hardware. Rank 0 of each collective group aggregates: every other
+// rank sends its contribution to rank 0, which reduces them in rank order on
+// the host and sends the result back. Operations are matched by issue order,
+// which the CollNet proxy already enforces. Only iallreduce is provided.
+//
+// Enabled with RCCL_COLLNET_SOCKET=1 on top of the Socket network, e.g.
+// NCCL_NET=Socket NCCL_COLLNET_ENABLE=1 RCCL_COLLNET_SOCKET=1.
+
+#include "comm.h"
+#include "core.h"
+#include "socket.h"
+#include "net.h"
+#include "param.h"
+#include "coll_net_socket.h"
+
+RCCL_PARAM(CollNetSocket, "COLLNET_SOCKET", 0);
+
+ncclResult_t ncclNetSocketInit(ncclDebugLogger_t logFunction);
+ncclResult_t ncclNetSocketDevices(int* ndev);
+ncclResult_t ncclNetSocketGetProperties(int dev, ncclNetProperties_t* props);
+ncclResult_t ncclNetSocketGetDevAddr(int dev, union ncclSocketAddress* addr);
+
+#define COLLNET_SOCKET_MAX_REQUESTS NCCL_NET_MAX_REQUESTS
+#define COLLNET_SOCKET_MAGIC 0x636f6c6c6e657473ULL // "collnets"
+
+struct collNetSocketHandle {
+  union ncclSocketAddress connectAddr;
+  uint64_t magic;
+};
+
+struct collNetSocketListenComm {
+  struct ncclSocket sock;
+  int dev;
+};
+
+enum collNetSocketReqState {
+  collNetSocketReqFree = 0,
+  collNetSocketReqGather = 1,
+  collNetSocketReqScatter = 2,
+  collNetSocketReqDone = 3
+};
+
+struct collNetSocketComm;
+
+struct collNetSocketRequest {
+  struct collNetSocketComm* comm;
+  enum collNetSocketReqState state;
+  void* sendData;
+  void* recvData;
+  int count;
+  int size;
+  ncclDataType_t dataType;
+  ncclRedOp_t redOp;
+};
+
+struct collNetSocketComm {
+  int rank;
+  int nranks;
+  // On the root, socks[r] connects to rank r (socks[0] is unused).
+  // Other ranks only use socks[0], connected to the root.
+  struct ncclSocket* socks;
+  struct collNetSocketRequest requests[COLLNET_SOCKET_MAX_REQUESTS];
+  int head; // Oldest request in flight
+  int tail; // Next request slot
+  // Progress of the head request, per peer
+  int* offsets;
+  int nReduced;
+  char** scratch;
+  int scratchSize;
+};
+
+static int collNetSocketTypeSupported(ncclDataType_t dataType) {
+  switch (dataType) {
+    case ncclInt8: case ncclUint8:
+    case ncclInt32: case ncclUint32:
+    case ncclInt64: case ncclUint64:
+    case ncclFloat32: case ncclFloat64:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static int collNetSocketOp(ncclRedOp_t redOp) {
+  switch (redOp) {
+    case ncclSum:  return ncclCollNetSocketSum;
+    case ncclProd: return ncclCollNetSocketProd;
+    case ncclMax:  return ncclCollNetSocketMax;
+    case ncclMin:  return ncclCollNetSocketMin;
+    default:       return -1;
+  }
+}
+
+static void collNetSocketReduce(void* dst, const void* src, int count, ncclDataType_t dataType, ncclRedOp_t redOp) {
+  int op = collNetSocketOp(redOp);
+  switch (dataType) {
+    case ncclInt8:    ncclCollNetSocketReduceType((int8_t*)dst, (const int8_t*)src, count, op); break;
+    case ncclUint8:   ncclCollNetSocketReduceType((uint8_t*)dst, (const uint8_t*)src, count, op); break;
+    case ncclInt32:   ncclCollNetSocketReduceType((int32_t*)dst, (const int32_t*)src, count, op); break;
+    case ncclUint32:  ncclCollNetSocketReduceType((uint32_t*)dst, (const uint32_t*)src, count, op); break;
+    case ncclInt64:   ncclCollNetSocketReduceType((int64_t*)dst, (const int64_t*)src, count, op); break;
+    case ncclUint64:  ncclCollNetSocketReduceType((uint64_t*)dst, (const uint64_t*)src, count, op); break;
+    case ncclFloat32: ncclCollNetSocketReduceType((float*)dst, (const float*)src, count, op); break;
+    case ncclFloat64: ncclCollNetSocketReduceType((double*)dst, (const double*)src, count, op); break;
+    default: break;
+  }
+}
+
+static ncclResult_t collNetSocketInit(ncclDebugLogger_t logFunction) {
+  if (rcclParamCollNetSocket() == 0) return ncclSuccess;
+  NCCLCHECK(ncclNetSocketInit(logFunction));
+  INFO(NCCL_INIT|NCCL_NET, "CollNet/Socket : Using software CollNet with host reduction");
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketDevices(int* ndev) {
+  *ndev = 0;
+  if (rcclParamCollNetSocket() == 0) return ncclSuccess;
+  NCCLCHECK(ncclNetSocketDevices(ndev));
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketGetProperties(int dev, ncclNetProperties_t* props) {
+  NCCLCHECK(ncclNetSocketGetProperties(dev, props));
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketListen(int dev, void* opaqueHandle, void** listenComm) {
+  struct collNetSocketHandle* handle = (struct collNetSocketHandle*)opaqueHandle;
+  memset(handle, 0, sizeof(struct collNetSocketHandle));
+  static_assert(sizeof(struct collNetSocketHandle) <= NCCL_NET_HANDLE_MAXSIZE, "collNetSocketHandle size too large");
+  struct collNetSocketListenComm* comm;
+  union ncclSocketAddress addr;
+  NCCLCHECK(ncclNetSocketGetDevAddr(dev, &addr));
+  NCCLCHECK(ncclCalloc(&comm, 1));
+  comm->dev = dev;
+  handle->magic = COLLNET_SOCKET_MAGIC;
+  NCCLCHECK(ncclSocketInit(&comm->sock, &addr, handle->magic, ncclSocketTypeNetSocket, NULL, 0));
+  NCCLCHECK(ncclSocketListen(&comm->sock));
+  NCCLCHECK(ncclSocketGetAddr(&comm->sock, &handle->connectAddr));
+  *listenComm = comm;
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketConnect(void* handles[], int nranks, int rank, void* listenComm, void** collComm) {
+  ncclResult_t ret = ncclSuccess;
+  struct collNetSocketListenComm* lComm = (struct collNetSocketListenComm*)listenComm;
+  struct collNetSocketComm* comm = NULL;
+  // Connection accepted but not yet stored in comm->socks
+  struct ncclSocket sock;
+  NCCLCHECK(ncclSocketInit(&sock));
+  NCCLCHECKGOTO(ncclCalloc(&comm, 1), ret, fail);
+  comm->rank = rank;
+  comm->nranks = nranks;
+  NCCLCHECKGOTO(ncclCalloc(&comm->socks, nranks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&comm->offsets, nranks), ret, fail);
+  NCCLCHECKGOTO(ncclCalloc(&comm->scratch, nranks), ret, fail);
+
+  if (rank == 0) {
+    // Accept one connection per peer; each peer tells us its rank.
+    for (int i=1; i<nranks; i++) {
+      int peer;
+      NCCLCHECKGOTO(ncclSocketAccept(&sock, &lComm->sock), ret, fail);
+      NCCLCHECKGOTO(ncclSocketRecv(&sock, &peer, sizeof(int)), ret, fail);
+      if (peer <= 0 || peer >= nranks || comm->socks[peer].state != ncclSocketStateNone) {
+        WARN("CollNet/Socket : unexpected connection from rank %d", peer);
+        ret = ncclInternalError;
+        goto fail;
+      }
+      memcpy(comm->socks+peer, &sock, sizeof(struct ncclSocket));
+      NCCLCHECKGOTO(ncclSocketInit(&sock), ret, fail);
+    }
+  } else {
+    struct collNetSocketHandle* handle = (struct collNetSocketHandle*)handles[0];
+    NCCLCHECKGOTO(ncclSocketInit(comm->socks, &handle->connectAddr, handle->magic, ncclSocketTypeNetSocket, NULL, 0), ret, fail);
+    NCCLCHECKGOTO(ncclSocketConnect(comm->socks), ret, fail);
+    NCCLCHECKGOTO(ncclSocketSend(comm->socks, &rank, sizeof(int)), ret, fail);
+  }
+  INFO(NCCL_INIT|NCCL_NET, "CollNet/Socket : connected rank %d/%d dev %d", rank, nranks, lComm->dev);
+  *collComm = comm;
+exit:
+  return ret;
+fail:
+  ncclSocketClose(&sock);
+  if (comm) {
+    if (comm->socks) {
+      // Calloc'ed sockets that were never initialized have no fd to close
+      for (int r=0; r<nranks; r++) {
+        if (comm->socks[r].state != ncclSocketStateNone) ncclSocketClose(comm->socks+r);
+      }
+    }
+    free(comm->scratch);
+    free(comm->offsets);
+    free(comm->socks);
+    free(comm);
+  }
+  goto exit;
+}
+
+static ncclResult_t collNetSocketReduceSupport(ncclDataType_t dataType, ncclRedOp_t redOp, int* supported) {
+  *supported = collNetSocketTypeSupported(dataType) && collNetSocketOp(redOp) >= 0;
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketRegMr(void* collComm, void* data, size_t size, int type, void** mhandle) {
+  if (type != NCCL_PTR_HOST) return ncclInternalError;
+  *mhandle = NULL;
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketDeregMr(void* collComm, void* mhandle) {
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketIallreduce(void* collComm, void* sendData, void* recvData, int count,
+    ncclDataType_t dataType, ncclRedOp_t redOp, void* sendMhandle, void* recvMhandle, void** request) {
+  struct collNetSocketComm* comm = (struct collNetSocketComm*)collComm;
+  struct collNetSocketRequest* req = comm->requests + (comm->tail % COLLNET_SOCKET_MAX_REQUESTS);
+  if (req->state != collNetSocketReqFree) {
+    // All request slots are in flight; the caller will retry.
+    *request = NULL;
+    return ncclSuccess;
+  }
+  req->comm = comm;
+  req->state = collNetSocketReqGather;
+  req->sendData = sendData;
+  req->recvData = recvData;
+  req->count = count;
+  req->size = count*ncclTypeSize(dataType);
+  req->dataType = dataType;
+  req->redOp = redOp;
+  comm->tail++;
+  *request = req;
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketIflush(void* collComm, void* data, int size, void* mhandle, void** request) {
+  // Data lands in host memory, nothing to flush.
+  *request = NULL;
+  return ncclSuccess;
+}
+
+// Progress the oldest request in flight. Returns once it is blocked on the network.
+static ncclResult_t collNetSocketProgressHead(struct collNetSocketComm* comm) {
+  struct collNetSocketRequest* req = comm->requests + (comm->head % COLLNET_SOCKET_MAX_REQUESTS);
+  if (req->state == collNetSocketReqGather) {
+    if (comm->rank == 0) {
+      if (comm->nReduced == 0) {
+        if (comm->scratchSize < req->size) {
+          for (int r=1; r<comm->nranks; r++) {
+            free(comm->scratch[r]);
+            NCCLCHECK(ncclCalloc(comm->scratch+r, req->size));
+          }
+          comm->scratchSize = req->size;
+        }
+        if (req->recvData != req->sendData) memcpy(req->recvData, req->sendData, req->size);
+        comm->nReduced = 1;
+      }
+      for (int r=1; r<comm->nranks; r++) {
+        if (comm->offsets[r] < req->size) NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_RECV, comm->socks+r, comm->scratch[r], req->size, comm->offsets+r));
+      }
+      // Reduce in rank order so that results do not depend on arrival order.
+      if (!ncclCollNetSocketReduceArrived(comm->nranks, comm->offsets, req->size, &comm->nReduced, [&](int r) {
+            collNetSocketReduce(req->recvData, comm->scratch[r], req->count, req->dataType, req->redOp);
+          })) return ncclSuccess;
+    } else {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_SEND, comm->socks, req->sendData, req->size, comm->offsets));
+      if (comm->offsets[0] < req->size) return ncclSuccess;
+    }
+    memset(comm->offsets, 0, comm->nranks*sizeof(int));
+    comm->nReduced = 0;
+    req->state = collNetSocketReqScatter;
+  }
+  if (req->state == collNetSocketReqScatter) {
+    int done = 1;
+    if (comm->rank == 0) {
+      for (int r=1; r<comm->nranks; r++) {
+        if (comm->offsets[r] < req->size) NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_SEND, comm->socks+r, req->recvData, req->size, comm->offsets+r));
+        if (comm->offsets[r] < req->size) done = 0;
+      }
+    } else {
+      NCCLCHECK(ncclSocketProgress(NCCL_SOCKET_RECV, comm->socks, req->recvData, req->size, comm->offsets));
+      if (comm->offsets[0] < req->size) done = 0;
+    }
+    if (!done) return ncclSuccess;
+    memset(comm->offsets, 0, comm->nranks*sizeof(int));
+    req->state = collNetSocketReqDone;
+    comm->head++;
+  }
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketTest(void* request, int* done, int* size) {
+  struct collNetSocketRequest* req = (struct collNetSocketRequest*)request;
+  struct collNetSocketComm* comm = req->comm;
+  // Requests complete in issue order, so drive the older ones first.
+  while (req->state != collNetSocketReqDone && comm->head != comm->tail) {
+    int head = comm->head;
+    NCCLCHECK(collNetSocketProgressHead(comm));
+    if (comm->head == head) break;
+  }
+  *done = 0;
+  if (req->state == collNetSocketReqDone) {
+    *done = 1;
+    if (size) *size = req->size;
+    req->state = collNetSocketReqFree;
+  }
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketCloseColl(void* collComm) {
+  struct collNetSocketComm* comm = (struct collNetSocketComm*)collComm;
+  if (comm) {
+    for (int r=0; r<comm->nranks; r++) {
+      free(comm->scratch[r]);
+      if (comm->socks[r].state == ncclSocketStateNone) continue;
+      int ready;
+      NCCLCHECK(ncclSocketReady(comm->socks+r, &ready));
+      if (ready) NCCLCHECK(ncclSocketClose(comm->socks+r));
+    }
+    free(comm->scratch);
+    free(comm->offsets);
+    free(comm->socks);
+    free(comm);
+  }
+  return ncclSuccess;
+}
+
+static ncclResult_t collNetSocketCloseListen(void* listenComm) {
+  struct collNetSocketListenComm* comm = (struct collNetSocketListenComm*)listenComm;
+  if (comm) {
+    int ready;
+    NCCLCHECK(ncclSocketReady(&comm->sock, &ready));
+    if (ready) NCCLCHECK(ncclSocketClose(&comm->sock));
+    free(comm);
+  }
+  return ncclSuccess;
+}
+
+ncclCollNet_t ncclCollNetSocket = {
+  "Socket",
+  collNetSocketInit,
+  collNetSocketDevices,
+  collNetSocketGetProperties,
+  collNetSocketListen,
+  collNetSocketConnect,
+  collNetSocketReduceSupport,
+  collNetSocketRegMr,
+  NULL, // No DMA-BUF support
+  collNetSocketDeregMr,
+  collNetSocketIallreduce,
+  NULL, // No iallgather
+  NULL, // No ireducescatter
+  collNetSocketIflush,
+  collNetSocketTest,
+  collNetSocketCloseColl,
+  collNetSocketCloseListen
+};
@@ -14,6 +14,8 @@
 #include "gdrwrap.h"
 #include "shm.h"
 #include "p2p.h"
+#include "p2p_sizing.h"
+#include "net_flush.h"
 #include "profiler.h"
 #include "graph.h"
 #include "graph/topo.h"
@@ -213,7 +215,7 @@ static ncclResult_t sendSetup(struct ncclComm* comm, struct ncclTopoGraph* graph
   req.tpLocalRank = comm->topParentLocalRanks[comm->localRank];
   req.tpRank = comm->topParentRanks[myInfo->rank];
   req.tpRemoteRank = comm->topParentRanks[peerInfo->rank];
-  NCCLCHECK(ncclProxyCallBlocking(comm, &send->proxyConn, ncclProxyMsgSetup, &req, sizeof(req), NULL, 0));
+  NCCLCHECK(ncclProxyCallDeferred(comm, &send->proxyConn, ncclProxyMsgSetup, &req, sizeof(req), NULL, 0));
 
   if (proxyRank == myInfo->rank) {
     INFO(NCCL_INIT|NCCL_NET,"Channel %02d/%d : %d[%lx] -> %d[%lx] [send] via NET/%s/%d%s%s comm %p nRanks %02d", channelId, connIndex, myInfo->rank, myInfo->busId, peerInfo->rank, peerInfo->busId, comm->ncclNet->name, req.netDev,
@@ -256,7 +258,7 @@ static ncclResult_t recvSetup(struct ncclComm* comm, struct ncclTopoGraph* graph
   req.tpLocalRank = comm->topParentLocalRanks[comm->localRank];
   req.tpRank = comm->topParentRanks[myInfo->rank];
   req.tpRemoteRank = comm->topParentRanks[peerInfo->rank];
-  NCCLCHECK(ncclProxyCallBlocking(comm, &recv->proxyConn, ncclProxyMsgSetup, &req, sizeof(req), connectInfo, sizeof(ncclNetHandle_t)));
+  NCCLCHECK(ncclProxyCallDeferred(comm, &recv->proxyConn, ncclProxyMsgSetup, &req, sizeof(req), connectInfo, sizeof(ncclNetHandle_t)));
   INFO(NCCL_INIT|NCCL_NET,"Channel %02d/%d : %d[%lx] -> %d[%lx] [receive] via NET/%s/%d%s%s comm %p nRanks %02d", channelId, connIndex, peerInfo->rank, peerInfo->busId, myInfo->rank, myInfo->busId, comm->ncclNet->name, req.netDev,
       req.useGdr ? "/GDRDMA" : "", req.shared ? "/Shared" : "", comm, comm->nRanks);
   return ncclSuccess;
@@ -502,7 +504,9 @@ static ncclResult_t recvFree(struct ncclConnector* recv) {
   return ncclSuccess;
 }
 
-#define NCCL_SHARED_STEPS 16
+// The pool holds p2pSharedSteps slots per channel, scaled at init with the number
+// of network peers. It is allocated with the first connection using it and freed
+// with the last one.
 static ncclResult_t sharedNetBuffersInit(struct ncclProxyState* proxyState, int cuda, int tpLocalRank, int type, int sameProcess,
     int nChannels, char** gpuPtr, char** cpuPtr, int* size, ncclIpcDesc *ipcDesc) {
   if (cuda == 0 && sameProcess == 0) {
@@ -521,8 +525,9 @@ static ncclResult_t sharedNetBuffersInit(struct ncclProxyState* proxyState, int
   struct ncclProxySharedP2p* state = type == 0 ? &peer->send : &peer->recv;
   state->refcount++;
   if (state->size == 0) {
-    state->size = (int64_t)nChannels * NCCL_SHARED_STEPS * proxyState->p2pChunkSize;
-
+    state->size = (int64_t)nChannels * proxyState->p2pSharedSteps * proxyState->p2pChunkSize;
+    INFO(NCCL_NET|NCCL_PROXY, "Shared %s buffers for local rank %d: %d channels x %d steps x %d bytes",
+         type == 0 ? "send" : "recv", tpLocalRank, nChannels, proxyState->p2pSharedSteps, proxyState->p2pChunkSize);
   }
 
   if (size) *size = state->size;
@@ -556,7 +561,7 @@ static ncclResult_t sharedNetBuffersInit(struct ncclProxyState* proxyState, int
 
 static ncclResult_t sharedBuffersGet(struct ncclProxyState* proxyState, int channel, int slot, int* offset, int* size) {
   // Use different pools for different channels and also separate send/recv.
-  int globalSlot = (channel*NCCL_SHARED_STEPS)+slot;
+  int globalSlot = (channel*proxyState->p2pSharedSteps)+slot;
   *offset = proxyState->p2pChunkSize * globalSlot;
   if (size) *size = proxyState->p2pChunkSize;
   return ncclSuccess;
@@ -1142,7 +1147,7 @@ static ncclResult_t sendProxyProgress(struct ncclProxyState* proxyState, struct
   args->idle = 1;
   if (args->state == ncclProxyOpProgress) {
     int p = args->protocol;
-    int maxDepth = std::min(NCCL_STEPS, NCCL_SHARED_STEPS/args->nsubs);
+    int maxDepth = std::min(NCCL_STEPS, proxyState->p2pSharedSteps/args->nsubs);
     for (int s=0; s<args->nsubs; s++) {
       struct ncclProxySubArgs* sub = args->subs+s;
       if (sub->done == sub->nsteps) continue;
@@ -1349,6 +1354,45 @@ static ncclResult_t sendProxyProgress(struct ncclProxyState* proxyState, struct
   return ncclSuccess;
 }
 
+// Maximum number of GDR flushes in flight per group of receives. Steps received
+// while the limit is reached are covered by a single flush once one completes.
+// 0 means no limit, i.e. one flush per received step as before coalescing.
+RCCL_PARAM(NetFlushMaxInflight, "NET_FLUSH_MAX_INFLIGHT", 1);
+
+// Issue one flush for all steps of subGroup in [flushed, received). A flush
+// orders all prior writes to the GPU, so flushing the most recent buffer of
+// each sub covers the earlier steps as well. See ncclNetFlushAdvance().
+static ncclResult_t recvProxyFlush(struct ncclProxyState* proxyState, struct ncclProxySubArgs* subGroup, void** request) {
+  struct recvNetResources* resources = (struct recvNetResources*) (subGroup->connection->transportResources);
+  *request = NULL;
+  if (resources->gdcFlush) {
+#if defined (__x86_64__)
+    // Force a PCI-E read from GPU memory
+    asm volatile ("mov (%0), %%eax" :: "l"(resources->gdcFlush) : "%eax");
+#else
+    WARN("NET: GDR Flush only supported on x86_64");
+    return ncclInternalError;
+#endif
+  } else {
+    int subCount = 0;
+    void* ptrs[NCCL_PROXY_MAX_SUBS];
+    int sizes[NCCL_PROXY_MAX_SUBS];
+    void* mhandles[NCCL_PROXY_MAX_SUBS];
+    for (int i=0; i<subGroup->groupSize; i++) {
+      struct ncclProxySubArgs* sub = subGroup + i;
+      if (sub->flushSize == 0) continue;
+      ptrs[subCount] = sub->flushPtr;
+      sizes[subCount] = sub->flushSize;
+      mhandles[subCount] = sub->mhandle;
+      subCount++;
+    }
+    NCCLCHECK(proxyState->ncclNet->iflush(resources->netRecvComm, subCount, ptrs, sizes, mhandles, request));
+  }
+  TRACE(NCCL_NET, "recvProxy flush steps [%ld:%ld) request %p", (long)subGroup->flushed, (long)subGroup->received, *request);
+  for (int i=0; i<subGroup->groupSize; i++) subGroup[i].flushSize = 0;
+  return ncclSuccess;
+}
+
 static ncclResult_t recvProxyProgress(struct ncclProxyState* proxyState, struct ncclProxyArgs* args) {
 #if defined(ENABLE_NPKIT) && defined(ENABLE_NPKIT_NET_COLLECT_POLL_CNT)
   g_npkit_net_poll_cnt++;
@@ -1385,7 +1429,8 @@ static ncclResult_t recvProxyProgress(struct ncclProxyState* proxyState, struct
       sub->base = ROUNDUP(resources->step, args->chunkSteps);
       // Set step base for next op
       resources->step = sub->base + sub->nsteps;
-      sub->posted = sub->received = sub->transmitted = sub->done = 0;
+      sub->posted = sub->received = sub->flushed = sub->transmitted = sub->done = 0;
+      sub->flushNeeded = sub->flushesInFlight = sub->flushSize = 0;
       for (int i=0; i<groupSize; i++) sub[-i].groupSize = groupSize;
       for (uint64_t step=0; step<sub->nsteps; step++) ncclProfilingRecord(args, s, step, ncclProxyProfileBegin);
       if (sub->reg && sub->nbytes > 0) {
@@ -1400,7 +1445,7 @@ static ncclResult_t recvProxyProgress(struct ncclProxyState* proxyState, struct
   args->idle = 1;
   if (args->state == ncclProxyOpProgress) {
     int p = args->protocol;
-    int maxDepth = std::min(NCCL_STEPS, NCCL_SHARED_STEPS/args->nsubs);
+    int maxDepth = std::min(NCCL_STEPS, proxyState->p2pSharedSteps/args->nsubs);
     for (int s=0; s<args->nsubs; s+=args->subs[s].groupSize) {
       struct ncclProxySubArgs* subGroup = args->subs+s;
       int subCount = 0;
@@ -1477,108 +1522,101 @@ static ncclResult_t recvProxyProgress(struct ncclProxyState* proxyState, struct
     }
     if (args->idle == 0) return ncclSuccess;
 
+    int maxFlushes = rcclParamNetFlushMaxInflight();
     for (int s=0; s<args->nsubs; s+=args->subs[s].groupSize) {
       struct ncclProxySubArgs* subGroup = args->subs+s;
-      if (subGroup->posted > subGroup->received) {
+      auto flush = [&](void** request) { return recvProxyFlush(proxyState, subGroup, request); };
+      int progress;
+      while (subGroup->posted > subGroup->received) {
         uint64_t step = subGroup->received;
         int done;
-        void* ptrs[NCCL_PROXY_MAX_SUBS];
         int sizes[NCCL_PROXY_MAX_SUBS];
-        void* mhandles[NCCL_PROXY_MAX_SUBS];
         for (int i=0; i<NCCL_PROXY_MAX_SUBS; i++) sizes[i] = 0;
         NCCLCHECK(proxyState->ncclNet->test(subGroup->requests[step%NCCL_STEPS], &done, sizes));
-        if (done) {
-          int needFlush = 0;
-          int totalSize = 0;
-          int subIndex = 0;
-          for (int i=0; i<NCCL_PROXY_MAX_SUBS; i++) totalSize += sizes[i];
-          for (int i=0; i<subGroup->groupSize; i++) {
-            struct ncclProxySubArgs* sub = subGroup + i;
+        if (!done) break;
+        int needFlush = 0;
+        int totalSize = 0;
+        int subIndex = 0;
+        for (int i=0; i<NCCL_PROXY_MAX_SUBS; i++) totalSize += sizes[i];
+        for (int i=0; i<subGroup->groupSize; i++) {
+          struct ncclProxySubArgs* sub = subGroup + i;
 
 #if defined(ENABLE_NPKIT) && defined(ENABLE_NPKIT_EVENT_NET_RECV_ENTRY) && defined(ENABLE_NPKIT_EVENT_NET_RECV_EXIT)
-            NpKit::CollectCpuEvent(
-                NPKIT_EVENT_NET_RECV_EXIT,
+          NpKit::CollectCpuEvent(
+              NPKIT_EVENT_NET_RECV_EXIT,
 #if defined(ENABLE_NPKIT_NET_COLLECT_POLL_CNT)
-                g_npkit_net_poll_cnt,
+              g_npkit_net_poll_cnt,
 #else
-                sizes[i],
+              sizes[i],
 #endif
-                uint64_t(sub->requests+(step%NCCL_STEPS))/sizeof(void*),
-                *(volatile uint64_t*)NpKit::GetCpuTimestamp(), sub->channelId);
+              uint64_t(sub->requests+(step%NCCL_STEPS))/sizeof(void*),
+              *(volatile uint64_t*)NpKit::GetCpuTimestamp(), sub->channelId);
 #if defined(ENABLE_NPKIT_NET_COLLECT_POLL_CNT)
-            g_npkit_net_poll_cnt = 0;
+          g_npkit_net_poll_cnt = 0;
 #endif
 #endif
 
-            if (sub->received < sub->nsteps) {
-              int size = sizes[subIndex++];
-              if (sub->reg) {
-                if (size < sub->nbytes) {
-                  sub->buffer = ((char*)sub->buffer) + size;
-                  sub->nbytes -= size;
-                  // Do one more step (at least)
-                  sub->nsteps++;
-                } else {
-                  // Reset connFifo size indicating the GPU was ready to receive.
-                  // There is a __sync_synchronize() later to ensure it is reset before it is set again by the GPU.
-                  struct recvNetResources* resources = (struct recvNetResources*) (sub->connection->transportResources);
-                  volatile struct ncclConnFifo* connFifo = (volatile struct ncclConnFifo*)resources->recvMem->connFifo;
-                  connFifo[sub->base%NCCL_STEPS].size = -1;
-                }
+          if (sub->received < sub->nsteps) {
+            int size = sizes[subIndex++];
+            if (sub->reg) {
+              if (size < sub->nbytes) {
+                sub->buffer = ((char*)sub->buffer) + size;
+                sub->nbytes -= size;
+                // Do one more step (at least)
+                sub->nsteps++;
+              } else {
+                // Reset connFifo size indicating the GPU was ready to receive.
+                // There is a __sync_synchronize() later to ensure it is reset before it is set again by the GPU.
+                struct recvNetResources* resources = (struct recvNetResources*) (sub->connection->transportResources);
+                volatile struct ncclConnFifo* connFifo = (volatile struct ncclConnFifo*)resources->recvMem->connFifo;
+                connFifo[sub->base%NCCL_STEPS].size = -1;
               }
             }
-            sub->received += args->sliceSteps;
-            for (uint64_t step=sub->received-args->sliceSteps; step<sub->received; step++) ncclProfilingRecord(args, s+i, step, ncclProxyProfileRecvFlushWait);
+          }
+          sub->received += args->sliceSteps;
+          for (uint64_t step=sub->received-args->sliceSteps; step<sub->received; step++) ncclProfilingRecord(args, s+i, step, ncclProxyProfileRecvFlushWait);
+          if (step < sub->nsteps) {
+            struct recvNetResources* resources = (struct recvNetResources*) (sub->connection->transportResources);
+            if (resources->useGdr) needFlush |= resources->needFlush;
+          }
+        }
+        subGroup->requests[step%NCCL_STEPS] = NULL;
+        if (totalSize > 0 && p == NCCL_PROTO_SIMPLE && needFlush) {
+          // Remember the most recent buffer of each sub; recvProxyFlush() covers all pending steps with it.
+          int subCount = 0;
+          for (int i=0; i<subGroup->groupSize; i++) {
+            struct ncclProxySubArgs* sub = subGroup + i;
             if (step < sub->nsteps) {
               struct recvNetResources* resources = (struct recvNetResources*) (sub->connection->transportResources);
-              if (resources->useGdr) needFlush |= resources->needFlush;
-            }
-          }
-          subGroup->requests[step%NCCL_STEPS] = NULL;
-          if (totalSize > 0 && p == NCCL_PROTO_SIMPLE && needFlush) {
-            // GDRCOPY support
-            struct recvNetResources* resources = (struct recvNetResources*) (subGroup->connection->transportResources);
-            if (resources->gdcFlush) {
-#if defined (__x86_64__)
-              // Force a PCI-E read from GPU memory
-              asm volatile ("mov (%0), %%eax" :: "l"(resources->gdcFlush) : "%eax");
-#else
-              WARN("NET: GDR Flush only supported on x86_64");
-              return ncclInternalError;
-#endif
-            } else {
-              int subCount = 0;
-              for (int i=0; i<subGroup->groupSize; i++) {
-                struct ncclProxySubArgs* sub = subGroup + i;
-                if (step < sub->nsteps) {
-                  struct recvNetResources* resources = (struct recvNetResources*) (sub->connection->transportResources);
-                  int stepSize = resources->buffSizes[p] / NCCL_STEPS;
-                  char* localBuff = NCCL_NET_MAP_GET_POINTER(&resources->map, cpu, buffs[p]);
-                  int buffSlot = (sub->base+sub->received-args->sliceSteps)%NCCL_STEPS;
-                  ptrs[subCount] = resources->shared ?
-                    (sub->reg ? sub->buffer : localBuff+resources->recvMem->connFifo[buffSlot].offset) :
-                    localBuff+buffSlot*stepSize;
-                  mhandles[subCount] = sub->mhandle;
-                  subCount++;
-                }
+              int stepSize = resources->buffSizes[p] / NCCL_STEPS;
+              char* localBuff = NCCL_NET_MAP_GET_POINTER(&resources->map, cpu, buffs[p]);
+              int buffSlot = (sub->base+sub->received-args->sliceSteps)%NCCL_STEPS;
+              if (sizes[subCount]) {
+                sub->flushPtr = resources->shared ?
+                  (sub->reg ? sub->buffer : localBuff+resources->recvMem->connFifo[buffSlot].offset) :
+                  localBuff+buffSlot*stepSize;
+                sub->flushSize = sizes[subCount];
               }
-              struct recvNetResources* resources = (struct recvNetResources*) (subGroup->connection->transportResources);
-              NCCLCHECK(proxyState->ncclNet->iflush(resources->netRecvComm, subCount, ptrs, sizes, mhandles, subGroup->requests+(step%NCCL_STEPS)));
+              subCount++;
             }
           }
-          args->idle = 0;
+          subGroup->flushNeeded = 1;
         }
+        if (maxFlushes == 0) NCCLCHECK(ncclNetFlushAdvance(subGroup, args->sliceSteps, maxFlushes, flush, &progress));
+        args->idle = 0;
       }
+      NCCLCHECK(ncclNetFlushAdvance(subGroup, args->sliceSteps, maxFlushes, flush, &progress));
+      if (progress) args->idle = 0;
     }
     if (args->idle == 0) return ncclSuccess;
 
     for (int s=0; s<args->nsubs; s+=args->subs[s].groupSize) {
       struct ncclProxySubArgs* subGroup = args->subs+s;
-      if (subGroup->received > subGroup->transmitted) {
+      if (subGroup->flushed > subGroup->transmitted) {
         uint64_t step = subGroup->transmitted;
-        int done = 1;
-        void* request = subGroup->requests[step%NCCL_STEPS];
-        if (request) NCCLCHECK(proxyState->ncclNet->test(request, &done, NULL));
+        int done;
+        NCCLCHECK(ncclNetFlushTest(subGroup, args->sliceSteps,
+              [&](void* request, int* flushDone) { return proxyState->ncclNet->test(request, flushDone, NULL); }, &done));
         if (done) {
           for (int i=0; i<subGroup->groupSize; i++) {
             struct ncclProxySubArgs* sub = subGroup + i;
@@ -107,6 +107,13 @@ ncclResult_t ncclNetSocketGetProperties(int dev, ncclNetProperties_t* props) {
   return ncclSuccess;
 }
 
+// Used by the socket CollNet to listen on the same interface
+ncclResult_t ncclNetSocketGetDevAddr(int dev, union ncclSocketAddress* addr) {
+  if (dev < 0 || dev >= ncclNetIfs) return ncclInternalError;
+  memcpy(addr, &ncclNetSocketDevs[dev].addr, sizeof(union ncclSocketAddress));
+  return ncclSuccess;
+}
+
 /* Communication functions */
 
 #define MAX_SOCKETS 64
@@ -262,6 +262,7 @@ ncclResult_t ncclNvlsInit(struct ncclComm* comm) {
 ncclResult_t ncclNvlsSetup(struct ncclComm* comm, struct ncclComm* parent) {
   if (comm->nvlsSupport == 0 || comm->nvlsChannels == 0) return ncclSuccess;
 
+  ncclMemAccountGuard memGuard(&comm->memAccount, ncclMemNvls);
   int nHeads = comm->channels[0].nvls.nHeads;
   int headRank = comm->channels[0].nvls.headRank;
   char shmPath[sizeof("/dev/shm/nccl-XXXXXX")];
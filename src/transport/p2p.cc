@@ -347,6 +347,16 @@ static ncclResult_t p2pMap(struct ncclComm *comm, struct ncclProxyConnector* pro
   return ncclSuccess;
 }
 
+// Send/recv connections (no graph, connIndex 1) step through the SIMPLE buffer by
+// p2pChunkSize, so they only need NCCL_STEPS chunks instead of a full buffer.
+// SIMPLE is the last buffer of ncclRecvMem, so the other offsets are unchanged.
+static int p2pSimpleBuffSize(struct ncclComm* comm, struct ncclTopoGraph* graph, int connIndex) {
+  if (graph == NULL && connIndex == 1 && useMemcpy == 0) {
+    return std::min(comm->buffSizes[NCCL_PROTO_SIMPLE], NCCL_STEPS*comm->p2pChunkSize);
+  }
+  return comm->buffSizes[NCCL_PROTO_SIMPLE];
+}
+
 /* Send: Create and return connect structures for this peer to connect to me */
 ncclResult_t p2pSendSetup(struct ncclComm* comm, struct ncclTopoGraph* graph, struct ncclPeerInfo* myInfo, struct ncclPeerInfo* peerInfo,
     struct ncclConnect* connectInfo, struct ncclConnector* send, int channelId, int connIndex) {
@@ -378,7 +388,7 @@ ncclResult_t p2pSendSetup(struct ncclComm* comm, struct ncclTopoGraph* graph, st
 
   int sendSize = sizeof(struct ncclSendMem);
   // For P2P Read the SIMPLE buffer is tagged on the end of the ncclSendMem structure
-  if (info->read) sendSize += comm->buffSizes[NCCL_PROTO_SIMPLE];
+  if (info->read) sendSize += p2pSimpleBuffSize(comm, graph, connIndex);
   ALIGN_SIZE(sendSize, CUDA_IPC_MIN);
 
   if (intermediateRank == -1) {
@@ -443,7 +453,10 @@ ncclResult_t p2pRecvSetup(struct ncclComm* comm, struct ncclTopoGraph* graph, st
 
   int recvSize = sizeof(struct ncclRecvMem);
   // For P2P Read the SIMPLE buffer is tagged on the end of the ncclSendMem structure
-  for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) if (!(info->read && p == NCCL_PROTO_SIMPLE)) recvSize += comm->buffSizes[p];
+  for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+    if (p != NCCL_PROTO_SIMPLE) recvSize += comm->buffSizes[p];
+    else if (!info->read) recvSize += p2pSimpleBuffSize(comm, graph, connIndex);
+  }
   ALIGN_SIZE(recvSize, CUDA_IPC_MIN);
 
   if (intermediateRank == -1) {
@@ -501,7 +514,7 @@ static ncclResult_t p2pSendConnect(struct ncclComm* comm, struct ncclConnect* co
     send->conn.connFifo = resources->proxyInfo.ceRecvMem->connFifo;
     send->conn.head = &resources->proxyInfo.devShm->sendMem.head;
     // Send SIMPLE buff to proxy, and replace it by local buffer
-    NCCLCHECK(ncclProxyCallBlocking(comm, &send->proxyConn, ncclProxyMsgConnect, &send->conn.buffs[NCCL_PROTO_SIMPLE], sizeof(void*), NULL, 0));
+    NCCLCHECK(ncclProxyCallDeferred(comm, &send->proxyConn, ncclProxyMsgConnect, &send->conn.buffs[NCCL_PROTO_SIMPLE], sizeof(void*), NULL, 0));
     send->conn.buffs[NCCL_PROTO_SIMPLE] = resources->proxyInfo.ceDevBuff;
   } else {
     send->conn.tail = &remDevMem->tail;
@@ -0,0 +1,154 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+ // Note: InPlace is not supported for All-Gatherv
+
+#include "TestBed.hpp"
+
+namespace RcclUnitTesting
+{
+  // Segments of AllGatherv in recvcounts/rdispls within options, with a gap of
+  // rank elements before each one. Returns the number of output elements.
+  //   pattern 0: uneven counts
+  //   pattern 1: empty segments on odd ranks
+  //   pattern 2: only the last rank has a segment
+  //   pattern 3: all segments empty
+  static size_t PrepareAllGathervCounts(int const totalRanks, int const pattern, size_t const chunkSize,
+                                        OptionalColArgs& options)
+  {
+    size_t displ = 0;
+    for (int rank = 0; rank < totalRanks; ++rank)
+    {
+      size_t count = 0;
+      switch (pattern)
+      {
+      case 0: count = (rank + 1) * chunkSize + rank;                  break;
+      case 1: count = (rank % 2) ? 0 : (rank + 1) * chunkSize + 3;    break;
+      case 2: count = (rank == totalRanks - 1) ? chunkSize + 5 : 0;   break;
+      default: count = 0;                                             break;
+      }
+      displ += rank;
+      options.recvcounts[rank] = count;
+      options.rdispls[rank]    = displ;
+      displ += count;
+    }
+    return displ;
+  }
+
+  TEST(AllGatherv, OutOfPlace)
+  {
+    TestBed testBed;
+
+    // Configuration
+    std::vector<ncclDataType_t> const& dataTypes       = {ncclInt8, ncclFloat32, ncclFloat64};
+    std::vector<size_t>         const& chunkSizes      = {1, 257, 65536 + 3};
+    std::vector<int>            const& patterns        = {0, 1, 2, 3};
+    bool                        const  inPlace         = false;
+    bool                        const  useManagedMem   = false;
+    bool                        const  useHipGraph     = false;
+
+    OptionalColArgs options;
+
+    bool isCorrect = true;
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (size_t chunkSize : chunkSizes)
+      for (int pattern : patterns)
+      {
+        if (!isCorrect) break;
+        size_t const numOutputElements = PrepareAllGathervCounts(totalRanks, pattern, chunkSize, options);
+
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     ncclCollAllGatherv, dataTypes[dataIdx],
+                                                     ncclSum, -1, inPlace, useManagedMem, useHipGraph);
+          INFO("%s pattern %d chunk %lu\n", name.c_str(), pattern, chunkSize);
+        }
+
+        for (int rank = 0; rank < totalRanks; ++rank)
+        {
+          testBed.SetCollectiveArgs(ncclCollAllGatherv,
+                                    dataTypes[dataIdx],
+                                    std::max(options.recvcounts[rank], (size_t)1),
+                                    std::max(numOutputElements, (size_t)1),
+                                    options,
+                                    -1,
+                                    0,
+                                    rank);
+        }
+        testBed.AllocateMem(inPlace, useManagedMem);
+        testBed.PrepareData();
+        testBed.ExecuteCollectives({}, useHipGraph);
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+  }
+
+  TEST(AllGatherv, OutOfPlaceGraph)
+  {
+    TestBed testBed;
+
+    // Configuration
+    std::vector<ncclDataType_t> const& dataTypes       = {ncclFloat16, ncclInt32};
+    std::vector<int>            const& patterns        = {0, 1};
+    bool                        const  inPlace         = false;
+    bool                        const  useManagedMem   = false;
+    bool                        const  useHipGraph     = true;
+
+    OptionalColArgs options;
+
+    bool isCorrect = true;
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (int pattern : patterns)
+      {
+        if (!isCorrect) break;
+        size_t const numOutputElements = PrepareAllGathervCounts(totalRanks, pattern, 4096 + 7, options);
+
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     ncclCollAllGatherv, dataTypes[dataIdx],
+                                                     ncclSum, -1, inPlace, useManagedMem, useHipGraph);
+          INFO("%s pattern %d\n", name.c_str(), pattern);
+        }
+
+        for (int rank = 0; rank < totalRanks; ++rank)
+        {
+          testBed.SetCollectiveArgs(ncclCollAllGatherv,
+                                    dataTypes[dataIdx],
+                                    std::max(options.recvcounts[rank], (size_t)1),
+                                    std::max(numOutputElements, (size_t)1),
+                                    options,
+                                    -1,
+                                    0,
+                                    rank);
+        }
+        testBed.AllocateMem(inPlace, useManagedMem);
+        testBed.PrepareData();
+        testBed.ExecuteCollectives({}, useHipGraph);
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+  }
+}
@@ -0,0 +1,1391 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+// Unit tests of the host-side logic kept in dependency-free headers of src/include.
+// These run without a GPU or a communicator.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+#include <string.h>
+#include <gtest/gtest.h>
+#include <rccl/rccl.h>
+
+#include "p2p_sizing.h"
+#include "ptr_cache.h"
+#include "env_profile.h"
+#include "step_sim.h"
+#include "node_order.h"
+#include "gather_tree.h"
+#include "backend_select.h"
+#include "msccl/msccl_scheduler.h"
+#include "tree_root.h"
+#include "reduce_acc.h"
+#include "coll_v.h"
+#include "mem_budget.h"
+#include "proxy_batch.h"
+#include "if_cache.h"
+#include "graph_limits.h"
+#include "net_flush.h"
+#include "work_pool.h"
+#include "coll_net_socket.h"
+
+namespace RcclUnitTesting
+{
+  /**
+   * \brief Verify P2P chunk and shared pool sizing against the peer count (host only)
+   * ******************************************************************************************/
+  TEST(HostUnit, P2pBufferSizing)
+  {
+    const int64_t budget = 1LL << 30;
+    // Few peers keep the configured chunk size and the default pool depth
+    EXPECT_EQ(ncclP2pComputeChunkSize(1 << 17, budget, 7, 4, 8), 1 << 17);
+    EXPECT_EQ(ncclP2pComputeSharedSteps(8, 4, 32, 1 << 17, budget, NCCL_SHARED_STEPS, 512), NCCL_SHARED_STEPS);
+
+    // 1023 peers x 2 channels x 8 steps x 2 directions must fit in 1GB: 32KB chunks
+    EXPECT_EQ(ncclP2pComputeChunkSize(1 << 17, budget, 1023, 2, 8), 1 << 15);
+    // The chunk size never goes below NCCL_P2P_MIN_CHUNKSIZE nor above the configured one
+    EXPECT_EQ(ncclP2pComputeChunkSize(1 << 17, budget, 16383, 2, 8), NCCL_P2P_MIN_CHUNKSIZE);
+    EXPECT_EQ(ncclP2pComputeChunkSize(1 << 14, budget, 16383, 2, 8), 1 << 14);
+    // A budget of 0 disables sizing
+    EXPECT_EQ(ncclP2pComputeChunkSize(1 << 17, 0, 16383, 2, 8), 1 << 17);
+
+    // The pool grows with peers per channel: 64 peers x 2 channels / 32 channels = 4 per channel is
+    // still covered by 16 slots, 1024 peers need 128 slots.
+    EXPECT_EQ(ncclP2pComputeSharedSteps(64, 2, 32, 1 << 15, budget, NCCL_SHARED_STEPS, 512), NCCL_SHARED_STEPS);
+    EXPECT_EQ(ncclP2pComputeSharedSteps(1024, 2, 32, 1 << 15, budget, NCCL_SHARED_STEPS, 512), 128);
+    // ... up to maxSteps, and within half of the budget per direction
+    EXPECT_EQ(ncclP2pComputeSharedSteps(1 << 20, 2, 32, 1 << 15, budget, NCCL_SHARED_STEPS, 256), 256);
+    EXPECT_EQ(ncclP2pComputeSharedSteps(1 << 20, 2, 32, 1 << 15, 1LL << 28, NCCL_SHARED_STEPS, 512), 128);
+    EXPECT_EQ(ncclP2pComputeSharedSteps(1 << 20, 2, 32, 1 << 15, 0, NCCL_SHARED_STEPS, 512), NCCL_SHARED_STEPS);
+  }
+
+  /**
+   * \brief Verify the pointer validation cache with a mocked attribute query (host only)
+   * ******************************************************************************************/
+  static int ptrQueryCalls;
+  static int mockPtrQuery(const void* ptr, uintptr_t* base, size_t* size, int* dev)
+  {
+    ptrQueryCalls++;
+    // Two 1MB allocations on devices 0 and 1 at 0x100000 and 0x200000, host memory at 0x300000
+    uintptr_t addr = (uintptr_t)ptr;
+    if (addr < 0x100000 || addr >= 0x400000) return 1;
+    *base = addr & ~(uintptr_t)0xfffff;
+    *size = 0x100000;
+    *dev = *base == 0x300000 ? -1 : (int)(*base >> 20) - 1;
+    return 0;
+  }
+
+  TEST(HostUnit, PtrCache)
+  {
+    auto cache = std::make_unique<ncclPtrCache>();
+    int dev;
+    uint64_t epoch;
+    ptrQueryCalls = 0;
+
+    // First access to an allocation queries, other pointers into it hit the cache
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x100010, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(dev, 0);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x1fffff, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 1);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x200000, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_EQ(dev, 1);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x300100, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(dev, -1);
+    EXPECT_EQ(ptrQueryCalls, 3);
+
+    // Invalid pointers are not cached
+    EXPECT_NE(ncclPtrCacheCheck(cache.get(), (void*)0x500000, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_NE(ncclPtrCacheCheck(cache.get(), (void*)0x500000, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 5);
+
+    // Freed ranges are queried again, explicit inserts replace overlapping ranges
+    ncclPtrCacheErase(cache.get(), (void*)0x200000, 1);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x200000, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 6);
+    ncclPtrCacheInsert(cache.get(), (void*)0x180000, 0x100000, 3, NCCL_PTR_CACHE_OWNED);
+    EXPECT_TRUE(ncclPtrCacheFind(cache.get(), 0x200000, &dev, &epoch));
+    EXPECT_EQ(dev, 3);
+    EXPECT_EQ(epoch, NCCL_PTR_CACHE_OWNED);
+    EXPECT_FALSE(ncclPtrCacheFind(cache.get(), 0x100000, &dev, &epoch));
+
+    // A full cache starts over instead of failing
+    for (uintptr_t i = 0; i <= NCCL_PTR_CACHE_SIZE; i++)
+      ncclPtrCacheInsert(cache.get(), (void*)(0x1000000 + i * 0x1000), 0x1000, 0, 0);
+    EXPECT_TRUE(ncclPtrCacheFind(cache.get(), 0x1000000 + NCCL_PTR_CACHE_SIZE * 0x1000, &dev, &epoch));
+    EXPECT_LE(cache->count.load(), NCCL_PTR_CACHE_SIZE);
+
+    // Ranges freed outside of the cache: a device mismatch is checked again before it is
+    // reported and a range that no longer resolves is expired
+    cache = std::make_unique<ncclPtrCache>();
+    ptrQueryCalls = 0;
+    ncclPtrCacheInsert(cache.get(), (void*)0x200000, 0x100000, 0, NCCL_PTR_CACHE_OWNED);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x200010, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 0);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x200010, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_EQ(dev, 1);
+    EXPECT_EQ(ptrQueryCalls, 1);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x2fffff, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 1);
+    ncclPtrCacheInsert(cache.get(), (void*)0x500000, 0x100000, 0, NCCL_PTR_CACHE_OWNED);
+    EXPECT_NE(ncclPtrCacheCheck(cache.get(), (void*)0x500000, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_FALSE(ncclPtrCacheFind(cache.get(), 0x500000, &dev, &epoch));
+    EXPECT_EQ(ptrQueryCalls, 2);
+    // Host memory is trusted from any device
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x300000, mockPtrQuery, 1, 0, &dev), 0);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x300000, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(dev, -1);
+    EXPECT_EQ(ptrQueryCalls, 3);
+
+    // Ranges found by a query are validated again in a new epoch: a range freed since
+    // then is expired, a reallocated one takes the base and size of the new allocation
+    cache = std::make_unique<ncclPtrCache>();
+    ptrQueryCalls = 0;
+    ncclPtrCacheInsert(cache.get(), (void*)0x500000, 0x100000, 0, 0);
+    ncclPtrCacheInsert(cache.get(), (void*)0x180000, 0x10000, 0, 0);
+    ncclPtrCacheInsert(cache.get(), (void*)0x600000, 0x100000, 0, NCCL_PTR_CACHE_OWNED);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x500000, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x180000, mockPtrQuery, 0, 0, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 0);
+    EXPECT_NE(ncclPtrCacheCheck(cache.get(), (void*)0x500000, mockPtrQuery, 0, 1, &dev), 0);
+    EXPECT_FALSE(ncclPtrCacheFind(cache.get(), 0x500000, &dev, &epoch));
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x180000, mockPtrQuery, 0, 1, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 2);
+    EXPECT_TRUE(ncclPtrCacheFind(cache.get(), 0x1fffff, &dev, &epoch));
+    EXPECT_EQ(epoch, 1);
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x1fffff, mockPtrQuery, 0, 1, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 2);
+    // Ranges owned by NCCL are trusted in any epoch
+    EXPECT_EQ(ncclPtrCacheCheck(cache.get(), (void*)0x600000, mockPtrQuery, 0, 7, &dev), 0);
+    EXPECT_EQ(ptrQueryCalls, 2);
+
+    // Epochs advance every interval checks, at every check for 0
+    cache = std::make_unique<ncclPtrCache>();
+    EXPECT_EQ(ncclPtrCacheNextEpoch(cache.get(), 2), 0);
+    EXPECT_EQ(ncclPtrCacheNextEpoch(cache.get(), 2), 0);
+    EXPECT_EQ(ncclPtrCacheNextEpoch(cache.get(), 2), 1);
+    EXPECT_NE(ncclPtrCacheNextEpoch(cache.get(), 0), ncclPtrCacheNextEpoch(cache.get(), 0));
+  }
+
+  /**
+   * \brief Verify rccl.conf profile matching and precedence with synthetic fingerprints (host only)
+   * ******************************************************************************************/
+  TEST(HostUnit, EnvProfileMatch)
+  {
+    rcclEnvFingerprint mi300 = {"gfx942:sramecc+:xnack-", 8, 8, 1, RCCL_ENV_MODEL_UNKNOWN};
+    rcclEnvFingerprint mi250 = {"gfx90a:sramecc+:xnack-", 8, 4, 0, 3};
+    int specificity = 0;
+
+    EXPECT_EQ(rcclEnvSectionMatch("arch=gfx94", &mi300, &specificity), rcclEnvMatch);
+    EXPECT_EQ(specificity, 1);
+    EXPECT_EQ(rcclEnvSectionMatch("arch=gfx942, gpus=8, xgmi=1", &mi300, &specificity), rcclEnvMatch);
+    EXPECT_EQ(specificity, 3);
+    EXPECT_EQ(rcclEnvSectionMatch("arch=gfx94", &mi250, nullptr), rcclEnvNoMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("arch=gfx90a,nics=4,xgmi=0", &mi250, nullptr), rcclEnvMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("arch=gfx90a,nics=8", &mi250, nullptr), rcclEnvNoMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("gpus=*,nics=*", &mi250, &specificity), rcclEnvMatch);
+    EXPECT_EQ(specificity, 2);
+
+    // Model sections wait for the graph search, unless another key already fails
+    EXPECT_EQ(rcclEnvSectionMatch("model=3", &mi300, nullptr), rcclEnvDefer);
+    EXPECT_EQ(rcclEnvSectionMatch("model=3,gpus=4", &mi300, nullptr), rcclEnvNoMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("model=3", &mi250, nullptr), rcclEnvMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("model=4", &mi250, nullptr), rcclEnvNoMatch);
+
+    // Unknown keys and malformed selectors never match
+    EXPECT_EQ(rcclEnvSectionMatch("cpu=rome", &mi300, nullptr), rcclEnvNoMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("gpus", &mi300, nullptr), rcclEnvNoMatch);
+    EXPECT_EQ(rcclEnvSectionMatch("gpus=eight", &mi300, nullptr), rcclEnvNoMatch);
+
+    // Environment > user profile > user file > system profile > system file
+    int userProfile = rcclEnvRank(0, true), userFlat = rcclEnvRank(0, false);
+    int systemProfile = rcclEnvRank(1, true), systemFlat = rcclEnvRank(1, false);
+    EXPECT_TRUE(rcclEnvOverrides(systemFlat, RCCL_ENV_RANK_UNSET));
+    EXPECT_TRUE(rcclEnvOverrides(systemProfile, systemFlat));
+    EXPECT_FALSE(rcclEnvOverrides(systemProfile, userFlat));
+    EXPECT_TRUE(rcclEnvOverrides(userProfile, userFlat));
+    EXPECT_FALSE(rcclEnvOverrides(userProfile, userProfile));
+    EXPECT_FALSE(rcclEnvOverrides(userProfile, RCCL_ENV_RANK_ENVIRONMENT));
+  }
+
+  struct StepSimLinks
+  {
+    bool   shared;
+    double latUs;
+  };
+
+  static void StepSimLink(void* ctx, int channel, int src, int dst, ncclSimLink* link)
+  {
+    StepSimLinks* links = (StepSimLinks*)ctx;
+    link->id = (links->shared ? 0 : channel)*1024 + src*32 + dst;
+    link->bw = 10.0;
+    link->latUs = links->latUs;
+    link->net = false;
+  }
+
+  TEST(HostUnit, StepSimulator)
+  {
+    const int nRanks = 4, nChannels = 2;
+    std::vector<int> rings, treeUp(nChannels*nRanks), treeDn(nChannels*nRanks*NCCL_SIM_MAX_ARITY, -1);
+    for (int c = 0; c < nChannels; c++) {
+      for (int r = 0; r < nRanks; r++) {
+        rings.push_back(r);
+        treeUp[c*nRanks+r] = r-1;
+        if (r+1 < nRanks) treeDn[(c*nRanks+r)*NCCL_SIM_MAX_ARITY] = r+1;
+      }
+    }
+    StepSimLinks links = {false, 1.0};
+    ncclSimParams params = {};
+    params.coll = ncclSimAllReduce;
+    params.algorithm = ncclSimAlgoRing;
+    params.protocol = ncclSimProtoSimple;
+    params.nRanks = nRanks;
+    params.nChannels = nChannels;
+    params.nBytes = 64 << 20;
+    params.nSteps = 8;
+    params.stepSize = (1 << 22) / params.nSteps;
+    params.chunkSteps = 4;
+    params.sliceSteps = 2;
+    params.chunkSize = params.stepSize * params.chunkSteps;
+    params.stepLatUs = 0.5;
+    params.launchUs = 5.0;
+    params.rings = rings.data();
+    params.treeUp = treeUp.data();
+    params.treeDn = treeDn.data();
+    params.linkFn = StepSimLink;
+    params.linkCtx = &links;
+
+    // Large ring allreduce is bandwidth bound: 2(n-1)/n of the data crosses every link
+    ncclSimResult result;
+    ASSERT_EQ(ncclSimRun(&params, &result), 0);
+    double busBytes = 2.0 * (nRanks-1) / nRanks * params.nBytes / nChannels;
+    EXPECT_EQ(result.links.size(), (size_t)nRanks*nChannels);
+    for (auto& link : result.links) EXPECT_EQ(link.bytes, (int64_t)busBytes);
+    double ideal = busBytes / (10.0 * 1e3);
+    EXPECT_GT(result.timeUs, ideal);
+    EXPECT_LT(result.timeUs, ideal * 1.05);
+
+    // Channels sharing their links take twice as long
+    links.shared = true;
+    ncclSimResult sharedResult;
+    ASSERT_EQ(ncclSimRun(&params, &sharedResult), 0);
+    EXPECT_EQ(sharedResult.links.size(), (size_t)nRanks);
+    EXPECT_NEAR(sharedResult.timeUs / result.timeUs, 2.0, 0.1);
+    links.shared = false;
+
+    // LL doubles the bytes on the wire
+    params.protocol = ncclSimProtoLL;
+    params.stepSize = 16384;
+    params.chunkSteps = params.sliceSteps = 1;
+    params.chunkSize = params.stepSize / 2;
+    params.nBytes = 1 << 20;
+    ncclSimResult ll;
+    ASSERT_EQ(ncclSimRun(&params, &ll), 0);
+    EXPECT_EQ(ll.links[0].bytes, (int64_t)(2 * 2.0 * (nRanks-1) / nRanks * params.nBytes / nChannels));
+
+    // On high latency links the tree pipeline is limited by NCCL_STEPS credits
+    params.algorithm = ncclSimAlgoTree;
+    links.latUs = 20.0;
+    ncclSimResult shallow, deep;
+    ASSERT_EQ(ncclSimRun(&params, &shallow), 0);
+    params.nSteps = 16;
+    ASSERT_EQ(ncclSimRun(&params, &deep), 0);
+    EXPECT_LT(deep.timeUs, shallow.timeUs * 0.8);
+    params.nSteps = 8;
+    links.latUs = 1.0;
+
+    // Small messages are latency bound, in every algorithm
+    params.nBytes = 1024;
+    for (int a = 0; a < 3; a++) {
+      params.algorithm = a == 0 ? ncclSimAlgoRing : ncclSimAlgoTree;
+      params.protocol = a == 2 ? ncclSimProtoSimple : ncclSimProtoLL;
+      ncclSimResult small;
+      ASSERT_EQ(ncclSimRun(&params, &small), 0);
+      EXPECT_GT(small.timeUs, params.launchUs);
+      EXPECT_LT(small.timeUs, 100.0);
+    }
+
+    // Tree reduce and broadcast both cross every edge of the chain once
+    params.algorithm = ncclSimAlgoTree;
+    params.protocol = ncclSimProtoSimple;
+    params.nBytes = 8 << 20;
+    params.stepSize = (1 << 22) / params.nSteps;
+    params.chunkSteps = params.sliceSteps = 1;
+    params.chunkSize = 1 << 17;
+    ncclSimResult tree;
+    ASSERT_EQ(ncclSimRun(&params, &tree), 0);
+    EXPECT_EQ(tree.links.size(), (size_t)2*(nRanks-1)*nChannels);
+    for (auto& link : tree.links) EXPECT_EQ(link.bytes, params.nBytes / nChannels);
+
+    // A send only uses the link from the first to the second rank of each ring
+    params.coll = ncclSimSendRecv;
+    params.algorithm = ncclSimAlgoRing;
+    params.stepSize = params.chunkSize;
+    ncclSimResult p2p;
+    ASSERT_EQ(ncclSimRun(&params, &p2p), 0);
+    EXPECT_EQ(p2p.links.size(), (size_t)nChannels);
+    for (auto& link : p2p.links) EXPECT_EQ(link.bytes, params.nBytes / nChannels);
+    EXPECT_GT(p2p.timeUs, params.nBytes / nChannels / (10.0 * 1e3));
+  }
+
+  static void NodeOrderFatTree(int nNodes, int nSwitches, bool sparse, std::vector<float>& cost)
+  {
+    // Node i is behind leaf switch i%nSwitches, so rank order crosses switches at every hop
+    cost.assign(nNodes*nNodes, -1);
+    for (int i = 0; i < nNodes; i++) {
+      for (int j = 0; j < nNodes; j++) {
+        int d = (j - i + nNodes) % nNodes;
+        if (sparse && i != j && (d & (d-1)) != 0) continue;
+        cost[i*nNodes+j] = i == j ? 0 : (i % nSwitches == j % nSwitches ? 2.0f : 10.0f);
+      }
+    }
+  }
+
+  TEST(HostUnit, NodeOrder)
+  {
+    const int nNodes = 16, nSwitches = 4;
+    std::vector<float> cost;
+    std::vector<int> order(nNodes);
+
+    // Only distances that are powers of two are measured, the rest is completed
+    NodeOrderFatTree(nNodes, nSwitches, true, cost);
+    ASSERT_TRUE(ncclNodeOrderComplete(nNodes, cost.data()));
+    for (int i = 0; i < nNodes; i++) {
+      for (int j = 0; j < nNodes; j++) {
+        EXPECT_EQ(cost[i*nNodes+j], cost[j*nNodes+i]);
+        if (i != j && i % nSwitches == j % nSwitches) {
+          EXPECT_LE(cost[i*nNodes+j], 4.0f);
+        }
+      }
+    }
+
+    // The ring only leaves each switch once and the trees get cheaper
+    NodeOrderFatTree(nNodes, nSwitches, false, cost);
+    std::vector<int> rankOrder(nNodes);
+    for (int i = 0; i < nNodes; i++) rankOrder[i] = i;
+    ASSERT_TRUE(ncclNodeOrderCompute(nNodes, cost.data(), order.data()));
+    std::vector<int> seen(nNodes, 0);
+    int crossings = 0;
+    for (int p = 0; p < nNodes; p++) {
+      seen[order[p]]++;
+      if (order[p] % nSwitches != order[(p+1)%nNodes] % nSwitches) crossings++;
+    }
+    for (int i = 0; i < nNodes; i++) EXPECT_EQ(seen[i], 1);
+    EXPECT_EQ(crossings, nSwitches);
+    EXPECT_LT(ncclNodeOrderTreeCost(nNodes, cost.data(), order.data()),
+              ncclNodeOrderTreeCost(nNodes, cost.data(), rankOrder.data()));
+
+    // Every rank computes the same order
+    std::vector<int> order2(nNodes);
+    ncclNodeOrderCompute(nNodes, cost.data(), order2.data());
+    EXPECT_EQ(order, order2);
+
+    // A flat network keeps rank order
+    std::vector<float> flat(nNodes*nNodes, 5.0f);
+    EXPECT_FALSE(ncclNodeOrderCompute(nNodes, flat.data(), order.data()));
+    for (int i = 0; i < nNodes; i++) EXPECT_EQ(order[i], i);
+
+    // Tree parents match ncclGetDtree
+    EXPECT_EQ(ncclNodeOrderBtreeParent(14, 13), 12);
+    EXPECT_EQ(ncclNodeOrderBtreeParent(14, 12), 8);
+    EXPECT_EQ(ncclNodeOrderBtreeParent(14, 8), 0);
+    EXPECT_EQ(ncclNodeOrderBtreeParent(14, 0), -1);
+    EXPECT_EQ(ncclNodeOrderDtreeParent(12, 0), 1);
+    EXPECT_EQ(ncclNodeOrderDtreeParent(13, 0), 9);
+  }
+
+  // Check the schedule of every rank and return the longest path to the root
+  static int GatherTreeCheck(int nRanks, const std::vector<int>& rankToNode, int nNodes, int root, int intraRadix, int interRadix)
+  {
+    std::vector<int> order(nRanks), nodeStart(nNodes+1), pos(nRanks);
+    ncclGatherTreeOrder(nRanks, rankToNode.data(), nNodes, root, order.data(), nodeStart.data());
+    EXPECT_EQ(order[0], root);
+    for (int p = 0; p < nRanks; p++) pos[order[p]] = p;
+    std::vector<ncclGatherTreePlan> plans(nRanks);
+    std::vector<std::vector<ncclGatherTreeXfer>> children(nRanks, std::vector<ncclGatherTreeXfer>(nRanks));
+    for (int p = 0; p < nRanks; p++) {
+      plans[p].children = children[p].data();
+      ncclGatherTreeBuild(nNodes, order.data(), nodeStart.data(), p, intraRadix, interRadix, &plans[p]);
+    }
+    int depth = 0;
+    for (int p = 0; p < nRanks; p++) {
+      // A subtree is the rank and the disjoint subtrees of its children, which agree on the transfer
+      EXPECT_EQ(plans[p].up.first, p);
+      int covered = 1;
+      for (int c = 0; c < plans[p].nChildren; c++) {
+        ncclGatherTreeXfer& x = plans[p].children[c];
+        EXPECT_EQ(order[x.first], x.peer);
+        ncclGatherTreeXfer& up = plans[pos[x.peer]].up;
+        EXPECT_EQ(up.peer, order[p]);
+        EXPECT_EQ(up.first, x.first);
+        EXPECT_EQ(up.count, x.count);
+        covered += x.count;
+      }
+      EXPECT_EQ(covered, plans[p].up.count);
+      int d = 0;
+      for (int q = p; plans[q].up.peer != -1 && d <= nRanks; q = pos[plans[q].up.peer]) d++;
+      depth = std::max(depth, d);
+    }
+    EXPECT_EQ(plans[0].up.count, nRanks);
+    return depth;
+  }
+
+  TEST(HostUnit, GatherTree)
+  {
+    for (int nNodes : {1, 3, 16}) {
+      for (int localRanks : {1, 3, 8}) {
+        int nRanks = nNodes*localRanks;
+        std::vector<int> blocked(nRanks), cyclic(nRanks);
+        for (int r = 0; r < nRanks; r++) {
+          blocked[r] = r / localRanks;
+          cyclic[r] = r % nNodes;
+        }
+        for (int root : {0, nRanks-1}) {
+          for (int radix : {0, 2, 3}) {
+            GatherTreeCheck(nRanks, blocked, nNodes, root, radix, radix);
+            GatherTreeCheck(nRanks, cyclic, nNodes, root, radix, radix);
+          }
+        }
+      }
+    }
+
+    // 64 nodes of 8 ranks: log2(8) + log2(64) steps with binomial trees, a flat
+    // gather within nodes saves two of them. Only node leaders cross the network.
+    std::vector<int> rankToNode(512);
+    for (int r = 0; r < 512; r++) rankToNode[r] = r / 8;
+    EXPECT_EQ(GatherTreeCheck(512, rankToNode, 64, 5, 2, 2), 3+6);
+    EXPECT_EQ(GatherTreeCheck(512, rankToNode, 64, 5, 0, 2), 1+6);
+    EXPECT_EQ(GatherTreeCheck(512, rankToNode, 64, 5, 0, 4), 1+3);
+    std::vector<int> order(512), nodeStart(65);
+    std::vector<ncclGatherTreeXfer> children(512);
+    ncclGatherTreeOrder(512, rankToNode.data(), 64, 5, order.data(), nodeStart.data());
+    ncclGatherTreePlan plan = { {}, 0, children.data() };
+    ncclGatherTreeBuild(64, order.data(), nodeStart.data(), 0, 0, 2, &plan);
+    EXPECT_EQ(plan.nChildren, 7+6);
+    ncclGatherTreeBuild(64, order.data(), nodeStart.data(), 3, 0, 2, &plan);
+    EXPECT_EQ(plan.nChildren, 0);
+    EXPECT_EQ(plan.up.peer, 5);
+    EXPECT_EQ(rankToNode[plan.up.peer], rankToNode[order[3]]);
+  }
+
+  // Alpha-beta cost model of a stub backend
+  struct BackendStub {
+    float latency;
+    float bytesPerUs;
+    size_t maxBytes;
+    int rcclFunc; // Function RCCL has no estimate for, -1 for none
+    int calls;
+  };
+
+  static float BackendStubTime(void* ctx, const ncclBackendOp* op)
+  {
+    BackendStub* stub = (BackendStub*)ctx;
+    stub->calls++;
+    if (op->nBytes > stub->maxBytes || op->func == stub->rcclFunc) return -1;
+    return stub->latency + op->nBytes / stub->bytesPerUs;
+  }
+
+  TEST(HostUnit, BackendSelect)
+  {
+    // MSCCL is untimed: its estimate is never compared, only whether it can run the operation
+    BackendStub rccl = {10, 100, SIZE_MAX, 9, 0}, mscclpp = {2, 50, 1 << 20, -1, 0}, msccl = {1000, 1, 4 << 20, -1, 0};
+    ncclBackendSelector* sel = new ncclBackendSelector;
+    auto init = [&](const char* forced) {
+      bool valid = ncclBackendSelectorInit(sel, forced);
+      ncclBackendSetProvider(sel, ncclBackendRccl, BackendStubTime, &rccl, true);
+      ncclBackendSetProvider(sel, ncclBackendMscclpp, BackendStubTime, &mscclpp, true);
+      ncclBackendSetProvider(sel, ncclBackendMsccl, BackendStubTime, &msccl, false);
+      return valid;
+    };
+    auto select = [&](int func, size_t nBytes, unsigned eligible) {
+      ncclBackendOp op = { func, 7, 0, nBytes, false, nullptr };
+      return ncclBackendSelect(sel, &op, eligible);
+    };
+    const unsigned all = (1u << ncclBackendMscclpp) | (1u << ncclBackendMsccl);
+
+    // The cheapest timed backend wins, and MSCCL takes over from RCCL whenever it can run
+    // the operation: latency bound, then bandwidth bound, then beyond the MSCCL++ and MSCCL limits
+    ASSERT_TRUE(init(nullptr));
+    EXPECT_EQ(select(2, 256, all), ncclBackendMscclpp);
+    EXPECT_EQ(select(2, 256, 1u << ncclBackendMscclpp), ncclBackendMscclpp);
+    EXPECT_EQ(select(2, 4096, all), ncclBackendMsccl);
+    EXPECT_EQ(select(2, 2 << 20, all), ncclBackendMsccl);
+    EXPECT_EQ(select(2, 8 << 20, all), ncclBackendRccl);
+    EXPECT_EQ(select(2, 4096, 1u << ncclBackendMscclpp), ncclBackendRccl);
+    EXPECT_EQ(select(2, 256, 0), ncclBackendRccl);
+    // Without an RCCL estimate, another backend that can run the operation is used
+    EXPECT_EQ(select(9, 2 << 20, 1u << ncclBackendMscclpp), ncclBackendRccl);
+    EXPECT_EQ(select(9, 2 << 20, all), ncclBackendMsccl);
+
+    // Decisions are cached per operation and eligibility
+    int calls = rccl.calls + mscclpp.calls + msccl.calls;
+    uint64_t hits = sel->hits;
+    EXPECT_EQ(select(2, 4096, all), ncclBackendMsccl);
+    EXPECT_EQ(select(2, 4096, 1u << ncclBackendMscclpp), ncclBackendRccl);
+    EXPECT_EQ(rccl.calls + mscclpp.calls + msccl.calls, calls);
+    EXPECT_EQ(sel->hits, hits + 2);
+    EXPECT_EQ(select(2, 4096 + 32, all), ncclBackendMsccl);
+    EXPECT_GT(rccl.calls + mscclpp.calls + msccl.calls, calls);
+
+    // A forced backend is used whenever it can run the operation
+    ASSERT_TRUE(init("rccl"));
+    EXPECT_EQ(select(2, 256, all), ncclBackendRccl);
+    EXPECT_EQ(select(9, 256, all), ncclBackendRccl);
+    ASSERT_TRUE(init("msccl"));
+    EXPECT_EQ(select(2, 256, all), ncclBackendMsccl);
+    EXPECT_EQ(select(2, 8 << 20, all), ncclBackendRccl);
+    ASSERT_TRUE(init("MSCCL++"));
+    EXPECT_EQ(select(2, 4096, all), ncclBackendMscclpp);
+    EXPECT_EQ(select(2, 2 << 20, all), ncclBackendMsccl);
+    EXPECT_EQ(select(2, 4096, 1u << ncclBackendMsccl), ncclBackendMsccl);
+    ASSERT_TRUE(init("mscclpp"));
+    EXPECT_EQ(sel->forced, ncclBackendMscclpp);
+    EXPECT_FALSE(init("nccl"));
+    EXPECT_EQ(sel->forced, -1);
+    delete sel;
+  }
+
+  // Trees like connectTrees builds them: a chain below the first rank of each node,
+  // and a binary tree (or the mirrored one) of the first ranks across nodes
+  static void TreeRootBuild(int nNodes, int localRanks, bool mirror, std::vector<int>& parent, std::vector<int>& down)
+  {
+    int nRanks = nNodes*localRanks;
+    parent.assign(nRanks, -1);
+    down.assign(nRanks*NCCL_TREE_ROOT_MAX_DOWN, -1);
+    auto link = [&](int child, int up) {
+      int i = 0;
+      while (down[up*NCCL_TREE_ROOT_MAX_DOWN+i] != -1) i++;
+      down[up*NCCL_TREE_ROOT_MAX_DOWN+i] = child;
+      parent[child] = up;
+    };
+    for (int n = 0; n < nNodes; n++) {
+      int u = mirror ? ncclNodeOrderDtreeParent(nNodes, n) : ncclNodeOrderBtreeParent(nNodes, n);
+      if (u != -1) link(n*localRanks, u*localRanks);
+      for (int l = 1; l < localRanks; l++) link(n*localRanks+l, n*localRanks+l-1);
+    }
+  }
+
+  // Hops from root to the farthest rank
+  static int TreeRootDistance(int nRanks, const std::vector<int>& parent, int root)
+  {
+    std::vector<int> dist(nRanks, -1), queue(1, root);
+    dist[root] = 0;
+    for (size_t q = 0; q < queue.size(); q++) {
+      int r = queue[q];
+      for (int s = 0; s < nRanks; s++) {
+        if (dist[s] == -1 && (parent[s] == r || parent[r] == s)) {
+          dist[s] = dist[r]+1;
+          queue.push_back(s);
+        }
+      }
+    }
+    return *std::max_element(dist.begin(), dist.end());
+  }
+
+  TEST(HostUnit, TreeRoot)
+  {
+    std::vector<int> parent, down;
+    for (int nNodes : {1, 2, 5, 16}) {
+      for (int localRanks : {1, 4, 8}) {
+        for (bool mirror : {false, true}) {
+          int nRanks = nNodes*localRanks;
+          if (nRanks == 1) continue;
+          TreeRootBuild(nNodes, localRanks, mirror, parent, down);
+          EXPECT_TRUE(ncclTreeRootConnected(nRanks, parent.data()));
+          for (int root = 0; root < nRanks; root++) {
+            // Every chunk is one hop further per round, whatever the root
+            int dist = TreeRootDistance(nRanks, parent, root);
+            for (int nChunks : {1, 7}) {
+              EXPECT_EQ(ncclTreeRootSimulate(nRanks, parent.data(), down.data(), root, nChunks, false), dist+nChunks-1);
+              EXPECT_EQ(ncclTreeRootSimulate(nRanks, parent.data(), down.data(), root, nChunks, true), dist+nChunks-1);
+            }
+          }
+        }
+      }
+    }
+
+    // 4 nodes of 2 ranks: 0 -> {1, 4}, 4 -> {2, 5, 6}, 2 -> 3, 6 -> 7
+    TreeRootBuild(4, 2, false, parent, down);
+    const int* down4 = down.data() + 4*NCCL_TREE_ROOT_MAX_DOWN;
+    EXPECT_EQ(ncclTreeToRoot(8, parent.data(), 4, down4, 4), NCCL_TREE_ROOT_SELF);
+    EXPECT_EQ(ncclTreeToRoot(8, parent.data(), 4, down4, 7), 2);
+    EXPECT_EQ(ncclTreeToRoot(8, parent.data(), 4, down4, 1), NCCL_TREE_ROOT_UP);
+    EXPECT_EQ(ncclTreeToRoot(8, parent.data(), 0, down.data(), 7), 1);
+    EXPECT_EQ(ncclTreeRootPeer(parent[4], down4, 2), 6);
+    EXPECT_EQ(ncclTreeRootPeer(parent[4], down4, NCCL_TREE_ROOT_UP), 0);
+    EXPECT_EQ(ncclTreeRootPeer(parent[4], down4, NCCL_TREE_ROOT_SELF), -1);
+    // Rank 4 no longer knows its child 6
+    down[4*NCCL_TREE_ROOT_MAX_DOWN+2] = -1;
+    EXPECT_EQ(ncclTreeToRoot(8, parent.data(), 4, down4, 7), -1);
+    EXPECT_EQ(ncclTreeRootSimulate(8, parent.data(), down.data(), 0, 4, false), -1);
+    EXPECT_EQ(ncclTreeRootSimulate(8, parent.data(), down.data(), 7, 4, true), -1);
+
+    // Trees that do not connect all ranks make init fall back to rings for Broadcast and Reduce
+    TreeRootBuild(4, 2, false, parent, down);
+    parent[4] = -1; // Two trees, rooted at 0 and 4
+    EXPECT_FALSE(ncclTreeRootConnected(8, parent.data()));
+    parent[4] = 6; // 4 -> 6 -> 4
+    EXPECT_FALSE(ncclTreeRootConnected(8, parent.data()));
+    parent[4] = 8;
+    EXPECT_FALSE(ncclTreeRootConnected(8, parent.data()));
+    parent[4] = 0;
+    EXPECT_TRUE(ncclTreeRootConnected(8, parent.data()));
+  }
+
+  // Tree reduction laid out like a heap of arity 3, every rank summing its own
+  // value with the partial sums received from its children
+  static uint16_t ReduceAccTree(int type, const std::vector<uint16_t>& vals, int rank, bool fp32)
+  {
+    uint16_t srcs[4];
+    int n = 0;
+    srcs[n++] = vals[rank];
+    for (int c = 3*rank+1; c <= 3*rank+3 && c < (int)vals.size(); c++) srcs[n++] = ReduceAccTree(type, vals, c, fp32);
+    return ncclReduceAccStep(type, n, srcs, 0, 1.0f, fp32);
+  }
+
+  TEST(HostUnit, ReduceAcc)
+  {
+    // Conversions round to nearest even
+    EXPECT_EQ(ncclReduceAccFloatToHalf(1.0f), 0x3c00);
+    EXPECT_EQ(ncclReduceAccFloatToHalf(65519.0f), 0x7bff);
+    EXPECT_EQ(ncclReduceAccFloatToHalf(65520.0f), 0x7c00);
+    EXPECT_EQ(ncclReduceAccFloatToHalf(ldexpf(1.0f, -24)), 0x0001);
+    EXPECT_EQ(ncclReduceAccFloatToHalf(ldexpf(1.0f, -25)), 0x0000);
+    EXPECT_EQ(ncclReduceAccHalfToFloat(0x0001), ldexpf(1.0f, -24));
+    EXPECT_EQ(ncclReduceAccHalfToFloat(0xc000), -2.0f);
+    EXPECT_EQ(ncclReduceAccFloatToBf16(1.0f + ldexpf(1.0f, -8)), 0x3f80);
+    EXPECT_EQ(ncclReduceAccFloatToBf16(1.0f + ldexpf(3.0f, -8)), 0x3f82);
+    EXPECT_EQ(ncclReduceAccBf16ToFloat(0x3b00), ldexpf(1.0f, -9));
+
+    // 1 + 3*2^-9: every addition rounds back to 1 in bfloat16
+    uint16_t small[4] = { 0x3f80, 0x3b00, 0x3b00, 0x3b00 };
+    EXPECT_EQ(ncclReduceAccStep(ncclReduceAccBfloat16, 4, small, 0, 1.0f, false), 0x3f80);
+    EXPECT_EQ(ncclReduceAccStep(ncclReduceAccBfloat16, 4, small, 0, 1.0f, true), 0x3f81);
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (int type : {ncclReduceAccHalf, ncclReduceAccBfloat16}) {
+      // Two sums round once either way, ring steps do not need fp32
+      for (int i = 0; i < 100000; i++) {
+        uint16_t pair[2] = { ncclReduceAccFromFloat(type, dist(gen)), ncclReduceAccFromFloat(type, dist(gen)*64) };
+        EXPECT_EQ(ncclReduceAccStep(type, 2, pair, 0, 1.0f, false), ncclReduceAccStep(type, 2, pair, 0, 1.0f, true));
+      }
+      // ncclAvg rounds the scaled input before the sum unless it is carried in fp32
+      float scale = ncclReduceAccToFloat(type, ncclReduceAccFromFloat(type, 1.0f/3));
+      double errAvg[2] = { 0, 0 };
+      for (int i = 0; i < 10000; i++) {
+        uint16_t pair[2] = { ncclReduceAccFromFloat(type, dist(gen)), ncclReduceAccFromFloat(type, dist(gen)) };
+        double exact = (double)ncclReduceAccToFloat(type, pair[0])*scale + ncclReduceAccToFloat(type, pair[1]);
+        for (int fp32 = 0; fp32 < 2; fp32++) {
+          errAvg[fp32] += fabs(ncclReduceAccToFloat(type, ncclReduceAccStep(type, 2, pair, 1, scale, fp32)) - exact);
+        }
+      }
+      EXPECT_LT(errAvg[1], errAvg[0]);
+      // Trees of 256 ranks, compared with the exact sum of the same inputs
+      double err[2] = { 0, 0 };
+      std::vector<uint16_t> vals(256);
+      for (int i = 0; i < 200; i++) {
+        double exact = 0;
+        for (auto& v : vals) {
+          v = ncclReduceAccFromFloat(type, dist(gen));
+          exact += ncclReduceAccToFloat(type, v);
+        }
+        for (int fp32 = 0; fp32 < 2; fp32++) {
+          err[fp32] += fabs(ncclReduceAccToFloat(type, ReduceAccTree(type, vals, 0, fp32)) - exact);
+        }
+      }
+      EXPECT_LT(err[1], 0.75*err[0]);
+    }
+  }
+
+  TEST(HostUnit, CollV)
+  {
+    // Parts of a segment are aligned and cover it exactly once
+    for (uint64_t count : {0, 1, 15, 16, 17, 1000, 65537}) {
+      for (int nParts : {1, 3, 16}) {
+        for (uint64_t align : {1, 4, 16}) {
+          uint64_t next = 0;
+          for (int part = 0; part < nParts; part++) {
+            uint64_t beg, end;
+            ncclCollVPart(count, part, nParts, align, &beg, &end);
+            EXPECT_EQ(beg, next);
+            EXPECT_LE(beg, end);
+            if (beg < count) {
+              EXPECT_EQ(beg % align, 0);
+            }
+            next = end;
+          }
+          EXPECT_EQ(next, count);
+        }
+      }
+    }
+    EXPECT_EQ(ncclCollVAlign(1), 16);
+    EXPECT_EQ(ncclCollVAlign(2), 8);
+    EXPECT_EQ(ncclCollVAlign(8), 2);
+    // 100 elements in 2 parts of 56 and 44, by chunks of 32
+    uint64_t offset;
+    EXPECT_EQ(ncclCollVChunk(100, 0, 2, 8, 32, 32, &offset), 24);
+    EXPECT_EQ(offset, 32);
+    EXPECT_EQ(ncclCollVChunk(100, 1, 2, 8, 32, 32, &offset), 12);
+    EXPECT_EQ(offset, 88);
+    EXPECT_EQ(ncclCollVChunk(100, 1, 2, 8, 64, 32, &offset), 0);
+    // Channels get the same share of uneven segments
+    struct ncclCollVSeg uneven[4] = { {4096, 0}, {0, 4096}, {1, 4096}, {2048, 4097} };
+    for (int part = 0; part < 4; part++) EXPECT_EQ(ncclCollVPartMax(uneven, 4, part, 4, 1), 1024);
+    size_t counts[4] = { 3, 9, 0, 2 };
+    EXPECT_EQ(ncclCollVMaxCount(counts, 4), 9);
+    EXPECT_EQ(ncclCollVTableWorks(8, 256), 1);
+    EXPECT_EQ(ncclCollVTableWorks(17, 256), 2);
+
+    // Ring data flow with random segments, some empty, packed or with gaps
+    std::mt19937 gen(1234);
+    for (int nRanks = 2; nRanks <= 8; nRanks++) {
+      for (int iter = 0; iter < 20; iter++) {
+        std::vector<struct ncclCollVSeg> segs(nRanks);
+        uint64_t bufSize = 0;
+        for (int r = 0; r < nRanks; r++) {
+          segs[r].count = gen() % 4 == 0 ? 0 : gen() % 300;
+          bufSize += iter % 2 ? gen() % 7 : 0;
+          segs[r].displ = bufSize;
+          bufSize += segs[r].count;
+        }
+        // Displacements need not follow the ranks
+        if (iter % 3 == 0) std::shuffle(segs.begin(), segs.end(), gen);
+        for (int nParts : {1, 3, 8}) {
+          for (uint64_t chunkCount : {8, 64, 1024}) {
+            EXPECT_TRUE(ncclCollVSimulate(nRanks, segs.data(), bufSize, nParts, 4, chunkCount, false));
+            EXPECT_TRUE(ncclCollVSimulate(nRanks, segs.data(), bufSize, nParts, 4, chunkCount, true));
+          }
+        }
+      }
+    }
+  }
+
+  TEST(HostUnit, MemBudget)
+  {
+    // LL 256KiB, LL128 4MiB, Simple 4MiB, 7 peers with one channel and 32KiB chunks
+    int buffSizes[3] = { 1 << 18, 1 << 22, 1 << 22 };
+    bool protoUsed[3] = { true, true, true };
+    struct ncclMemBudget b = { 0, 3, 2, buffSizes, protoUsed, 7, 1, 1 << 15, 8 };
+    // Send and receive buffers of 8 chunks to every peer
+    EXPECT_EQ(ncclMemBudgetP2pBytes(&b), 2*7*8*(1 << 15));
+    EXPECT_EQ(ncclMemBudgetCollBytes(&b, 2), 2*4*((1 << 18) + (1 << 23)));
+    // LL128 does not count when it is disabled
+    protoUsed[1] = false;
+    EXPECT_EQ(ncclMemBudgetCollBytes(&b, 2), 2*4*((1 << 18) + (1 << 22)));
+    protoUsed[1] = true;
+
+    // No budget leaves everything alone
+    int nChannels = 32;
+    EXPECT_EQ(ncclMemBudgetFit(&b, &nChannels, 4), ncclMemBudgetEstimate(&b, 32));
+    EXPECT_EQ(nChannels, 32);
+    EXPECT_EQ(buffSizes[2], 1 << 22);
+
+    // The simple buffer shrinks first
+    b.budget = ncclMemBudgetEstimate(&b, 32) - 1;
+    EXPECT_LE(ncclMemBudgetFit(&b, &nChannels, 4), b.budget);
+    EXPECT_EQ(nChannels, 32);
+    EXPECT_EQ(buffSizes[2], 1 << 21);
+
+    // Then the channels, once the simple buffer is at its minimum
+    buffSizes[2] = 1 << 22;
+    b.budget = 160 << 20;
+    int64_t estimate = ncclMemBudgetFit(&b, &nChannels, 4);
+    EXPECT_LE(estimate, b.budget);
+    EXPECT_EQ(buffSizes[2], NCCL_MEM_BUDGET_MIN_BUFFSIZE);
+    EXPECT_EQ(nChannels, 8);
+    EXPECT_GT(ncclMemBudgetEstimate(&b, 16), b.budget);
+
+    // minChannels wins over the budget, and the estimate says so
+    buffSizes[2] = 1 << 22;
+    nChannels = 32;
+    b.budget = 1 << 20;
+    EXPECT_GT(ncclMemBudgetFit(&b, &nChannels, 4), b.budget);
+    EXPECT_EQ(nChannels, 4);
+
+    // Postset doubles the searched channels and duplicates them nc times
+    for (int maxChannels : {1, 2, 3, 8, 12, 32, 64}) {
+      for (int search : {1, 2, 4, 16}) {
+        for (int nc : {1, 2, 4, 16}) {
+          int n = search, c = nc;
+          ncclMemBudgetCapChannels(maxChannels, &n, &c);
+          EXPECT_GE(n, 1);
+          EXPECT_GE(c, 1);
+          EXPECT_LE(n, search);
+          EXPECT_LE(c, nc);
+          if (maxChannels >= 2) {
+            EXPECT_LE(2*n, maxChannels);
+            EXPECT_LE(c*n, std::max(maxChannels, 2*n));
+          }
+          if (2*search <= maxChannels && nc*search <= maxChannels) {
+            EXPECT_EQ(n, search);
+            EXPECT_EQ(c, nc);
+          }
+        }
+      }
+    }
+  }
+
+  // Mock proxy: creates a connection for every Init, resolves the connection of the
+  // other calls like the proxy service and answers each call with the connection it
+  // ran on and the first int of its request. Message types are those of
+  // ncclProxyMsgType: 1 Init, 3 Setup, 4 Connect, 10 Batch.
+  struct ProxyBatchMock
+  {
+    std::vector<std::unique_ptr<long>> conns;
+    std::vector<std::pair<void*, int>> ran; // connection, request
+    int nMsgs = 0;
+
+    bool Receive(const char* msg, size_t size)
+    {
+      const char* ptr = msg;
+      int type, n;
+      memcpy(&type, ptr, sizeof(int)); ptr += sizeof(int);
+      memcpy(&n, ptr, sizeof(int)); ptr += sizeof(int);
+      if (type != 10) return false;
+      std::vector<void*> batchConns(n, nullptr);
+      for (int i = 0; i < n; i++) {
+        int callType, reqSize, respSize, req = -1;
+        void *connection, *opId;
+        memcpy(&callType, ptr, sizeof(int)); ptr += sizeof(int);
+        memcpy(&connection, ptr, sizeof(void*)); ptr += sizeof(void*);
+        memcpy(&reqSize, ptr, sizeof(int)); ptr += sizeof(int);
+        memcpy(&respSize, ptr, sizeof(int)); ptr += sizeof(int);
+        if (reqSize >= (int)sizeof(int)) memcpy(&req, ptr, sizeof(int));
+        ptr += reqSize;
+        memcpy(&opId, ptr, sizeof(void*)); ptr += sizeof(void*);
+        if (callType == 1) {
+          conns.emplace_back(new long(0));
+          connection = batchConns[i] = conns.back().get();
+        } else if (!ncclProxyBatchResolve(connection, batchConns.data(), i, &connection)) {
+          return false;
+        }
+        ran.push_back({connection, req});
+        struct ncclProxyDeferredCall* c = (struct ncclProxyDeferredCall*)opId;
+        if (respSize >= (int)(sizeof(void*) + sizeof(int))) {
+          memcpy(c->respBuff, &connection, sizeof(void*));
+          memcpy((char*)c->respBuff + sizeof(void*), &req, sizeof(int));
+        }
+      }
+      nMsgs++;
+      return ptr == msg + size;
+    }
+  };
+
+  // Flush like proxyBatchFlush(): one message per proxy, then the Inits complete their connectors
+  static bool ProxyBatchFlush(struct ncclProxyBatch* batch, ProxyBatchMock& mock, std::map<void*, void*>& connected)
+  {
+    int count = batch->count;
+    batch->count = 0;
+    bool ok = true;
+    for (int first = 0; first < count && ok; first++) {
+      if (batch->calls[first].batchIndex != -1) continue;
+      int n;
+      size_t size = ncclProxyBatchPack(batch, count, first, 10, nullptr, &n);
+      std::vector<char> msg(size);
+      EXPECT_EQ(ncclProxyBatchPack(batch, count, first, 10, msg.data(), nullptr), size);
+      ok = mock.Receive(msg.data(), size);
+    }
+    for (int i = 0; i < count && ok; i++) {
+      if (batch->calls[i].isInit) memcpy(&connected[batch->calls[i].proxyConn], batch->calls[i].respBuff, sizeof(void*));
+    }
+    ncclProxyBatchRelease(batch, count);
+    return ok;
+  }
+
+  TEST(HostUnit, ProxyBatch)
+  {
+    // Connectors only serve as keys here
+    char keys[5];
+    struct ncclProxyConnector* conn[5];
+    for (int i = 0; i < 5; i++) conn[i] = (struct ncclProxyConnector*)(keys+i);
+    long existing = 0;
+    struct ncclProxyBatch batch = {};
+    struct { char data[sizeof(void*) + sizeof(int)]; } resp[8];
+    int const respSize = sizeof(resp[0]);
+
+    // Connector 4 has no connection and no Init queued
+    int req = 0;
+    EXPECT_EQ(ncclProxyBatchPush(&batch, conn[4], 0, nullptr, 3, 0, &req, sizeof(int), resp, respSize, nullptr), ncclProxyBatchNotConnected);
+    EXPECT_EQ(batch.count, 0);
+
+    // Proxies 0 and 2 get Init then Setup/Connect on the new connections, proxy 1 a Setup on an existing one
+    struct { int conn, proxy, type; void* connection; } calls[] = {
+      {0, 0, 1, nullptr}, {1, 1, 3, &existing}, {0, 0, 3, nullptr}, {2, 0, 1, nullptr},
+      {3, 2, 1, nullptr}, {0, 0, 4, nullptr}, {2, 0, 3, nullptr}, {3, 2, 3, nullptr},
+    };
+    int const nCalls = sizeof(calls)/sizeof(calls[0]);
+    for (int i = 0; i < nCalls; i++) {
+      req = 100+i;
+      struct ncclProxyDeferredCall* call = nullptr;
+      EXPECT_EQ(ncclProxyBatchPush(&batch, conn[calls[i].conn], calls[i].proxy, calls[i].connection, calls[i].type,
+                                   calls[i].type == 1, &req, sizeof(int), calls[i].type == 1 ? nullptr : resp+i, respSize, &call), ncclProxyBatchOk);
+      ASSERT_NE(call, nullptr);
+      // The request is copied, the caller's buffer can go away
+      req = -1;
+      EXPECT_EQ(*(int*)call->reqBuff, 100+i);
+    }
+    EXPECT_EQ(batch.count, nCalls);
+    EXPECT_EQ(batch.calls[2].pendingInit, 0);
+    EXPECT_EQ(batch.calls[6].pendingInit, 3);
+    EXPECT_EQ(batch.calls[1].pendingInit, -1);
+
+    ProxyBatchMock mock;
+    std::map<void*, void*> connected;
+    ASSERT_TRUE(ProxyBatchFlush(&batch, mock, connected));
+    EXPECT_EQ(batch.count, 0);
+    // One message per proxy, every call ran once, in queue order per proxy
+    EXPECT_EQ(mock.nMsgs, 3);
+    ASSERT_EQ(mock.ran.size(), (size_t)nCalls);
+    int order[] = {100, 102, 103, 105, 106, 101, 104, 107};
+    for (int i = 0; i < nCalls; i++) EXPECT_EQ(mock.ran[i].second, order[i]);
+    // Calls after an Init ran on the connection it created
+    EXPECT_EQ(connected.size(), 3u);
+    for (int i = 0; i < nCalls; i++) {
+      if (calls[i].type == 1) continue;
+      void* expected = calls[i].connection ? calls[i].connection : connected[conn[calls[i].conn]];
+      void* got;
+      memcpy(&got, resp[i].data, sizeof(void*));
+      EXPECT_EQ(got, expected);
+      int echo;
+      memcpy(&echo, resp[i].data + sizeof(void*), sizeof(int));
+      EXPECT_EQ(echo, 100+i);
+    }
+    EXPECT_NE(connected[conn[0]], connected[conn[2]]);
+
+    // The queue is reused, and calls on connected connectors need no Init
+    req = 7;
+    EXPECT_EQ(ncclProxyBatchPush(&batch, conn[0], 0, connected[conn[0]], 3, 0, &req, sizeof(int), resp, respSize, nullptr), ncclProxyBatchOk);
+    ASSERT_TRUE(ProxyBatchFlush(&batch, mock, connected));
+    EXPECT_EQ(mock.ran.back().first, connected[conn[0]]);
+
+    // Initial connections are never odd, references to unknown Inits are rejected
+    void* resolved;
+    void* batchConns[2] = { &existing, nullptr };
+    EXPECT_TRUE(ncclProxyBatchResolve(ncclProxyBatchInitRef(0), batchConns, 2, &resolved));
+    EXPECT_EQ(resolved, (void*)&existing);
+    EXPECT_FALSE(ncclProxyBatchResolve(ncclProxyBatchInitRef(1), batchConns, 2, &resolved));
+    EXPECT_FALSE(ncclProxyBatchResolve(ncclProxyBatchInitRef(2), batchConns, 2, &resolved));
+
+    // A proxy giving up on a batch after its first call reads the other calls and
+    // finds the next message right after them
+    {
+      std::vector<char> big(300, 'x');
+      EXPECT_EQ(ncclProxyBatchPush(&batch, conn[0], 0, nullptr, 1, 1, &req, sizeof(int), nullptr, respSize, nullptr), ncclProxyBatchOk);
+      EXPECT_EQ(ncclProxyBatchPush(&batch, conn[0], 0, nullptr, 3, 0, big.data(), (int)big.size(), resp, respSize, nullptr), ncclProxyBatchOk);
+      EXPECT_EQ(ncclProxyBatchPush(&batch, conn[0], 0, nullptr, 4, 0, nullptr, 0, resp+1, respSize, nullptr), ncclProxyBatchOk);
+      int n;
+      size_t size = ncclProxyBatchPack(&batch, batch.count, 0, 10, nullptr, &n);
+      std::vector<char> stream(size + sizeof(int));
+      EXPECT_EQ(ncclProxyBatchPack(&batch, batch.count, 0, 10, stream.data(), nullptr), size);
+      int const next = 12345;
+      memcpy(stream.data() + size, &next, sizeof(int));
+      size_t offset = 2*sizeof(int) + ncclProxyBatchEntrySize(sizeof(int));
+      auto recv = [&](void* buf, int bytes) {
+        if (offset + bytes > stream.size()) return ncclSystemError;
+        memcpy(buf, stream.data() + offset, bytes);
+        offset += bytes;
+        return ncclSuccess;
+      };
+      EXPECT_EQ(ncclProxyBatchSkip(n-1, recv), ncclSuccess);
+      EXPECT_EQ(offset, size);
+      int got = 0;
+      EXPECT_EQ(recv(&got, sizeof(int)), ncclSuccess);
+      EXPECT_EQ(got, next);
+      // A stream cut short returns the error of the read
+      offset = size - 4;
+      EXPECT_EQ(ncclProxyBatchSkip(1, recv), ncclSystemError);
+      ncclProxyBatchRelease(&batch, batch.count);
+      batch.count = 0;
+    }
+
+    // Teardown drops what is still queued
+    for (int i = 0; i < 100; i++)
+      EXPECT_EQ(ncclProxyBatchPush(&batch, conn[i % 2], 0, nullptr, 1, 1, &req, sizeof(int), nullptr, respSize, nullptr), ncclProxyBatchOk);
+    EXPECT_EQ(ncclProxyBatchFree(&batch), 100);
+    EXPECT_EQ(batch.calls, nullptr);
+    EXPECT_EQ(batch.size, 0);
+    EXPECT_EQ(ncclProxyBatchFree(&batch), 0);
+  }
+
+  TEST(HostUnit, IfCache)
+  {
+    static ncclIfCache<int, 8, 4> cache;
+    // Mock interfaces: "ib0".."ib2" with addresses 10..12, or none
+    int nUp = 3, nScans = 0;
+    auto scan = [&](char* names, int* addrs, int nameSize, int maxIfs) {
+      nScans++;
+      int n = std::min(nUp, maxIfs);
+      for (int i = 0; i < n; i++) {
+        snprintf(names+i*nameSize, nameSize, "ib%d", i);
+        addrs[i] = 10+i;
+      }
+      return n;
+    };
+    char names[4*8];
+    int addrs[4];
+    bool cached;
+
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, nullptr, nullptr, scan, names, addrs, 8, 4, &cached), 3);
+    EXPECT_FALSE(cached);
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, nullptr, nullptr, scan, names, addrs, 8, 4, &cached), 3);
+    EXPECT_TRUE(cached);
+    EXPECT_EQ(nScans, 1);
+    EXPECT_STREQ(names+2*8, "ib2");
+    EXPECT_EQ(addrs[2], 12);
+
+    // Fewer interfaces or shorter names get a prefix of the list
+    memset(names, 0, sizeof(names));
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, "", nullptr, scan, names, addrs, 4, 1, &cached), 1);
+    EXPECT_TRUE(cached);
+    EXPECT_STREQ(names, "ib0");
+    EXPECT_EQ(names[4], 0);
+
+    // Any setting the list depends on triggers a new scan
+    ncclIfCacheGet(&cache, 10, nullptr, nullptr, scan, names, addrs, 8, 4, &cached);
+    EXPECT_FALSE(cached);
+    ncclIfCacheGet(&cache, 10, "ib1", nullptr, scan, names, addrs, 8, 4, &cached);
+    EXPECT_FALSE(cached);
+    ncclIfCacheGet(&cache, 10, "ib1", "10.0.0.1:1234", scan, names, addrs, 8, 4, &cached);
+    EXPECT_FALSE(cached);
+    ncclIfCacheGet(&cache, 10, "ib1", "10.0.0.1:1234", scan, names, addrs, 8, 4, &cached);
+    EXPECT_TRUE(cached);
+    EXPECT_EQ(nScans, 4);
+
+    // Names longer than the caller's are cut and terminated
+    memset(names, 'x', sizeof(names));
+    EXPECT_EQ(ncclIfCacheGet(&cache, 10, "ib1", "10.0.0.1:1234", scan, names, addrs, 3, 2, &cached), 2);
+    EXPECT_STREQ(names, "ib");
+    EXPECT_STREQ(names+3, "ib");
+
+    // A reset forces a new scan with the same settings
+    ncclIfCacheReset(&cache);
+    ncclIfCacheGet(&cache, 10, "ib1", "10.0.0.1:1234", scan, names, addrs, 8, 4, &cached);
+    EXPECT_FALSE(cached);
+    ncclIfCacheGet(&cache, 10, "ib1", "10.0.0.1:1234", scan, names, addrs, 8, 4, &cached);
+    EXPECT_TRUE(cached);
+    EXPECT_EQ(nScans, 5);
+
+    // No interface is not kept, the next call looks again
+    nUp = 0;
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, nullptr, nullptr, scan, names, addrs, 8, 4, &cached), 0);
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, nullptr, nullptr, scan, names, addrs, 8, 4, &cached), 0);
+    EXPECT_FALSE(cached);
+    nUp = 2;
+    EXPECT_EQ(ncclIfCacheGet(&cache, 2, nullptr, nullptr, scan, names, addrs, 8, 4, &cached), 2);
+    EXPECT_FALSE(cached);
+    EXPECT_EQ(nScans, 8);
+  }
+
+  // Mock net plugin for the NET receive proxy. A flush orders the steps received before
+  // it was issued, and completes on its second test.
+  struct NetFlushMock
+  {
+    struct Request { uint64_t covers; int testsLeft; };
+    std::vector<std::unique_ptr<Request>> requests;
+    int nFlushes = 0;
+    int nCompleted = 0;
+    int nStaleTests = 0;
+    int inFlight = 0;
+    int maxInFlight = 0;
+    uint64_t visible = 0;
+
+    ncclResult_t Iflush(uint64_t covers, void** request)
+    {
+      requests.emplace_back(new Request{covers, 2});
+      *request = requests.back().get();
+      nFlushes++;
+      inFlight++;
+      maxInFlight = std::max(maxInFlight, inFlight);
+      return ncclSuccess;
+    }
+
+    ncclResult_t Test(void* request, int* done)
+    {
+      Request* r = (Request*)request;
+      if (r->testsLeft <= 0) nStaleTests++;
+      *done = --r->testsLeft <= 0;
+      if (r->testsLeft == 0) {
+        visible = std::max(visible, r->covers);
+        inFlight--;
+        nCompleted++;
+      }
+      return ncclSuccess;
+    }
+  };
+
+  struct NetFlushSub
+  {
+    uint64_t received, flushed, transmitted;
+    int flushNeeded, flushesInFlight;
+    void* requests[8];
+  };
+
+  // Progress like recvProxyProgress(): each pass receives up to burst steps, flushes them,
+  // then hands at most one flushed step to the GPU. The 8 slots bound the steps in flight.
+  static void NetFlushRun(int nSteps, int burst, int maxFlushes, bool gdr, NetFlushMock& mock, NetFlushSub& sub)
+  {
+    memset(&sub, 0, sizeof(sub));
+    auto flush = [&](void** request) { return mock.Iflush(sub.received, request); };
+    auto test = [&](void* request, int* done) { return mock.Test(request, done); };
+    for (int pass = 0; sub.transmitted < (uint64_t)nSteps && pass < 10*nSteps; pass++) {
+      int progress;
+      for (int i = 0; i < burst && sub.received < (uint64_t)nSteps && sub.received < sub.transmitted + 8; i++) {
+        sub.received++;
+        if (gdr) sub.flushNeeded = 1;
+        if (maxFlushes == 0) {
+          EXPECT_EQ(ncclNetFlushAdvance(&sub, 1, maxFlushes, flush, &progress), ncclSuccess);
+        }
+      }
+      EXPECT_EQ(ncclNetFlushAdvance(&sub, 1, maxFlushes, flush, &progress), ncclSuccess);
+      int done;
+      EXPECT_EQ(ncclNetFlushTest(&sub, 1, test, &done), ncclSuccess);
+      if (done) {
+        // The GPU only sees steps a completed flush has ordered
+        if (gdr) {
+          EXPECT_LT(sub.transmitted, mock.visible);
+        }
+        sub.transmitted++;
+      }
+    }
+  }
+
+  TEST(HostUnit, NetFlush)
+  {
+    int const nSteps = 64;
+    for (int maxFlushes : {1, 2}) {
+      NetFlushMock mock;
+      NetFlushSub sub;
+      NetFlushRun(nSteps, 4, maxFlushes, true, mock, sub);
+      EXPECT_EQ(sub.transmitted, (uint64_t)nSteps);
+      // Bursts of received steps share a flush, and no more than maxFlushes are in flight
+      EXPECT_GT(mock.nFlushes, 0);
+      EXPECT_LT(mock.nFlushes, nSteps/2);
+      EXPECT_LE(mock.maxInFlight, maxFlushes);
+      // Every flush completed, was tested no more after that, and was released from its slots
+      EXPECT_EQ(mock.nCompleted, mock.nFlushes);
+      EXPECT_EQ(mock.nStaleTests, 0);
+      EXPECT_EQ(mock.inFlight, 0);
+      EXPECT_EQ(sub.flushesInFlight, 0);
+      for (int i = 0; i < 8; i++) EXPECT_EQ(sub.requests[i], nullptr);
+    }
+
+    // Without a limit, every received step gets its own flush as before coalescing
+    {
+      NetFlushMock mock;
+      NetFlushSub sub;
+      NetFlushRun(nSteps, 4, 0, true, mock, sub);
+      EXPECT_EQ(sub.transmitted, (uint64_t)nSteps);
+      EXPECT_EQ(mock.nFlushes, nSteps);
+      EXPECT_EQ(mock.nCompleted, nSteps);
+      EXPECT_EQ(mock.nStaleTests, 0);
+    }
+
+    // Steps that need no flush go to the GPU right away
+    {
+      NetFlushMock mock;
+      NetFlushSub sub;
+      NetFlushRun(nSteps, 4, 1, false, mock, sub);
+      EXPECT_EQ(sub.transmitted, (uint64_t)nSteps);
+      EXPECT_EQ(mock.nFlushes, 0);
+    }
+  }
+
+  TEST(HostUnit, GraphLimits)
+  {
+    struct ncclTopoGraphLimits limits;
+    ncclTopoGraphLimitsReset(&limits);
+    EXPECT_EQ(limits.nChannels.rank, -1);
+    EXPECT_EQ(limits.typeInter.bestRank, -1);
+
+    // pattern, nChannels, sameChannels, bwIntra, bwInter, typeIntra, typeInter
+    struct ncclTopoGraphInfo infos[] = {
+      {4, 16, 1, 48.0f, 24.0f, 1, 5},
+      {4, 16, 1, 48.0f, 12.0f, 1, 5},
+      {4,  8, 1, 64.0f, 12.0f, 3, 4},
+      {4, 24, 1, 48.0f, 24.0f, 1, 6},
+    };
+    for (int r = 0; r < 4; r++) ncclTopoGraphLimitsUpdate(&limits, infos+r, r);
+
+    // Global values are the lowest counts and bandwidths and the worst path types, from the first rank having them
+    EXPECT_EQ(limits.nChannels.value, 8);
+    EXPECT_EQ(limits.nChannels.rank, 2);
+    EXPECT_EQ(limits.nChannels.best, 24);
+    EXPECT_EQ(limits.nChannels.bestRank, 3);
+    EXPECT_EQ(limits.bwIntra.value, 48.0f);
+    EXPECT_EQ(limits.bwIntra.rank, 0);
+    EXPECT_EQ(limits.bwIntra.best, 64.0f);
+    EXPECT_EQ(limits.bwIntra.bestRank, 2);
+    EXPECT_EQ(limits.bwInter.value, 12.0f);
+    EXPECT_EQ(limits.bwInter.rank, 1);
+    EXPECT_EQ(limits.bwInter.bestRank, 0);
+    EXPECT_EQ(limits.typeIntra.value, 3);
+    EXPECT_EQ(limits.typeIntra.rank, 2);
+    EXPECT_EQ(limits.typeIntra.best, 1);
+    EXPECT_EQ(limits.typeIntra.bestRank, 0);
+    EXPECT_EQ(limits.typeInter.value, 6);
+    EXPECT_EQ(limits.typeInter.rank, 3);
+    EXPECT_EQ(limits.typeInter.best, 4);
+    EXPECT_EQ(limits.typeInter.bestRank, 2);
+
+    // Identical ranks leave the first one responsible
+    ncclTopoGraphLimitsReset(&limits);
+    for (int r = 0; r < 8; r++) ncclTopoGraphLimitsUpdate(&limits, infos, r);
+    EXPECT_EQ(limits.bwInter.rank, 0);
+    EXPECT_EQ(limits.bwInter.bestRank, 0);
+    EXPECT_EQ(limits.bwInter.value, limits.bwInter.best);
+
+    // Per-algorithm lookup, as done by ncclTopoGetGraphLimits
+    struct ncclTopoGraphLimits all[3], out;
+    for (int a = 0; a < 3; a++)
+    {
+      ncclTopoGraphLimitsReset(all+a);
+      ncclTopoGraphLimitsUpdate(all+a, infos+a, a);
+    }
+    EXPECT_TRUE(ncclTopoGraphLimitsGet(all, 3, 2, &out));
+    EXPECT_EQ(out.nChannels.value, 8);
+    EXPECT_EQ(out.nChannels.rank, 2);
+    EXPECT_TRUE(ncclTopoGraphLimitsGet(all, 3, 0, &out));
+    EXPECT_EQ(out.nChannels.value, 16);
+    EXPECT_EQ(out.bwInter.rank, 0);
+    EXPECT_FALSE(ncclTopoGraphLimitsGet(all, 3, 3, &out));
+    EXPECT_FALSE(ncclTopoGraphLimitsGet(all, 3, -1, &out));
+    EXPECT_EQ(out.nChannels.value, 16);
+  }
+
+  TEST(HostUnit, WorkPool)
+  {
+    // Mock device allocations and copies, counted
+    struct Work { int x; };
+    typedef ncclWorkPoolChunk<Work> Chunk;
+    int nAllocs = 0, nFrees = 0, nCopies = 0, nCopied = 0;
+    bool failAlloc = false;
+    auto alloc = [&](Chunk** chunk, int capacity) {
+      if (failAlloc) return ncclSystemError;
+      *chunk = new Chunk();
+      (*chunk)->capacity = capacity;
+      (*chunk)->hostWork = new Work[capacity];
+      (*chunk)->devWork = new Work[capacity];
+      nAllocs++;
+      return ncclSuccess;
+    };
+    auto freeChunk = [&](Chunk* chunk) {
+      delete[] chunk->hostWork;
+      delete[] chunk->devWork;
+      delete chunk;
+      nFrees++;
+      return ncclSuccess;
+    };
+    auto copy = [&](Work* dst, Work* src, int nWork) {
+      memcpy(dst, src, nWork*sizeof(Work));
+      nCopies++;
+      nCopied += nWork;
+      return ncclSuccess;
+    };
+
+    ncclWorkPool<Work> pool = {};
+    Chunk* chunks[101];
+    Work *hostWork, *devWork;
+
+    // 100 captured plans of 8 works share one chunk and one upload
+    for (int p = 0; p < 100; p++)
+    {
+      EXPECT_EQ(ncclWorkPoolAlloc(&pool, 8, 1024, alloc, chunks+p, &hostWork, &devWork), ncclSuccess);
+      EXPECT_EQ(devWork, chunks[0]->devWork + 8*p);
+      hostWork[0].x = p;
+    }
+    EXPECT_EQ(nAllocs, 1);
+    EXPECT_EQ(pool.nChunkAllocs, 1u);
+    EXPECT_EQ(pool.nPlans, 100u);
+    EXPECT_EQ(ncclWorkPoolUpload(&pool, copy), ncclSuccess);
+    EXPECT_EQ(ncclWorkPoolUpload(&pool, copy), ncclSuccess);
+    EXPECT_EQ(nCopies, 1);
+    EXPECT_EQ(nCopied, 800);
+    EXPECT_EQ(pool.nUploads, 1u);
+    EXPECT_EQ(chunks[0]->devWork[8*99].x, 99);
+
+    // A plan larger than what is left gets its own chunk, only its work is uploaded
+    EXPECT_EQ(ncclWorkPoolAlloc(&pool, 2000, 1024, alloc, chunks+100, &hostWork, &devWork), ncclSuccess);
+    EXPECT_EQ(chunks[100]->capacity, 2000);
+    EXPECT_EQ(nAllocs, 2);
+    EXPECT_EQ(ncclWorkPoolUpload(&pool, copy), ncclSuccess);
+    EXPECT_EQ(nCopies, 2);
+    EXPECT_EQ(nCopied, 2800);
+
+    // Failed allocations leave the pool as it was
+    failAlloc = true;
+    EXPECT_EQ(ncclWorkPoolAlloc(&pool, 2000, 1024, alloc, chunks+100, &hostWork, &devWork), ncclSystemError);
+    EXPECT_EQ(pool.nChunkAllocs, 2u);
+    EXPECT_EQ(pool.nPlans, 101u);
+    failAlloc = false;
+
+    // The older chunk is freed with its last plan, the current one is rewound and reused
+    for (int p = 0; p < 100; p++) EXPECT_EQ(ncclWorkPoolRelease(&pool, chunks[p], freeChunk), ncclSuccess);
+    EXPECT_EQ(nFrees, 1);
+    EXPECT_EQ(pool.nChunkFrees, 1u);
+    EXPECT_EQ(ncclWorkPoolRelease(&pool, chunks[100], freeChunk), ncclSuccess);
+    EXPECT_EQ(nFrees, 1);
+    EXPECT_EQ(pool.chunks->used, 0);
+    EXPECT_EQ(ncclWorkPoolAlloc(&pool, 16, 1024, alloc, chunks, &hostWork, &devWork), ncclSuccess);
+    EXPECT_EQ(nAllocs, 2);
+    EXPECT_EQ(devWork, pool.chunks->devWork);
+
+    // Destruction frees what is left
+    EXPECT_EQ(ncclWorkPoolDestroy(&pool, freeChunk), ncclSuccess);
+    EXPECT_EQ(pool.chunks, nullptr);
+    EXPECT_EQ(nFrees, nAllocs);
+    EXPECT_EQ(pool.nChunkFrees, pool.nChunkAllocs);
+  }
+
+  TEST(HostUnit, CollNetSocket)
+  {
+    int32_t a[4] = { 1, -2, 3, 7 };
+    const int32_t b[4] = { 4, 5, -6, 7 };
+    ncclCollNetSocketReduceType(a, b, 4, ncclCollNetSocketSum);
+    EXPECT_EQ(std::vector<int32_t>(a, a+4), std::vector<int32_t>({ 5, 3, -3, 14 }));
+    ncclCollNetSocketReduceType(a, b, 4, ncclCollNetSocketProd);
+    EXPECT_EQ(std::vector<int32_t>(a, a+4), std::vector<int32_t>({ 20, 15, 18, 98 }));
+    ncclCollNetSocketReduceType(a, b, 4, ncclCollNetSocketMin);
+    EXPECT_EQ(std::vector<int32_t>(a, a+4), std::vector<int32_t>({ 4, 5, -6, 7 }));
+    uint8_t u[2] = { 200, 3 };
+    const uint8_t v[2] = { 100, 250 };
+    ncclCollNetSocketReduceType(u, v, 2, ncclCollNetSocketMax);
+    EXPECT_EQ(u[0], 200);
+    EXPECT_EQ(u[1], 250);
+    ncclCollNetSocketReduceType(u, v, 2, ncclCollNetSocketSum);
+    EXPECT_EQ(u[0], 44); // Wraps around like the kernels
+    EXPECT_EQ(u[1], 244);
+
+    // Float sums depend on the order: 1e8 + 1 - 1e8 is 0 in rank order, 1 if rank 2 came first
+    const int nranks = 3, size = sizeof(float);
+    const float contrib[nranks] = { 1e8f, 1.0f, -1e8f };
+    std::vector<std::vector<int>> arrivals = { {1, 2}, {2, 1} };
+    for (auto& arrival : arrivals) {
+      int offsets[nranks] = { size, 0, 0 };
+      int nReduced = 1;
+      float result = contrib[0];
+      std::vector<int> order;
+      auto reduce = [&](int r) {
+        order.push_back(r);
+        ncclCollNetSocketReduceType(&result, contrib+r, 1, ncclCollNetSocketSum);
+      };
+      // Partially received contributions are not reduced yet
+      offsets[arrival[0]] = size/2;
+      EXPECT_FALSE(ncclCollNetSocketReduceArrived(nranks, offsets, size, &nReduced, reduce));
+      offsets[arrival[0]] = size;
+      EXPECT_FALSE(ncclCollNetSocketReduceArrived(nranks, offsets, size, &nReduced, reduce));
+      EXPECT_EQ(nReduced, arrival[0] == 1 ? 2 : 1);
+      offsets[arrival[1]] = size;
+      EXPECT_TRUE(ncclCollNetSocketReduceArrived(nranks, offsets, size, &nReduced, reduce));
+      EXPECT_EQ(nReduced, nranks);
+      EXPECT_EQ(order, std::vector<int>({ 1, 2 }));
+      EXPECT_EQ(result, 0.0f);
+    }
+  }
+}
@@ -4,6 +4,7 @@
  * See LICENSE.txt for license information
  ************************************************************************/
 #include "TestBed.hpp"
+#include "reduce_acc.h"
 
 namespace RcclUnitTesting
 {
@@ -120,4 +121,81 @@ namespace RcclUnitTesting
                            inPlaceList, managedMemList, useHipGraphList);
     testBed.Finalize();
   }
+
+  // ncclAvg along the ring, compared bit exactly with the reduce steps of reduce_acc.h,
+  // with and without fp32 partial sums
+  TEST(ReduceScatter, ReduceAccFp32RingAvg)
+  {
+    // Set algorithm env var prior to TestBed
+    setenv("NCCL_ALGO", "RING", 1);
+
+    TestBed testBed;
+
+    // Configuration
+    ncclFunc_t                  const  funcType      = ncclCollReduceScatter;
+    std::vector<ncclDataType_t> const& dataTypes     = {ncclFloat16, ncclBfloat16};
+    std::vector<int>            const  numElements   = {1048576, 12888, 384};
+    std::vector<const char *>   const  accList       = {"0", "1"};
+    std::vector<const char *>   const  protoList     = {"LL", "SIMPLE"};
+    bool                        const  inPlace       = false;
+    bool                        const  useManagedMem = false;
+
+    // The fp32 partial sums change results whenever 1/nRanks is not a power of two
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int type : {ncclReduceAccHalf, ncclReduceAccBfloat16})
+    {
+      if ((totalRanks & (totalRanks - 1)) == 0) continue;
+      int numDiffer = 0;
+      for (int i = 0; i < 1024; ++i)
+      {
+        uint16_t const input = ReduceAccRingAvgInput(type, i);
+        numDiffer += ReduceAccRingAvgExpected(type, totalRanks, input, false) !=
+                     ReduceAccRingAvgExpected(type, totalRanks, input, true);
+      }
+      EXPECT_GT(numDiffer, 0) << totalRanks << " ranks, type " << type;
+    }
+
+    OptionalColArgs options;
+    options.redOp = ncclAvg;
+
+    bool isCorrect = true;
+    for (auto acc : accList)
+    for (auto proto : protoList)
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      setenv("RCCL_REDUCE_ACC_FP32", acc, 1);
+      setenv("NCCL_PROTO", proto, 1);
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (int numIdx = 0; numIdx < numElements.size() && isCorrect; ++numIdx)
+      {
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     funcType, dataTypes[dataIdx],
+                                                     ncclAvg, -1, inPlace, useManagedMem, false);
+          INFO("%s RCCL_REDUCE_ACC_FP32=%s %s %d elements\n", name.c_str(), acc, proto, numElements[numIdx]);
+        }
+
+        int numInputElements, numOutputElements;
+        CollectiveArgs::GetNumElementsForFuncType(funcType, numElements[numIdx], totalRanks,
+                                                  &numInputElements, &numOutputElements);
+        testBed.SetCollectiveArgs(funcType, dataTypes[dataIdx], numInputElements, numOutputElements, options);
+        testBed.AllocateMem(inPlace, useManagedMem);
+        testBed.PrepareData(-1, -1, -1, PrepData_ReduceAccRingAvg);
+        testBed.ExecuteCollectives();
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+
+    unsetenv("NCCL_ALGO");
+    unsetenv("NCCL_PROTO");
+    unsetenv("RCCL_REDUCE_ACC_FP32");
+  }
 }
@@ -0,0 +1,160 @@
+/*************************************************************************
+ * Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+ *
+ * See LICENSE.txt for license information
+ ************************************************************************/
+
+ // Note: InPlace is not supported for Reduce-Scatterv
+
+#include "TestBed.hpp"
+
+namespace RcclUnitTesting
+{
+  // Segments of ReduceScatterv in sendcounts/sdispls within options, with a gap of
+  // rank elements before each one. Returns the number of input elements.
+  //   pattern 0: uneven counts
+  //   pattern 1: empty segments on odd ranks
+  //   pattern 2: only the last rank has a segment
+  //   pattern 3: all segments empty
+  static size_t PrepareReduceScattervCounts(int const totalRanks, int const pattern, size_t const chunkSize,
+                                        OptionalColArgs& options)
+  {
+    size_t displ = 0;
+    for (int rank = 0; rank < totalRanks; ++rank)
+    {
+      size_t count = 0;
+      switch (pattern)
+      {
+      case 0: count = (rank + 1) * chunkSize + rank;                  break;
+      case 1: count = (rank % 2) ? 0 : (rank + 1) * chunkSize + 3;    break;
+      case 2: count = (rank == totalRanks - 1) ? chunkSize + 5 : 0;   break;
+      default: count = 0;                                             break;
+      }
+      displ += rank;
+      options.sendcounts[rank] = count;
+      options.sdispls[rank]    = displ;
+      displ += count;
+    }
+    return displ;
+  }
+
+  TEST(ReduceScatterv, OutOfPlace)
+  {
+    TestBed testBed;
+
+    // Configuration
+    std::vector<ncclDataType_t> const& dataTypes       = {ncclInt8, ncclFloat32, ncclFloat64};
+    std::vector<ncclRedOp_t>    const& redOps          = {ncclSum, ncclMax, ncclAvg};
+    std::vector<size_t>         const& chunkSizes      = {1, 257, 65536 + 3};
+    std::vector<int>            const& patterns        = {0, 1, 2, 3};
+    bool                        const  inPlace         = false;
+    bool                        const  useManagedMem   = false;
+    bool                        const  useHipGraph     = false;
+
+    OptionalColArgs options;
+
+    bool isCorrect = true;
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (ncclRedOp_t redOp : redOps)
+      for (size_t chunkSize : chunkSizes)
+      for (int pattern : patterns)
+      {
+        if (!isCorrect) break;
+        size_t const numInputElements = PrepareReduceScattervCounts(totalRanks, pattern, chunkSize, options);
+        options.redOp = redOp;
+
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     ncclCollReduceScatterv, dataTypes[dataIdx],
+                                                     redOp, -1, inPlace, useManagedMem, useHipGraph);
+          INFO("%s pattern %d chunk %lu\n", name.c_str(), pattern, chunkSize);
+        }
+
+        for (int rank = 0; rank < totalRanks; ++rank)
+        {
+          testBed.SetCollectiveArgs(ncclCollReduceScatterv,
+                                    dataTypes[dataIdx],
+                                    std::max(numInputElements, (size_t)1),
+                                    std::max(options.sendcounts[rank], (size_t)1),
+                                    options,
+                                    -1,
+                                    0,
+                                    rank);
+        }
+        testBed.AllocateMem(inPlace, useManagedMem);
+        testBed.PrepareData();
+        testBed.ExecuteCollectives({}, useHipGraph);
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+  }
+
+  TEST(ReduceScatterv, OutOfPlaceGraph)
+  {
+    TestBed testBed;
+
+    // Configuration
+    std::vector<ncclDataType_t> const& dataTypes       = {ncclFloat16, ncclInt32};
+    std::vector<ncclRedOp_t>    const& redOps          = {ncclSum};
+    std::vector<int>            const& patterns        = {0, 1};
+    bool                        const  inPlace         = false;
+    bool                        const  useManagedMem   = false;
+    bool                        const  useHipGraph     = true;
+
+    OptionalColArgs options;
+
+    bool isCorrect = true;
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (ncclRedOp_t redOp : redOps)
+      for (int pattern : patterns)
+      {
+        if (!isCorrect) break;
+        size_t const numInputElements = PrepareReduceScattervCounts(totalRanks, pattern, 4096 + 7, options);
+        options.redOp = redOp;
+
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     ncclCollReduceScatterv, dataTypes[dataIdx],
+                                                     redOp, -1, inPlace, useManagedMem, useHipGraph);
+          INFO("%s pattern %d\n", name.c_str(), pattern);
+        }
+
+        for (int rank = 0; rank < totalRanks; ++rank)
+        {
+          testBed.SetCollectiveArgs(ncclCollReduceScatterv,
+                                    dataTypes[dataIdx],
+                                    std::max(numInputElements, (size_t)1),
+                                    std::max(options.sendcounts[rank], (size_t)1),
+                                    options,
+                                    -1,
+                                    0,
+                                    rank);
+        }
+        testBed.AllocateMem(inPlace, useManagedMem);
+        testBed.PrepareData();
+        testBed.ExecuteCollectives({}, useHipGraph);
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+  }
+}
@@ -120,4 +120,68 @@ namespace RcclUnitTesting
                            inPlaceList, managedMemList, useHipGraphList);
     testBed.Finalize();
   }
+
+  TEST(Reduce, Tree)
+  {
+    // Opt in to Reduce on trees prior to TestBed
+    setenv("RCCL_TREE_BCAST_REDUCE", "1", 1);
+    setenv("NCCL_ALGO", "TREE", 1);
+
+    TestBed testBed;
+
+    // Configuration
+    std::vector<ncclDataType_t> const dataTypes       = {ncclInt32, ncclFloat32};
+    std::vector<ncclRedOp_t>    const redOps          = {ncclSum, ncclMax};
+    std::vector<int>            const numElements     = {1048576, 12888, 384};
+    std::vector<bool>           const inPlaceList     = {false, true};
+    std::vector<const char *>   const protoList       = {"LL", "LL128", "SIMPLE"};
+
+    OptionalColArgs options;
+
+    bool isCorrect = true;
+    for (auto proto : protoList)
+    for (int totalRanks : testBed.ev.GetNumGpusList())
+    for (int isMultiProcess : testBed.ev.GetIsMultiProcessList())
+    {
+      setenv("NCCL_PROTO", proto, 1);
+      int const numProcesses = isMultiProcess ? totalRanks : 1;
+      testBed.InitComms(TestBed::GetDeviceIdsList(numProcesses, totalRanks));
+
+      // First, second, middle and last rank, which sit at different depths of the tree
+      std::vector<int> const roots = {0, 1, totalRanks / 2, totalRanks - 1};
+      for (int dataIdx = 0; dataIdx < dataTypes.size() && isCorrect; ++dataIdx)
+      for (int redOpIdx = 0; redOpIdx < redOps.size() && isCorrect; ++redOpIdx)
+      for (int rootIdx = 0; rootIdx < roots.size() && isCorrect; ++rootIdx)
+      for (bool inPlace : inPlaceList)
+      for (int numElement : numElements)
+      {
+        if (!isCorrect) break;
+        if (rootIdx > 0 && roots[rootIdx] == roots[rootIdx - 1]) continue;
+        options.redOp = redOps[redOpIdx];
+        options.root  = roots[rootIdx];
+
+        if (testBed.ev.showNames)
+        {
+          std::string name = testBed.GetTestCaseName(totalRanks, isMultiProcess,
+                                                     ncclCollReduce, dataTypes[dataIdx],
+                                                     redOps[redOpIdx], roots[rootIdx],
+                                                     inPlace, false, false);
+          INFO("%s %s %d elements\n", name.c_str(), proto, numElement);
+        }
+
+        testBed.SetCollectiveArgs(ncclCollReduce, dataTypes[dataIdx], numElement, numElement, options);
+        testBed.AllocateMem(inPlace, false);
+        testBed.PrepareData();
+        testBed.ExecuteCollectives();
+        testBed.ValidateResults(isCorrect);
+        testBed.DeallocateMem();
+      }
+      testBed.DestroyComms();
+    }
+    testBed.Finalize();
+
+    unsetenv("NCCL_PROTO");
+    unsetenv("NCCL_ALGO");
+    unsetenv("RCCL_TREE_BCAST_REDUCE");
+  }
 }
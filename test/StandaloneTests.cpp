@@ -4,6 +4,9 @@
  * See LICENSE.txt for license information
  ************************************************************************/
 
+#include <cmath>
+#include <memory>
+#include <random>
 #include <gtest/gtest.h>
 #include <rccl/rccl.h>
 
@@ -57,6 +60,75 @@ namespace RcclUnitTesting
       NCCLCHECK(ncclCommDestroy(comm));
   }
 
+  /**
+   * \brief Destroys several cliques of communicators from one process, serially and in parallel.
+   * ******************************************************************************************/
+  TEST(Standalone, ParallelDestroy)
+  {
+    // Check for multi-gpu
+    int numDevices;
+    HIPCALL(hipGetDeviceCount(&numDevices));
+    if (numDevices < 2) {
+      GTEST_SKIP() << "This test requires at least 2 devices.";
+    }
+
+    int const numCliques = 4;
+    size_t const N = 1024;
+    std::vector<float*> buff(numDevices);
+    std::vector<hipStream_t> streams(numDevices);
+    for (int i = 0; i < numDevices; i++) {
+      HIPCALL(hipSetDevice(i));
+      HIPCALL(hipStreamCreate(&streams[i]));
+      HIPCALL(hipMalloc(&buff[i], N * sizeof(float)));
+    }
+
+    const char* parallel = getenv("RCCL_PARALLEL_DESTROY");
+    for (const char* mode : {"0", "1"}) {
+      setenv("RCCL_PARALLEL_DESTROY", mode, 1);
+      // Comms created after a destroy must work like the first ones
+      for (int cycle = 0; cycle < 3; cycle++) {
+        std::vector<std::vector<ncclComm_t>> comms(numCliques, std::vector<ncclComm_t>(numDevices));
+        for (auto& clique : comms)
+          NCCLCHECK(ncclCommInitAll(clique.data(), numDevices, nullptr));
+
+        for (auto& clique : comms) {
+          std::vector<float> ones(N, 1.0f);
+          for (int i = 0; i < numDevices; i++) {
+            HIPCALL(hipSetDevice(i));
+            HIPCALL(hipMemcpy(buff[i], ones.data(), N * sizeof(float), hipMemcpyHostToDevice));
+          }
+          NCCLCHECK(ncclGroupStart());
+          for (int i = 0; i < numDevices; i++)
+            NCCLCHECK(ncclAllReduce(buff[i], buff[i], N, ncclFloat, ncclSum, clique[i], streams[i]));
+          NCCLCHECK(ncclGroupEnd());
+          for (int i = 0; i < numDevices; i++) {
+            HIPCALL(hipSetDevice(i));
+            HIPCALL(hipStreamSynchronize(streams[i]));
+            std::vector<float> result(N);
+            HIPCALL(hipMemcpy(result.data(), buff[i], N * sizeof(float), hipMemcpyDeviceToHost));
+            for (size_t j = 0; j < N; j++)
+              ASSERT_EQ(result[j], (float)numDevices);
+          }
+        }
+
+        // The last destroy of each clique frees all its comms at once
+        for (auto& clique : comms)
+          for (auto& comm : clique)
+            ASSERT_EQ(ncclCommDestroy(comm), ncclSuccess);
+      }
+    }
+    if (parallel)
+      setenv("RCCL_PARALLEL_DESTROY", parallel, 1);
+    else
+      unsetenv("RCCL_PARALLEL_DESTROY");
+
+    for (int i = 0; i < numDevices; i++) {
+      HIPCALL(hipSetDevice(i));
+      HIPCALL(hipFree(buff[i]));
+      HIPCALL(hipStreamDestroy(streams[i]));
+    }
+  }
+
   /**
    * \brief Creates a communicator for each device and gathers them all in one rank.
    * ******************************************************************************************/
@@ -152,6 +224,42 @@ namespace RcclUnitTesting
       NCCLCHECK(ncclCommDestroy(comm));
   }
 
+  /**
+   * \brief Verify ncclCommGetMemUsage reports the resources allocated during init.
+   * ******************************************************************************************/
+  TEST(Standalone, MemUsage)
+  {
+    int numDevices;
+    HIPCALL(hipGetDeviceCount(&numDevices));
+    if (numDevices < 2) {
+      GTEST_SKIP() << "This test requires at least 2 devices.";
+    }
+
+    std::vector<ncclComm_t> comms(2);
+    NCCLCHECK(ncclCommInitAll(comms.data(), 2, nullptr));
+
+    for (auto& comm : comms) {
+      ncclMemUsage_t usage;
+      NCCLCHECK(ncclCommGetMemUsage(comm, &usage));
+
+      // Channel structures and the work FIFO are always allocated
+      EXPECT_GT(usage.deviceBytes[ncclMemChannels], 0u);
+      EXPECT_GT(usage.deviceBytes[ncclMemWorkFifo] + usage.hostPinnedBytes[ncclMemWorkFifo], 0u);
+
+      // Ring connections are set up during init, whichever transport they use
+      size_t buffBytes = 0;
+      for (int c = ncclMemBuffP2p; c <= ncclMemProxyShared; c++)
+        buffBytes += usage.deviceBytes[c] + usage.hostPinnedBytes[c] + usage.hostBytes[c];
+      EXPECT_GT(buffBytes, 0u);
+      EXPECT_EQ(usage.deviceBytes[ncclMemRegistered], 0u);
+    }
+
+    EXPECT_EQ(ncclCommGetMemUsage(comms[0], nullptr), ncclInvalidArgument);
+
+    for (auto& comm : comms)
+      NCCLCHECK(ncclCommDestroy(comm));
+  }
+
   /**
    * \brief Verify there is no regression in timing for each protocol [LL, LL128, Simple]
    * ******************************************************************************************/
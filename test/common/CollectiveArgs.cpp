@@ -174,6 +174,8 @@ namespace RcclUnitTesting
     case ncclCollScatter:       ss << "ncclScatter";       break;
     case ncclCollAllToAll:      ss << "ncclAllToAll";      break;
     case ncclCollAllToAllv:     ss << "ncclAllToAllv";     break;
+    case ncclCollAllGatherv:    ss << "ncclAllGatherv";    break;
+    case ncclCollReduceScatterv:ss << "ncclReduceScatterv";break;
     case ncclCollSend:          ss << "ncclSend";          break;
     case ncclCollRecv:          ss << "ncclRecv";          break;
     default:                    ss << "[Unknown]";         break;
@@ -182,6 +184,7 @@ namespace RcclUnitTesting
     ss << " " << ncclDataTypeNames[this->dataType] << " ";
     if (this->funcType == ncclCollReduce ||
         this->funcType == ncclCollReduceScatter ||
+        this->funcType == ncclCollReduceScatterv ||
         this->funcType == ncclCollAllReduce)
     {
       if (this->options.redOp < ncclNumOps)
@@ -269,9 +272,10 @@ namespace RcclUnitTesting
 
   bool CollectiveArgs::UsesReduce(ncclFunc_t const funcType)
   {
-    return (funcType == ncclCollReduce    ||
-            funcType == ncclCollAllReduce ||
-            funcType == ncclCollReduceScatter);
+    return (funcType == ncclCollReduce        ||
+            funcType == ncclCollAllReduce     ||
+            funcType == ncclCollReduceScatter ||
+            funcType == ncclCollReduceScatterv);
   }
 
   bool CollectiveArgs::UsesRoot(ncclFunc_t const funcType)
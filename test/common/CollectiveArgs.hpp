@@ -22,6 +22,8 @@ namespace RcclUnitTesting
     ncclCollScatter,
     ncclCollAllToAll,
     ncclCollAllToAllv,
+    ncclCollAllGatherv,
+    ncclCollReduceScatterv,
     ncclCollSend,
     ncclCollRecv,
     ncclNumFuncs
@@ -38,6 +40,8 @@ namespace RcclUnitTesting
     "Scatter",
     "AllToAll",
     "AllToAllv",
+    "AllGatherv",
+    "ReduceScatterv",
     "Send",
     "Recv"
   };
@@ -82,7 +86,8 @@ namespace RcclUnitTesting
     ScalarTransport scalarTransport;        // Used for custom reduction operators
     int             scalarMode = -1;        // -1 if scalar not used
 
-    // allToAllv args
+    // allToAllv args, allGatherv uses the first totalRanks recvcounts/rdispls
+    // and reduceScatterv the first totalRanks sendcounts/sdispls
     size_t          sendcounts[MAX_RANKS*MAX_RANKS];
     size_t          sdispls[MAX_RANKS*MAX_RANKS];
     size_t          recvcounts[MAX_RANKS*MAX_RANKS];
@@ -6,7 +6,9 @@
 
 #include "CollectiveArgs.hpp"
 #include "PrepDataFuncs.hpp"
+#include "reduce_acc.h"
 #include <cstdio>
+#include <cstdlib>
 #include <hip/hip_runtime.h>
 
 namespace RcclUnitTesting
@@ -24,6 +26,8 @@ namespace RcclUnitTesting
     case ncclCollScatter:       return DefaultPrepData_Scatter(collArgs);
     case ncclCollAllToAll:      return DefaultPrepData_AllToAll(collArgs);
     case ncclCollAllToAllv:     return DefaultPrepData_AllToAllv(collArgs);
+    case ncclCollAllGatherv:    return DefaultPrepData_AllGatherv(collArgs);
+    case ncclCollReduceScatterv:return DefaultPrepData_ReduceScatterv(collArgs);
     case ncclCollSend:          return DefaultPrepData_Send(collArgs);
     case ncclCollRecv:          return DefaultPrepData_Recv(collArgs);
     default:
@@ -381,6 +385,102 @@ namespace RcclUnitTesting
     return TEST_SUCCESS;
   }
 
+  ErrCode DefaultPrepData_AllGatherv(CollectiveArgs &collArgs)
+  {
+    CHECK_CALL(CheckAllocation(collArgs));
+    size_t const typeSize = DataTypeToBytes(collArgs.dataType);
+    size_t const numOutputBytes = collArgs.numOutputElements * typeSize;
+    for (int rank = 0; rank < collArgs.totalRanks; ++rank)
+    {
+      if (collArgs.options.rdispls[rank] + collArgs.options.recvcounts[rank] > collArgs.numOutputElements)
+      {
+        ERROR("Segment of rank %d exceeds the %lu output elements for AllGatherv\n", rank, collArgs.numOutputElements);
+        return TEST_FAIL;
+      }
+    }
+
+    // Clear output for all ranks, parts of it between segments are left untouched
+    CHECK_CALL(collArgs.outputGpu.ClearGpuMem(numOutputBytes));
+    PtrUnion result;
+    CHECK_CALL(result.Attach(collArgs.expected.ptr));
+    CHECK_CALL(result.ClearCpuMem(numOutputBytes));
+
+    PtrUnion tempInputCpu;
+    CHECK_CALL(tempInputCpu.Attach(collArgs.outputCpu.ptr));
+    for (int rank = 0; rank < collArgs.totalRanks; ++rank)
+    {
+      size_t const count = collArgs.options.recvcounts[rank];
+      CHECK_CALL(tempInputCpu.FillPattern(collArgs.dataType, count, rank, false));
+      if (rank == collArgs.globalRank)
+      {
+        CHECK_HIP(hipMemcpy(collArgs.inputGpu.ptr, tempInputCpu.ptr, count * typeSize, hipMemcpyHostToDevice));
+      }
+      memcpy(result.U1 + collArgs.options.rdispls[rank] * typeSize, tempInputCpu.ptr, count * typeSize);
+    }
+    return TEST_SUCCESS;
+  }
+
+  ErrCode DefaultPrepData_ReduceScatterv(CollectiveArgs &collArgs)
+  {
+    CHECK_CALL(CheckAllocation(collArgs));
+    size_t const typeSize = DataTypeToBytes(collArgs.dataType);
+    size_t const numInputBytes  = collArgs.numInputElements * typeSize;
+    size_t const numOutputBytes = collArgs.numOutputElements * typeSize;
+    size_t const displ = collArgs.options.sdispls[collArgs.globalRank];
+    for (int rank = 0; rank < collArgs.totalRanks; ++rank)
+    {
+      if (collArgs.options.sdispls[rank] + collArgs.options.sendcounts[rank] > collArgs.numInputElements)
+      {
+        ERROR("Segment of rank %d exceeds the %lu input elements for ReduceScatterv\n", rank, collArgs.numInputElements);
+        return TEST_FAIL;
+      }
+    }
+    if (collArgs.options.sendcounts[collArgs.globalRank] > collArgs.numOutputElements)
+    {
+      ERROR("# of output elements must hold the segment of the rank for ReduceScatterv\n");
+      return TEST_FAIL;
+    }
+
+    // Clear output for all ranks
+    CHECK_CALL(collArgs.outputGpu.ClearGpuMem(numOutputBytes));
+    CHECK_CALL(collArgs.expected.ClearCpuMem(numOutputBytes));
+
+    PtrUnion tempInputCpu;
+    PtrUnion tempResultCpu;
+    CHECK_CALL(tempInputCpu.AllocateCpuMem(numInputBytes));
+    CHECK_CALL(tempResultCpu.AllocateCpuMem(numInputBytes));
+
+    // If average is used, perform a summation instead
+    ncclRedOp_t const tempOp = (collArgs.options.redOp >= ncclAvg ? ncclSum : collArgs.options.redOp);
+    for (int rank = 0; rank < collArgs.totalRanks; ++rank)
+    {
+      CHECK_CALL(tempInputCpu.FillPattern(collArgs.dataType, collArgs.numInputElements, rank, false));
+      if (rank == collArgs.globalRank)
+      {
+        CHECK_HIP(hipMemcpy(collArgs.inputGpu.ptr, tempInputCpu.ptr, numInputBytes, hipMemcpyHostToDevice));
+      }
+      if (rank == 0)
+      {
+        memcpy(tempResultCpu.ptr, tempInputCpu.ptr, numInputBytes);
+      }
+      else
+      {
+        CHECK_CALL(tempResultCpu.Reduce(collArgs.dataType, collArgs.numInputElements, tempInputCpu, tempOp));
+      }
+    }
+    if (collArgs.options.redOp == ncclAvg)
+    {
+      CHECK_CALL(tempResultCpu.DivideByInt(collArgs.dataType, collArgs.numInputElements, collArgs.totalRanks));
+    }
+
+    // Copy over the segment of this rank
+    memcpy(collArgs.expected.U1, tempResultCpu.U1 + displ * typeSize,
+           collArgs.options.sendcounts[collArgs.globalRank] * typeSize);
+    CHECK_CALL(tempInputCpu.FreeCpuMem());
+    CHECK_CALL(tempResultCpu.FreeCpuMem());
+    return TEST_SUCCESS;
+  }
+
   ErrCode DefaultPrepData_Send(CollectiveArgs &collArgs)
   {
     CHECK_CALL(CheckAllocation(collArgs));
@@ -397,4 +497,74 @@ namespace RcclUnitTesting
                                          collArgs.options.root,
                                          false);
   }
+
+  uint16_t ReduceAccRingAvgInput(int const type, size_t const idx)
+  {
+    return ncclReduceAccFromFloat(type, 256.0f + (idx % 1024) * 0.25f);
+  }
+
+  // Every rank has the same input, so along the ring each step adds the scaled input
+  // of one rank to the partial sum received from the previous one, whatever the ring
+  // order: the first rank only scales its input, the others add theirs.
+  uint16_t ReduceAccRingAvgExpected(int const type, int const totalRanks, uint16_t const input, bool const fp32)
+  {
+    // ncclAvg scales every input by 1/nRanks converted to the element type
+    float const scale = ncclReduceAccToFloat(type, ncclReduceAccFromFloat(type, float(1.0/totalRanks)));
+    uint16_t srcs[2] = {input, 0};
+    uint16_t sum = ncclReduceAccStep(type, 1, srcs, 1, scale, fp32);
+    for (int step = 1; step < totalRanks; ++step)
+    {
+      srcs[1] = sum;
+      sum = ncclReduceAccStep(type, 2, srcs, 1, scale, fp32);
+    }
+    return sum;
+  }
+
+  // Expected results follow ncclReduceAccStep, with fp32 partial sums when
+  // RCCL_REDUCE_ACC_FP32 is set. Values are in [256, 512), where one ulp is above
+  // the validation tolerance, so the comparison is bit exact.
+  ErrCode PrepData_ReduceAccRingAvg(CollectiveArgs &collArgs)
+  {
+    CHECK_CALL(CheckAllocation(collArgs));
+    if (collArgs.dataType != ncclFloat16 && collArgs.dataType != ncclBfloat16)
+    {
+      ERROR("PrepData_ReduceAccRingAvg only supports ncclFloat16 and ncclBfloat16\n");
+      return TEST_FAIL;
+    }
+    bool const isAllReduce = collArgs.funcType == ncclCollAllReduce;
+    if (!isAllReduce && collArgs.numInputElements != collArgs.numOutputElements * collArgs.totalRanks)
+    {
+      ERROR("Number of input elements must be number of output elements times totalRanks for ReduceScatter\n");
+      return TEST_FAIL;
+    }
+
+    int const type = collArgs.dataType == ncclBfloat16 ? ncclReduceAccBfloat16 : ncclReduceAccHalf;
+    char const* env = getenv("RCCL_REDUCE_ACC_FP32");
+    bool const fp32 = env && atoi(env) != 0;
+
+    size_t const numInputBytes  = collArgs.numInputElements * DataTypeToBytes(collArgs.dataType);
+    size_t const numOutputBytes = collArgs.numOutputElements * DataTypeToBytes(collArgs.dataType);
+
+    // Clear output for all ranks (done before filling input in case of in-place)
+    CHECK_CALL(collArgs.outputGpu.ClearGpuMem(numOutputBytes));
+
+    PtrUnion tempInputCpu;
+    CHECK_CALL(tempInputCpu.AllocateCpuMem(numInputBytes));
+    uint16_t* input = (uint16_t*)tempInputCpu.ptr;
+    for (size_t i = 0; i < collArgs.numInputElements; ++i)
+      input[i] = ReduceAccRingAvgInput(type, i);
+    if (hipMemcpy(collArgs.inputGpu.ptr, tempInputCpu.ptr, numInputBytes, hipMemcpyHostToDevice) != hipSuccess)
+    {
+      ERROR("hipMemcpy to input failed\n");
+      CHECK_CALL(tempInputCpu.FreeCpuMem());
+      return TEST_FAIL;
+    }
+
+    uint16_t* expected = (uint16_t*)collArgs.expected.ptr;
+    size_t const offset = isAllReduce ? 0 : collArgs.globalRank * collArgs.numOutputElements;
+    for (size_t i = 0; i < collArgs.numOutputElements; ++i)
+      expected[i] = ReduceAccRingAvgExpected(type, collArgs.totalRanks, input[offset + i], fp32);
+    CHECK_CALL(tempInputCpu.FreeCpuMem());
+    return TEST_SUCCESS;
+  }
 }
@@ -5,6 +5,8 @@
  ************************************************************************/
 #pragma once
 #include "ErrCode.hpp"
+#include <cstddef>
+#include <cstdint>
 
 namespace RcclUnitTesting
 {
@@ -23,6 +25,14 @@ namespace RcclUnitTesting
   ErrCode DefaultPrepData_Scatter(CollectiveArgs &collArgs);
   ErrCode DefaultPrepData_AllToAll(CollectiveArgs &collArgs);
   ErrCode DefaultPrepData_AllToAllv(CollectiveArgs &collArgs);
+  ErrCode DefaultPrepData_AllGatherv(CollectiveArgs &collArgs);
+  ErrCode DefaultPrepData_ReduceScatterv(CollectiveArgs &collArgs);
   ErrCode DefaultPrepData_Send(CollectiveArgs &collArgs);
   ErrCode DefaultPrepData_Recv(CollectiveArgs &collArgs);
+
+  // ncclAvg on half/bfloat16 along the ring, bit exact with RCCL_REDUCE_ACC_FP32 on or off.
+  // type is an ncclReduceAccType, see reduce_acc.h
+  uint16_t ReduceAccRingAvgInput(int const type, size_t const idx);
+  uint16_t ReduceAccRingAvgExpected(int const type, int const totalRanks, uint16_t const input, bool const fp32);
+  ErrCode PrepData_ReduceAccRingAvg(CollectiveArgs &collArgs);
 }
@@ -645,6 +645,31 @@ namespace RcclUnitTesting
                                         this->streams[groupId][localRank][collArg.streamIdx]),
                           "ncclAllToAllv");
           break;
+        case ncclCollAllGatherv:
+          CHILD_NCCL_CALL_RANK(errCode, ncclAllGatherv(
+                                        collArg.inputGpu.ptr,
+                                        collArg.options.recvcounts[collArg.globalRank],
+                                        collArg.outputGpu.ptr,
+                                        collArg.options.recvcounts,
+                                        collArg.options.rdispls,
+                                        collArg.dataType,
+                                        this->comms[localRank],
+                                        this->streams[groupId][localRank][collArg.streamIdx]),
+                          "ncclAllGatherv");
+          break;
+        case ncclCollReduceScatterv:
+          CHILD_NCCL_CALL_RANK(errCode, ncclReduceScatterv(
+                                            collArg.inputGpu.ptr,
+                                            collArg.options.sendcounts,
+                                            collArg.options.sdispls,
+                                            collArg.outputGpu.ptr,
+                                            collArg.options.sendcounts[collArg.globalRank],
+                                            collArg.dataType,
+                                            collArg.options.redOp,
+                                            this->comms[localRank],
+                                            this->streams[groupId][localRank][collArg.streamIdx]),
+                          "ncclReduceScatterv");
+          break;
         case ncclCollSend:
           if (collArg.userRegistered)
             CHILD_NCCL_CALL_RANK(errCode, ncclCommRegister(this->comms[localRank], collArg.inputGpu.ptr, collArg.numInputBytesAllocated, &(collArg.commRegHandle)),"ncclCommRegister");
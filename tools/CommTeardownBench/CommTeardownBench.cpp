@@ -0,0 +1,125 @@
+/*
+Copyright (c) 2024 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Times communicator creation and destruction, as done by elastic jobs that
+// rebuild their communicators after every membership change. It creates one
+// communicator per GPU of this node with ncclCommInitAll and runs an AllReduce
+// on them, so it needs GPUs. Standalone.ParallelDestroy in the unit tests
+// checks the communicators still work across destroy cycles.
+//
+// Usage: CommTeardownBench [iterations] [numGpus]
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <hip/hip_runtime.h>
+#include <rccl/rccl.h>
+
+#define HIP_CALL(cmd)                                                 \
+  do {                                                                \
+    hipError_t error = (cmd);                                         \
+    if (error != hipSuccess)                                          \
+    {                                                                   \
+      std::cout << "Encountered HIP error (" << hipGetErrorString(error) << ") at line " \
+                << __LINE__ << " in file " << __FILE__ << "\n";         \
+      exit(-1);                                                         \
+    }                                                                   \
+  } while (0)
+
+#define NCCL_CALL(cmd) \
+  do { \
+    ncclResult_t error = (cmd);                 \
+    if (error != ncclSuccess)                   \
+    {                                           \
+      std::cout << "Encountered NCCL error (" << ncclGetErrorString(error) << ") at line " \
+                << __LINE__ << " in file " << __FILE__ << "\n";         \
+      exit(-1);                                                         \
+    }                                                                   \
+  } while (0)
+
+static double msSince(std::chrono::high_resolution_clock::time_point t0)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+}
+
+int main(int argc, char **argv)
+{
+  int iterations = argc > 1 ? atoi(argv[1]) : 5;
+  int nranks;
+  HIP_CALL(hipGetDeviceCount(&nranks));
+  if (argc > 2 && atoi(argv[2]) > 0 && atoi(argv[2]) < nranks) nranks = atoi(argv[2]);
+
+  const char* parallel = getenv("RCCL_PARALLEL_DESTROY");
+  printf("Communicator teardown benchmark: %d GPUs, %d iterations, RCCL_PARALLEL_DESTROY=%s\n",
+         nranks, iterations, parallel ? parallel : "(unset, serial)");
+
+  size_t const N = 1024;
+  std::vector<float*> buff(nranks);
+  std::vector<hipStream_t> stream(nranks);
+  for (int r = 0; r < nranks; r++)
+  {
+    HIP_CALL(hipSetDevice(r));
+    HIP_CALL(hipStreamCreate(&stream[r]));
+    HIP_CALL(hipMalloc((void **)&buff[r], N * sizeof(float)));
+  }
+
+  double totalInit = 0, totalDestroy = 0;
+  printf("%10s %12s %12s\n", "Iteration", "Init (ms)", "Destroy (ms)");
+  for (int it = 0; it < iterations; it++)
+  {
+    std::vector<ncclComm_t> comm(nranks);
+    auto t0 = std::chrono::high_resolution_clock::now();
+    NCCL_CALL(ncclCommInitAll(comm.data(), nranks, NULL));
+    double initMs = msSince(t0);
+
+    // Use the communicators once so that all connections get set up
+    NCCL_CALL(ncclGroupStart());
+    for (int r = 0; r < nranks; r++)
+      NCCL_CALL(ncclAllReduce(buff[r], buff[r], N, ncclFloat, ncclSum, comm[r], stream[r]));
+    NCCL_CALL(ncclGroupEnd());
+    for (int r = 0; r < nranks; r++)
+    {
+      HIP_CALL(hipSetDevice(r));
+      HIP_CALL(hipStreamSynchronize(stream[r]));
+    }
+
+    t0 = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < nranks; r++)
+      NCCL_CALL(ncclCommDestroy(comm[r]));
+    double destroyMs = msSince(t0);
+
+    printf("%10d %12.2f %12.2f\n", it, initMs, destroyMs);
+    totalInit += initMs;
+    totalDestroy += destroyMs;
+  }
+  printf("%10s %12.2f %12.2f\n", "Average", totalInit / iterations, totalDestroy / iterations);
+
+  for (int r = 0; r < nranks; r++)
+  {
+    HIP_CALL(hipSetDevice(r));
+    HIP_CALL(hipFree(buff[r]));
+    HIP_CALL(hipStreamDestroy(stream[r]));
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdio>
+#include <cstddef>
+
+// NOTE: Parsing is based on this line logging collective information in enqueue.cc
+// INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d \
+                   root %d comm %p [nranks=%d] stream %p task %d globalrank %d",
+//                info->opName, info->comm->opCount, info->sendbuff, info->recvbuff, info->count,
+//                info->datatype, info->op, info->root, info->comm, info->comm->nRanks, info->stream,
+//                info->comm->tasks.nTasksP2p + info->comm->tasks.nTasksColl,
+//                info->comm->localRankToRank[info->comm->localRank]);
+//
+// Only depends on the C library so that host-only tools (e.g. topo_expl) can read the same logs.
+
+#define RCCL_LOG_MAX_HOSTNAME 256
+
+struct LineItem
+{
+  char   hostname[RCCL_LOG_MAX_HOSTNAME];
+  int    pid;
+  int    tid;
+  int    cudaDev;
+  char   opName[32];
+  int    opCount;
+  char   sendbuff[32];
+  char   recvbuff[32];
+  size_t count;
+  int    datatype;
+  int    op;
+  int    root;
+  char   comm[32];
+  int    nRanks;
+  void*  stream;
+  int    task;
+  int    globalRank;
+};
+
+// parse the logs and assign them into lineItem
+static inline bool ParseLineItem(char const* line, LineItem& li)
+{
+  return sscanf(line,
+                "%255[^:]:%d:%d [%d] NCCL INFO %31[^:]: opCount %x sendbuff %31s "
+                "recvbuff %31s count %lu datatype %d op %d root %d comm %31s "
+                "[nranks=%d] stream %p task %d globalrank %d",
+                li.hostname, &li.pid, &li.tid, &li.cudaDev, li.opName,
+                &li.opCount, li.sendbuff, li.recvbuff,
+                &li.count, &li.datatype, &li.op, &li.root, li.comm,
+                &li.nRanks, &li.stream, &li.task, &li.globalRank) == 17;
+}
@@ -4,13 +4,7 @@
 
 #include <rccl/rccl.h>
 
-// NOTE: Parsing is based on this line logging collective information in enqueue.cc
-// INFO(NCCL_COLL,"%s: opCount %lx sendbuff %p recvbuff %p count %zi datatype %d op %d \
-                   root %d comm %p [nranks=%d] stream %p task %d globalrank %d",
-//                info->opName, info->comm->opCount, info->sendbuff, info->recvbuff, info->count,
-//                info->datatype, info->op, info->root, info->comm, info->comm->nRanks, info->stream,
-//                info->comm->tasks.nTasksP2p + info->comm->tasks.nTasksColl,
-//                info->comm->localRankToRank[info->comm->localRank]);
+#include "rcclLogParser.hpp"
 
 #define HIP_CALL(cmd)                                                   \
   do {                                                                  \
@@ -31,27 +25,6 @@
     }                                                           \
   } while(0)
 
-struct LineItem
-{
-  char   hostname[MPI_MAX_PROCESSOR_NAME];
-  int    pid;
-  int    tid;
-  int    cudaDev;
-  char   opName[32];
-  int    opCount;
-  char   sendbuff[32];
-  char   recvbuff[32];
-  size_t count;
-  int    datatype;
-  int    op;
-  int    root;
-  char   comm[32];
-  int    nRanks;
-  void*  stream;
-  int    task;
-  int    globalRank;
-};
-
 // Enumeration of all collective functions currently supported
 typedef enum
 {
@@ -204,9 +177,6 @@ ncclFunc_t GetFuncType(char* func)
   exit(1);
 }
 
-// parse the logs and assign them into lineItem
-bool ParseLineItem(char const* line, LineItem& li);
-
 // this covers grouping the logs based on opCount and task number,
 // validatation of the groupCalls for both non-send/recv collectives and send/recv
 void ParseCollectives(char const* logFilename, bool isFirstRank, CollectiveCalls& collectiveCalls);
@@ -39,22 +39,37 @@ public:
   int firstRank;
   int currRank;
 
+  ncclResult_t status; // Error loading the topology, the model is unusable when set
+
+  // Path of a topology file: absolute, or relative to models/ next to the executable
+  static void getPath(const char *xml_file, char *filename) {
+    if (xml_file[0] == '/') {
+      // Absolute path to a user provided topology file
+      strncpy(filename, xml_file, PATH_MAX-1);
+      filename[PATH_MAX-1] = '\0';
+    } else {
+      ssize_t count = readlink("/proc/self/exe", filename, PATH_MAX);
+      while (--count > 0) {
+        if (filename[count] == '/') {
+          filename[count+1] = 0;
+          break;
+        }
+      };
+      strcat(filename, "models/");
+      strcat(filename, xml_file);
+    }
+  }
+
   NodeModel(const char *xml_file) {
     char filename[PATH_MAX];
-    ssize_t count = readlink("/proc/self/exe", filename, PATH_MAX);
-    while (--count > 0) {
-      if (filename[count] == '/') {
-        filename[count+1] = 0;
-        break;
-      }
-    };
-    strcat(filename, "models/");
-    strcat(filename, xml_file);
+    getPath(xml_file, filename);
     struct ncclTopoSystem* system;
-    ncclTopoGetSystem(filename, &system);
+    status = ncclTopoGetSystem(filename, &system);
+    if (status != ncclSuccess) return;
     systems.push_back(system);
     for (int i=0; i<getNumGpus()-1; i++) {
-      ncclTopoGetSystem(filename, &system);
+      status = ncclTopoGetSystem(filename, &system);
+      if (status != ncclSuccess) return;
       systems.push_back(system);
     }
     hostHash = ((uint64_t)rand() << 32) | rand();
@@ -8,18 +8,8 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
-struct graphInfo {
-  int pattern;
-  int nChannels;
-  int sameChannels;
-  float bwIntra;
-  float bwInter;
-  int typeIntra;
-  int typeInter;
-};
-
 struct allGatherInfo {
-  struct graphInfo graphInfo[NCCL_NUM_ALGORITHMS];
+  struct ncclTopoGraphInfo graphInfo[NCCL_NUM_ALGORITHMS];
   struct ncclTopoRanks topoRanks;
   int nc;
   bool pivotA2AEnabled;
@@ -40,13 +40,25 @@ THE SOFTWARE.
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <math.h>
 #include <cstdio>
 #include <iostream>
 #include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <climits>
+#include <algorithm>
 #include "model.h"
 #include "utils.h"
 #include "topo.h"
 #include "graph.h"
+#include "step_sim.h"
+#include "p2p_sizing.h"
+#include "../rccl_replayer/rcclLogParser.hpp"
 
 NodeModel *node_model;
 extern ncclNet_t* ncclNet;
@@ -165,45 +177,893 @@ NodeModelDesc model_descs[] = {
 NCCL_PARAM(MaxCTAs, "MAX_CTAS", MAXCHANNELS);
 NCCL_PARAM(MinCTAs, "MIN_CTAS", 1);
 
-int main(int argc,char* argv[])
-{
-  struct ncclComm *comm;
-  const int num_models = sizeof(model_descs) / sizeof(*model_descs);
-  int minCTAsEnv;
-  int maxCTAsEnv;
+static double timeUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec*1e-3;
+}
 
-  if (!cmdOptionExists(argv, argv + argc, "-m")) {
-    printf("Usage: ./topo_expl -m model_id [-n numNodes=1]\n");
-    printf("List of model_id:\n");
-    for (int i = 0; i < num_models; i++)
-      printf("  %d: %s\n", i, model_descs[i].description);
-    exit(0);
+// JSON has no representation for inf/nan, which the tuning model uses for
+// disabled algorithms in some configurations.
+static void jsonFloat(FILE* f, float v) {
+  if (isfinite(v)) fprintf(f, "%.6g", v);
+  else fprintf(f, "null");
+}
+
+static void jsonGraph(FILE* f, const char* name, struct ncclTopoGraph* graph, int ngpus) {
+  fprintf(f, "\"%s\":{\"pattern\":%d,\"nChannels\":%d,\"sameChannels\":%d,\"bwIntra\":", name,
+      graph->pattern, graph->nChannels, graph->sameChannels);
+  jsonFloat(f, graph->bwIntra);
+  fprintf(f, ",\"bwInter\":");
+  jsonFloat(f, graph->bwInter);
+  fprintf(f, ",\"typeIntra\":\"%s\",\"typeInter\":\"%s\",\"intra\":[",
+      topoPathTypeStr[graph->typeIntra], topoPathTypeStr[graph->typeInter]);
+  for (int c=0; c<graph->nChannels; c++) {
+    fprintf(f, "%s[", c ? "," : "");
+    for (int g=0; g<ngpus; g++) fprintf(f, "%s%d", g ? "," : "", graph->intra[c*ngpus+g]);
+    fprintf(f, "]");
+  }
+  fprintf(f, "],\"inter\":[");
+  for (int c=0; c<graph->nChannels; c++) {
+    fprintf(f, "%s[%d,%d]", c ? "," : "", graph->inter[c*2], graph->inter[c*2+1]);
   }
+  fprintf(f, "]}");
+}
 
-  int model_id = 0;
-  char *mi = getCmdOption(argv, argv + argc, "-m");
-  if (mi)
-    model_id = atol(mi);
+// Emit one model run as a single line of JSON. Everything before the "timing"
+// key is deterministic and is what the golden comparison looks at.
+static ncclResult_t jsonModel(FILE* f, int model_id, NodeModelDesc* desc, int nnodes, struct ncclComm* comm,
+    struct ncclTopoGraph* treeGraph, struct ncclTopoGraph* ringGraph, struct ncclTopoGraph* collNetGraph,
+    struct ncclTopoGraph* nvlsGraph, double searchUs, double totalUs) {
+  int nranks = comm[0].nRanks;
+  int ngpus = comm[0].topo->nodes[GPU].count;
+  fprintf(f, "{\"model\":%d,\"nnodes\":%d,\"nranks\":%d,\"desc\":\"%s\",\"graphs\":{", model_id, nnodes, nranks, desc->description);
+  jsonGraph(f, "ring", ringGraph, ngpus);
+  fprintf(f, ",");
+  jsonGraph(f, "tree", treeGraph, ngpus);
+  fprintf(f, ",");
+  jsonGraph(f, "collnet", collNetGraph, ngpus);
+  fprintf(f, ",");
+  jsonGraph(f, "nvls", nvlsGraph, ngpus);
+  fprintf(f, "},\"nChannels\":%d,\"rings\":[", comm[0].nChannels);
+  for (int c=0; c<comm[0].nChannels; c++) {
+    fprintf(f, "%s[", c ? "," : "");
+    for (int r=0; r<nranks; r++) fprintf(f, "%s%d", r ? "," : "", comm[0].channels[c].ring.userRanks[r]);
+    fprintf(f, "]");
+  }
+  // Trees as [up, down0, down1, down2] for every rank
+  fprintf(f, "],\"trees\":[");
+  for (int c=0; c<comm[0].nChannels; c++) {
+    fprintf(f, "%s[", c ? "," : "");
+    for (int r=0; r<nranks; r++) {
+      struct ncclTree* tree = &comm[r].channels[c].tree;
+      fprintf(f, "%s[%d,%d,%d,%d]", r ? "," : "", tree->up, tree->down[0], tree->down[1], tree->down[2]);
+    }
+    fprintf(f, "]");
+  }
+  // Number of GPU/NIC pairs relayed by each local GPU through PXN
+  struct ncclTopoSystem* system = comm[0].topo;
+  fprintf(f, "],\"pxnRelays\":[");
+  for (int g=0; g<ngpus; g++) {
+    int relays = 0;
+    for (int p=0; p<ngpus; p++) {
+      for (int n=0; n<system->nodes[NET].count; n++) {
+        struct ncclTopoLinkList* path = system->nodes[GPU].nodes[p].paths[NET]+n;
+        if (path->type != PATH_PXN) continue;
+        int proxyRank;
+        NCCLCHECK(ncclTopoGetIntermediateRank(system, system->nodes[GPU].nodes[p].gpu.rank, system->nodes[NET].nodes[n].id, &proxyRank));
+        if (proxyRank == system->nodes[GPU].nodes[g].gpu.rank) relays++;
+      }
+    }
+    fprintf(f, "%s%d", g ? "," : "", relays);
+  }
+  // Latency (us) and bandwidth (GB/s) tables computed by ncclTopoTuneModel
+  fprintf(f, "],\"tuning\":{");
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    fprintf(f, "%s\"%s\":{", c ? "," : "", ncclFuncStr[c]);
+    for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+      fprintf(f, "%s\"%s\":{", a ? "," : "", ncclAlgoStr[a]);
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        fprintf(f, "%s\"%s\":[", p ? "," : "", ncclProtoStr[p]);
+        jsonFloat(f, comm[0].latencies[c][a][p]);
+        fprintf(f, ",");
+        jsonFloat(f, comm[0].bandwidths[c][a][p]);
+        fprintf(f, "]");
+      }
+      fprintf(f, "}");
+    }
+    fprintf(f, "}");
+  }
+  // Algorithm/protocol selected for each collective at each size
+  fprintf(f, "},\"selection\":{");
+  for (int c=0; c<NCCL_NUM_FUNCTIONS; c++) {
+    fprintf(f, "%s\"%s\":[", c ? "," : "", ncclFuncStr[c]);
+    for (uint64_t len = 8; len <= 4294967296L; len *= 2) {
+      struct ncclInfo info;
+      float minTime = 3600000000.0;
+      info.comm = &comm[0];
+      info.coll = (ncclFunc_t)c;
+      info.nBytes = len;
+      info.algorithm = -1;
+      info.protocol = -1;
+      for (int a=0; a<NCCL_NUM_ALGORITHMS; a++) {
+        for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+          float time;
+          NCCLCHECK(ncclTopoGetAlgoTime(&info, a, p, 1, &time));
+          if (time >= 0 && time < minTime) {
+            info.algorithm = a;
+            info.protocol = p;
+            minTime = time;
+          }
+        }
+      }
+      fprintf(f, "%s[%lu,\"%s\",\"%s\",", len == 8 ? "" : ",", len,
+          info.algorithm == -1 ? "none" : ncclAlgoStr[info.algorithm], info.protocol == -1 ? "none" : ncclProtoStr[info.protocol]);
+      jsonFloat(f, minTime);
+      fprintf(f, "]");
+    }
+    fprintf(f, "]");
+  }
+  fprintf(f, "},\"timing\":{\"searchUs\":%.0f,\"totalUs\":%.0f}}\n", searchUs, totalUs);
+  return ncclSuccess;
+}
 
-  if (model_id >= num_models) {
-      printf("Invalid model_id %d\n", model_id);
-      exit(0);
+struct PredictOp {
+  ncclFunc_t coll;
+  ncclDataType_t datatype;
+  size_t count;
+  int repeat;
+};
+
+static const struct { const char* name; ncclFunc_t coll; } predictColls[] = {
+  { "broadcast", ncclFuncBroadcast }, { "reduce", ncclFuncReduce }, { "allgather", ncclFuncAllGather },
+  { "reducescatter", ncclFuncReduceScatter }, { "allreduce", ncclFuncAllReduce },
+};
+
+static const struct { const char* name; ncclDataType_t datatype; } predictTypes[] = {
+  { "int8", ncclInt8 }, { "uint8", ncclUint8 }, { "int32", ncclInt32 }, { "uint32", ncclUint32 },
+  { "int64", ncclInt64 }, { "uint64", ncclUint64 }, { "half", ncclFloat16 }, { "float16", ncclFloat16 },
+  { "float", ncclFloat32 }, { "float32", ncclFloat32 }, { "double", ncclFloat64 }, { "float64", ncclFloat64 },
+  { "bfloat16", ncclBfloat16 }, { "fp8e4m3", ncclFp8E4M3 }, { "fp8e5m2", ncclFp8E5M2 },
+};
+
+static const char* predictTypeStr(ncclDataType_t datatype) {
+  for (auto& t : predictTypes) if (t.datatype == datatype) return t.name;
+  return "unknown";
+}
+
+// Read a list of operations, one per line: <collective> <datatype> <count>[K|M|G] [repeat]
+// Counts are in elements (per rank for allgather/reducescatter, as in the NCCL API).
+static ncclResult_t readPredictOps(const char* file, std::vector<struct PredictOp>& ops) {
+  FILE* f = fopen(file, "r");
+  if (f == NULL) {
+    WARN("Unable to open %s : %s", file, strerror(errno));
+    return ncclSystemError;
+  }
+  char line[1024];
+  int lineNum = 0;
+  while (fgets(line, sizeof(line), f)) {
+    lineNum++;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = '\0';
+    char collStr[64], typeStr[64], countStr[64];
+    int repeat = 1;
+    int n = sscanf(line, "%63s %63s %63s %d", collStr, typeStr, countStr, &repeat);
+    if (n <= 0) continue;
+    struct PredictOp op;
+    op.coll = ncclNumFuncs;
+    op.datatype = ncclNumTypes;
+    if (n >= 3) {
+      for (auto& c : predictColls) if (strcasecmp(collStr, c.name) == 0) op.coll = c.coll;
+      for (auto& t : predictTypes) if (strcasecmp(typeStr, t.name) == 0) op.datatype = t.datatype;
+    }
+    char* end;
+    op.count = n >= 3 ? strtoull(countStr, &end, 0) : 0;
+    if (n >= 3) {
+      if (*end == 'K' || *end == 'k') op.count <<= 10;
+      else if (*end == 'M' || *end == 'm') op.count <<= 20;
+      else if (*end == 'G' || *end == 'g') op.count <<= 30;
+    }
+    op.repeat = repeat;
+    if (op.coll == ncclNumFuncs || op.datatype == ncclNumTypes || op.count == 0 || op.repeat <= 0) {
+      WARN("%s:%d : expected '<collective> <datatype> <count> [repeat]'", file, lineNum);
+      fclose(f);
+      return ncclInvalidArgument;
+    }
+    ops.push_back(op);
+  }
+  fclose(f);
+  return ncclSuccess;
+}
+
+// Run the same algorithm, protocol and channel selection as enqueue time on
+// rank 0 and report the predicted time of every operation.
+static ncclResult_t predictOps(struct ncclComm* comm, std::vector<struct PredictOp>& ops) {
+  double total = 0;
+  printf("Predicted times for %d ranks on %d nodes\n", comm->nRanks, comm->nNodes);
+  printf("%14s %9s %12s %14s %14s %7s %9s %9s %12s %7s\n", "Collective", "Type", "Count", "Bytes", "Algorithm", "Proto",
+      "nChannels", "nThreads", "Time (us)", "Repeat");
+  for (auto& op : ops) {
+    struct ncclInfo info;
+    memset(&info, 0, sizeof(info));
+    info.comm = comm;
+    info.coll = op.coll;
+    info.count = op.count;
+    info.datatype = op.datatype;
+    info.op = ncclSum;
+    NCCLCHECK(ncclInfoSetDerived(&info, comm->nRanks));
+    info.algorithm = NCCL_ALGO_UNDEF;
+    info.protocol = NCCL_PROTO_UNDEF;
+    NCCLCHECK(ncclTopoGetAlgoInfo(&info, comm->collNetSupport, comm->nvlsSupport, 1));
+    NCCLCHECK(ncclTopoGetChannelThreadInfo(&info));
+    float time;
+    NCCLCHECK(ncclTopoGetAlgoTime(&info, info.algorithm, info.protocol, 1, &time));
+    printf("%14s %9s %12lu %14lu %14s %7s %9d %9d %12.1f %7d\n", ncclFuncStr[op.coll], predictTypeStr(op.datatype), op.count,
+        info.nBytes, ncclAlgoStr[info.algorithm], ncclProtoStr[info.protocol], info.nChannels, info.nThreads, time, op.repeat);
+    total += (double)time * op.repeat;
   }
+  printf("Total predicted time %.1f us\n", total);
+  return ncclSuccess;
+}
+
+// Link model of the step simulator, in ns
+NCCL_PARAM(SimStepLat, "SIM_STEP_LAT_NS", 400);
+NCCL_PARAM(SimXgmiLat, "SIM_XGMI_LAT_NS", 800);
+NCCL_PARAM(SimPciLat, "SIM_PCI_LAT_NS", 2200);
+NCCL_PARAM(SimNetLat, "SIM_NET_LAT_NS", 5000);
+NCCL_PARAM(SimProxyLat, "SIM_PROXY_LAT_NS", 2000);
+NCCL_PARAM(SimLaunchLat, "SIM_LAUNCH_LAT_NS", 12000);
+
+struct SimLinkCtx {
+  struct ncclComm* comm;
+  struct ncclTopoGraph* graph;
+  bool p2p;
+};
+
+// Intra-node hops get the per-channel bandwidth of the graph. Network hops share
+// the bandwidth of the NIC the graph uses on that channel. Intra-node sends use the
+// path between the two GPUs whatever the channel.
+static void simLink(void* ctx, int channel, int src, int dst, struct ncclSimLink* link) {
+  struct SimLinkCtx* sim = (struct SimLinkCtx*)ctx;
+  struct ncclComm* comm = sim->comm;
+  struct ncclTopoGraph* graph = sim->graph;
+  int nRanks = comm->nRanks;
+  int c = graph->nChannels ? channel % graph->nChannels : 0;
+  int srcNode = src == nRanks ? -1 : comm->rankToNode[src];
+  int dstNode = dst == nRanks ? -1 : comm->rankToNode[dst];
+  int s, d;
+  if (srcNode == dstNode && sim->p2p && ncclTopoRankToIndex(comm[src].topo, src, &s) == ncclSuccess &&
+      ncclTopoRankToIndex(comm[src].topo, dst, &d) == ncclSuccess) {
+    struct ncclTopoLinkList* path = comm[src].topo->nodes[GPU].nodes[s].paths[GPU]+d;
+    link->id = src*(nRanks+1) + dst;
+    link->bw = path->bw;
+    link->latUs = (path->type <= PATH_NVB ? ncclParamSimXgmiLat() : ncclParamSimPciLat()) / 1000.0;
+    link->net = false;
+    return;
+  }
+  if (srcNode == dstNode) {
+    // Channels duplicated from the same graph channel share its links
+    link->id = (c*(nRanks+1) + src)*(nRanks+1) + dst;
+    link->bw = graph->bwIntra;
+    link->latUs = (graph->typeIntra <= PATH_NVB ? ncclParamSimXgmiLat() : ncclParamSimPciLat()) / 1000.0;
+    link->net = false;
+    return;
+  }
+  struct ncclTopoSystem* system = comm->topo;
+  int64_t netId = graph->inter[c*2+1];
+  int n = 0;
+  while (n < system->nodes[NET].count && system->nodes[NET].nodes[n].id != netId) n++;
+  int node = srcNode >= 0 ? srcNode : dstNode;
+  if (n < system->nodes[NET].count) {
+    // Both directions of a NIC are independent
+    link->id = -1 - ((node*NCCL_TOPO_MAX_NODES + n)*2 + (srcNode >= 0 ? 0 : 1));
+    link->bw = system->nodes[NET].nodes[n].net.bw;
+  } else {
+    link->id = -(1 << 24) - ((c*(nRanks+1) + src)*(nRanks+1) + dst);
+    link->bw = graph->bwInter;
+  }
+  link->latUs = ncclParamSimNetLat() / 1000.0;
+  link->net = true;
+}
+
+// Same chunk size as computeCollChunkInfo at enqueue time, buffSize is NCCL_BUFFSIZE
+static void simChunkInfo(struct ncclComm* comm, int algorithm, int protocol, int64_t nBytes, int nChannels,
+    int buffSize, struct ncclSimParams* params) {
+  const int buffSizes[NCCL_NUM_PROTOCOLS] = {
+    NCCL_LL_LINES_PER_THREAD*NCCL_LL_MAX_NTHREADS*NCCL_STEPS*(int)sizeof(union ncclLLFifoLine),
+    NCCL_LL128_ELEMS_PER_THREAD*NCCL_LL128_MAX_NTHREADS*NCCL_STEPS*(int)sizeof(uint64_t),
+    buffSize };
+  int stepSize = buffSizes[protocol] / NCCL_STEPS;
+  bool ringSimple = protocol == NCCL_PROTO_SIMPLE && algorithm == NCCL_ALGO_RING;
+  int chunkSteps = ringSimple ? ALLREDUCE_CHUNKSTEPS : 1;
+  int sliceSteps = ringSimple ? ALLREDUCE_SLICESTEPS : 1;
+  int chunkSize = stepSize * chunkSteps;
+  if (protocol == NCCL_PROTO_LL) chunkSize /= 2;
+  if (protocol == NCCL_PROTO_LL128) chunkSize = (chunkSize / NCCL_LL128_LINEELEMS) * NCCL_LL128_DATAELEMS;
+  if (algorithm == NCCL_ALGO_TREE && protocol == NCCL_PROTO_SIMPLE) {
+    int depth = comm->channels[0].tree.depth;
+    while (nBytes / (nChannels*chunkSize) < depth*8 && chunkSize > 131072) chunkSize /= 2;
+    while (nBytes / (nChannels*chunkSize) < depth*4 && chunkSize > 65536) chunkSize /= 2;
+    while (nBytes / (nChannels*chunkSize) < depth && chunkSize > 32768) chunkSize /= 2;
+  } else if (algorithm == NCCL_ALGO_COLLNET_CHAIN) {
+    int depth = comm->channels[0].collnetChain.depth;
+    stepSize = buffSizes[NCCL_PROTO_SIMPLE] / NCCL_STEPS;
+    chunkSize = std::min(256 * 1024, stepSize * chunkSteps);
+    while (nBytes / (nChannels * chunkSize) < depth * 64 && chunkSize > 131072) chunkSize /= 2;
+    while (nBytes / (nChannels * chunkSize) < depth * 8 && chunkSize > 65536) chunkSize /= 2;
+    while (nBytes / (nChannels * chunkSize) < depth && chunkSize > 32768) chunkSize /= 2;
+  } else if (algorithm == NCCL_ALGO_TREE && protocol == NCCL_PROTO_LL128) {
+    int nNodes = comm->nNodes;
+    float ppn = comm->nRanks / (float)nNodes;
+    float nstepsLL128 = 1+log2i(nNodes) + 0.1*ppn;
+    while (nBytes / (nChannels*chunkSize) < nstepsLL128*64/ppn && chunkSize > 131072) chunkSize /= 2;
+    while (nBytes / (nChannels*chunkSize) < nstepsLL128*16/ppn && chunkSize > 32768) chunkSize /= 2;
+  }
+  params->chunkSize = chunkSize;
+  params->stepSize = stepSize;
+  params->chunkSteps = chunkSteps;
+  params->sliceSteps = sliceSteps;
+  params->nSteps = NCCL_STEPS;
+}
+
+NCCL_PARAM(BuffSize, "BUFFSIZE", -2);
+
+// Simple protocol buffer size, as computeBuffSizes
+static int simBuffSize() {
+  int64_t env = ncclParamBuffSize();
+  return env > 0 ? (int)env : (1 << 22);
+}
+
+// Rings, trees and chains of all ranks in the layout of ncclSimParams. Channels
+// beyond comm->nChannels repeat the existing ones, as channel duplication does.
+struct SimTopo {
+  struct ncclComm* comm;
+  struct ncclTopoGraph* treeGraph;
+  struct ncclTopoGraph* ringGraph;
+  struct ncclTopoGraph* collNetGraph;
+  std::vector<int> rings, treeUp, treeDn, chainUp, chainDn;
+};
+
+static void simTopoInit(struct SimTopo* topo, struct ncclComm* comm, struct ncclTopoGraph* treeGraph,
+    struct ncclTopoGraph* ringGraph, struct ncclTopoGraph* collNetGraph) {
+  int nRanks = comm[0].nRanks;
+  int nChannels = std::max(1, comm[0].nChannels);
+  topo->comm = comm;
+  topo->treeGraph = treeGraph;
+  topo->ringGraph = ringGraph;
+  topo->collNetGraph = collNetGraph;
+  topo->rings.resize(MAXCHANNELS*nRanks);
+  topo->treeUp.resize(MAXCHANNELS*nRanks);
+  topo->chainUp.resize(MAXCHANNELS*nRanks);
+  topo->treeDn.resize(MAXCHANNELS*nRanks*NCCL_SIM_MAX_ARITY);
+  topo->chainDn.resize(MAXCHANNELS*nRanks*NCCL_SIM_MAX_ARITY);
+  for (int c=0; c<MAXCHANNELS; c++) {
+    int cc = c % nChannels;
+    for (int r=0; r<nRanks; r++) {
+      topo->rings[c*nRanks+r] = comm[0].channels[cc].ring.userRanks[r];
+      struct ncclTree* tree = &comm[r].channels[cc].tree;
+      struct ncclTree* chain = &comm[r].channels[cc].collnetChain;
+      topo->treeUp[c*nRanks+r] = tree->up;
+      topo->chainUp[c*nRanks+r] = chain->up;
+      for (int i=0; i<NCCL_SIM_MAX_ARITY; i++) {
+        topo->treeDn[(c*nRanks+r)*NCCL_SIM_MAX_ARITY+i] = tree->down[i];
+        topo->chainDn[(c*nRanks+r)*NCCL_SIM_MAX_ARITY+i] = chain->down[i];
+      }
+    }
+  }
+}
+
+static void simParamsInit(struct ncclSimParams* params, int nChannels, int64_t nBytes) {
+  memset(params, 0, sizeof(*params));
+  params->nChannels = nChannels;
+  params->nBytes = nBytes;
+  params->stepLatUs = ncclParamSimStepLat() / 1000.0;
+  params->proxyLatUs = ncclParamSimProxyLat() / 1000.0;
+  params->launchUs = ncclParamSimLaunchLat() / 1000.0;
+  params->linkFn = simLink;
+}
+
+// Simulate one collective. Returns ncclInvalidUsage for collectives and algorithms
+// the simulator does not model.
+static ncclResult_t simColl(struct SimTopo* topo, ncclFunc_t coll, int algorithm, int protocol, int64_t nBytes,
+    int nChannels, int buffSize, struct ncclSimResult* result, int* chunkSize = NULL) {
+  enum ncclSimColl simColl;
+  if (coll == ncclFuncAllReduce) simColl = ncclSimAllReduce;
+  else if (coll == ncclFuncAllGather) simColl = ncclSimAllGather;
+  else if (coll == ncclFuncReduceScatter) simColl = ncclSimReduceScatter;
+  else return ncclInvalidUsage;
+  if (algorithm != NCCL_ALGO_RING && algorithm != NCCL_ALGO_TREE && algorithm != NCCL_ALGO_COLLNET_CHAIN) return ncclInvalidUsage;
+  if (algorithm != NCCL_ALGO_RING && coll != ncclFuncAllReduce) return ncclInvalidUsage;
+  struct ncclComm* comm = topo->comm;
+  struct SimLinkCtx ctx = { comm, algorithm == NCCL_ALGO_RING ? topo->ringGraph :
+      algorithm == NCCL_ALGO_TREE ? topo->treeGraph : topo->collNetGraph, false };
+  struct ncclSimParams params;
+  simParamsInit(&params, nChannels, nBytes);
+  params.coll = simColl;
+  params.algorithm = (enum ncclSimAlgo)algorithm;
+  params.protocol = (enum ncclSimProto)protocol;
+  params.nRanks = comm->nRanks;
+  simChunkInfo(comm, algorithm, protocol, nBytes, nChannels, buffSize, &params);
+  params.rings = topo->rings.data();
+  params.treeUp = algorithm == NCCL_ALGO_COLLNET_CHAIN ? topo->chainUp.data() : topo->treeUp.data();
+  params.treeDn = algorithm == NCCL_ALGO_COLLNET_CHAIN ? topo->chainDn.data() : topo->treeDn.data();
+  params.linkCtx = &ctx;
+  if (chunkSize) *chunkSize = params.chunkSize;
+  if (ncclSimRun(&params, result) != 0) {
+    WARN("Step simulation of %s %s/%s deadlocked", ncclFuncStr[coll], ncclAlgoStr[algorithm], ncclProtoStr[protocol]);
+    return ncclInternalError;
+  }
+  return ncclSuccess;
+}
+
+// Simulate a send of nBytes from rank to peer over nChannels channels
+static ncclResult_t simP2p(struct SimTopo* topo, int rank, int peer, int64_t nBytes, int nChannels, int chunkSize,
+    struct ncclSimResult* result) {
+  struct ncclComm* comm = topo->comm;
+  int nRanks = comm->nRanks;
+  std::vector<int> rings(nChannels*nRanks, -1);
+  for (int c=0; c<nChannels; c++) {
+    rings[c*nRanks] = rank;
+    rings[c*nRanks+1] = peer;
+  }
+  struct SimLinkCtx ctx = { comm, topo->ringGraph, true };
+  struct ncclSimParams params;
+  simParamsInit(&params, nChannels, nBytes);
+  params.coll = ncclSimSendRecv;
+  params.algorithm = ncclSimAlgoRing;
+  params.protocol = ncclSimProtoSimple;
+  params.nRanks = nRanks;
+  params.chunkSize = params.stepSize = chunkSize;
+  params.chunkSteps = params.sliceSteps = 1;
+  params.nSteps = NCCL_STEPS;
+  params.rings = rings.data();
+  params.linkCtx = &ctx;
+  if (ncclSimRun(&params, result) != 0) {
+    WARN("Step simulation of send from %d to %d deadlocked", rank, peer);
+    return ncclInternalError;
+  }
+  return ncclSuccess;
+}
+
+// Replay the step schedule of AllReduce with every ring, tree and CollNet chain
+// protocol and compare with the analytical model of tuning.cc.
+static ncclResult_t simulateModel(struct ncclComm* comm, struct ncclTopoGraph* treeGraph, struct ncclTopoGraph* ringGraph,
+    struct ncclTopoGraph* collNetGraph) {
+  int nRanks = comm[0].nRanks;
+  int nChannels = comm[0].nChannels;
+  struct SimTopo topo;
+  simTopoInit(&topo, comm, treeGraph, ringGraph, collNetGraph);
+  const int algos[] = { NCCL_ALGO_RING, NCCL_ALGO_TREE, NCCL_ALGO_COLLNET_CHAIN };
+  printf("Simulated AllReduce for %d ranks on %d nodes\n", nRanks, comm->nNodes);
+  printf("%14s %14s %7s %9s %10s %12s %12s %8s\n", "Bytes", "Algorithm", "Proto", "nChannels", "chunkSize",
+      "Model (us)", "Sim (us)", "MaxUtil");
+  struct ncclSimResult best;
+  float bestTime = -1;
+  int bestAlgo = -1, bestProto = -1;
+  for (int64_t nBytes = 1024; nBytes <= (1LL << 30); nBytes *= 4) {
+    for (int a : algos) {
+      if (a == NCCL_ALGO_COLLNET_CHAIN && !comm->collNetSupport) continue;
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        if (a == NCCL_ALGO_COLLNET_CHAIN && p != NCCL_PROTO_SIMPLE) continue;
+        // LL moves 8 KB per slice and is never used at these sizes, skip the millions of events
+        if (p == NCCL_PROTO_LL && nBytes > (16LL << 20)) continue;
+        struct ncclInfo info;
+        memset(&info, 0, sizeof(info));
+        info.comm = comm;
+        info.coll = ncclFuncAllReduce;
+        info.nBytes = nBytes;
+        info.algorithm = a;
+        info.protocol = p;
+        float model;
+        NCCLCHECK(ncclTopoGetAlgoTime(&info, a, p, 1, &model));
+        if (model < 0) continue;
+        NCCLCHECK(ncclTopoGetChannelThreadInfo(&info));
+        int nc = std::max(1, std::min(info.nChannels, nChannels));
+
+        struct ncclSimResult result;
+        int chunkSize;
+        NCCLCHECK(simColl(&topo, ncclFuncAllReduce, a, p, nBytes, nc, simBuffSize(), &result, &chunkSize));
+        double maxUtil = 0;
+        for (auto& link : result.links) maxUtil = std::max(maxUtil, link.util);
+        printf("%14ld %14s %7s %9d %10d %12.1f %12.1f %8.2f\n", nBytes, ncclAlgoStr[a], ncclProtoStr[p], nc,
+            chunkSize, model, result.timeUs, maxUtil);
+        if (nBytes == (1LL << 30) && (bestTime < 0 || result.timeUs < bestTime)) {
+          best = result;
+          bestTime = result.timeUs;
+          bestAlgo = a;
+          bestProto = p;
+        }
+      }
+    }
+  }
+  if (bestTime < 0) return ncclSuccess;
+  // Most utilized links of the fastest configuration for the largest size
+  std::sort(best.links.begin(), best.links.end(), [](const struct ncclSimLinkStats& x, const struct ncclSimLinkStats& y) {
+      return x.util > y.util; });
+  printf("Link utilisation of %s/%s at %lld bytes (%zu links)\n", ncclAlgoStr[bestAlgo], ncclProtoStr[bestProto], 1LL << 30,
+      best.links.size());
+  printf("%12s %10s %14s %8s\n", "Link", "GB/s", "Bytes", "Util");
+  for (size_t i = 0; i < best.links.size() && i < 16; i++) {
+    printf("%12d %10.1f %14ld %8.2f\n", best.links[i].id, best.links[i].bw, best.links[i].bytes, best.links[i].util);
+  }
+  return ncclSuccess;
+}
+
+// Workload advisor. The calls of one rank in an NCCL_DEBUG=INFO NCCL_DEBUG_SUBSYS=COLL
+// log (the rcclReplayer input) are replayed through the tuning model and the step
+// simulator to find settings that shorten the whole workload.
+NCCL_PARAM(P2pNetChunkSize, "P2P_NET_CHUNKSIZE", (1 << 17));
+NCCL_PARAM(P2pPciChunkSize, "P2P_PCI_CHUNKSIZE", (1 << 17));
+NCCL_PARAM(P2pNvlChunkSize, "P2P_NVL_CHUNKSIZE", (1 << 19));
+RCCL_PARAM(P2pInflightBytes, "P2P_INFLIGHT_BYTES", (1LL << 30));
+
+// Recommendations saving less than this fraction of the workload time are not reported
+#define ADVISOR_MIN_GAIN 0.01
+
+struct WorkloadOp {
+  ncclFunc_t coll;          // ncclFuncSendRecv for sends
+  ncclDataType_t datatype;
+  size_t count;
+  int nRanks;
+  int peer;                 // Destination of sends, -1 for collectives
+  int64_t calls;
+  // Tuning model choice with the current settings
+  int64_t nBytes;
+  int algorithm, protocol, nChannels;
+  float model;
+  double time;              // Simulated when the simulator models the operation, model time otherwise
+  bool simulated;
+};
+
+struct Workload {
+  std::vector<struct WorkloadOp> ops;
+  std::map<std::string, int64_t> skipped;
+  int rank;                 // Global rank whose calls are counted
+};
+
+// Histogram of (collective, datatype, count, nranks) weighted by the number of calls
+static ncclResult_t readWorkload(const char* file, struct Workload* workload) {
+  FILE* f = fopen(file, "r");
+  if (f == NULL) {
+    WARN("Unable to open %s : %s", file, strerror(errno));
+    return ncclSystemError;
+  }
+  char* buf = NULL;
+  size_t size = 0;
+  struct LineItem li;
+  // Every rank logs its own calls, only count those of the lowest rank
+  workload->rank = INT_MAX;
+  while (getline(&buf, &size, f) > 0) {
+    if (ParseLineItem(buf, li)) workload->rank = std::min(workload->rank, li.globalRank);
+  }
+  if (workload->rank == INT_MAX) {
+    WARN("%s : no collective calls found, the log needs NCCL_DEBUG=INFO NCCL_DEBUG_SUBSYS=COLL", file);
+    free(buf);
+    fclose(f);
+    return ncclInvalidArgument;
+  }
+  rewind(f);
+  std::map<std::tuple<int, int, size_t, int, int>, int64_t> histogram;
+  while (getline(&buf, &size, f) > 0) {
+    if (!ParseLineItem(buf, li) || li.globalRank != workload->rank) continue;
+    const char* name = li.opName;
+    if (strncmp(name, "mscclFunc", strlen("mscclFunc")) == 0) name += strlen("mscclFunc");
+    ncclFunc_t coll = ncclNumFuncs;
+    int peer = -1;
+    for (auto& c : predictColls) if (strcasecmp(name, c.name) == 0) coll = c.coll;
+    if (strcmp(name, "Send") == 0) {
+      coll = ncclFuncSendRecv;
+      peer = li.root;
+    }
+    // Receives are the sends of the peers
+    if (strcmp(name, "Recv") == 0) continue;
+    if (coll == ncclNumFuncs || li.datatype < 0 || li.datatype >= ncclNumTypes) {
+      workload->skipped[name]++;
+      continue;
+    }
+    histogram[std::make_tuple((int)coll, li.datatype, li.count, li.nRanks, peer)]++;
+  }
+  free(buf);
+  fclose(f);
+  for (auto& h : histogram) {
+    struct WorkloadOp op;
+    memset(&op, 0, sizeof(op));
+    op.coll = (ncclFunc_t)std::get<0>(h.first);
+    op.datatype = (ncclDataType_t)std::get<1>(h.first);
+    op.count = std::get<2>(h.first);
+    op.nRanks = std::get<3>(h.first);
+    op.peer = std::get<4>(h.first);
+    op.calls = h.second;
+    workload->ops.push_back(op);
+  }
+  return ncclSuccess;
+}
+
+// Time of a collective limited to maxChannels channels with a Simple buffer of buffSize
+// bytes. The algorithm and protocol are those of the tuning model unless given. *time
+// is negative when the algorithm is not available.
+static ncclResult_t workloadCollTime(struct SimTopo* topo, struct WorkloadOp* op, int maxChannels, int buffSize,
+    int algorithm, int protocol, double* time, struct WorkloadOp* choice = NULL) {
+  struct ncclComm* comm = topo->comm;
+  struct ncclInfo info;
+  memset(&info, 0, sizeof(info));
+  info.comm = comm;
+  info.coll = op->coll;
+  info.count = op->count;
+  info.datatype = op->datatype;
+  info.op = ncclSum;
+  NCCLCHECK(ncclInfoSetDerived(&info, comm->nRanks));
+  info.algorithm = algorithm;
+  info.protocol = protocol;
+  if (algorithm == NCCL_ALGO_UNDEF || protocol == NCCL_PROTO_UNDEF) {
+    NCCLCHECK(ncclTopoGetAlgoInfo(&info, comm->collNetSupport, comm->nvlsSupport, 1));
+  }
+  float model;
+  NCCLCHECK(ncclTopoGetAlgoTime(&info, info.algorithm, info.protocol, 1, &model));
+  *time = model;
+  if (model < 0) return ncclSuccess;
+  info.nChannels = maxChannels;
+  NCCLCHECK(ncclTopoGetChannelThreadInfo(&info));
+  int nc = std::max(1, info.nChannels);
+  struct ncclSimResult result;
+  ncclResult_t ret = simColl(topo, op->coll, info.algorithm, info.protocol, info.nBytes, nc, buffSize, &result);
+  if (ret != ncclSuccess && ret != ncclInvalidUsage) return ret;
+  if (ret == ncclSuccess) *time = result.timeUs;
+  if (choice) {
+    choice->nBytes = info.nBytes;
+    choice->algorithm = info.algorithm;
+    choice->protocol = info.protocol;
+    choice->nChannels = nc;
+    choice->model = model;
+    choice->time = *time;
+    choice->simulated = ret == ncclSuccess;
+  }
+  return ncclSuccess;
+}
+
+static ncclResult_t workloadP2pTime(struct SimTopo* topo, struct Workload* workload, struct WorkloadOp* op,
+    int nChannelsPerPeer, int chunkSize, double* time) {
+  int64_t nBytes = op->count * ncclTypeSize(op->datatype);
+  // Small sends do not use all channels of the peer
+  int nc = std::max(1, (int)std::min<int64_t>(nChannelsPerPeer, DIVUP(nBytes, chunkSize)));
+  struct ncclSimResult result;
+  NCCLCHECK(simP2p(topo, workload->rank, op->peer, nBytes, nc, chunkSize, &result));
+  *time = result.timeUs;
+  return ncclSuccess;
+}
+
+// P2P chunk size as computeP2pBuffSizes, chunkSize being the NCCL_P2P_*_CHUNKSIZE value
+static int workloadP2pChunkSize(struct ncclComm* comm, int chunkSize, int buffSize, int nChannelsPerPeer) {
+  if (chunkSize * NCCL_STEPS > buffSize) chunkSize = buffSize / NCCL_STEPS;
+  return ncclP2pComputeChunkSize(chunkSize, rcclParamP2pInflightBytes(), comm->nRanks-1, nChannelsPerPeer, NCCL_STEPS);
+}
+
+struct WorkloadSettings {
+  int maxChannels;
+  int buffSize;
+  int p2pChunkSize;         // NCCL_P2P_*_CHUNKSIZE
+  int p2pnChannelsPerPeer;
+};
+
+// Total time of the workload with the given settings and the tuning model choices
+static ncclResult_t workloadTime(struct SimTopo* topo, struct Workload* workload, struct WorkloadSettings* settings,
+    double* total) {
+  *total = 0;
+  for (auto& op : workload->ops) {
+    double time;
+    if (op.coll == ncclFuncSendRecv) {
+      int chunkSize = workloadP2pChunkSize(topo->comm, settings->p2pChunkSize, settings->buffSize, settings->p2pnChannelsPerPeer);
+      NCCLCHECK(workloadP2pTime(topo, workload, &op, settings->p2pnChannelsPerPeer, chunkSize, &time));
+    } else if (op.simulated) {
+      NCCLCHECK(workloadCollTime(topo, &op, settings->maxChannels, settings->buffSize, op.algorithm, op.protocol, &time));
+    } else {
+      time = op.time;
+    }
+    *total += time * op.calls;
+  }
+  return ncclSuccess;
+}
+
+// saved is the time the setting saves over the whole workload, positive when it helps
+static void printAdvice(const char* setting, double saved, double base, int iterations) {
+  printf("  %-40s %12.1f us/step %7.1f%%\n", setting, saved / iterations, 100.0 * saved / base);
+}
+
+// Evaluate the workload of a log on this topology and report the buffer size, channel,
+// protocol and P2P settings that would shorten it, with the time saved per step.
+static ncclResult_t adviseWorkload(struct ncclComm* comm, struct ncclTopoGraph* treeGraph, struct ncclTopoGraph* ringGraph,
+    struct ncclTopoGraph* collNetGraph, struct Workload* workload, int iterations) {
+  struct SimTopo topo;
+  simTopoInit(&topo, comm, treeGraph, ringGraph, collNetGraph);
+  int nRanks = comm->nRanks;
+
+  std::map<int, int64_t> otherSizes;
+  std::vector<struct WorkloadOp> ops;
+  for (auto& op : workload->ops) {
+    if (op.nRanks != nRanks) otherSizes[op.nRanks] += op.calls;
+    else if (op.coll == ncclFuncSendRecv && (op.peer < 0 || op.peer >= nRanks || op.peer == workload->rank)) workload->skipped["Send"] += op.calls;
+    else ops.push_back(op);
+  }
+  workload->ops = ops;
+  for (auto& s : workload->skipped) printf("Skipping %ld %s calls, not modeled\n", s.second, s.first.c_str());
+  for (auto& o : otherSizes) {
+    printf("Skipping %ld calls on communicators of %d ranks, this topology has %d (see -n)\n", o.second, o.first, nRanks);
+  }
+  if (workload->rank >= nRanks) {
+    WARN("Log rank %d is outside of the %d ranks of this topology", workload->rank, nRanks);
+    return ncclInvalidArgument;
+  }
+  if (workload->ops.empty()) {
+    printf("No operations to evaluate\n");
+    return ncclSuccess;
+  }
+
+  struct WorkloadSettings current;
+  current.maxChannels = comm->nChannels;
+  current.buffSize = simBuffSize();
+  if (comm->nNodes > 1) current.p2pChunkSize = ncclParamP2pNetChunkSize();
+  else if (ncclTopoPathAllNVLink(comm->topo)) current.p2pChunkSize = ncclParamP2pNvlChunkSize();
+  else current.p2pChunkSize = ncclParamP2pPciChunkSize();
+  current.p2pnChannelsPerPeer = comm->p2pnChannelsPerPeer;
+  const char* p2pChunkEnv = comm->nNodes > 1 ? "NCCL_P2P_NET_CHUNKSIZE" :
+      ncclTopoPathAllNVLink(comm->topo) ? "NCCL_P2P_NVL_CHUNKSIZE" : "NCCL_P2P_PCI_CHUNKSIZE";
+
+  printf("Workload of rank %d for %d ranks on %d nodes, %d steps\n", workload->rank, nRanks, comm->nNodes, iterations);
+  printf("%14s %9s %12s %6s %14s %14s %7s %9s %12s %12s %10s\n", "Collective", "Type", "Count", "Peer", "Bytes", "Algorithm",
+      "Proto", "nChannels", "Model (us)", "Sim (us)", "Calls");
+  bool hasP2p = false;
+  int p2pChunkSize = workloadP2pChunkSize(comm, current.p2pChunkSize, current.buffSize, current.p2pnChannelsPerPeer);
+  for (auto& op : workload->ops) {
+    if (op.coll == ncclFuncSendRecv) {
+      hasP2p = true;
+      op.nBytes = op.count * ncclTypeSize(op.datatype);
+      op.algorithm = NCCL_ALGO_RING;
+      op.protocol = NCCL_PROTO_SIMPLE;
+      op.nChannels = current.p2pnChannelsPerPeer;
+      op.model = -1;
+      op.simulated = true;
+      NCCLCHECK(workloadP2pTime(&topo, workload, &op, current.p2pnChannelsPerPeer, p2pChunkSize, &op.time));
+      printf("%14s %9s %12lu %6d %14ld %14s %7s %9d %12s %12.1f %10ld\n", "Send", predictTypeStr(op.datatype), op.count,
+          op.peer, op.nBytes, "P2P", ncclProtoStr[op.protocol], op.nChannels, "-", op.time, op.calls);
+      continue;
+    }
+    double time;
+    NCCLCHECK(workloadCollTime(&topo, &op, current.maxChannels, current.buffSize, NCCL_ALGO_UNDEF, NCCL_PROTO_UNDEF, &time, &op));
+    char sim[32] = "-";
+    if (op.simulated) snprintf(sim, sizeof(sim), "%.1f", op.time);
+    printf("%14s %9s %12lu %6s %14ld %14s %7s %9d %12.1f %12s %10ld\n", ncclFuncStr[op.coll], predictTypeStr(op.datatype),
+        op.count, "-", op.nBytes, ncclAlgoStr[op.algorithm], ncclProtoStr[op.protocol], op.nChannels, op.model, sim, op.calls);
+  }
+  double base;
+  NCCLCHECK(workloadTime(&topo, workload, &current, &base));
+  printf("Time per step %.1f us\n", base / iterations);
+  printf("Recommendations (time saved per step):\n");
+  int nAdvice = 0;
+  char setting[64];
+
+  // Simple protocol buffer size
+  struct WorkloadSettings best = current, settings = current;
+  double bestTime = base, time;
+  for (int buffSize = 1 << 20; buffSize <= (1 << 24); buffSize *= 2) {
+    settings.buffSize = buffSize;
+    NCCLCHECK(workloadTime(&topo, workload, &settings, &time));
+    if (time < bestTime) { bestTime = time; best = settings; }
+  }
+  if (base - bestTime > ADVISOR_MIN_GAIN * base) {
+    snprintf(setting, sizeof(setting), "NCCL_BUFFSIZE=%d", best.buffSize);
+    printAdvice(setting, base - bestTime, base, iterations);
+    nAdvice++;
+  }
+
+  // Channel limits. More channels than the search found duplicate its channels.
+  settings = best = current;
+  bestTime = base;
+  for (int nc = std::max(1, current.maxChannels/4); nc <= std::min(MAXCHANNELS, current.maxChannels*2); nc *= 2) {
+    settings.maxChannels = nc;
+    NCCLCHECK(workloadTime(&topo, workload, &settings, &time));
+    if (time < bestTime) { bestTime = time; best = settings; }
+  }
+  if (base - bestTime > ADVISOR_MIN_GAIN * base) {
+    snprintf(setting, sizeof(setting), "%s=%d", best.maxChannels < current.maxChannels ? "NCCL_MAX_NCHANNELS" :
+        "NCCL_MIN_NCHANNELS", best.maxChannels);
+    printAdvice(setting, base - bestTime, base, iterations);
+    nAdvice++;
+  }
+
+  // Algorithm and protocol per size range, where the model choice is slower than the simulated best
+  struct Range { int64_t minBytes, maxBytes; double saved; };
+  std::map<std::tuple<int, int, int, int, int>, struct Range> ranges;
+  const int algos[] = { NCCL_ALGO_RING, NCCL_ALGO_TREE, NCCL_ALGO_COLLNET_CHAIN };
+  for (auto& op : workload->ops) {
+    if (op.coll == ncclFuncSendRecv || !op.simulated) continue;
+    double opBest = op.time;
+    int bestAlgo = op.algorithm, bestProto = op.protocol;
+    for (int a : algos) {
+      if (a == NCCL_ALGO_COLLNET_CHAIN && comm->collNetSupport != 1) continue;
+      for (int p=0; p<NCCL_NUM_PROTOCOLS; p++) {
+        if (p == NCCL_PROTO_LL128 && comm->topo->type != RCCL_TOPO_XGMI_ALL) continue;
+        if (p == NCCL_PROTO_LL && op.nBytes > (16LL << 20)) continue;
+        if (a == op.algorithm && p == op.protocol) continue;
+        struct WorkloadOp choice;
+        NCCLCHECK(workloadCollTime(&topo, &op, current.maxChannels, current.buffSize, a, p, &time, &choice));
+        if (time < 0 || !choice.simulated) continue;
+        if (time < opBest) { opBest = time; bestAlgo = a; bestProto = p; }
+      }
+    }
+    if (op.time - opBest < ADVISOR_MIN_GAIN * op.time) continue;
+    auto key = std::make_tuple((int)op.coll, op.algorithm, op.protocol, bestAlgo, bestProto);
+    auto it = ranges.find(key);
+    if (it == ranges.end()) ranges[key] = { op.nBytes, op.nBytes, 0 };
+    struct Range& range = ranges[key];
+    range.minBytes = std::min(range.minBytes, op.nBytes);
+    range.maxBytes = std::max(range.maxBytes, op.nBytes);
+    range.saved += (op.time - opBest) * op.calls;
+  }
+  int nRanges = 0;
+  for (auto& r : ranges) {
+    if (r.second.saved < ADVISOR_MIN_GAIN * base) continue;
+    snprintf(setting, sizeof(setting), "%s %ld-%ld B %s/%s->%s/%s", ncclFuncStr[std::get<0>(r.first)], r.second.minBytes,
+        r.second.maxBytes, ncclAlgoStr[std::get<1>(r.first)], ncclProtoStr[std::get<2>(r.first)],
+        ncclAlgoStr[std::get<3>(r.first)], ncclProtoStr[std::get<4>(r.first)]);
+    printAdvice(setting, r.second.saved, base, iterations);
+    nRanges++;
+  }
+  if (nRanges) printf("  (algorithm/protocol thresholds: NCCL_ALGO/NCCL_PROTO or a tuner plugin)\n");
+
+  if (hasP2p) {
+    // P2P chunk size
+    settings = best = current;
+    bestTime = base;
+    for (int chunkSize = NCCL_P2P_MIN_CHUNKSIZE; chunkSize * NCCL_STEPS <= current.buffSize; chunkSize *= 2) {
+      settings.p2pChunkSize = chunkSize;
+      NCCLCHECK(workloadTime(&topo, workload, &settings, &time));
+      if (time < bestTime) { bestTime = time; best = settings; }
+    }
+    if (base - bestTime > ADVISOR_MIN_GAIN * base) {
+      snprintf(setting, sizeof(setting), "%s=%d", p2pChunkEnv, best.p2pChunkSize);
+      printAdvice(setting, base - bestTime, base, iterations);
+      nAdvice++;
+    }
+
+    // Channels per peer. Single node gfx94x doubles NCCL_NCHANNELS_PER_PEER.
+    int factor = comm->topo->nodes[GPU].count == nRanks && IsArchMatch(comm->topo->nodes[GPU].nodes[0].gpu.gcn, "gfx94") ? 2 : 1;
+    settings = best = current;
+    bestTime = base;
+    for (int nc = factor; nc <= std::max(comm->p2pnChannels, factor); nc *= 2) {
+      settings.p2pnChannelsPerPeer = nc;
+      NCCLCHECK(workloadTime(&topo, workload, &settings, &time));
+      if (time < bestTime) { bestTime = time; best = settings; }
+    }
+    if (base - bestTime > ADVISOR_MIN_GAIN * base) {
+      snprintf(setting, sizeof(setting), "NCCL_NCHANNELS_PER_PEER=%d", best.p2pnChannelsPerPeer / factor);
+      printAdvice(setting, base - bestTime, base, iterations);
+      nAdvice++;
+    }
+  }
+  if (nAdvice + nRanges == 0) printf("  none, the current settings are within %.0f%% of the best found\n", ADVISOR_MIN_GAIN*100);
+  return ncclSuccess;
+}
+
+static int runModel(int model_id, NodeModelDesc* desc, int numNodes, FILE* json, std::vector<struct PredictOp>* ops, bool simulate,
+    struct Workload* workload, int iterations) {
+  struct ncclComm *comm;
+  int minCTAsEnv;
+  int maxCTAsEnv;
+  double startUs = timeUs();
 
   NetworkModel network;
   NodeModel* node;
 
   initCollNet();
 
-  NodeModelDesc *desc = &model_descs[model_id];
-  int numNodes = desc->num_nodes;
-  if (cmdOptionExists(argv, argv + argc, "-n")) {
-    char *numNodesStr = getCmdOption(argv, argv + argc, "-n");
-    if (numNodesStr)
-      numNodes = atol(numNodesStr);
-  }
+  if (numNodes <= 0) numNodes = desc->num_nodes;
   for (int i=0; i < numNodes; i++) {
       node = new NodeModel(desc->filename);
+      if (node->status != ncclSuccess) {
+        ncclResult_t ret = node->status;
+        delete node;
+        return ret;
+      }
       network.AddNode(node);
   }
 
@@ -269,11 +1129,13 @@ int main(int argc,char* argv[])
     NCCLCHECK(fillInfo(&comm[i], comm[i].peerInfo+comm[i].rank, 0));
   }
 
+  double searchStartUs = timeUs();
   for (int i = 0; i < nranks; i++) {
     node_model = network.GetNode(i);
     assert(node_model!=0);
-    initTransportsRank_1(&comm[i], allGather3Data, treeGraph[i], ringGraph[i], collNetGraph[i], nvlsGraph[i]);
+    NCCLCHECK(initTransportsRank_1(&comm[i], allGather3Data, treeGraph[i], ringGraph[i], collNetGraph[i], nvlsGraph[i]));
   }
+  double searchUs = timeUs() - searchStartUs;
 
   for (int i = 0; i < nranks; i++) {
     node_model = network.GetNode(i);
@@ -309,6 +1171,16 @@ int main(int argc,char* argv[])
     INFO(NCCL_TUNING, "%10ld %s %s time %f", info.nBytes, ncclAlgoStr[info.algorithm], ncclProtoStr[info.protocol], minTime);
   }
 
+  node_model = network.GetNode(0);
+  if (ops) NCCLCHECK(predictOps(&comm[0], *ops));
+  if (simulate) NCCLCHECK(simulateModel(comm, treeGraph, ringGraph, collNetGraph));
+  if (workload) NCCLCHECK(adviseWorkload(comm, treeGraph, ringGraph, collNetGraph, workload, iterations));
+
+  if (json) {
+    NCCLCHECK(jsonModel(json, model_id, desc, nnodes, comm, treeGraph, ringGraph, collNetGraph, nvlsGraph,
+        searchUs, timeUs() - startUs));
+  }
+
   for (int i = 0; i < nranks; i++) {
     free(comm[i].connectSend);
     free(comm[i].connectRecv);
@@ -325,3 +1197,383 @@ int main(int argc,char* argv[])
 
   return 0;
 }
+
+struct BatchResult {
+  int model_id;
+  int nnodes;
+  std::string line;
+  double searchUs;
+};
+
+// Run a model in a child process so that a crash or leak in one model does not
+// affect the others, and collect its JSON line through a pipe.
+static void runModelIsolated(int model_id, int numNodes, bool verbose, struct BatchResult* result) {
+  int fds[2];
+  result->model_id = model_id;
+  result->nnodes = numNodes > 0 ? numNodes : model_descs[model_id].num_nodes;
+  result->searchUs = 0;
+  char error[256] = "";
+  pid_t pid = -1;
+  // The child must not inherit, and print again, what is buffered so far
+  fflush(stdout);
+  if (pipe(fds) != 0 || (pid = fork()) < 0) {
+    snprintf(error, sizeof(error), "fork failed: %s", strerror(errno));
+  } else if (pid == 0) {
+    close(fds[0]);
+    if (!verbose) {
+      if (freopen("/dev/null", "w", stdout) == NULL) _exit(1);
+    }
+    FILE* json = fdopen(fds[1], "w");
+    int ret = runModel(model_id, &model_descs[model_id], numNodes, json, NULL, false, NULL, 1);
+    fclose(json);
+    _exit(ret);
+  } else {
+    close(fds[1]);
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0) result->line.append(buf, n);
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) snprintf(error, sizeof(error), "killed by signal %d", WTERMSIG(status));
+    else if (WEXITSTATUS(status) != 0) snprintf(error, sizeof(error), "exit status %d", WEXITSTATUS(status));
+  }
+  if (error[0]) {
+    char line[512];
+    snprintf(line, sizeof(line), "{\"model\":%d,\"nnodes\":%d,\"desc\":\"%s\",\"error\":\"%s\"}\n",
+        model_id, result->nnodes, model_descs[model_id].description, error);
+    result->line = line;
+    return;
+  }
+  size_t pos = result->line.find("\"searchUs\":");
+  if (pos != std::string::npos) result->searchUs = atof(result->line.c_str()+pos+strlen("\"searchUs\":"));
+}
+
+// Key of a JSON line: the '"model":X,"nnodes":Y' prefix.
+static std::string lineKey(const std::string& line) {
+  size_t end = line.find(",\"nranks\"");
+  if (end == std::string::npos) end = line.find(",\"desc\"");
+  return line.substr(0, end);
+}
+
+// Part of a JSON line compared against the golden set, i.e. everything but timing.
+static std::string lineBody(const std::string& line) {
+  std::string body = line.substr(0, line.find(",\"timing\""));
+  while (body.size() && (body.back() == '\n' || body.back() == ',')) body.pop_back();
+  return body;
+}
+
+static int compareGolden(const char* goldenFile, std::vector<struct BatchResult>& results) {
+  FILE* f = fopen(goldenFile, "r");
+  if (f == NULL) {
+    printf("Unable to open golden file %s: %s\n", goldenFile, strerror(errno));
+    return 1;
+  }
+  std::map<std::string, std::string> golden;
+  char* buf = NULL;
+  size_t size = 0;
+  while (getline(&buf, &size, f) > 0) {
+    std::string line(buf);
+    if (line.compare(0, 9, "{\"model\":") != 0) continue;
+    golden[lineKey(line)] = lineBody(line);
+  }
+  free(buf);
+  fclose(f);
+
+  int mismatches = 0;
+  for (auto& r : results) {
+    std::string key = lineKey(r.line);
+    auto it = golden.find(key);
+    if (it == golden.end()) {
+      printf("NEW      model %d nnodes %d (not in golden set)\n", r.model_id, r.nnodes);
+      continue;
+    }
+    std::string body = lineBody(r.line);
+    if (body != it->second) {
+      size_t d = 0;
+      while (d < body.size() && d < it->second.size() && body[d] == it->second[d]) d++;
+      size_t from = d > 60 ? d-60 : 0;
+      printf("MISMATCH model %d nnodes %d at offset %zu\n  golden: ...%s...\n  actual: ...%s...\n", r.model_id, r.nnodes, d,
+          it->second.substr(from, 120).c_str(), body.substr(from, 120).c_str());
+      mismatches++;
+    }
+    golden.erase(it);
+  }
+  for (auto& g : golden) printf("MISSING  %s}\n", g.first.c_str());
+  printf("Golden comparison: %zu runs, %d mismatches, %zu missing\n", results.size(), mismatches, golden.size());
+  return (mismatches || golden.size()) ? 1 : 0;
+}
+
+static int runBatch(const char* nodesList, const char* jsonFile, const char* goldenFile, bool verbose) {
+  const int num_models = sizeof(model_descs) / sizeof(*model_descs);
+  std::vector<int> nodeCounts;
+  if (nodesList) {
+    char* list = strdup(nodesList);
+    for (char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) nodeCounts.push_back(atoi(tok));
+    free(list);
+  } else {
+    nodeCounts.push_back(0); // Default node count of each model
+  }
+
+  std::vector<struct BatchResult> results;
+  int skipped = 0;
+  for (int m = 0; m < num_models; m++) {
+    // Some models refer to topologies that are not shipped in models/: leave them
+    // out of the results, and of the golden set, rather than record a failure.
+    char path[PATH_MAX];
+    NodeModel::getPath(model_descs[m].filename, path);
+    if (access(path, R_OK) != 0) {
+      printf("%3d: %-50s skipped, models/%s not found\n", m, model_descs[m].description, model_descs[m].filename);
+      skipped += nodeCounts.size();
+      continue;
+    }
+    for (int n : nodeCounts) {
+      struct BatchResult result;
+      runModelIsolated(m, n, verbose, &result);
+      printf("%3d: %-50s nnodes %2d %s search %10.0f us\n", m, model_descs[m].description, result.nnodes,
+          result.line.find("\"error\"") != std::string::npos ? "FAILED" : "ok    ", result.searchUs);
+      results.push_back(result);
+    }
+  }
+
+  if (jsonFile) {
+    FILE* f = fopen(jsonFile, "w");
+    if (f == NULL) {
+      printf("Unable to open %s: %s\n", jsonFile, strerror(errno));
+      return 1;
+    }
+    fprintf(f, "[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+      std::string line = results[i].line;
+      while (line.size() && line.back() == '\n') line.pop_back();
+      fprintf(f, "%s%s\n", line.c_str(), i+1 < results.size() ? "," : "");
+    }
+    fprintf(f, "]\n");
+    fclose(f);
+  }
+
+  // Search time outliers
+  std::vector<struct BatchResult*> sorted;
+  for (auto& r : results) sorted.push_back(&r);
+  std::sort(sorted.begin(), sorted.end(), [](struct BatchResult* a, struct BatchResult* b) { return a->searchUs > b->searchUs; });
+  double median = sorted.size() ? sorted[sorted.size()/2]->searchUs : 0;
+  printf("Slowest graph searches (median %.0f us):\n", median);
+  for (size_t i = 0; i < sorted.size() && i < 10; i++) {
+    printf("  %10.0f us  %5.1fx  model %d nnodes %d: %s\n", sorted[i]->searchUs, median > 0 ? sorted[i]->searchUs/median : 0,
+        sorted[i]->model_id, sorted[i]->nnodes, model_descs[sorted[i]->model_id].description);
+  }
+
+  int failed = 0;
+  for (auto& r : results) if (r.line.find("\"error\"") != std::string::npos) failed++;
+  printf("%zu runs, %d failed, %d skipped\n", results.size(), failed, skipped);
+
+  if (goldenFile) return compareGolden(goldenFile, results);
+  return 0;
+}
+
+// FNV-1a hash of the contents of a file.
+static bool hashFile(const char* path, uint64_t* hash, size_t* bytes) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) return false;
+  *hash = 0xcbf29ce484222325ULL;
+  *bytes = 0;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    *hash = (*hash ^ (unsigned char)c) * 0x100000001b3ULL;
+    (*bytes)++;
+  }
+  fclose(f);
+  return true;
+}
+
+static ncclResult_t xmlParseDump(const char* inFile, const char* outFile) {
+  struct ncclXml* xml;
+  NCCLCHECK(xmlAlloc(&xml));
+  ncclResult_t ret = ncclTopoGetXmlFromFile(inFile, xml, 1);
+  if (ret == ncclSuccess) ret = ncclTopoDumpXmlToFile(outFile, xml);
+  xmlFree(xml);
+  return ret;
+}
+
+// Parse every model topology file and dump it back. The dump must read back to
+// itself, and its hash, one '<file> <hash> <bytes>' line per file, is written to
+// outFile or compared against goldenFile so that parser changes can be checked to
+// load every model the same way.
+static int runXmlCheck(const char* outFile, const char* goldenFile) {
+  const int num_models = sizeof(model_descs) / sizeof(*model_descs);
+  char dump1[] = "/tmp/topo_expl_xml1_XXXXXX";
+  char dump2[] = "/tmp/topo_expl_xml2_XXXXXX";
+  int fd1 = mkstemp(dump1), fd2 = fd1 < 0 ? -1 : mkstemp(dump2);
+  if (fd1 < 0 || fd2 < 0) {
+    printf("Unable to create temporary files: %s\n", strerror(errno));
+    return 1;
+  }
+  close(fd1);
+  close(fd2);
+
+  std::map<std::string, std::string> results;
+  int failed = 0;
+  for (int m = 0; m < num_models; m++) {
+    const char* filename = model_descs[m].filename;
+    if (results.count(filename)) continue;
+    char path[PATH_MAX];
+    NodeModel::getPath(filename, path);
+    if (access(path, R_OK) != 0) continue;
+    uint64_t hash1 = 0, hash2 = 0;
+    size_t bytes1 = 0, bytes2 = 0;
+    const char* error = NULL;
+    if (xmlParseDump(path, dump1) != ncclSuccess || !hashFile(dump1, &hash1, &bytes1)) error = "parse failed";
+    else if (xmlParseDump(dump1, dump2) != ncclSuccess || !hashFile(dump2, &hash2, &bytes2)) error = "reparse failed";
+    else if (hash1 != hash2 || bytes1 != bytes2) error = "dump does not read back to itself";
+    if (error) {
+      printf("FAILED   %s: %s\n", filename, error);
+      failed++;
+      continue;
+    }
+    char line[PATH_MAX+64];
+    snprintf(line, sizeof(line), "%016lx %zu", (unsigned long)hash1, bytes1);
+    results[filename] = line;
+  }
+  unlink(dump1);
+  unlink(dump2);
+
+  if (outFile) {
+    FILE* f = fopen(outFile, "w");
+    if (f == NULL) {
+      printf("Unable to open %s: %s\n", outFile, strerror(errno));
+      return 1;
+    }
+    for (auto& r : results) fprintf(f, "%s %s\n", r.first.c_str(), r.second.c_str());
+    fclose(f);
+  }
+  printf("%zu files, %d failed\n", results.size(), failed);
+  if (goldenFile == NULL) return failed ? 1 : 0;
+
+  FILE* f = fopen(goldenFile, "r");
+  if (f == NULL) {
+    printf("Unable to open golden file %s: %s\n", goldenFile, strerror(errno));
+    return 1;
+  }
+  std::map<std::string, std::string> golden;
+  char name[PATH_MAX], value[64];
+  unsigned long bytes;
+  while (fscanf(f, "%4095s %63s %lu", name, value, &bytes) == 3) {
+    snprintf(value+strlen(value), sizeof(value)-strlen(value), " %lu", bytes);
+    golden[name] = value;
+  }
+  fclose(f);
+  int mismatches = 0;
+  for (auto& r : results) {
+    auto it = golden.find(r.first);
+    if (it == golden.end()) {
+      printf("NEW      %s (not in golden set)\n", r.first.c_str());
+      continue;
+    }
+    if (it->second != r.second) {
+      printf("MISMATCH %s: golden %s, actual %s\n", r.first.c_str(), it->second.c_str(), r.second.c_str());
+      mismatches++;
+    }
+    golden.erase(it);
+  }
+  for (auto& g : golden) printf("MISSING  %s\n", g.first.c_str());
+  printf("Golden comparison: %zu files, %d mismatches, %zu missing\n", results.size(), mismatches, golden.size());
+  return (failed || mismatches || golden.size()) ? 1 : 0;
+}
+
+int main(int argc,char* argv[])
+{
+  const int num_models = sizeof(model_descs) / sizeof(*model_descs);
+  bool batch = cmdOptionExists(argv, argv + argc, "-a");
+  char *xmlFile = getCmdOption(argv, argv + argc, "-x");
+
+  bool xmlCheck = cmdOptionExists(argv, argv + argc, "-t");
+
+  if (!batch && !xmlCheck && !xmlFile && !cmdOptionExists(argv, argv + argc, "-m")) {
+    printf("Usage: ./topo_expl -m model_id [-n numNodes=1] [-j output.json] [-p ops.txt] [-s] [-w rccl.log [-i steps=1]]\n");
+    printf("       ./topo_expl -x topo.xml [-n numNodes=1] [-j output.json] [-p ops.txt] [-s] [-w rccl.log [-i steps=1]]\n");
+    printf("       ./topo_expl -a [-n numNodes[,numNodes...]] [-j output.json] [-g golden.json] [-v]\n");
+    printf("       ./topo_expl -t [-j output.txt] [-g golden.txt]\n");
+    printf("  -x  use a topology XML file (e.g. from NCCL_TOPO_DUMP_FILE) instead of a built-in model\n");
+    printf("  -p  predict algorithm, protocol, channels and time of the operations listed in a file,\n");
+    printf("      one '<collective> <datatype> <count>[K|M|G] [repeat]' per line\n");
+    printf("  -s  simulate the step schedule of AllReduce for every algorithm and protocol, compare\n");
+    printf("      with the tuning model and report link utilisation (NCCL_SIM_*_LAT_NS set the link model)\n");
+    printf("  -w  evaluate the calls of an NCCL_DEBUG=INFO NCCL_DEBUG_SUBSYS=COLL log (as used by rcclReplayer)\n");
+    printf("      and recommend buffer, channel, protocol and P2P settings; -i is the number of steps\n");
+    printf("      in the log, to report savings per step\n");
+    printf("  -a  run all models, each in its own process, and print search time outliers\n");
+    printf("  -j  write graphs, channels, tuning tables and timings as JSON (one model per line)\n");
+    printf("  -g  compare results against a JSON file previously written with -j, ignoring timings\n");
+    printf("  -v  keep the output of each model in batch mode\n");
+    printf("  -t  parse every model XML file and dump it back, check that the dump reads back to itself\n");
+    printf("      and write (-j) or compare (-g) the hash of the dump of each file\n");
+    printf("List of model_id:\n");
+    for (int i = 0; i < num_models; i++)
+      printf("  %d: %s\n", i, model_descs[i].description);
+    exit(0);
+  }
+
+  char *jsonFile = getCmdOption(argv, argv + argc, "-j");
+  if (xmlCheck) return runXmlCheck(jsonFile, getCmdOption(argv, argv + argc, "-g"));
+  if (batch) {
+    return runBatch(getCmdOption(argv, argv + argc, "-n"), jsonFile, getCmdOption(argv, argv + argc, "-g"),
+        cmdOptionExists(argv, argv + argc, "-v"));
+  }
+
+  int model_id = 0;
+  NodeModelDesc xmlDesc;
+  NodeModelDesc *desc;
+  char xmlPath[PATH_MAX];
+  if (xmlFile) {
+    if (realpath(xmlFile, xmlPath) == NULL) {
+      printf("Unable to open %s: %s\n", xmlFile, strerror(errno));
+      return 1;
+    }
+    model_id = -1;
+    xmlDesc.num_nodes = 1;
+    xmlDesc.filename = xmlPath;
+    xmlDesc.description = xmlPath;
+    desc = &xmlDesc;
+  } else {
+    char *mi = getCmdOption(argv, argv + argc, "-m");
+    if (mi)
+      model_id = atol(mi);
+
+    if (model_id < 0 || model_id >= num_models) {
+        printf("Invalid model_id %d\n", model_id);
+        exit(0);
+    }
+    desc = &model_descs[model_id];
+  }
+
+  int numNodes = 0;
+  if (cmdOptionExists(argv, argv + argc, "-n")) {
+    char *numNodesStr = getCmdOption(argv, argv + argc, "-n");
+    if (numNodesStr)
+      numNodes = atol(numNodesStr);
+  }
+
+  std::vector<struct PredictOp> ops;
+  char *opsFile = getCmdOption(argv, argv + argc, "-p");
+  if (opsFile && readPredictOps(opsFile, ops) != ncclSuccess) return 1;
+
+  struct Workload workload;
+  char *workloadFile = getCmdOption(argv, argv + argc, "-w");
+  if (workloadFile && readWorkload(workloadFile, &workload) != ncclSuccess) return 1;
+  int iterations = 1;
+  char *iterationsStr = getCmdOption(argv, argv + argc, "-i");
+  if (iterationsStr) iterations = std::max(1, atoi(iterationsStr));
+
+  FILE* json = NULL;
+  if (jsonFile) {
+    json = fopen(jsonFile, "w");
+    if (json == NULL) {
+      printf("Unable to open %s: %s\n", jsonFile, strerror(errno));
+      return 1;
+    }
+  }
+  int ret = runModel(model_id, desc, numNodes, json, opsFile ? &ops : NULL,
+      cmdOptionExists(argv, argv + argc, "-s"), workloadFile ? &workload : NULL, iterations);
+  if (json) fclose(json);
+  return ret;
+}